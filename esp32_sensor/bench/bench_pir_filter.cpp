@@ -0,0 +1,271 @@
+// bench_pir_filter.cpp - фильтр PIR на трассах выхода датчика
+//
+// Трасса - фронты выхода PIR и ожидаемые начала движения:
+//
+//   # комментарий
+//   0 0                 время_мс уровень
+//   5000 1
+//   7400 0
+//   motion 5000         здесь должно быть срабатывание (± TRACE_MATCH_MS)
+//
+// Записанные трассы лежат в $PIR_TRACE_DIR (по умолчанию bench/pir_traces,
+// файлы *.txt). Сегменты трассы входов с платы (*.bin из /trace, см.
+// input_trace.h) в той же папке склеиваются в одну трассу без разметки:
+// для нее выводится только число срабатываний. К записанным трассам
+// добавляются сгенерированные: всплески HW-740,
+// проходы, дребезг внутри движения и долгое присутствие. Трасса
+// проигрывается через PirFilter с шагом PIR_SAMPLE_US, как в прошивке;
+// для сравнения считается и старый детектор - любой фронт LOW -> HIGH
+// после антифлуда.
+//
+//   PIR_TRACE_DIR=/path/to/traces program --bench pir_filter
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "hal_bench.h"
+#include "input_trace.h"
+#include "pir_filter.h"
+
+#define TRACE_MATCH_MS 500          // Допуск срабатывания от ожидаемого
+#define BENCH_COOLDOWN_MS 10000     // PIR_COOLDOWN из config.h (старый детектор)
+
+
+namespace {
+struct PirTrace {
+    std::string name;
+    std::vector<std::pair<uint32_t, uint8_t>> edges;   // мс, уровень
+    std::vector<uint32_t> motions;                     // Ожидаемые начала движения, мс
+    bool labeled = true;                               // false - трасса с платы, движения не размечены
+};
+
+struct ReplayResult {
+    int detected = 0;               // Совпали с ожидаемыми
+    int missed = 0;
+    int falseAlarms = 0;
+    int retriggers = 0;
+    double delayMs = 0;             // Средняя задержка срабатывания от начала движения
+    uint64_t samples = 0;
+};
+
+bool loadTrace(const char* path, PirTrace& t) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    const char* slash = strrchr(path, '/');
+    t.name = slash ? slash + 1 : path;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long ms;
+        unsigned level;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "motion %lu", &ms) == 1) t.motions.push_back(ms);
+        else if (sscanf(line, "%lu %u", &ms, &level) == 2) t.edges.push_back({(uint32_t)ms, (uint8_t)(level != 0)});
+    }
+    fclose(f);
+    return !t.edges.empty();
+}
+
+// Уровни PIR из сегментов трассы входов; перезагрузка платы - продолжение без скачка
+bool loadBinaryTrace(const std::vector<std::string>& paths, PirTrace& t) {
+    uint32_t base = 0, last = 0, anchor = 0;
+    bool first = true;
+    for (const std::string& path : paths) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) continue;
+        std::vector<uint8_t> data;
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+        fclose(f);
+        TraceReader rd(data.data(), data.size());
+        if (!rd.valid()) continue;
+        if (first || rd.boot()) {
+            base = last;
+            anchor = rd.baseMs();
+            first = false;
+        }
+        TraceRecord r;
+        while (rd.next(r)) {
+            last = base + (r.ms - anchor);
+            if (r.kind == TraceKind::PirLevel && r.len == 1) t.edges.push_back({last, r.data[0]});
+        }
+    }
+    t.labeled = false;
+    return !t.edges.empty();
+}
+
+std::vector<PirTrace> loadTraceDir(const char* dir) {
+    std::vector<PirTrace> out;
+    std::vector<std::string> segments;
+    DIR* d = opendir(dir);
+    if (!d) return out;
+    while (dirent* e = readdir(d)) {
+        size_t n = strlen(e->d_name);
+        std::string path = std::string(dir) + "/" + e->d_name;
+        if (n > 4 && strcmp(e->d_name + n - 4, ".bin") == 0) segments.push_back(path);
+        if (n < 5 || strcmp(e->d_name + n - 4, ".txt") != 0) continue;
+        PirTrace t;
+        if (loadTrace(path.c_str(), t)) out.push_back(t);
+    }
+    closedir(d);
+    std::sort(segments.begin(), segments.end());
+    PirTrace t;
+    t.name = "device trace (" + std::to_string(segments.size()) + " seg)";
+    if (!segments.empty() && loadBinaryTrace(segments, t)) out.push_back(t);
+    return out;
+}
+
+
+// ===== Сгенерированные трассы =====
+uint32_t rng = 12345;
+uint32_t nextRand(uint32_t n) {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) % n;
+}
+
+// Импульс [at, at+len) - два фронта
+void pulse(PirTrace& t, uint32_t at, uint32_t len) {
+    t.edges.push_back({at, 1});
+    t.edges.push_back({at + len, 0});
+}
+
+// Всплески HW-740: 1-8 мс, иногда пачкой; движения нет
+PirTrace glitchTrace() {
+    PirTrace t{"gen: glitches", {{0, 0}}, {}};
+    for (uint32_t at = 1000; at < 600000; at += 500 + nextRand(4000)) {
+        int burst = nextRand(4) == 0 ? 1 + nextRand(5) : 1;
+        for (int i = 0; i < burst; i++, at += 15 + nextRand(20)) pulse(t, at, 1 + nextRand(8));
+    }
+    return t;
+}
+
+// Проходы: HIGH 2-4 с (время удержания HW-740)
+PirTrace walkTrace() {
+    PirTrace t{"gen: walk-by", {{0, 0}}, {}};
+    for (uint32_t at = 5000; at < 600000; at += 15000 + nextRand(20000)) {
+        pulse(t, at, 2000 + nextRand(2000));
+        t.motions.push_back(at);
+    }
+    return t;
+}
+
+// Движение с провалами 1-5 мс внутри и всплесками вокруг
+PirTrace chatterTrace() {
+    PirTrace t{"gen: chatter + glitches", {{0, 0}}, {}};
+    for (uint32_t at = 5000; at < 600000; at += 20000 + nextRand(10000)) {
+        pulse(t, at - 3000, 3);
+        uint32_t end = at + 2500 + nextRand(1500);
+        uint32_t from = at;
+        while (from < end) {
+            uint32_t len = std::min(end - from, 100 + nextRand(600));
+            pulse(t, from, len);
+            from += len + 1 + nextRand(5);
+        }
+        t.motions.push_back(at);
+    }
+    return t;
+}
+
+// Человек в зоне минуту: один HIGH, повторы раз в PIR_RETRIGGER_MS
+PirTrace presenceTrace() {
+    PirTrace t{"gen: 60 s presence", {{0, 0}}, {}};
+    pulse(t, 5000, 60000);
+    t.motions.push_back(5000);
+    return t;
+}
+
+
+// Проигрывание с шагом PIR_SAMPLE_US; ожидаемое движение засчитывается один раз
+ReplayResult replay(const PirTrace& t, PirFilter& f) {
+    ReplayResult r;
+    f.reset();
+    std::vector<bool> matched(t.motions.size(), false);
+    uint32_t endMs = t.edges.back().first + 1000;
+    size_t next = 0;
+    bool level = false;
+    double delaySum = 0;
+    for (uint64_t us = 0; us <= (uint64_t)endMs * 1000; us += PIR_SAMPLE_US) {
+        uint32_t ms = (uint32_t)(us / 1000);
+        while (next < t.edges.size() && t.edges[next].first <= ms) level = t.edges[next++].second;
+        PirDecision d = f.sample(level, ms);
+        r.samples++;
+        if (d == PirDecision::Retrigger) r.retriggers++;
+        if (d != PirDecision::Start) continue;
+        bool hit = false;
+        for (size_t i = 0; i < t.motions.size(); i++) {
+            if (!matched[i] && ms >= t.motions[i] && ms - t.motions[i] <= TRACE_MATCH_MS) {
+                matched[i] = hit = true;
+                delaySum += ms - t.motions[i];
+                break;
+            }
+        }
+        if (hit) r.detected++;
+        else r.falseAlarms++;
+    }
+    r.missed = (int)t.motions.size() - r.detected;
+    r.delayMs = r.detected ? delaySum / r.detected : 0;
+    return r;
+}
+
+// Старый детектор: фронт LOW -> HIGH после антифлуда - уже движение
+int rawEdgeAlarms(const PirTrace& t) {
+    int alarms = 0;
+    uint32_t last = 0;
+    bool any = false;
+    for (const auto& e : t.edges) {
+        if (e.second && (!any || e.first - last > BENCH_COOLDOWN_MS)) {
+            bool expected = false;
+            for (uint32_t m : t.motions) expected |= e.first >= m && e.first - m <= TRACE_MATCH_MS;
+            alarms += !expected;
+            last = e.first;
+            any = true;
+        }
+    }
+    return alarms;
+}
+}
+
+
+SIM_BENCH(pir_filter) {
+    const char* dir = getenv("PIR_TRACE_DIR");
+    std::vector<PirTrace> traces = loadTraceDir(dir ? dir : "bench/pir_traces");
+    printf("  recorded traces: %zu from %s\n", traces.size(), dir ? dir : "bench/pir_traces");
+    traces.push_back(glitchTrace());
+    traces.push_back(walkTrace());
+    traces.push_back(chatterTrace());
+    traces.push_back(presenceTrace());
+
+    PirFilter filter;
+    int falseTotal = 0, missedTotal = 0, rawFalseTotal = 0;
+    for (const PirTrace& t : traces) {
+        ReplayResult r = replay(t, filter);
+        int rawFalse = rawEdgeAlarms(t);
+        if (!t.labeled) {
+            printf("  %-26s unlabeled, %zu edges: filter starts %d, retriggers %d (raw edge: %d)\n", t.name.c_str(),
+                   t.edges.size(), r.falseAlarms, r.retriggers, rawFalse);
+            continue;
+        }
+        printf("  %-26s motions %3zu: detected %3d, missed %d, false %d (raw edge: %d), "
+               "retriggers %d, delay %.0f ms\n",
+               t.name.c_str(), t.motions.size(), r.detected, r.missed, r.falseAlarms, rawFalse, r.retriggers,
+               r.delayMs);
+        falseTotal += r.falseAlarms;
+        missedTotal += r.missed;
+        rawFalseTotal += rawFalse;
+    }
+
+    // Цена одного отсчета: колбэк таймера раз в мс делает только это
+    PirTrace walk = walkTrace();
+    uint64_t samples = 0;
+    uint64_t t0 = sim::hostNs();
+    for (int i = 0; i < 5; i++) samples += replay(walk, filter).samples;
+    double nsPerSample = (double)(sim::hostNs() - t0) / samples;
+    printf("  cost: %.1f ns per sample (with trace stepping), %.4f%% of one core at 1 kHz\n", nsPerSample,
+           nsPerSample * 1000 / 1e9 * 100);
+    printf("  false alarms: %d filtered vs %d raw edge, missed %d\n", falseTotal, rawFalseTotal, missedTotal);
+    sim::report("false_alarms", falseTotal);
+    sim::report("missed", missedTotal);
+    sim::report("ns_per_sample", nsPerSample);
+}
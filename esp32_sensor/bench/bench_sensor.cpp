@@ -0,0 +1,288 @@
+// bench_sensor.cpp - логика датчика движения на ПК
+//
+// Время здесь виртуальное: delay() прошивки не спит, а двигает часы.
+// Фронт PIR подается через sim::setPin() - прерывание срабатывает сразу и
+// запускает опрос 1 кГц, отсчеты идут, пока бенчмарк двигает часы. Задача
+// отправки работает в своем потоке, как на втором ядре.
+#include <atomic>
+#include <thread>
+#include <LittleFS.h>
+#include "hal_bench.h"
+#include "hal_sim.h"
+#include "pir_capture.h"
+#include "event_store.h"
+#include "boot_timer.h"
+#include "wifi_fast.h"
+
+#define BENCH_PIR_PIN 18    // PIR_PIN из config.h
+#define BENCH_LED_PIN 48    // STATUS_LED из config.h
+#define BENCH_WIFI_CACHE "/wifi.bin"   // WIFI_CACHE_FILE из config.h
+
+// Подключение к WiFi на плате: сканирование каналов, ассоциация, DHCP
+#define BENCH_WIFI_SCAN_MS 2500
+#define BENCH_WIFI_ASSOC_MS 300
+#define BENCH_WIFI_DHCP_MS 1200
+
+extern PirCapture pir;
+extern std::atomic<uint32_t> edgesHandled;
+extern EventStore store;
+extern BootTimer boot;
+extern WifiFastConnect wifiLink;
+extern const char* WIFI_SSID;            // secrets.h
+extern const char* WIFI_PASS;
+
+namespace {
+std::atomic<uint64_t> sendCount{0};
+std::atomic<uint64_t> lastSendNs{0};
+std::atomic<uint64_t> lastSendVirtUs{0};
+double setupMs = 0;                  // Первый запуск (виртуальное время)
+double coldReadyMs = 0;
+
+// Ждем, пока задача отправки обработает все пойманные фронты
+bool waitEdgesHandled() {
+    uint64_t t0 = sim::hostNs();
+    while (edgesHandled < pir.captured()) {
+        if (sim::hostNs() - t0 > 1000000000ull) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+}
+
+
+static void bootSensor() {
+    static bool booted = false;
+    if (booted) return;
+    booted = true;
+    sim::serialEnabled(false);
+    sim::useVirtualClock(true);
+    sim::setFsRoot("/tmp/esp32_sensor_bench_fs");
+    sim::clearFs();
+    // Сервер отвечает 200 и отмечает момент отправки (пульс не в счет)
+    sim::httpClient().handler = [](const String&, const String& body, String& resp) {
+        resp = "{\"status\":\"ok\"}";
+        if (body.startsWith("type=heartbeat")) return 200;
+        lastSendNs = sim::hostNs();
+        lastSendVirtUs = sim::nowUs();
+        sendCount++;
+        return 200;
+    };
+    sim::wifi().scanMs = BENCH_WIFI_SCAN_MS;
+    sim::wifi().connectDelayMs = BENCH_WIFI_ASSOC_MS;
+    sim::wifi().dhcpMs = BENCH_WIFI_DHCP_MS;
+    uint64_t t0 = sim::nowUs();
+    setup();
+    setupMs = (sim::nowUs() - t0) / 1000.0;
+    // WiFi и прогрев PIR заканчиваются в loop()
+    while (!boot.ready()) loop();
+    coldReadyMs = (sim::nowUs() - t0) / 1000.0;
+}
+
+// Перезапуск подключения (как после сброса); время до подключения в мс
+static double reconnectWifi() {
+    WiFi.disconnect();
+    uint64_t t0 = sim::nowUs();
+    wifiLink.begin(LittleFS, BENCH_WIFI_CACHE, WIFI_SSID, WIFI_PASS);
+    while (wifiLink.poll() != WifiChange::Connected && sim::nowUs() - t0 < 60000000ull) sim::advanceMs(10);
+    return (sim::nowUs() - t0) / 1000.0;
+}
+
+
+// Запуск после сброса: setup() без ожиданий, WiFi по кэшу точки и адреса
+SIM_BENCH(boot) {
+    bootSensor();
+    char lines[BOOT_MAX_STAGES * 64];
+    boot.format(lines, sizeof(lines));
+    printf("  first boot (no WiFi cache):\n%s", lines);
+    printf("  setup():                %8.1f ms (was 3000 + WiFi wait + 30000 warm-up)\n", setupMs);
+    printf("  ready (all stages):     %8.1f ms\n", coldReadyMs);
+
+    double full = wifiLink.stats().lastConnectMs;
+    double fast = reconnectWifi();       // Кэш записан при первом подключении
+    WifiLinkStats st = wifiLink.stats();
+    sim::wifi().channel = 11;            // Точку перенесли на другой канал: кэш не подходит
+    double stale = reconnectWifi();
+    sim::wifi().channel = 6;
+    stale = max(stale, reconnectWifi()); // И обратно (кэш теперь с каналом 11)
+    printf("  WiFi, scan + DHCP:      %8.1f ms\n", full);
+    printf("  WiFi, cached BSSID/IP:  %8.1f ms (fast attempts %u, misses %u)\n", fast, st.fastAttempts,
+           st.fastMisses);
+    printf("  WiFi, stale cache:      %8.1f ms (fallback after %d ms)\n", stale, WIFI_FAST_TIMEOUT_MS);
+    sim::report("setup_ms", setupMs);
+    sim::report("wifi_fast_ms", fast);
+    sim::report("wifi_stale_ms", stale);
+}
+
+
+// Чистый фронт уходит, как только в окне набралось PIR_ON_SAMPLES HIGH
+// (PIR_MIN_RUN подряд набираются раньше): 40 мс на 1 кГц. Это цена фильтра
+// всплесков - прерывание без фильтра отправляло за 0 мс.
+#define EDGE_TO_SEND_MS (PIR_ON_SAMPLES * PIR_SAMPLE_US / 1000)
+
+SIM_BENCH(motion_edge) {
+    bootSensor();
+    const int N = 2000;
+    sim::Samples virt, host;
+    uint64_t sentBefore = sendCount;
+    int missed = 0;
+
+    for (int i = 0; i < N; i++) {
+        sim::setPin(BENCH_PIR_PIN, LOW);
+        sim::advanceMs(20000);   // Больше PIR_COOLDOWN, серия мигания успевает закончиться
+
+        uint64_t before = sendCount;
+        uint32_t decided = pir.captured();
+        uint64_t v0 = sim::nowUs();
+        sim::setPin(BENCH_PIR_PIN, HIGH);
+        // Фильтр решает через PIR_ON_SAMPLES отсчетов: часы идут по 1 мс
+        uint64_t h0 = sim::hostNs();
+        while (pir.captured() == decided && sim::nowUs() - v0 < 1000000) {
+            h0 = sim::hostNs();            // Решение - внутри последнего шага часов
+            sim::advanceMs(1);
+        }
+        while (sendCount == before && sim::hostNs() - h0 < 1000000000ull) std::this_thread::yield();
+        if (sendCount == before) {
+            missed++;
+            continue;
+        }
+        host.add((lastSendNs - h0) / 1000.0);
+        virt.add((lastSendVirtUs - v0) / 1000.0);
+    }
+    virt.print("edge -> send (device time)", "ms");
+    host.print("decision -> send (host wakeup)", "us");
+    printf("  events sent: %llu, missed: %d\n", (unsigned long long)(sendCount - sentBefore), missed);
+    // Решение - на шаге часов, где набрался последний отсчет: допуск 1 мс
+    bool latencyOk = virt.count() && virt.percentile(0) >= EDGE_TO_SEND_MS &&
+                     virt.percentile(100) <= EDGE_TO_SEND_MS + 1;
+    printf("  expected edge -> send: %d ms (PIR_ON_SAMPLES at 1 kHz) -> %s\n", EDGE_TO_SEND_MS,
+           latencyOk ? "ok" : "FAILED");
+    host.report("edge_to_send_us");
+    sim::report("edge_to_send_ms", virt.percentile(50));
+    sim::report("edge_latency_errors", !latencyOk);
+    sim::report("missed", missed);
+
+    // Светодиод мигает по таймеру, пока задача уже свободна
+    waitEdgesHandled();
+    sim::setPin(BENCH_PIR_PIN, LOW);
+    sim::advanceMs(20000);
+    waitEdgesHandled();
+    uint32_t writes0 = sim::pinWrites(BENCH_LED_PIN);
+    sim::setPin(BENCH_PIR_PIN, HIGH);
+    sim::advanceMs(100);
+    waitEdgesHandled();
+    sim::advanceMs(1400);
+    printf("  LED writes in 1.5 s after send: %u (timer-driven blink)\n", sim::pinWrites(BENCH_LED_PIN) - writes0);
+}
+
+
+// Всплески HW-740 в несколько мс будят опрос, но движением не считаются
+SIM_BENCH(pir_glitches) {
+    bootSensor();
+    const int GLITCHES = 1000;
+    const int MOTIONS = 50;
+    sim::setPin(BENCH_PIR_PIN, LOW);
+    sim::advanceMs(20000);
+    waitEdgesHandled();
+    uint32_t raw0 = pir.rawEdges(), decided0 = pir.captured(), glitches0 = pir.glitches(), samples0 = pir.samples();
+
+    for (int i = 0; i < GLITCHES; i++) {
+        sim::setPin(BENCH_PIR_PIN, HIGH);
+        sim::advanceMs(1 + i % 8);
+        sim::setPin(BENCH_PIR_PIN, LOW);
+        sim::advanceMs(200);
+    }
+    waitEdgesHandled();
+    uint32_t falseMotions = pir.captured() - decided0;
+    double samplesPerGlitch = (double)(pir.samples() - samples0) / GLITCHES;
+    bool idle = !pir.sampling();
+
+    uint32_t decided1 = pir.captured();
+    for (int i = 0; i < MOTIONS; i++) {
+        sim::setPin(BENCH_PIR_PIN, HIGH);
+        sim::advanceMs(2500);              // Удержание выхода HW-740
+        sim::setPin(BENCH_PIR_PIN, LOW);
+        sim::advanceMs(5000);
+        waitEdgesHandled();
+    }
+    uint32_t detected = (pir.captured() - decided1) / 2;   // Начало и конец
+
+    printf("  glitches 1-8 ms:   %d (%u raw edges), motion decisions %u, counted as glitches %u\n", GLITCHES,
+           pir.rawEdges() - raw0, falseMotions, pir.glitches() - glitches0);
+    printf("  sampling per glitch: %.0f samples at 1 kHz, then timer stopped: %s\n", samplesPerGlitch,
+           idle ? "yes" : "NO");
+    printf("  2.5 s motions:     %u of %d detected\n", detected, MOTIONS);
+    sim::report("false_motions", falseMotions);
+    sim::report("missed_motions", MOTIONS - (int)detected);
+}
+
+
+// Обрыв WiFi: события копятся в PSRAM и журнале, после связи уходят пачками
+SIM_BENCH(store_forward) {
+    bootSensor();
+    const int N = 5000;
+    const int COOLDOWN_MS = 10001;      // PIR_COOLDOWN + 1
+    auto defaultHandler = sim::httpClient().handler;
+
+    sim::advanceMs(COOLDOWN_MS);         // Прошлые бенчмарки не мешают антифлуду
+    sim::wifi().available = false;
+    loop();                              // loop() замечает потерю WiFi
+    EventStoreStats s0 = store.stats();
+
+    uint64_t t0 = sim::hostNs();
+    for (int i = 0; i < N; i++) {
+        sim::setPin(BENCH_PIR_PIN, HIGH);
+        sim::advanceMs(100);               // Дольше порога фильтра
+        sim::setPin(BENCH_PIR_PIN, LOW);
+        sim::advanceMs(COOLDOWN_MS);
+        if (i % 8 == 7) waitEdgesHandled();
+    }
+    waitEdgesHandled();
+    double storeUs = (sim::hostNs() - t0) / 1000.0 / N;
+    EventStoreStats s1 = store.stats();
+
+    // Перезагрузка во время обрыва: очередь читается из журнала заново
+    EventStore reloaded;
+    uint64_t r0 = sim::hostNs();
+    reloaded.begin(LittleFS, "/queue", store.capacity(), 1);
+    double reloadMs = (sim::hostNs() - r0) / 1e6;
+
+    // Сервер принимает пачки и проверяет порядок и время событий
+    std::atomic<int> batches{0}, received{0}, outOfOrder{0};
+    std::atomic<uint32_t> lastSeq{0};
+    sim::httpClient().handler = [&](const String& url, const String& body, String& resp) {
+        if (url.indexOf("/events") < 0) return defaultHandler(url, body, resp);
+        const char* p = strchr(body.c_str(), '\n');
+        for (; p && *++p; p = strchr(p, '\n')) {
+            unsigned long seq, ts;
+            unsigned boot;
+            char name[16];
+            if (sscanf(p, "%lu;%15[^;];%u;%lu", &seq, name, &boot, &ts) != 4) continue;
+            if (seq != lastSeq + 1) outOfOrder++;
+            lastSeq = seq;
+            received++;
+        }
+        batches++;
+        resp = "{\"status\":\"ok\"}";
+        return 200;
+    };
+    lastSeq = store.peek(0).seq - 1;
+
+    sim::wifi().available = true;
+    uint64_t d0 = sim::hostNs();
+    loop();                              // Связь вернулась - задача отправки выгружает очередь
+    while (store.pending() > 0 && sim::hostNs() - d0 < 10000000000ull) std::this_thread::yield();
+    double drainMs = (sim::hostNs() - d0) / 1e6;
+    sim::httpClient().handler = defaultHandler;
+    EventStoreStats s2 = store.stats();
+
+    printf("  events during outage:  %d (stored %u, dropped %u)\n", N, s1.stored - s0.stored, s1.dropped - s0.dropped);
+    printf("  store cost:            %.1f us host per event, %u bytes to flash\n", storeUs,
+           s1.flashBytes - s0.flashBytes);
+    printf("  reload after reboot:   %zu events in %.2f ms\n", reloaded.pending(), reloadMs);
+    printf("  drain after reconnect: %d events in %d batches, %.1f ms host time, out of order %d\n",
+           received.load(), batches.load(), drainMs, outOfOrder.load());
+    printf("  head file writes:      %u (one per batch), pending now %zu\n", s2.headWrites - s1.headWrites,
+           store.pending());
+    sim::report("store_us_per_event", storeUs);
+    sim::report("dropped", s1.dropped - s0.dropped);
+}
@@ -6,9 +6,41 @@
 #define BUTTON_PIN 0            // Кнопка BOOT на S3 (GPIO0)
 
 // Настройки для ESP32-S3
-#define HEARTBEAT_INTERVAL 30000    // 30 секунд
+#define HEARTBEAT_INTERVAL 30000    // 30 секунд между пульсами (сервер ждет SENSOR_SILENCE_MS)
 #define PIR_COOLDOWN 10000          // 10 секунд антифлуд
-#define MOTION_SENSITIVITY 1        // 1 срабатывание = отправка
+#define MOTION_SENSITIVITY 1        // Срабатываний фильтра PIR за MOTION_CONFIRM_MS на одну отправку
+#define MOTION_CONFIRM_MS 30000     // Окно подтверждения для MOTION_SENSITIVITY > 1
+#define LED_BLINK_MS 100            // Фаза мигания светодиода
+#define PIR_WARMUP_MS 30000         // Прогрев PIR после включения: фронты раньше не считаются
+#define LOOP_IDLE_MS 10             // Пауза loop() (WiFi и /metrics)
+
+// Задача отправки (фронты PIR, ACK и повторы UDP)
+#define SENDER_TASK_CORE 0          // Ядро сети
+#define SENDER_TASK_STACK 8192
+#define SENDER_TASK_PRIORITY 2      // Выше loop(): фронт обрабатывается сразу
+#define SENDER_POLL_MS 10           // Просыпаться для повторов UDP без фронтов
+
+// Передача событий на сервер
+#define SENSOR_ID "pir_sensor"      // Имя датчика на сервере
+#define USE_UDP_TRANSPORT true      // false = только HTTP /event
+#define UDP_RETRY_MS 30             // Первый повтор кадра без ACK
+#define UDP_MAX_RETRIES 4           // Затем событие уходит через HTTP
+
+// Быстрое подключение к WiFi (точка, канал и адрес с прошлого запуска)
+#define WIFI_CACHE_FILE "/wifi.bin"
+
+// Трасса входов: уровни PIR и WiFi (input_trace.h, проверка на ПК - --bench pir_filter)
+#define TRACE_ENABLED true
+#define TRACE_DIR "/trace"
+#define TRACE_SEGMENT_BYTES 16384
+#define TRACE_MAX_SEGMENTS 16       // До 256 КБ флеша, старые сегменты удаляются
+#define TRACE_FLUSH_MS 5000         // Сброс буфера трассы во флеш
+
+// Очередь событий на время без связи (PSRAM + LittleFS)
+#define STORE_DIR "/queue"
+#define STORE_CAPACITY 8192         // Событий (16 байт каждое в PSRAM)
+#define STORE_BATCH 64              // Событий в одном POST /events
+#define STORE_RETRY_MS 5000         // Пауза после неудачной выгрузки
 
 // Режим USB CDC (для Serial через USB)
 #define USE_USB_CDC true            // true = использовать USB для Serial
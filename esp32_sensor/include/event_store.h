@@ -0,0 +1,292 @@
+// event_store.h - очередь неотправленных событий на время без связи
+//
+// События, которые не ушли на сервер, копятся в кольце в PSRAM и
+// дублируются в журнал LittleFS, чтобы пережить перезагрузку.
+// Журнал бережет флеш:
+//   - записи по 16 байт только дописываются в файлы-сегменты (STORE_DIR/<n>.log);
+//   - сегмент удаляется целиком, когда все его записи доставлены;
+//   - номер первой недоставленной записи (файл head) пишется один раз на пачку,
+//     а не на каждое событие.
+// Каждая запись несет seq, bootId и время датчика (millis) - сервер по ним
+// отсеивает повторы и восстанавливает, когда событие случилось.
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "sensor_proto.h"
+
+#define STORE_RECORD_SIZE 16
+#define STORE_SEGMENT_RECORDS 1024     // 16 КБ на файл сегмента
+#define STORE_MAX_SEGMENTS 32
+#define STORE_RECORD_MAGIC 0xE5
+
+
+struct StoredEvent {
+    uint32_t seq;                      // Сквозной номер, растет и между перезагрузками
+    uint32_t timestampMs;              // millis() датчика в момент события
+    uint16_t bootId;                   // Загрузка, к которой относится timestampMs
+    SensorEvent event;
+};
+
+struct EventStoreStats {
+    uint32_t stored;                   // Принято в очередь
+    uint32_t delivered;                // Подтверждено сервером
+    uint32_t dropped;                  // Вытеснено при переполнении
+    uint32_t flashBytes;               // Записано в журнал
+    uint32_t headWrites;               // Перезаписей файла head
+};
+
+
+class EventStore {
+public:
+    ~EventStore() { free(ring_); }
+
+    // Загрузка недоставленных событий из журнала; capacity - записей в PSRAM
+    bool begin(fs::FS& fs, const char* dir, size_t capacity, uint16_t bootId) {
+        if (ring_ || capacity == 0) return false;
+        ring_ = (StoredEvent*)ps_malloc(capacity * sizeof(StoredEvent));
+        if (!ring_) ring_ = (StoredEvent*)malloc(capacity * sizeof(StoredEvent));
+        if (!ring_) return false;
+        fs_ = &fs;
+        capacity_ = capacity;
+        bootId_ = bootId;
+        snprintf(dir_, sizeof(dir_), "%s", dir);
+        fs.mkdir(dir_);
+
+        readHead();
+        loadSegments();
+        return true;
+    }
+
+    // Событие, которое сейчас не удалось отправить
+    bool push(SensorEvent event, uint32_t timestampMs) {
+        if (!ring_) return false;
+        if (count_ == capacity_) {
+            // Места нет: теряем самое старое, новое важнее
+            headSeq_ = ring_[head_].seq + 1;
+            head_ = (head_ + 1) % capacity_;
+            count_--;
+            stats_.dropped++;
+        }
+        StoredEvent& e = ring_[(head_ + count_) % capacity_];
+        e.seq = ++lastSeq_;
+        e.timestampMs = timestampMs;
+        e.bootId = bootId_;
+        e.event = event;
+        count_++;
+        stats_.stored++;
+        appendRecord(e);
+        return true;
+    }
+
+    size_t pending() const { return count_; }
+    size_t capacity() const { return capacity_; }
+
+    // i-е по старшинству недоставленное событие (i < pending())
+    const StoredEvent& peek(size_t i) const { return ring_[(head_ + i) % capacity_]; }
+
+    // Сервер подтвердил n самых старых событий
+    void commit(size_t n) {
+        if (n > count_) n = count_;
+        if (n == 0) return;
+        headSeq_ = peek(n - 1).seq + 1;
+        writeHead();
+        dropDeliveredSegments();
+        head_ = (head_ + n) % capacity_;
+        count_ -= n;
+        stats_.delivered += n;
+    }
+
+    const EventStoreStats& stats() const { return stats_; }
+
+private:
+    struct Segment {
+        uint32_t id;
+        uint32_t lastSeq;              // Последняя запись в сегменте
+    };
+
+    void segmentPath(uint32_t id, char* buf, size_t size) const {
+        snprintf(buf, size, "%s/%08lx.log", dir_, (unsigned long)id);
+    }
+
+    static uint8_t crc8(const uint8_t* p, size_t n) {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < n; i++) {
+            crc ^= p[i];
+            for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    // [0] magic [1] событие [2..3] bootId [4..7] seq [8..11] время [12..14] 0 [15] crc8
+    static void encodeRecord(const StoredEvent& e, uint8_t* r) {
+        memset(r, 0, STORE_RECORD_SIZE);
+        r[0] = STORE_RECORD_MAGIC;
+        r[1] = (uint8_t)e.event;
+        r[2] = (uint8_t)e.bootId;
+        r[3] = (uint8_t)(e.bootId >> 8);
+        for (int i = 0; i < 4; i++) {
+            r[4 + i] = (uint8_t)(e.seq >> (8 * i));
+            r[8 + i] = (uint8_t)(e.timestampMs >> (8 * i));
+        }
+        r[15] = crc8(r, 15);
+    }
+
+    static bool decodeRecord(const uint8_t* r, StoredEvent& e) {
+        if (r[0] != STORE_RECORD_MAGIC || r[15] != crc8(r, 15)) return false;
+        e.event = (SensorEvent)r[1];
+        e.bootId = (uint16_t)(r[2] | r[3] << 8);
+        e.seq = 0;
+        e.timestampMs = 0;
+        for (int i = 0; i < 4; i++) {
+            e.seq |= (uint32_t)r[4 + i] << (8 * i);
+            e.timestampMs |= (uint32_t)r[8 + i] << (8 * i);
+        }
+        return true;
+    }
+
+    void appendRecord(const StoredEvent& e) {
+        // Новый сегмент: текущий заполнен или после сбоя в нем битый хвост
+        if (!segFile_ || segRecords_ >= STORE_SEGMENT_RECORDS) {
+            if (segFile_) segFile_.close();
+            if (segmentCount_ == STORE_MAX_SEGMENTS) return;   // Журнал переполнен, событие только в PSRAM
+            uint32_t id = segmentCount_ ? segments_[segmentCount_ - 1].id + 1 : 1;
+            segments_[segmentCount_++] = {id, 0};
+            char path[48];
+            segmentPath(id, path, sizeof(path));
+            segFile_ = fs_->open(path, "a");
+            segRecords_ = 0;
+            if (!segFile_) return;
+        }
+        uint8_t r[STORE_RECORD_SIZE];
+        encodeRecord(e, r);
+        segFile_.write(r, sizeof(r));
+        segFile_.flush();
+        segRecords_++;
+        segments_[segmentCount_ - 1].lastSeq = e.seq;
+        stats_.flashBytes += sizeof(r);
+    }
+
+    void readHead() {
+        headSeq_ = 1;
+        char path[48];
+        snprintf(path, sizeof(path), "%s/head", dir_);
+        fs::File f = fs_->open(path, "r");
+        if (!f) return;
+        uint8_t b[4];
+        if (f.read(b, 4) == 4) headSeq_ = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+        f.close();
+    }
+
+    void writeHead() {
+        char path[48];
+        snprintf(path, sizeof(path), "%s/head", dir_);
+        fs::File f = fs_->open(path, "w");
+        if (!f) return;
+        uint8_t b[4] = {(uint8_t)headSeq_, (uint8_t)(headSeq_ >> 8), (uint8_t)(headSeq_ >> 16),
+                        (uint8_t)(headSeq_ >> 24)};
+        f.write(b, 4);
+        f.close();
+        stats_.headWrites++;
+    }
+
+    // Сегменты по возрастанию id; в RAM попадают недоставленные записи
+    void loadSegments() {
+        lastSeq_ = headSeq_ - 1;
+        fs::File dir = fs_->open(dir_, "r");
+        uint32_t ids[STORE_MAX_SEGMENTS];
+        size_t n = 0;
+        for (fs::File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+            unsigned long id;
+            if (n < STORE_MAX_SEGMENTS && sscanf(f.name(), "%8lx.log", &id) == 1) ids[n++] = (uint32_t)id;
+            f.close();
+        }
+        dir.close();
+        std::sort(ids, ids + n);
+
+        bool tornTail = false;
+        for (size_t i = 0; i < n; i++) {
+            char path[48];
+            segmentPath(ids[i], path, sizeof(path));
+            fs::File f = fs_->open(path, "r");
+            Segment seg = {ids[i], 0};
+            uint8_t r[STORE_RECORD_SIZE];
+            size_t records = 0;
+            tornTail = false;
+            while (f.read(r, sizeof(r)) == sizeof(r)) {
+                records++;
+                StoredEvent e;
+                if (!decodeRecord(r, e)) continue;   // Запись оборвана сбоем питания
+                if (e.seq > seg.lastSeq) seg.lastSeq = e.seq;
+                if (e.seq > lastSeq_) lastSeq_ = e.seq;
+                if (e.seq >= headSeq_) loadRecord(e);
+            }
+            tornTail = f.size() % STORE_RECORD_SIZE != 0;
+            f.close();
+
+            if (seg.lastSeq < headSeq_) {
+                fs_->remove(path);                   // Все доставлено
+            } else {
+                segments_[segmentCount_++] = seg;
+                segRecords_ = records;
+            }
+        }
+        // Дописываем в последний сегмент, если он цел и не заполнен
+        if (segmentCount_ > 0 && !tornTail && segRecords_ < STORE_SEGMENT_RECORDS) {
+            char path[48];
+            segmentPath(segments_[segmentCount_ - 1].id, path, sizeof(path));
+            segFile_ = fs_->open(path, "a");
+        }
+    }
+
+    void loadRecord(const StoredEvent& e) {
+        if (count_ == capacity_) {
+            head_ = (head_ + 1) % capacity_;
+            count_--;
+            stats_.dropped++;
+        }
+        ring_[(head_ + count_) % capacity_] = e;
+        count_++;
+    }
+
+    void dropDeliveredSegments() {
+        size_t keep = 0;
+        bool lastDropped = false;
+        for (size_t i = 0; i < segmentCount_; i++) {
+            bool isLast = i == segmentCount_ - 1;
+            if (segments_[i].lastSeq < headSeq_ && (!isLast || segRecords_ >= STORE_SEGMENT_RECORDS)) {
+                char path[48];
+                segmentPath(segments_[i].id, path, sizeof(path));
+                if (isLast) {
+                    segFile_.close();
+                    lastDropped = true;
+                }
+                fs_->remove(path);
+            } else {
+                segments_[keep++] = segments_[i];
+            }
+        }
+        segmentCount_ = keep;
+        if (lastDropped) segRecords_ = STORE_SEGMENT_RECORDS;   // Следующая запись - новый сегмент
+    }
+
+    fs::FS* fs_ = nullptr;
+    char dir_[24];
+    uint16_t bootId_ = 0;
+
+    // Кольцо в PSRAM
+    StoredEvent* ring_ = nullptr;
+    size_t capacity_ = 0;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    uint32_t headSeq_ = 1;             // Первая недоставленная запись (файл head)
+    uint32_t lastSeq_ = 0;
+
+    // Журнал
+    Segment segments_[STORE_MAX_SEGMENTS];
+    size_t segmentCount_ = 0;
+    fs::File segFile_;                 // Открытый на дозапись последний сегмент
+    size_t segRecords_ = 0;
+
+    EventStoreStats stats_ = {};
+};
@@ -0,0 +1,126 @@
+// pir_capture.h - движение от PIR датчика: фронт будит опрос, окно решает
+//
+// Прерывание на CHANGE только запускает периодический esp_timer: выход
+// датчика опрашивается раз в PIR_SAMPLE_US, и каждый отсчет идет в
+// PirFilter (pir_filter.h). Решения фильтра - начало, повтор и конец
+// движения - записываются в lock-free очередь и будят задачу-обработчик.
+// Когда окно опустело и движения нет, таймер сам останавливается до
+// следующего фронта: без движения процессор не тратит на PIR ничего,
+// а во время движения - один короткий колбэк в миллисекунду.
+//
+// Всплеск в несколько мс будит опрос, но до порога фильтра не доходит
+// и считается в glitches(). Смены уровня в отсчетах можно писать в
+// трассу входов (input_trace.h) для проверки фильтра на ПК.
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "input_trace.h"
+#include "lockfree_queue.h"
+#include "pir_filter.h"
+
+#define PIR_QUEUE_SLOTS 32             // Решений в очереди (степень двойки)
+
+
+struct PirEdge {
+    int64_t timeUs;                    // esp_timer_get_time(): начало серии HIGH или конец движения
+    uint8_t level;                     // HIGH - движение (начало или повтор), LOW - конец
+    bool retrigger;                    // Повтор: движение продолжается дольше PIR_RETRIGGER_MS
+};
+
+
+class PirCapture {
+public:
+    // consumer - задача, которую будит каждое решение фильтра
+    void begin(uint8_t pin, TaskHandle_t consumer, const PirFilterConfig& cfg = PirFilterConfig()) {
+        pin_ = pin;
+        consumer_ = consumer;
+        filter_ = PirFilter(cfg);
+        esp_timer_create_args_t args = {};
+        args.callback = onSample;
+        args.arg = this;
+        args.name = "pir";
+        esp_timer_create(&args, &timer_);
+        instance_ = this;
+        attachInterrupt(digitalPinToInterrupt(pin), onEdge, CHANGE);
+        if (digitalRead(pin) == HIGH) wake();    // Движение уже идет
+    }
+
+    bool pop(PirEdge& e) { return edges_.tryPop(e); }
+
+    // Писать смены уровня выхода датчика (по отсчетам) в трассу
+    void traceTo(InputTrace* trace) { trace_ = trace; }
+
+    uint32_t captured() const { return captured_; }     // Решений в очереди за все время
+    uint32_t overflows() const { return overflows_; }   // Очередь была полна
+    uint32_t rawEdges() const { return rawEdges_; }     // Фронтов на входе
+    uint32_t samples() const { return samples_; }       // Отсчетов через фильтр
+    uint32_t glitches() const { return glitches_; }     // Пробуждений без движения
+    bool sampling() const { return esp_timer_is_active(timer_); }
+
+private:
+    // Запуск опроса из прерывания (esp_timer_start_* безопасны в ISR);
+    // уже запущенный таймер просто продолжает работать
+    void wake() { esp_timer_start_periodic(timer_, PIR_SAMPLE_US); }
+
+    static void IRAM_ATTR onEdge() {
+        PirCapture* self = instance_;
+        self->rawEdges_++;
+        self->wake();
+    }
+
+    static void onSample(void* arg) {
+        PirCapture* self = (PirCapture*)arg;
+        int64_t now = esp_timer_get_time();
+        bool high = digitalRead(self->pin_) == HIGH;
+        if (high != self->lastHigh_) {
+            self->lastHigh_ = high;
+            if (self->trace_) self->trace_->record(TraceKind::PirLevel, (uint8_t)high);
+        }
+        PirDecision d = self->filter_.sample(high, (uint32_t)(now / 1000));
+        self->samples_++;
+        if (d != PirDecision::None) {
+            self->sawMotion_ = true;
+            // Начало движения - с первого отсчета последней серии HIGH
+            int64_t at = d == PirDecision::Start ? now - (int64_t)(self->filter_.run() - 1) * PIR_SAMPLE_US : now;
+            self->push(at, d == PirDecision::End ? LOW : HIGH, d == PirDecision::Retrigger);
+        }
+        if (!self->filter_.idle()) return;
+
+        esp_timer_stop(self->timer_);
+        if (!self->sawMotion_) self->glitches_++;
+        self->sawMotion_ = false;
+        // Фронт между последним отсчетом и остановкой не запустил таймер (он еще шел)
+        if (digitalRead(self->pin_) == HIGH) self->wake();
+    }
+
+    void push(int64_t timeUs, uint8_t level, bool retrigger) {
+        bool ok = edges_.tryPushWith([&](PirEdge& e) {
+            e.timeUs = timeUs;
+            e.level = level;
+            e.retrigger = retrigger;
+        });
+        if (!ok) {
+            overflows_++;
+            return;
+        }
+        captured_++;
+        xTaskNotifyGive(consumer_);
+    }
+
+    uint8_t pin_ = 0;
+    TaskHandle_t consumer_ = nullptr;
+    esp_timer_handle_t timer_ = nullptr;
+    PirFilter filter_;                 // Только в колбэке таймера
+    bool sawMotion_ = false;
+    bool lastHigh_ = false;            // Уровень последнего отсчета (для трассы)
+    InputTrace* trace_ = nullptr;
+    LockFreeQueue<PirEdge, PIR_QUEUE_SLOTS> edges_;
+    std::atomic<uint32_t> captured_{0};
+    std::atomic<uint32_t> overflows_{0};
+    std::atomic<uint32_t> rawEdges_{0};
+    std::atomic<uint32_t> samples_{0};
+    std::atomic<uint32_t> glitches_{0};
+
+    static inline PirCapture* instance_ = nullptr;
+};
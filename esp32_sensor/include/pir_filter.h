@@ -0,0 +1,100 @@
+// pir_filter.h - решение "есть движение" по окну отсчетов PIR
+//
+// HW-740 иногда выдает на выходе короткие всплески в несколько мс, и
+// одиночный фронт LOW -> HIGH давал ложную тревогу. Здесь выход датчика
+// опрашивается с частотой 1 кГц, последние 64 отсчета лежат в одном
+// 64-битном слове (младший бит - самый новый), а решение принимается
+// за постоянное время на каждый отсчет:
+//   - число HIGH в окне ведется сложением и вычитанием уходящего бита;
+//   - длина последней серии HIGH - число младших единиц (ctz инверсии).
+//
+// Начало движения: в окне не меньше onSamples HIGH, и последние minRun
+// отсчетов подряд HIGH. Конец: HIGH в окне не больше offSamples (между
+// порогами - гистерезис). После конца новое движение не начинается
+// holdoffMs. Движение дольше retriggerMs выдает повторное срабатывание.
+//
+// Цена фильтра - задержка: чистое движение решается через onSamples
+// отсчетов, с настройками ниже фронт уходит на сервер через 40 мс, а не
+// сразу по прерыванию. Проверка: --bench motion_edge.
+//
+// Класс без Arduino и таймеров: одна и та же логика работает в прошивке
+// (pir_capture.h) и в хостовой проверке на записанных трассах.
+#pragma once
+
+#include <stdint.h>
+
+
+// ===== Настройки =====
+#define PIR_SAMPLE_US 1000             // Период опроса: 1 кГц
+#define PIR_WINDOW 64                  // Отсчетов в окне (биты uint64_t)
+#define PIR_ON_SAMPLES 40              // HIGH в окне для начала движения (40 мс из 64)
+#define PIR_MIN_RUN 16                 // ...и столько последних отсчетов подряд HIGH
+#define PIR_OFF_SAMPLES 8              // HIGH в окне не больше - движение кончилось
+#define PIR_HOLDOFF_MS 2000            // После конца движения новое не начинается
+#define PIR_RETRIGGER_MS 20000         // Повторное срабатывание при долгом движении, 0 - нет
+
+
+enum class PirDecision : uint8_t { None, Start, Retrigger, End };
+
+struct PirFilterConfig {
+    uint8_t onSamples = PIR_ON_SAMPLES;
+    uint8_t minRun = PIR_MIN_RUN;
+    uint8_t offSamples = PIR_OFF_SAMPLES;
+    uint32_t holdoffMs = PIR_HOLDOFF_MS;
+    uint32_t retriggerMs = PIR_RETRIGGER_MS;
+};
+
+
+class PirFilter {
+public:
+    explicit PirFilter(const PirFilterConfig& cfg = PirFilterConfig()) : cfg_(cfg) {}
+
+    void reset() {
+        window_ = 0;
+        ones_ = 0;
+        active_ = false;
+        holdoffUntil_ = 0;
+        lastTrigger_ = 0;
+    }
+
+    // Очередной отсчет; nowMs - время отсчета (для hold-off и повторов)
+    PirDecision sample(bool high, uint32_t nowMs) {
+        ones_ += (uint8_t)high - (uint8_t)(window_ >> (PIR_WINDOW - 1));
+        window_ = (window_ << 1) | (uint64_t)high;
+
+        if (!active_) {
+            if (ones_ < cfg_.onSamples || run() < cfg_.minRun || (int32_t)(nowMs - holdoffUntil_) < 0) {
+                return PirDecision::None;
+            }
+            active_ = true;
+            lastTrigger_ = nowMs;
+            return PirDecision::Start;
+        }
+        if (ones_ <= cfg_.offSamples) {
+            active_ = false;
+            holdoffUntil_ = nowMs + cfg_.holdoffMs;
+            return PirDecision::End;
+        }
+        if (cfg_.retriggerMs && nowMs - lastTrigger_ >= cfg_.retriggerMs) {
+            lastTrigger_ = nowMs;
+            return PirDecision::Retrigger;
+        }
+        return PirDecision::None;
+    }
+
+    // Последние отсчеты подряд HIGH
+    uint8_t run() const { return ~window_ ? (uint8_t)__builtin_ctzll(~window_) : PIR_WINDOW; }
+    uint8_t ones() const { return ones_; }
+    bool active() const { return active_; }
+    // Окно пустое и движения нет: опрос можно остановить до следующего фронта
+    bool idle() const { return !active_ && window_ == 0; }
+    const PirFilterConfig& config() const { return cfg_; }
+
+private:
+    PirFilterConfig cfg_;
+    uint64_t window_ = 0;
+    uint8_t ones_ = 0;
+    bool active_ = false;
+    uint32_t holdoffUntil_ = 0;
+    uint32_t lastTrigger_ = 0;
+};
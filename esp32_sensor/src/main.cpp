@@ -3,17 +3,53 @@
 #include <vector>
 #include <WebServer.h>
 #include <HTTPClient.h>
+#include <LittleFS.h>
 #include "secrets.h"
 #include "config.h"
+#include "udp_link.h"
+#include "pir_capture.h"
+#include "pattern_player.h"
+#include "event_store.h"
+#include "metrics.h"
+#include "boot_timer.h"
+#include "wifi_fast.h"
+#include "input_trace.h"
 
 // ===== ГЛОБАЛЬНЫЕ ПЕРЕМЕННЫЕ =====
-bool wifiConnected = false;
+std::atomic<bool> wifiConnected{false};   // Пишет loop(), читает задача отправки
 unsigned long lastMotionTime = 0;
-int motionCounter = 0;
+int motionCounter = 0;           // Срабатывания фильтра в окне MOTION_CONFIRM_MS
+unsigned long firstMotionTime = 0;
 bool motionAlreadySent = false;  // Флаг для режима La
+UdpLink udpLink;                 // Бинарные события по UDP с подтверждением
+bool udpReady = false;
+PirCapture pir;                  // Движение: фронт PIR запускает опрос 1 кГц, фильтр решает
+PatternPlayer statusLed;         // Мигание по таймеру, без delay()
+TaskHandle_t senderHandle = nullptr;
+EventStore store;                // Недоставленные события (PSRAM + LittleFS)
+uint16_t storeBootId = 0;
+std::atomic<uint32_t> edgesHandled{0};
+WebServer web(80);               // Только GET /metrics
+WifiFastConnect wifiLink;        // WiFi по кэшу точки и адреса, без ожидания
+BootTimer boot;                  // Этапы запуска (отчет в Serial и /metrics)
+uint8_t bootWifi = BOOT_NO_STAGE;
+uint8_t bootPir = BOOT_NO_STAGE;
+std::atomic<uint32_t> warmupEdges{0};
+InputTrace trace;                // Уровни PIR и WiFi для проверки на ПК
+
+// Метрики (GET /metrics)
+LatencyHistogram senderLoopTime; // Один проход задачи отправки
+LatencyHistogram edgeToSend;     // Фронт PIR -> событие отправлено
 
 #define DEBUG_MODE true
 
+// Сигналы светодиода (вкл, выкл, ... в мс)
+constexpr uint16_t LED_BLINK_STEPS[] = {LED_BLINK_MS, LED_BLINK_MS};
+constexpr uint16_t LED_CONNECT_STEPS[] = {500, 500};
+constexpr Pattern LED_MOTION = makePattern(LED_BLINK_STEPS, PATTERN_PRIO_CHIRP, 5);
+constexpr Pattern LED_READY = makePattern(LED_BLINK_STEPS, PATTERN_PRIO_CHIRP, 2);
+constexpr Pattern LED_CONNECTING = makePattern(LED_CONNECT_STEPS, PATTERN_PRIO_STATUS, 0);
+
 
 // ===== ФУНКЦИИ =====
 void debugPrint(String message) {
@@ -22,11 +58,26 @@ void debugPrint(String message) {
     }
 }
 
-void sendToServer(String eventType, String sensorId, String value = "") {
-    if (!wifiConnected) {
-        debugPrint("Нет WiFi, пропускаем отправку: " + eventType);
+// Событие не ушло - сохраняем до восстановления связи
+void storeEvent(const String& eventType) {
+    SensorEvent event;
+    if (!sensorEventFromName(eventType.c_str(), event)) {
+        debugPrint("Неизвестное событие, не сохраняем: " + eventType);
         return;
     }
+    if (event == SensorEvent::Heartbeat) return;  // Старый пульс серверу не нужен
+    store.push(event, millis());
+    debugPrint("Сохранено до появления связи: " + eventType + " (в очереди " + String((int)store.pending()) + ")");
+}
+
+// Резервный путь: HTTP POST /event
+// eventUs - время события на часах датчика (фронт PIR), 0 - сейчас
+bool sendHttp(String eventType, String sensorId, String value, uint32_t eventUs = 0) {
+    if (!wifiConnected) {
+        debugPrint("Нет WiFi, откладываем отправку: " + eventType);
+        storeEvent(eventType);
+        return false;
+    }
     
     HTTPClient http;
     String url = "http://" + String(SERVER_IP) + "/event";
@@ -36,7 +87,9 @@ void sendToServer(String eventType, String sensorId, String value = "") {
     
     String postData = "type=" + eventType + 
                      "&sensor_id=" + sensorId + 
-                     "&value=" + value;
+                     "&value=" + value +
+                     "&rssi=" + String(WiFi.RSSI()) +
+                     "&event_us=" + String(eventUs ? eventUs : (uint32_t)micros());
     
     Serial.print("📤 Отправка: ");
     Serial.print(eventType);
@@ -54,52 +107,181 @@ void sendToServer(String eventType, String sensorId, String value = "") {
         }
     } else {
         debugPrint("❌ Ошибка! Код: " + String(httpCode));
+        storeEvent(eventType);
+    }
+    
+    http.end();
+    return httpCode == 200;
+}
+
+// Выгрузка накопленных событий пачкой (одна пачка за вызов):
+//   первая строка  sensor_id;bootId;millis;есть_еще
+//   далее          seq;событие;bootId;millis_события
+void drainStore() {
+    static unsigned long retryAt = 0;
+    if (!wifiConnected || store.pending() == 0 || (long)(millis() - retryAt) < 0) return;
+    
+    size_t count = min(store.pending(), (size_t)STORE_BATCH);
+    String body;
+    body.reserve(48 + count * 32);
+    char line[64];
+    snprintf(line, sizeof(line), "%s;%u;%lu;%d\n", SENSOR_ID, storeBootId, millis(),
+             store.pending() > count ? 1 : 0);
+    body += line;
+    for (size_t i = 0; i < count; i++) {
+        const StoredEvent& e = store.peek(i);
+        snprintf(line, sizeof(line), "%lu;%s;%u;%lu\n", (unsigned long)e.seq, sensorEventName(e.event),
+                 e.bootId, (unsigned long)e.timestampMs);
+        body += line;
     }
     
+    HTTPClient http;
+    http.begin("http://" + String(SERVER_IP) + "/events");
+    http.addHeader("Content-Type", "text/plain");
+    int httpCode = http.POST(body);
     http.end();
+    
+    if (httpCode == 200) {
+        store.commit(count);
+        if (store.pending() == 0) debugPrint("✅ Очередь событий выгружена");
+    } else {
+        debugPrint("❌ Выгрузка очереди не удалась, код " + String(httpCode));
+        retryAt = millis() + STORE_RETRY_MS;
+    }
+}
+
+// UDP кадр не подтвердился - повторяем событие по HTTP
+void onUdpFallback(SensorEvent event, const char* sensorId, uint32_t eventUs) {
+    debugPrint("UDP без ответа, отправка по HTTP");
+    sendHttp(sensorEventName(event), sensorId, sensorEventValue(event), eventUs);
+}
+
+void sendToServer(String eventType, String sensorId, String value = "", uint32_t eventUs = 0) {
+    SensorEvent event;
+    if (USE_UDP_TRANSPORT && udpReady && wifiConnected && sensorEventFromName(eventType.c_str(), event)) {
+        Serial.print("📤 Отправка по UDP: ");
+        Serial.println(eventType);
+        udpLink.send(event, sensorId.c_str(), WiFi.RSSI(), eventUs);  // ACK и повторы - в udpLink.poll()
+        return;
+    }
+    sendHttp(eventType, sensorId, value, eventUs);
 }
 
-void checkMotionSensor() {
-    static bool lastPirState = false;
-    static bool motionActive = false;
-    bool currentPirState = digitalRead(PIR_PIN);
+// PIR после включения питания выдает ложные фронты, пока не прогреется.
+// Отсчет от сброса: датчик включается вместе с платой.
+bool pirWarm(unsigned long ms) {
+    return ms >= PIR_WARMUP_MS;
+}
+
+// Обработка одного фронта PIR (в задаче отправки)
+void handleMotionEdge(const PirEdge& edge) {
+    unsigned long edgeMs = (unsigned long)(edge.timeUs / 1000);
+    if (!pirWarm(edgeMs)) {
+        warmupEdges++;
+        return;
+    }
     
-    // НОВОЕ ДВИЖЕНИЕ (LOW -> HIGH)
-    if (currentPirState == HIGH && lastPirState == LOW) {
-        Serial.println("\n🔴 ДВИЖЕНИЕ ОБНАРУЖЕНО!");
-        motionActive = true;
+    // НОВОЕ ДВИЖЕНИЕ (или продолжается дольше PIR_RETRIGGER_MS)
+    if (edge.level == HIGH) {
+        Serial.println(edge.retrigger ? "\n🔴 ДВИЖЕНИЕ ПРОДОЛЖАЕТСЯ" : "\n🔴 ДВИЖЕНИЕ ОБНАРУЖЕНО!");
+        if (edge.retrigger) motionAlreadySent = false;
+        
+        // Чувствительность: MOTION_SENSITIVITY срабатываний за MOTION_CONFIRM_MS
+        if (motionCounter == 0 || edgeMs - firstMotionTime > MOTION_CONFIRM_MS) {
+            motionCounter = 0;
+            firstMotionTime = edgeMs;
+        }
+        if (++motionCounter < MOTION_SENSITIVITY) return;
+        motionCounter = 0;
         
         // Проверяем антифлуд
-        if (millis() - lastMotionTime > PIR_COOLDOWN && !motionAlreadySent) {
+        if (edgeMs - lastMotionTime > PIR_COOLDOWN && !motionAlreadySent) {
             Serial.println("📤 ОТПРАВКА НА СЕРВЕР!");
             
-            sendToServer("motion", "pir_sensor", "detected");
-            lastMotionTime = millis();
+            uint32_t edgeUs = (uint32_t)edge.timeUs;   // micros() и esp_timer - одни часы
+            sendToServer("motion", SENSOR_ID, "detected", edgeUs);
+            edgeToSend.record(micros() - edgeUs);
+            lastMotionTime = edgeMs;
             motionAlreadySent = true;
             
-            // Мигаем светодиодом
-            for (int i = 0; i < 5; i++) {
-                digitalWrite(STATUS_LED, HIGH);
-                delay(100);
-                digitalWrite(STATUS_LED, LOW);
-                delay(100);
-            }
+            // Мигаем светодиодом (по таймеру, отправку не задерживает)
+            statusLed.play(LED_MOTION);
         }
     }
     
-    // ДВИЖЕНИЕ ПРЕКРАТИЛОСЬ (HIGH -> LOW)
-    if (currentPirState == LOW && lastPirState == HIGH) {
+    // ДВИЖЕНИЕ ПРЕКРАТИЛОСЬ (фильтр: окно почти без HIGH)
+    if (edge.level == LOW) {
         Serial.println("🟢 Движение прекратилось");
-        motionActive = false;
         motionAlreadySent = false;  // Сбрасываем флаг для следующего срабатывания
     }
-    
-    lastPirState = currentPirState;
+}
+
+// Задача отправки: спит до фронта PIR или до очередного шага повторов UDP
+void senderTask(void*) {
+    for (;;) {
+        // Пока есть что выгружать, не спим: фронты PIR обрабатываются между пачками
+        bool draining = wifiConnected && store.pending() > 0;
+        ulTaskNotifyTake(pdTRUE, draining ? 0 : pdMS_TO_TICKS(SENDER_POLL_MS));
+        uint32_t t0 = cycleNow();
+        
+        PirEdge edge;
+        while (pir.pop(edge)) {
+            handleMotionEdge(edge);
+            edgesHandled++;
+        }
+        
+        // Пульс: сервер считает датчик пропавшим, если он долго молчит
+        static unsigned long lastHeartbeat = 0;
+        if (wifiConnected && millis() - lastHeartbeat >= HEARTBEAT_INTERVAL) {
+            sendToServer("heartbeat", SENSOR_ID, "alive");
+            lastHeartbeat = millis();
+        }
+        
+        // ACK и повторы UDP кадров
+        if (udpReady) udpLink.poll();
+        
+        // Накопленное за время без связи
+        drainStore();
+        senderLoopTime.recordCycles(t0);
+    }
+}
+
+// Метрики датчика в формате Prometheus
+void handleMetrics() {
+    const UdpLinkStats& udp = udpLink.stats();
+    String out;
+    out.reserve(6144);
+    writeGauge(out, "sensor_uptime_seconds", "Время работы", millis() / 1000.0, "counter");
+    writeGauge(out, "sensor_wifi_rssi_dbm", "Уровень WiFi", wifiConnected ? WiFi.RSSI() : 0);
+    writeGauge(out, "sensor_free_heap_bytes", "Свободная куча", ESP.getFreeHeap());
+    writeGauge(out, "sensor_store_pending", "События в очереди без связи", store.pending());
+    writeGauge(out, "sensor_pir_edges_total", "Решений фильтра PIR обработано", edgesHandled, "counter");
+    writeGauge(out, "sensor_pir_raw_edges_total", "Фронтов на входе PIR", pir.rawEdges(), "counter");
+    writeGauge(out, "sensor_pir_samples_total", "Отсчетов PIR через фильтр", pir.samples(), "counter");
+    writeGauge(out, "sensor_pir_glitches_total", "Всплесков PIR, отброшенных фильтром", pir.glitches(), "counter");
+    TraceStats traceStats = trace.stats();
+    writeGauge(out, "sensor_trace_records_total", "Входов записано в трассу", traceStats.records, "counter");
+    writeGauge(out, "sensor_trace_dropped_total", "Входов, потерянных на полном буфере трассы",
+               traceStats.dropped, "counter");
+    writeGauge(out, "sensor_udp_sent_total", "UDP кадров отправлено", udp.sent, "counter");
+    writeGauge(out, "sensor_udp_retransmits_total", "Повторов UDP кадров", udp.retransmits, "counter");
+    writeGauge(out, "sensor_udp_fallbacks_total", "Событий ушло по HTTP после UDP", udp.fallbacks, "counter");
+    writeGauge(out, "sensor_pir_warmup_edges_total", "Фронтов PIR во время прогрева", warmupEdges, "counter");
+    const WifiLinkStats& wifi = wifiLink.stats();
+    writeGauge(out, "sensor_wifi_connect_seconds", "Последнее подключение к WiFi", wifi.lastConnectMs / 1000.0);
+    writeGauge(out, "sensor_wifi_fast_misses_total", "Кэш точки не подошел, обычное подключение",
+               wifi.fastMisses, "counter");
+    writeGauge(out, "sensor_boot_ready_seconds", "Запуск: все этапы готовы (0 - еще нет)", boot.readyUs() / 1e6);
+    writeBootStages(out, "sensor_boot_stage_done_seconds", "Запуск: конец этапа от сброса", boot);
+    writeHistogram(out, "sensor_sender_iteration_seconds", "Один проход задачи отправки", senderLoopTime);
+    writeHistogram(out, "sensor_edge_to_send_seconds", "Фронт PIR -> событие отправлено", edgeToSend);
+    writeHistogram(out, "sensor_udp_rtt_seconds", "UDP кадр -> ACK сервера", udpLink.rtt());
+    web.send(200, "text/plain; version=0.0.4", out);
 }
 
 void setup() {
+    uint8_t bootSetup = boot.start("setup");
     Serial.begin(115200);
-    delay(3000);
     
     Serial.println("\n" + String('=', 60));
     Serial.println("    ОХРАННЫЙ ДАТЧИК НА ESP32-S3");
@@ -114,7 +296,7 @@ void setup() {
     // Настройка пинов
     pinMode(PIR_PIN, INPUT);
     pinMode(STATUS_LED, OUTPUT);
-    digitalWrite(STATUS_LED, LOW);
+    statusLed.begin(STATUS_LED, "led");
     
     Serial.println("\n📡 Настройки:");
     Serial.println("  PIR_PIN: GPIO" + String(PIR_PIN));
@@ -122,78 +304,102 @@ void setup() {
     Serial.println("  PIR_COOLDOWN: " + String(PIR_COOLDOWN) + " мс");
     Serial.println("  SERVER_IP: " + String(SERVER_IP));
     
-    // Подключение к WiFi
+    // Очередь событий, не доставленных до перезагрузки
+    uint8_t bootFs = boot.start("fs");
+    storeBootId = (uint16_t)(esp_random() | 1);
+    if (LittleFS.begin(true) && store.begin(LittleFS, STORE_DIR, STORE_CAPACITY, storeBootId)) {
+        Serial.println("  Очередь событий: " + String((int)store.pending()) + " из " + String((int)store.capacity()));
+    } else {
+        Serial.println("  ❌ Очередь событий недоступна");
+    }
+    if (TRACE_ENABLED) trace.begin(LittleFS, TRACE_DIR, TRACE_SEGMENT_BYTES, TRACE_MAX_SEGMENTS);
+    boot.done(bootFs);
+    
+    // WiFi подключается в фоне, loop() отметит готовность.
+    // Без сети датчик работает: события копятся в очереди до подключения.
     Serial.print("\n📶 Подключение к WiFi: ");
     Serial.println(WIFI_SSID);
+    bootWifi = boot.start("wifi");
+    wifiLink.begin(LittleFS, WIFI_CACHE_FILE, WIFI_SSID, WIFI_PASS);
+    if (wifiLink.fast()) Serial.println("  По кэшу: точка, канал и адрес с прошлого запуска");
+    statusLed.play(LED_CONNECTING);
     
-    WiFi.begin(WIFI_SSID, WIFI_PASS);
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 40) {
-        delay(500);
-        Serial.print(".");
-        digitalWrite(STATUS_LED, !digitalRead(STATUS_LED));
-        attempts++;
+    if (USE_UDP_TRANSPORT) {
+        udpReady = udpLink.begin(SERVER_IP, SENSOR_UDP_PORT, onUdpFallback);
+        Serial.println(udpReady ? "  Передача: UDP (резерв HTTP)" : "  Передача: HTTP");
     }
     
-    if (WiFi.status() == WL_CONNECTED) {
-        wifiConnected = true;
-        Serial.println("\n✅ WiFi подключен!");
-        Serial.println("  IP адрес: " + WiFi.localIP().toString());
-        Serial.println("  MAC адрес: " + WiFi.macAddress());
-        Serial.println("  RSSI: " + String(WiFi.RSSI()) + " dBm");
-        digitalWrite(STATUS_LED, HIGH); // Постоянно горит
-    } else {
-        Serial.println("\n❌ Ошибка подключения к WiFi!");
-        // Режим аварийной индикации
-        while (true) {
-            digitalWrite(STATUS_LED, HIGH);
-            delay(200);
-            digitalWrite(STATUS_LED, LOW);
-            delay(200);
-        }
-    }
+    // PIR прогревается, пока идет подключение: фронты до готовности отбрасываются
+    bootPir = boot.start("pir");
+    Serial.println("⏳ Прогрев PIR датчика (" + String(PIR_WARMUP_MS / 1000) + " сек от включения)");
     
-    // Инициализация PIR (ждем 30 секунд)
-    Serial.println("\n⏳ Инициализация PIR датчика (30 сек)...");
-    for (int i = 0; i < 30; i++) {
-        delay(1000);
-        Serial.print(".");
-        if (i % 10 == 9) Serial.print(" ");
-    }
+    web.on("/metrics", HTTP_GET, handleMetrics);
+    web.begin();
     
-    Serial.println("\n✅ Система готова к работе!");
-    Serial.println(String('=', 60) + "\n");
+    // Задача отправки и прерывание PIR
+    xTaskCreatePinnedToCore(senderTask, "sender", SENDER_TASK_STACK, nullptr,
+                            SENDER_TASK_PRIORITY, &senderHandle, SENDER_TASK_CORE);
+    pir.traceTo(&trace);
+    pir.begin(PIR_PIN, senderHandle);
+    boot.done(bootSetup);
+}
+
+// Отчет о запуске - один раз, когда готовы все этапы
+void reportBoot() {
+    static bool reported = false;
+    if (reported || !boot.ready()) return;
+    reported = true;
     
-    // Короткий звуковой сигнал готовности
-    for (int i = 0; i < 2; i++) {
-        digitalWrite(STATUS_LED, HIGH);
-        delay(100);
-        digitalWrite(STATUS_LED, LOW);
-        delay(100);
-    }
+    char lines[BOOT_MAX_STAGES * 64];
+    boot.format(lines, sizeof(lines));
+    Serial.println("\n✅ Система готова к работе за " + String(boot.readyUs() / 1000) + " мс от сброса:");
+    Serial.print(lines);
+    Serial.println(String('=', 60) + "\n");
 }
 
+// Датчик и отправка живут в прерывании и senderTask, здесь только WiFi, прогрев и /metrics
 void loop() {
-    // Проверка датчика движения
-    checkMotionSensor();
+    web.handleClient();
     
-    // Проверка WiFi соединения
-    if (WiFi.status() != WL_CONNECTED) {
-        wifiConnected = false;
-        digitalWrite(STATUS_LED, LOW);
-        
-        // Пытаемся переподключиться
-        static unsigned long lastReconnect = 0;
-        if (millis() - lastReconnect > 30000) { // Каждые 30 секунд
+    switch (wifiLink.poll()) {
+        case WifiChange::Connected:
+            wifiConnected = true;
+            statusLed.stop(LED_CONNECTING);
+            statusLed.setIdle(true); // Постоянно горит
+            if (!boot.finished(bootWifi)) {
+                boot.done(bootWifi);
+                Serial.println("✅ WiFi подключен за " + String(wifiLink.stats().lastConnectMs) + " мс");
+                Serial.println("  IP адрес: " + WiFi.localIP().toString());
+                Serial.println("  MAC адрес: " + WiFi.macAddress());
+                Serial.println("  RSSI: " + String(WiFi.RSSI()) + " dBm");
+            } else {
+                Serial.println("✅ WiFi снова подключен");
+            }
+            trace.record(TraceKind::Wifi, 1);
+            break;
+        case WifiChange::Lost:
+            wifiConnected = false;
+            statusLed.setIdle(false);
+            statusLed.play(LED_CONNECTING);
             Serial.println("🔄 Потеря WiFi, переподключение...");
-            WiFi.reconnect();
-            lastReconnect = millis();
-        }
-    } else {
-        wifiConnected = true;
-        digitalWrite(STATUS_LED, HIGH);
+            trace.record(TraceKind::Wifi, 0);
+            break;
+        default:
+            break;
+    }
+    
+    if (!boot.finished(bootPir) && pirWarm(millis())) {
+        boot.done(bootPir);
+        Serial.println("✅ PIR прогрет");
+        statusLed.play(LED_READY); // Короткий сигнал готовности
+    }
+    reportBoot();
+    
+    static unsigned long lastTraceFlush = 0;
+    if (millis() - lastTraceFlush > TRACE_FLUSH_MS) {
+        trace.flush();
+        lastTraceFlush = millis();
     }
     
-    delay(100);
+    delay(LOOP_IDLE_MS);
 }
@@ -0,0 +1,166 @@
+// bench_alarm_hub.cpp - прошивка сервера целиком под нагрузкой на настоящих часах
+//
+// ALARM_HUB_SENSORS потоков-датчиков шлют POST /event по своим keep-alive
+// соединениям (ждут ответ, пауза 0..ALARM_HUB_THINK_US, следующее событие).
+// Отвечает им сетевая задача прошивки, а основной поток крутит loop() как
+// задача управления на ESP32 и раз в ALARM_HUB_SWIPE_MS
+// прикладывает карту: известная переключает охрану, неизвестная - отказ.
+// Telegram - заглушка hal_sim, каждый sendMessage занимает ALARM_HUB_TG_MS.
+//
+// Итог: событий в секунду, задержка ответа датчику, выделения памяти на
+// событие (весь процесс, включая задачу Telegram) и гистограммы прошивки.
+// С --save / --baseline эти числа ловят регрессии в handleSensorEvent,
+// addToLog и checkRFID.
+#include <atomic>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "metrics.h"
+
+#define ALARM_HUB_SENSORS 8            // Меньше HTTP_MAX_CONNECTIONS: без вытеснения
+#define ALARM_HUB_SECONDS 3
+#define ALARM_HUB_THINK_US 2000
+#define ALARM_HUB_SWIPE_MS 250         // Та же карта через 500 мс - больше RFID_REPEAT_MS
+#define ALARM_HUB_TG_MS 150
+
+extern LatencyHistogram sensorEventTime;
+extern LatencyHistogram inboxWaitTime;
+extern LatencyHistogram rfidDecisionTime;
+
+namespace {
+struct HubSensor {
+    char id[16];
+    sim::Samples latency;
+    uint32_t events = 0;
+    uint32_t errors = 0;
+};
+
+// Поток датчика: без выделений памяти, чтобы счетчик видел только прошивку
+void sensorThread(HubSensor& s, uint32_t seed, const std::atomic<int>& phase, std::atomic<int>& running) {
+    std::mt19937 rng(seed);
+    char body[96], req[320], rx[512];
+    int bodyLen = snprintf(body, sizeof(body), "type=motion&sensor_id=%s&value=detected", s.id);
+    int reqLen = snprintf(req, sizeof(req),
+                          "POST /event HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                          "Content-Type: application/x-www-form-urlencoded\r\n"
+                          "Content-Length: %d\r\nConnection: keep-alive\r\n\r\n%s",
+                          bodyLen, body);
+    while (phase == 0) std::this_thread::yield();
+    int fd = -1;
+    while (phase == 1) {
+        if (fd < 0 && (fd = connectLocal(false)) < 0) {
+            s.errors++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        uint64_t t0 = sim::hostNs();
+        int code = 0;
+        if (::send(fd, req, reqLen, MSG_NOSIGNAL) != reqLen || !readHttpResponse(fd, rx, sizeof(rx), code)) {
+            s.errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        s.latency.add((sim::hostNs() - t0) / 1000.0);
+        s.events++;
+        if (code != 200) s.errors++;
+        std::this_thread::sleep_for(std::chrono::microseconds(rng() % ALARM_HUB_THINK_US));
+    }
+    if (fd >= 0) close(fd);
+    running--;
+}
+}
+
+
+SIM_BENCH(alarm_hub) {
+    bootServer();
+    sim::useVirtualClock(false);
+    sim::httpClient().handler = nullptr;
+    sim::telegram().sendLatencyMs = ALARM_HUB_TG_MS;
+    setAlarmState(AlarmState::Disarmed);
+    sensorEventTime.reset();
+    inboxWaitTime.reset();
+    rfidDecisionTime.reset();
+
+    const uint8_t known[] = {0x23, 0x22, 0x04, 0x35};
+    const uint8_t unknown[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    static HubSensor sensors[ALARM_HUB_SENSORS];
+    for (int i = 0; i < ALARM_HUB_SENSORS; i++) {
+        snprintf(sensors[i].id, sizeof(sensors[i].id), "hub_pir_%02d", i);
+        sensors[i].latency.clear();
+        sensors[i].latency.reserve(100000);
+        sensors[i].events = sensors[i].errors = 0;
+    }
+    sim::Samples loopUs;
+    loopUs.reserve(100000);
+
+    // 0 - потоки ждут старта, 1 - нагрузка, 2 - стоп
+    std::atomic<int> phase{0};
+    std::atomic<int> running{ALARM_HUB_SENSORS};
+    std::thread threads[ALARM_HUB_SENSORS];
+    for (int i = 0; i < ALARM_HUB_SENSORS; i++) {
+        threads[i] = std::thread(sensorThread, std::ref(sensors[i]), 100 + i, std::cref(phase), std::ref(running));
+    }
+    size_t sentBefore = sim::telegram().sentCount;
+    uint64_t allocsBefore = sim::allocCount();
+    phase = 1;
+
+    uint64_t start = sim::hostNs();
+    uint64_t end = start + (uint64_t)ALARM_HUB_SECONDS * 1000000000ULL;
+    uint64_t nextSwipe = start;
+    uint32_t swipes = 0;
+    while (sim::hostNs() < end) {
+        if (sim::hostNs() >= nextSwipe) {
+            // Карты чередуются (повтор той же карты отсеивается): известная
+            // включает и снимает охрану, неизвестная - отказ
+            sim::rfid().tap(swipes % 2 ? unknown : known, 4);
+            swipes++;
+            nextSwipe += ALARM_HUB_SWIPE_MS * 1000000ULL;
+        }
+        uint64_t t0 = sim::hostNs();
+        loop();
+        loopUs.add((sim::hostNs() - t0) / 1000.0);
+    }
+    double seconds = (sim::hostNs() - start) / 1e9;
+
+    // Датчики дожидаются ответа на последний запрос, loop() разбирает очередь
+    phase = 2;
+    while (running > 0) loop();
+    drainSensorInputs();
+    uint64_t allocs = sim::allocCount() - allocsBefore;
+    for (std::thread& t : threads) t.join();
+
+    sim::Samples latency;
+    uint32_t events = 0, errors = 0;
+    for (HubSensor& s : sensors) {
+        events += s.events;
+        errors += s.errors;
+        latency.add(s.latency);
+    }
+    setAlarmState(AlarmState::Disarmed);
+    sim::rfid().remove();
+
+    printf("  %d sensor threads, think 0..%d us, RFID every %d ms, telegram %d ms, real clock\n",
+           ALARM_HUB_SENSORS, ALARM_HUB_THINK_US, ALARM_HUB_SWIPE_MS, ALARM_HUB_TG_MS);
+    printf("  events:              %u in %.1f s, %.0f events/s, errors %u\n", events, seconds, events / seconds, errors);
+    latency.print("POST /event round trip", "us");
+    loopUs.print("loop()", "us");
+    printf("  inbox wait:          p50 <= %u us, p99 <= %u us\n", inboxWaitTime.percentileUs(0.5),
+           inboxWaitTime.percentileUs(0.99));
+    printf("  sensor event:        p50 <= %u us, p99 <= %u us, n=%u\n", sensorEventTime.percentileUs(0.5),
+           sensorEventTime.percentileUs(0.99), sensorEventTime.count());
+    printf("  RFID decision:       p50 <= %u us, p99 <= %u us, n=%u of %u swipes\n", rfidDecisionTime.percentileUs(0.5),
+           rfidDecisionTime.percentileUs(0.99), rfidDecisionTime.count(), swipes);
+    printf("  telegram messages:   %zu\n", (size_t)(sim::telegram().sentCount - sentBefore));
+    printf("  allocs per event:    %.1f (%llu total)\n", events ? (double)allocs / events : 0.0,
+           (unsigned long long)allocs);
+
+    sim::report("events_per_s", events / seconds, sim::Better::Higher);
+    latency.report("round_trip_us");
+    loopUs.report("loop_us");
+    sim::report("allocs_per_event", events ? (double)allocs / events : 0);
+    sim::report("errors", errors);
+
+    sim::telegram().sendLatencyMs = 0;
+    sim::useVirtualClock(true);
+}
@@ -0,0 +1,308 @@
+// bench_alarm_stress.cpp - автомат охраны под одновременными входами
+//
+// Часть 1 - AlarmMachine отдельно: ALARM_STRESS_PRODUCERS потоков кладут
+// случайные входы, поток-владелец разбирает их run(). Записанный порядок
+// разбора затем проигрывается на новом автомате в одном потоке: переходы
+// должны совпасть один в один, а входы каждого потока - прийти в порядке
+// отправки и без потерь.
+//
+// Часть 2 - прошивка целиком на настоящих часах: датчики по HTTP и UDP,
+// команды Telegram и карты RFID одновременно, основной поток крутит loop().
+// Проверяется, что сирена следует за автоматом после каждого loop(), ответы
+// датчикам не противоречат сами себе, входы не теряются, все команды
+// выполнены, а записи Arm/Disarm/Alarm в журнале складываются в допустимую
+// цепочку переходов, которая кончается текущим состоянием.
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench_common.h"
+#include "event_journal.h"
+#include "sensor_proto.h"
+#include "telegram_outbox.h"
+
+#define ALARM_STRESS_PRODUCERS 4
+#define ALARM_STRESS_INPUTS 20000      // Входов на поток в части 1
+#define ALARM_STRESS_TIMEOUT 5         // Таймаут тревоги в проходах run() части 1
+#define ALARM_STRESS_SENSORS 4         // HTTP датчиков в части 2
+#define ALARM_STRESS_SECONDS 3
+#define ALARM_STRESS_THINK_US 3000
+#define ALARM_STRESS_COMMAND_MS 40     // Команда Telegram
+#define ALARM_STRESS_SWIPE_MS 250      // Та же карта через 500 мс - больше RFID_REPEAT_MS
+#define ALARM_STRESS_POLL_MS 20        // Опрос Telegram вместо расписания
+
+extern TelegramOutbox telegram;
+extern EventJournal journal;
+uint64_t logTime();
+bool sirenOn();
+
+namespace {
+struct Step {
+    AlarmInput input;
+    AlarmState from;
+    AlarmState to;
+    uint8_t producer;                  // 0xFF - таймаут от самого run()
+    uint32_t seq;
+};
+
+// Часть 1: возвращает число нарушений
+uint32_t runMachine(double& inputsPerSec, AlarmStats& stats) {
+    std::unique_ptr<AlarmMachine> m(new AlarmMachine());
+    m->begin(ALARM_STRESS_TIMEOUT);
+    const uint32_t total = ALARM_STRESS_PRODUCERS * ALARM_STRESS_INPUTS;
+    std::vector<Step> steps;
+    steps.reserve(total * 2);
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < ALARM_STRESS_PRODUCERS; p++) {
+        producers.emplace_back([&, p] {
+            std::mt19937 rng(500 + p);
+            while (!go) std::this_thread::yield();
+            for (uint32_t seq = 0; seq < ALARM_STRESS_INPUTS; seq++) {
+                // Движения больше всего, как в жизни
+                static const AlarmInput MIX[] = {AlarmInput::Arm, AlarmInput::Disarm, AlarmInput::Toggle,
+                                                 AlarmInput::Motion, AlarmInput::Motion, AlarmInput::Motion};
+                AlarmInput input = MIX[rng() % 6];
+                while (!m->postWith(input, EventSource::System, [&](AlarmEvent& e) {
+                    e.sensor = (uint8_t)p;
+                    e.mark = seq;
+                })) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint64_t t0 = sim::hostNs();
+    go = true;
+    uint32_t consumed = 0;
+    uint32_t now = 0;
+    while (consumed < total) {
+        m->run(now++, [&](const AlarmEvent& e, AlarmState from, AlarmState to) {
+            steps.push_back({e.input, from, to, e.sensor, e.mark});
+            if (e.input != AlarmInput::Timeout) consumed++;
+        });
+    }
+    inputsPerSec = total / ((sim::hostNs() - t0) / 1e9);
+    for (std::thread& t : producers) t.join();
+    stats = m->stats();
+
+    uint32_t violations = 0;
+    uint32_t next[ALARM_STRESS_PRODUCERS] = {0};
+    AlarmState state = AlarmState::Disarmed;
+    for (const Step& s : steps) {
+        if (s.from != state || s.to != alarmNext(s.from, s.input)) violations++;
+        state = s.to;
+        if (s.producer == 0xFF) continue;
+        if (s.seq != next[s.producer]) violations++;   // Порядок потока нарушен или вход потерян
+        next[s.producer] = s.seq + 1;
+    }
+
+    // Тот же порядок входов в одном потоке - те же переходы
+    std::unique_ptr<AlarmMachine> replay(new AlarmMachine());
+    replay->begin(ALARM_STRESS_TIMEOUT);
+    size_t i = 0;
+    for (const Step& s : steps) {
+        replay->post(s.input, EventSource::System);
+        replay->run(0, [&](const AlarmEvent& e, AlarmState from, AlarmState to) {
+            if (e.input != steps[i].input || from != steps[i].from || to != steps[i].to) violations++;
+            i++;
+        });
+    }
+    return violations + (i != steps.size());
+}
+
+
+struct Part2 {
+    std::atomic<int> phase{0};         // 0 - ждем, 1 - нагрузка, 2 - стоп
+    std::atomic<int> running{0};
+    std::atomic<uint32_t> replies{0};
+    std::atomic<uint32_t> acks{0};
+    std::atomic<uint32_t> inconsistent{0};
+    std::atomic<uint32_t> errors{0};
+    std::atomic<uint32_t> commands{0};
+};
+
+void httpSensor(Part2& st, int n) {
+    std::mt19937 rng(900 + n);
+    char body[96], req[320], rx[512];
+    int bodyLen = snprintf(body, sizeof(body), "type=motion&sensor_id=stress_pir_%d&value=detected", n);
+    int reqLen = snprintf(req, sizeof(req),
+                          "POST /event HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                          "Content-Type: application/x-www-form-urlencoded\r\n"
+                          "Content-Length: %d\r\nConnection: keep-alive\r\n\r\n%s",
+                          bodyLen, body);
+    while (st.phase == 0) std::this_thread::yield();
+    int fd = -1;
+    while (st.phase == 1) {
+        if (fd < 0 && (fd = connectLocal(false)) < 0) {
+            st.errors++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        int code = 0;
+        if (::send(fd, req, reqLen, MSG_NOSIGNAL) != reqLen || !readHttpResponse(fd, rx, sizeof(rx), code)) {
+            st.errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if (code == 200) {
+            st.replies++;
+            if (strstr(rx, "\"armed\":false,\"alarm\":true")) st.inconsistent++;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(rng() % ALARM_STRESS_THINK_US));
+    }
+    if (fd >= 0) close(fd);
+    st.running--;
+}
+
+void udpSensor(Part2& st) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    timeval tv = {0, 50000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(sim::hostPort(SENSOR_UDP_PORT));
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    SensorFrame frame = {};
+    frame.kind = FrameKind::Event;
+    frame.event = SensorEvent::Motion;
+    frame.bootId = 1;
+    strcpy(frame.sensorId, "stress_udp");
+    uint8_t buf[SENSOR_FRAME_SIZE];
+    while (st.phase == 0) std::this_thread::yield();
+    while (st.phase == 1) {
+        frame.seq++;
+        encodeFrame(frame, buf);
+        sendto(fd, buf, sizeof(buf), 0, (sockaddr*)&to, sizeof(to));
+        SensorFrame ack;
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n != SENSOR_FRAME_SIZE || !decodeFrame(buf, n, ack) || ack.kind != FrameKind::Ack) {
+            st.errors++;
+            continue;
+        }
+        st.acks++;
+        if ((ack.flags & ACK_FLAG_ALARM) && !(ack.flags & ACK_FLAG_ARMED)) st.inconsistent++;
+        std::this_thread::sleep_for(std::chrono::microseconds(ALARM_STRESS_THINK_US));
+    }
+    close(fd);
+    st.running--;
+}
+
+void telegramUser(Part2& st) {
+    std::mt19937 rng(77);
+    while (st.phase == 0) std::this_thread::yield();
+    while (st.phase == 1) {
+        sim::telegram().command(rng() % 2 ? "/arm" : "/disarm");
+        st.commands++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(ALARM_STRESS_COMMAND_MS));
+    }
+    st.running--;
+}
+}
+
+
+SIM_BENCH(alarm_stress) {
+    // ===== Часть 1: автомат отдельно =====
+    double inputsPerSec = 0;
+    AlarmStats machineStats;
+    uint32_t machineViolations = runMachine(inputsPerSec, machineStats);
+    printf("  machine: %d producers x %d inputs, %.0f inputs/s, queue full %u times, violations %u\n",
+           ALARM_STRESS_PRODUCERS, ALARM_STRESS_INPUTS, inputsPerSec, machineStats.dropped, machineViolations);
+
+    // ===== Часть 2: прошивка целиком =====
+    bootServer();
+    sim::useVirtualClock(false);
+    sim::httpClient().handler = nullptr;
+    telegram.setPollFixed(ALARM_STRESS_POLL_MS);
+    setAlarmState(AlarmState::Disarmed);
+    const uint8_t known[] = {0x23, 0x22, 0x04, 0x35};
+    const uint8_t unknown[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    uint64_t fromTs = logTime();
+    AlarmStats before = security.stats();
+
+    Part2 st;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ALARM_STRESS_SENSORS; i++) threads.emplace_back(httpSensor, std::ref(st), i);
+    threads.emplace_back(udpSensor, std::ref(st));
+    threads.emplace_back(telegramUser, std::ref(st));
+    st.running = (int)threads.size();
+    st.phase = 1;
+
+    uint64_t start = sim::hostNs();
+    uint64_t end = start + (uint64_t)ALARM_STRESS_SECONDS * 1000000000ULL;
+    uint64_t nextSwipe = start;
+    uint32_t swipes = 0, loops = 0, sirenMismatch = 0;
+    sim::Samples loopUs;
+    loopUs.reserve(10000);
+    auto step = [&] {
+        uint64_t t0 = sim::hostNs();
+        loop();
+        loopUs.add((sim::hostNs() - t0) / 1000.0);
+        loops++;
+        if (sirenOn() != security.alarm()) sirenMismatch++;
+    };
+    while (sim::hostNs() < end) {
+        if (sim::hostNs() >= nextSwipe) {
+            sim::rfid().tap(swipes % 2 ? unknown : known, 4);
+            swipes++;
+            nextSwipe += ALARM_STRESS_SWIPE_MS * 1000000ULL;
+        }
+        step();
+    }
+    st.phase = 2;
+    while (st.running > 0) step();
+    for (std::thread& t : threads) t.join();
+
+    // Последние команды: опрос Telegram и разбор очереди
+    uint64_t settle = sim::hostNs() + 10ULL * ALARM_STRESS_POLL_MS * 1000000ULL;
+    while (sim::hostNs() < settle) step();
+    drainSensorInputs();
+
+    // Журнал: цепочка переходов и выполненные команды
+    uint32_t chainErrors = 0, commandsLogged = 0, transitionsLogged = 0;
+    AlarmState walk = AlarmState::Disarmed;
+    journal.query(fromTs, UINT64_MAX, [&](const LogEntry& e) {
+        AlarmState next = walk;
+        switch (e.type) {
+            case EventType::Arm:      chainErrors += walk != AlarmState::Disarmed; next = AlarmState::Armed; break;
+            case EventType::Disarm:   chainErrors += walk == AlarmState::Disarmed; next = AlarmState::Disarmed; break;
+            case EventType::Alarm:    chainErrors += walk != AlarmState::Armed; next = AlarmState::Alarm; break;
+            case EventType::Telegram: commandsLogged++; break;
+            default: break;
+        }
+        transitionsLogged += next != walk;
+        walk = next;
+        return true;
+    });
+    chainErrors += walk != security.state();
+    AlarmStats after = security.stats();
+    uint32_t transitions = after.transitions - before.transitions;
+    uint32_t dropped = after.dropped - before.dropped;
+    uint32_t violations = sirenMismatch + st.inconsistent + chainErrors + dropped +
+                          (transitionsLogged != transitions) + (commandsLogged != st.commands);
+
+    setAlarmState(AlarmState::Disarmed);
+    sim::rfid().remove();
+    telegram.setPollFixed(0);
+
+    printf("  firmware: %d HTTP + 1 UDP sensors, telegram every %d ms, RFID every %d ms, real clock\n",
+           ALARM_STRESS_SENSORS, ALARM_STRESS_COMMAND_MS, ALARM_STRESS_SWIPE_MS);
+    printf("  inputs:              %u HTTP replies, %u UDP acks, %u commands, %u swipes, errors %u\n",
+           (uint32_t)st.replies, (uint32_t)st.acks, (uint32_t)st.commands, swipes, (uint32_t)st.errors);
+    printf("  alarm machine:       %u inputs, %u transitions (%u in journal), %u dropped\n",
+           after.posted - before.posted, transitions, transitionsLogged, dropped);
+    printf("  checks:              siren %u, replies %u, journal chain %u, commands %u of %u logged\n",
+           sirenMismatch, (uint32_t)st.inconsistent, chainErrors, commandsLogged, (uint32_t)st.commands);
+    loopUs.print("loop()", "us");
+
+    sim::report("machine_inputs_per_s", inputsPerSec, sim::Better::Higher);
+    sim::report("machine_violations", machineViolations);
+    sim::report("violations", violations);
+    loopUs.report("loop_us");
+    sim::useVirtualClock(true);
+}
@@ -0,0 +1,190 @@
+// bench_common.h - общие функции хостовых бенчмарков сервера
+#pragma once
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "hal_bench.h"
+#include "hal_sim.h"
+#include "alarm_machine.h"
+#include "boot_timer.h"
+#include "rfid_reader.h"
+#include "telegram_outbox.h"
+
+#define SERVER_PORT 80
+#define BENCH_RFID_IRQ_PIN 26          // RFID_IRQ_PIN из config.h
+
+// Подключение к WiFi на плате: сканирование каналов, ассоциация, DHCP
+#define BENCH_WIFI_SCAN_MS 2500
+#define BENCH_WIFI_ASSOC_MS 300
+#define BENCH_WIFI_DHCP_MS 1200
+
+// Задача управления прошивки (main.cpp): бенчмарк вызывает ее части из своего потока
+extern AlarmMachine security;
+int processSensorInputs();
+void runAlarm();
+void handleBuzzer();
+extern BootTimer boot;
+extern RfidReader rfidReader;
+extern TelegramOutbox telegram;
+
+
+// Разобрать все события, принятые сетевой задачей, и входы автомата охраны
+inline void drainSensorInputs() {
+    while (processSensorInputs() > 0) {}
+    runAlarm();
+}
+
+// Задача считывателя читает карту за реальное время, а часы стоят: ждем,
+// пока все ответившие на REQA карты окажутся в очереди касаний. Срока по
+// реальному времени нет: иначе на загруженной машине касание уходит в
+// следующий loop(), и результат зависит от планировщика ПК.
+inline void settleRfid() {
+    while (!rfidReader.idle()) std::this_thread::yield();
+}
+
+// Часы вперед шагами RFID_KICK_MS: каждый REQA задача отрабатывает в свой
+// момент, и карта читается по первому запросу после касания
+inline void advanceRfid(uint32_t ms) {
+    for (uint32_t step; ms; ms -= step) {
+        step = ms < RFID_KICK_MS ? ms : RFID_KICK_MS;
+        sim::advanceMs(step);
+        settleRfid();
+    }
+}
+
+// Состояние охраны без входов автомата (только из потока бенчмарка)
+inline void setAlarmState(AlarmState s) {
+    security.restore(s, millis());
+    handleBuzzer();
+}
+
+// POST /event от датчика
+inline sim::HttpRequest sensorEvent(const char* type, const char* sensorId, const char* value) {
+    sim::HttpRequest req;
+    req.method = HTTP_POST;
+    req.uri = "/event";
+    req.args = {{"type", type}, {"sensor_id", sensorId}, {"value", value}};
+    req.remote = IPAddress(192, 168, 1, 50);
+    return req;
+}
+
+// TCP соединение с HTTP сервера прошивки на localhost (порт сдвинут hostPort())
+inline int connectLocal(bool nonBlocking) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(sim::hostPort(SERVER_PORT));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (nonBlocking) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Ответ целиком с блокирующего сокета: заголовки и Content-Length байт тела
+inline bool readHttpResponse(int fd, char* rx, size_t size, int& code) {
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = recv(fd, rx + len, size - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        len += n;
+        rx[len] = '\0';
+        const char* end = strstr(rx, "\r\n\r\n");
+        if (!end) continue;
+        const char* cl = strcasestr(rx, "Content-Length:");
+        if (len < (size_t)(end + 4 - rx) + (cl ? atol(cl + 15) : 0)) continue;
+        code = atoi(rx + 9);
+        return true;
+    }
+}
+
+
+// Первый запуск прошивки (bootServer)
+struct BootResult {
+    double setupMs;                    // setup() целиком, виртуальное время
+    double readyMs;                    // setup() -> все этапы готовы (WiFi, сообщение о запуске)
+    int statusBeforeWifi;              // Код GET /status сразу после setup(), до WiFi
+    bool announced;                    // Ушло сообщение о запуске с разбивкой по этапам
+    uint32_t freeHeap;                 // Куча, когда все этапы готовы
+    uint32_t maxBlock;
+};
+
+inline BootResult& bootResult() {
+    static BootResult r = {};
+    return r;
+}
+
+// Сообщения Telegram, оставшиеся от прошлого бенчмарка, уходят, и ведра
+// чатов наполняются: каждый бенчмарк в --bench all начинает так же, как
+// запущенный один. Часы - снова виртуальные.
+inline void settleTelegramOutbox() {
+    sim::useVirtualClock(true);
+    uint64_t giveUp = sim::hostNs() + 5000000000ULL;
+    while (telegram.pending() && sim::hostNs() < giveUp) {
+        // Пауза лимита или повтора идет по часам, отправка - за реальное время
+        if (telegram.held()) sim::advanceMs(100);
+        else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sim::advanceMs(TELEGRAM_RATE_BURST * TELEGRAM_RATE_INTERVAL_MS);
+}
+
+// Однократный запуск setup() прошивки на виртуальных часах без вывода в Serial.
+// WiFi подключается в фоне: loop() крутится, пока не готовы все этапы запуска.
+// Следующие вызовы только разгружают очередь Telegram.
+inline void bootServer() {
+    static bool booted = false;
+    if (booted) {
+        settleTelegramOutbox();
+        return;
+    }
+    booted = true;
+    sim::serialEnabled(false);
+    sim::useVirtualClock(true);
+    sim::setFsRoot("/tmp/esp32_server_bench_fs");
+    sim::clearFs();
+    sim::rfid().irqPin = BENCH_RFID_IRQ_PIN;
+    sim::wifi().scanMs = BENCH_WIFI_SCAN_MS;
+    sim::wifi().connectDelayMs = BENCH_WIFI_ASSOC_MS;
+    sim::wifi().dhcpMs = BENCH_WIFI_DHCP_MS;
+    BootResult& r = bootResult();
+    uint64_t t0 = sim::nowUs();
+    setup();
+    r.setupMs = (sim::nowUs() - t0) / 1000.0;
+
+    // Сетевая задача уже отвечает, хотя WiFi еще подключается
+    int fd = connectLocal(false);
+    const char req[] = "GET /status HTTP/1.1\r\nHost: esp32\r\nConnection: close\r\n\r\n";
+    char rx[2048];
+    if (fd >= 0 && send(fd, req, sizeof(req) - 1, 0) == (ssize_t)(sizeof(req) - 1)) {
+        readHttpResponse(fd, rx, sizeof(rx), r.statusBeforeWifi);
+    }
+    if (fd >= 0) close(fd);
+
+    while (!boot.ready()) loop();
+    r.readyMs = (sim::nowUs() - t0) / 1000.0;
+    r.freeHeap = ESP.getFreeHeap();
+    r.maxBlock = ESP.getMaxAllocHeap();
+
+    // Задача Telegram отправляет сообщение за реальное время, часы стоят
+    uint64_t waitUntil = sim::hostNs() + 1000000000ULL;
+    while (!r.announced && sim::hostNs() < waitUntil) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> g(sim::telegram().lock);
+        for (const String& m : sim::telegram().sent) {
+            if (m.indexOf("Сервер запущен") >= 0 && m.indexOf("wifi") >= 0) r.announced = true;
+        }
+    }
+}
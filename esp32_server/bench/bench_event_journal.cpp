@@ -0,0 +1,106 @@
+// bench_event_journal.cpp - журнал событий в LittleFS: дозапись, загрузка, запросы по времени
+//
+// 100 тысяч событий с шагом 0..400 мс, сброс буфера раз в JOURNAL_FLUSH_MS
+// времени журнала, как в loop(). Лимиты журнала увеличены, чтобы все
+// события поместились (на устройстве - JOURNAL_SEGMENT_BYTES * JOURNAL_MAX_SEGMENTS).
+#include <LittleFS.h>
+#include <random>
+#include "bench_common.h"
+#include "event_journal.h"
+
+#define BENCH_JOURNAL_FLUSH_MS 2000    // JOURNAL_FLUSH_MS из config.h
+
+
+SIM_BENCH(event_journal) {
+    bootServer();
+    const char* DIR = "/bench_journal";
+    const size_t SEGMENT = 64 * 1024;
+    const size_t MAX_SEGMENTS = 128;
+    const size_t EVENTS = 100000;
+    const char* details[] = {
+        "pir_sensor: detected",
+        "RFID: Администратор включил систему сигнализации",
+        "RFID_ERROR: Неизвестная карта 23 22 04 35",
+        "Команда: /status",
+    };
+    std::mt19937 rng(42);
+
+    // Дозапись
+    uint64_t lastTs = 0;
+    JournalStats ws;
+    size_t totalBytes, segments;
+    double appendNs;
+    {
+        EventJournal j;
+        j.begin(LittleFS, DIR, SEGMENT, MAX_SEGMENTS);
+        j.clear();
+        uint64_t ts = 1000;
+        uint64_t nextFlush = ts + BENCH_JOURNAL_FLUSH_MS;
+        uint64_t t0 = sim::hostNs();
+        for (size_t i = 0; i < EVENTS; i++) {
+            ts += rng() % 400;
+            int k = i % 4;
+            j.append(ts, k == 0 ? EventType::Motion : k == 3 ? EventType::Telegram : EventType::Rfid,
+                     EventSource::Sensor, details[k], false);
+            if (ts >= nextFlush) {
+                j.flush();
+                nextFlush = ts + BENCH_JOURNAL_FLUSH_MS;
+            }
+        }
+        j.flush();
+        appendNs = (double)(sim::hostNs() - t0) / EVENTS;
+        lastTs = j.lastTimestamp();
+        ws = j.stats();
+        totalBytes = j.bytes();
+        segments = j.segments();
+    }
+
+    // Загрузка после перезагрузки: индексы запечатанных сегментов из .idx
+    EventJournal j;
+    uint64_t b0 = sim::hostNs();
+    j.begin(LittleFS, DIR, SEGMENT, MAX_SEGMENTS);
+    double bootMs = (sim::hostNs() - b0) / 1e6;
+
+    // Запросы: случайные окна в 1 минуту
+    const int QUERIES = 2000;
+    const uint64_t WINDOW = 60000;
+    sim::Samples q;
+    q.reserve(QUERIES);
+    uint64_t found = 0;
+    uint32_t read0 = j.stats().readBytes;
+    for (int i = 0; i < QUERIES; i++) {
+        uint64_t from = 1000 + (uint64_t)rng() % (lastTs - WINDOW);
+        uint64_t t0 = sim::hostNs();
+        found += j.query(from, from + WINDOW, [](const LogEntry&) { return true; });
+        q.add((sim::hostNs() - t0) / 1000.0);
+    }
+    double bytesPerQuery = (double)(j.stats().readBytes - read0) / QUERIES;
+
+    // Для сравнения - полный проход журнала
+    read0 = j.stats().readBytes;
+    uint64_t s0 = sim::hostNs();
+    size_t all = j.query(0, UINT64_MAX, [](const LogEntry&) { return true; });
+    double scanMs = (sim::hostNs() - s0) / 1e6;
+    uint32_t scanBytes = j.stats().readBytes - read0;
+
+    // Последние 20 событий (заполнение eventLog при запуске)
+    sim::Samples r;
+    for (int i = 0; i < 200; i++) {
+        uint64_t t0 = sim::hostNs();
+        j.recent(20, [](const LogEntry&) {});
+        r.add((sim::hostNs() - t0) / 1000.0);
+    }
+
+    printf("  events appended:     %zu, %.0f ns per append\n", EVENTS, appendNs);
+    printf("  flash writes:        %u flushes (%.1f events each), %u bytes, %.1f bytes/event\n", ws.flushes,
+           (double)EVENTS / ws.flushes, ws.flashBytes, (double)ws.flashBytes / EVENTS);
+    printf("  segments:            %zu x %zu KB, %zu bytes total, index RAM %zu bytes\n", segments, SEGMENT / 1024,
+           totalBytes, j.memoryBytes());
+    printf("  reload after reboot: %zu events in %.2f ms\n", j.size(), bootMs);
+    q.print("query 1 min window", "us");
+    printf("  query read:          %.0f bytes per query (%.2f%% of journal), %.1f events per window\n",
+           bytesPerQuery, 100.0 * bytesPerQuery / totalBytes, (double)found / QUERIES);
+    printf("  full scan:           %zu events, %u bytes, %.2f ms\n", all, scanBytes, scanMs);
+    r.print("recent(20)", "us");
+    j.clear();
+}
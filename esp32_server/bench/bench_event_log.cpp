@@ -0,0 +1,36 @@
+// bench_event_log.cpp - кольцевой буфер логов: время добавления и выделения памяти
+#include "event_log.h"
+#include "hal_bench.h"
+#include "hal_sim.h"
+
+
+SIM_BENCH(event_log) {
+    static EventRing<20> log;
+    const size_t EVENTS = 1000000;
+    const char* details[] = {
+        "pir_sensor: detected",
+        "RFID: Администратор включил систему сигнализации",
+        "RFID_ERROR: Неизвестная карта 23 22 04 35",
+    };
+
+    uint64_t allocsBefore = sim::allocCount();
+    uint64_t t0 = sim::hostNs();
+    for (size_t i = 0; i < EVENTS; i++) {
+        log.push(i, EventType::Motion, EventSource::Sensor, details[i % 3], false);
+    }
+    uint64_t t1 = sim::hostNs();
+    uint64_t allocs = sim::allocCount() - allocsBefore;
+
+    // Чтение от новых к старым
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < log.size(); i++) checksum += log.newest(i).timestamp;
+
+    printf("  events:            %zu\n", EVENTS);
+    printf("  ns per push:       %.1f\n", (double)(t1 - t0) / EVENTS);
+    printf("  allocs per event:  %.3f (%llu total)\n", (double)allocs / EVENTS, (unsigned long long)allocs);
+    printf("  entries kept:      %zu (newest ts %llu, checksum %llu)\n", log.size(),
+           (unsigned long long)log.newest(0).timestamp, (unsigned long long)checksum);
+    printf("  sizeof(LogEntry):  %zu bytes\n", sizeof(LogEntry));
+    sim::report("ns_per_push", (double)(t1 - t0) / EVENTS);
+    sim::report("allocs_per_event", (double)allocs / EVENTS);
+}
@@ -0,0 +1,266 @@
+// bench_heap.cpp - куча сервера под долгой нагрузкой
+//
+// 10 000 входов вперемешку, как на объекте: движение от 8 датчиков на
+// охране и без, касания карт, команды Telegram и GET /status. Замер -
+// куча после запуска, ее рост и пик за прогон и выделения памяти на вход
+// каждого вида: каждое временное выделение на плате дробит кучу.
+// Куча ПК общая с прошлыми бенчмарками, поэтому числа - от начала прогона.
+// Дробления на ПК нет, ESP.getMaxAllocHeap() равен свободной куче - на
+// плате наибольший блок показывает /metrics (alarm_heap_max_block_bytes).
+//
+// mem_soak - трое суток на виртуальных часах в режиме проверки утечек
+// (MEM_SOAK_MS): к синтетическим входам прошивки добавлены настоящие POST
+// /event и касания карт. Двое суток без утечки монитор памяти не должен
+// видеть убывания кучи, в третьи бенчмарк сам теряет по 64 байта раз в
+// 10 минут - и монитор должен его найти. Запас стека задач на ПК условный
+// (половина размера), на плате - настоящий high water mark. Синтетические
+// входы не должны оставить датчик "soak" в реестре и сообщения в Telegram.
+#include <vector>
+#include "bench_common.h"
+#include "mem_monitor.h"
+#include "sensor_registry.h"
+#include "telegram_outbox.h"
+
+#define SOAK_INPUTS 10000
+#define SOAK_SENSORS 8
+#define SOAK_STEP_MS 50
+
+#define MEM_SOAK_CLEAN_DAYS 2
+#define MEM_SOAK_INTERVAL_MS 2000      // Синтетический вход прошивки
+#define MEM_SOAK_EVENT_S 60            // POST /event
+#define MEM_SOAK_CARD_S 600            // Касание карты
+#define MEM_SOAK_LEAK_BYTES 64
+#define MEM_SOAK_LEAK_S 600
+
+void handleTelegramMessage(FB_msg& msg);
+extern TelegramOutbox telegram;
+extern MemMonitor memMonitor;
+extern SensorRegistry sensors;
+extern uint32_t soakIntervalMs;
+extern uint32_t soakInputs;
+
+static const uint8_t KNOWN[] = {0x23, 0x22, 0x04, 0x35};
+static const uint8_t UNKNOWN[] = {0xDE, 0xAD, 0xBE, 0xEF};
+static const char* const COMMANDS[] = {
+    "/start", "/rfid_status", "/zone pir_3 Кухня", "/add_card A1B2C3D4 Гость", "/revoke_card A1B2C3D4",
+    "/logs", "/sensors", "/test_sound",
+};
+
+enum SoakKind { SOAK_MOTION, SOAK_CARD, SOAK_COMMAND, SOAK_STATUS, SOAK_KINDS };
+
+struct SoakCount {
+    uint64_t inputs;
+    uint64_t allocs;
+
+    double perInput() const { return inputs ? (double)allocs / inputs : 0; }
+};
+
+
+// Следующим бенчмаркам - пустой журнал и очередь Telegram
+static void cleanupSoak() {
+    FB_msg clear;
+    clear.text = "/clear_logs";
+    handleTelegramMessage(clear);
+    sim::telegram().online = true;
+    for (int i = 0; i < 400 && telegram.pending(); i++) {
+        sim::advanceMs(500);
+        loop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));   // Задача Telegram - в реальном времени
+    }
+}
+
+
+SIM_BENCH(heap_soak) {
+    bootServer();
+    sim::useVirtualClock(true);
+    setAlarmState(AlarmState::Disarmed);
+    // Отправка в Telegram идет в своей задаче: на время прогона она молчит,
+    // и выделения считаются только в loop() и обработчиках
+    sim::telegram().online = false;
+    loop();
+    int64_t liveStart = sim::liveHeapBytes();
+    sim::resetHeapPeak();
+
+    SoakCount counts[SOAK_KINDS] = {};
+    char sensorId[16];
+    for (int i = 0; i < SOAK_INPUTS; i++) {
+        advanceRfid(SOAK_STEP_MS);
+        if (i % 400 == 0) setAlarmState(i % 800 ? AlarmState::Disarmed : AlarmState::Armed);
+        int slot = i % 10;
+        SoakKind kind = slot < 7 ? SOAK_MOTION : slot == 7 ? SOAK_CARD : slot == 8 ? SOAK_COMMAND : SOAK_STATUS;
+        uint64_t a0 = sim::allocCount();
+        switch (kind) {
+            case SOAK_MOTION: {
+                snprintf(sensorId, sizeof(sensorId), "pir_%d", (i / 10) % SOAK_SENSORS);
+                sim::httpRequest(SERVER_PORT, sensorEvent("motion", sensorId, "detected"));
+                loop();
+                break;
+            }
+            case SOAK_CARD:
+                sim::rfid().tap((i / 10) % 3 ? UNKNOWN : KNOWN, 4);
+                advanceRfid(RFID_KICK_MS);
+                loop();
+                sim::rfid().remove();
+                break;
+            case SOAK_COMMAND: {
+                FB_msg msg;
+                msg.chatID = "123456789";
+                msg.text = COMMANDS[(i / 10) % (sizeof(COMMANDS) / sizeof(COMMANDS[0]))];
+                handleTelegramMessage(msg);
+                loop();
+                break;
+            }
+            case SOAK_STATUS: {
+                sim::HttpRequest req;
+                req.method = HTTP_GET;
+                req.uri = "/status";
+                sim::httpRequest(SERVER_PORT, req);
+                loop();
+                break;
+            }
+            default:
+                break;
+        }
+        counts[kind].inputs++;
+        counts[kind].allocs += sim::allocCount() - a0;
+    }
+    setAlarmState(AlarmState::Disarmed);
+    loop();
+    int64_t growth = sim::liveHeapBytes() - liveStart;
+    int64_t peak = sim::peakHeapBytes() - liveStart;
+
+    cleanupSoak();
+
+    uint64_t allocs = 0;
+    for (const SoakCount& c : counts) allocs += c.allocs;
+    printf("  %d inputs: %llu motion, %llu cards, %llu commands, %llu GET /status\n", SOAK_INPUTS,
+           (unsigned long long)counts[SOAK_MOTION].inputs, (unsigned long long)counts[SOAK_CARD].inputs,
+           (unsigned long long)counts[SOAK_COMMAND].inputs, (unsigned long long)counts[SOAK_STATUS].inputs);
+    printf("  heap after boot:     %u bytes free of %u, largest block %u (native: no fragmentation)\n",
+           bootResult().freeHeap, ESP.getHeapSize(), bootResult().maxBlock);
+    printf("  heap during run:     %+lld bytes after, peak %+lld bytes above start\n", (long long)growth,
+           (long long)peak);
+    printf("  allocs per input:    motion %.1f, card %.1f, command %.1f, GET /status %.1f, all %.2f\n",
+           counts[SOAK_MOTION].perInput(), counts[SOAK_CARD].perInput(), counts[SOAK_COMMAND].perInput(),
+           counts[SOAK_STATUS].perInput(), (double)allocs / SOAK_INPUTS);
+    sim::report("allocs_per_input", (double)allocs / SOAK_INPUTS);
+    sim::report("heap_growth_bytes", (double)growth);
+    sim::report("peak_heap_bytes", (double)peak);
+}
+
+
+// Сутки (или сколько есть) кольца монитора: потолок первой и последней части
+struct SoakPhase {
+    uint64_t inputs;
+    size_t samples;
+    int32_t flaggedS;                  // Убывание замечено через столько секунд, -1 - нет
+    uint32_t firstCeiling;
+    uint32_t lastCeiling;
+    bool declining;
+};
+
+static SoakPhase runSoakDays(uint32_t days, std::vector<char*>* leaks) {
+    static const uint8_t card[] = {0x23, 0x22, 0x04, 0x35};
+    uint32_t soak0 = soakInputs;
+    uint64_t inputs = 0;
+    int32_t flagged = -1;
+    for (uint32_t sec = 0; sec < days * 86400; sec++) {
+        sim::advanceMs(1000);
+        if (sec % MEM_SOAK_EVENT_S == 0) {
+            sim::httpRequest(SERVER_PORT, sensorEvent("motion", "pir_soak", "detected"));
+            inputs++;
+        }
+        if (sec % MEM_SOAK_CARD_S == MEM_SOAK_CARD_S / 2) {
+            // Своя карта дважды: охрана включилась и выключилась
+            for (int i = 0; i < 2; i++) {
+                sim::rfid().tap(card, sizeof(card));
+                advanceRfid(RFID_KICK_MS);
+                loop();
+                sim::rfid().remove();
+                advanceRfid(RFID_REPEAT_MS);
+            }
+            inputs += 2;
+        }
+        if (leaks && sec % MEM_SOAK_LEAK_S == 0) leaks->push_back(new char[MEM_SOAK_LEAK_BYTES]);
+        loop();
+        if (flagged < 0 && memMonitor.declining()) flagged = sec;
+    }
+    MemTrend t = memMonitor.trend();
+    SoakPhase r = {};
+    r.inputs = inputs + (soakInputs - soak0);
+    r.samples = memMonitor.count();
+    r.flaggedS = flagged;
+    r.firstCeiling = t.parts ? t.ceiling[0] : 0;
+    r.lastCeiling = t.parts ? t.ceiling[t.parts - 1] : 0;
+    r.declining = memMonitor.declining();
+    return r;
+}
+
+SIM_BENCH(mem_soak) {
+    bootServer();
+    sim::useVirtualClock(true);
+    setAlarmState(AlarmState::Disarmed);
+    // Куча ПК общая с прошлыми бенчмарками: свободная - как после запуска на плате
+    sim::setFreeHeap(bootResult().freeHeap);
+    std::vector<char*> leaks;
+    leaks.reserve(86400 / MEM_SOAK_LEAK_S + 1);
+    uint64_t t0 = sim::hostNs();
+
+    soakIntervalMs = MEM_SOAK_INTERVAL_MS;
+    SoakPhase clean = runSoakDays(MEM_SOAK_CLEAN_DAYS, nullptr);
+    SoakPhase leaky = runSoakDays(1, &leaks);
+    soakIntervalMs = 0;
+    double hostMs = (sim::hostNs() - t0) / 1e6;
+
+    // Синтетические входы не оставляют следов: датчика "soak" нет в реестре,
+    // о карте 50 4B 00 .. в Telegram не писали (история - последние сообщения)
+    bool soakSensor = sensors.find("soak") != SENSOR_NONE;
+    uint32_t soakMessages = 0;
+    for (const String& m : sim::telegram().sent) {
+        if (strstr(m.c_str(), "50 4B 00")) soakMessages++;
+    }
+
+    // Отчеты памяти по HTTP и в Telegram
+    sim::HttpRequest req;
+    req.method = HTTP_GET;
+    req.uri = "/mem";
+    sim::HttpResponse mem = sim::httpRequest(SERVER_PORT, req);
+    FB_msg cmd;
+    cmd.chatID = "123456789";
+    cmd.text = "/mem";
+    handleTelegramMessage(cmd);
+    MemSample now = memMonitor.current(millis());
+
+    for (char* p : leaks) delete[] p;
+    size_t leaked = leaks.size() * MEM_SOAK_LEAK_BYTES;
+    leaks.clear();
+    cleanupSoak();
+
+    printf("  clean %d days: %llu inputs, %zu samples, heap ceiling %u -> %u, declining %s\n",
+           MEM_SOAK_CLEAN_DAYS, (unsigned long long)clean.inputs, clean.samples, clean.firstCeiling,
+           clean.lastCeiling, clean.declining ? "YES" : "no");
+    printf("  leak 1 day:   %llu inputs, %zu bytes lost, heap ceiling %u -> %u, declining %s",
+           (unsigned long long)leaky.inputs, leaked, leaky.firstCeiling, leaky.lastCeiling,
+           leaky.declining ? "YES" : "no");
+    if (leaky.flaggedS >= 0) printf(" (flagged after %.1f h)", leaky.flaggedS / 3600.0);
+    printf("\n");
+    printf("  GET /mem:     %d, %u bytes; host time %.0f ms for %d virtual days\n", mem.code,
+           (unsigned)mem.body.length(), hostMs, MEM_SOAK_CLEAN_DAYS + 1);
+    printf("  stack free:  ");
+    for (uint8_t i = 0; i < memMonitor.tasks(); i++) {
+        printf(" %s %u/%lu", memMonitor.taskName(i), (unsigned)now.stackFree[i],
+               (unsigned long)memMonitor.taskStack(i));
+    }
+    printf(" (native: placeholder)\n");
+    printf("  soak inputs:  sensor registered %s, Telegram messages %u\n", soakSensor ? "YES" : "no",
+           soakMessages);
+    if (soakSensor || soakMessages) printf("  FAIL: synthetic inputs left side effects\n");
+    if (clean.declining) printf("  FAIL: decline flagged without a leak\n");
+    if (!leaky.declining) printf("  FAIL: leak of %d bytes per %d s not flagged\n", MEM_SOAK_LEAK_BYTES,
+                                 MEM_SOAK_LEAK_S);
+    sim::report("clean_declining", clean.declining);
+    sim::report("leak_declining", leaky.declining);
+    sim::report("leak_flagged_hours", leaky.flaggedS / 3600.0);
+    sim::report("clean_ceiling_drop_bytes", (double)clean.firstCeiling - clean.lastCeiling);
+    sim::report("soak_side_effects", soakSensor + soakMessages);
+}
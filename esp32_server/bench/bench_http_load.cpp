@@ -0,0 +1,230 @@
+// bench_http_load.cpp - нагрузка на HttpFront: 32 датчика шлют POST /event одновременно
+//
+// HTTP обслуживает сетевая задача прошивки, события из ее очереди разбирает
+// поток управления, датчики - неблокирующие сокеты localhost в одном потоке
+// на poll(). Каждый датчик ждет ответ,
+// делает паузу 0..HTTP_LOAD_THINK_US и шлет следующее событие.
+// Keep-alive - до HTTP_MAX_CONNECTIONS (12) соединений. Датчиков больше: пока
+// новые ждут ячейку, сервер отвечает с Connection: close, и датчик
+// переподключается к следующему запросу (время входит в задержку).
+// Для сравнения - те же 32 датчика с Connection: close, как ходил WebServer,
+// и HTTP_MAX_CONNECTIONS датчиков, которым хватает ячеек.
+#include <atomic>
+#include <random>
+#include <thread>
+#include <errno.h>
+#include <poll.h>
+#include "bench_common.h"
+#include "http_front.h"
+
+#define HTTP_LOAD_SENSORS 32
+#define HTTP_LOAD_SECONDS 3
+#define HTTP_LOAD_THINK_US 2000
+
+extern HttpFront server;
+
+namespace {
+const char LOAD_BODY[] = "type=motion&sensor_id=load_pir&value=detected";
+
+struct LoadResult {
+    sim::Samples latency;
+    uint64_t requests = 0;
+    uint32_t errors = 0;
+    uint32_t reconnects = 0;
+    uint32_t serverClosed = 0;         // Ответов с Connection: close на keep-alive
+    double seconds = 0;
+};
+
+struct LoadSensor {
+    int fd = -1;
+    bool waiting = false;              // Запрос отправлен, ждем ответ
+    bool closing = false;              // Сервер ответил с Connection: close
+    uint64_t t0 = 0;                   // Начало текущего запроса
+    uint64_t nextNs = 0;               // Когда слать следующий
+    size_t rxLen = 0;
+    char rx[512];
+};
+
+// Запрос уходит целиком: он короче буфера сокета
+bool sendRequest(LoadSensor& s, bool keepAlive) {
+    if (s.fd < 0 && (s.fd = connectLocal(true)) < 0) return false;
+    char req[256];
+    int n = snprintf(req, sizeof(req),
+                     "POST /event HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                     "Content-Type: application/x-www-form-urlencoded\r\n"
+                     "Content-Length: %u\r\nConnection: %s\r\n\r\n%s",
+                     (unsigned)strlen(LOAD_BODY), keepAlive ? "keep-alive" : "close", LOAD_BODY);
+    s.rxLen = 0;
+    s.waiting = true;
+    return ::send(s.fd, req, n, MSG_NOSIGNAL) == n;
+}
+
+// 1 - ответ получен, 0 - ждем еще, -1 - соединение закрыто без ответа
+int readResponse(LoadSensor& s, int& code) {
+    for (;;) {
+        ssize_t n = recv(s.fd, s.rx + s.rxLen, sizeof(s.rx) - 1 - s.rxLen, 0);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        if (n == 0) return -1;
+        s.rxLen += n;
+        s.rx[s.rxLen] = '\0';
+        const char* end = strstr(s.rx, "\r\n\r\n");
+        if (!end) continue;
+        const char* cl = strcasestr(s.rx, "Content-Length:");
+        size_t need = (end + 4 - s.rx) + (cl ? atol(cl + 15) : 0);
+        if (s.rxLen < need) continue;
+        code = atoi(s.rx + 9);
+        s.closing = strcasestr(s.rx, "\r\nConnection: close\r\n") != nullptr;
+        return 1;
+    }
+}
+
+void closeSensor(LoadSensor& s) {
+    if (s.fd >= 0) close(s.fd);
+    s.fd = -1;
+}
+
+LoadResult runLoad(int count, bool keepAlive) {
+    LoadResult r;
+    r.latency.reserve(200000);
+    std::mt19937 rng(7);
+    LoadSensor sensors[HTTP_LOAD_SENSORS];
+    pollfd fds[HTTP_LOAD_SENSORS];
+
+    // Поток управления вместо loop(): разбирает события, принятые сетевой задачей
+    std::atomic<bool> done{false};
+    std::thread control([&] {
+        while (!done) {
+            if (processSensorInputs() == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+            runAlarm();
+        }
+    });
+
+    uint64_t start = sim::hostNs();
+    uint64_t stop = start + (uint64_t)HTTP_LOAD_SECONDS * 1000000000ULL;
+    for (LoadSensor& s : sensors) s.nextNs = start;
+
+    for (;;) {
+        uint64_t now = sim::hostNs();
+        bool busy = false;
+        for (int i = 0; i < count; i++) {
+            LoadSensor& s = sensors[i];
+            if (!s.waiting && now < stop && now >= s.nextNs) {
+                s.t0 = now;
+                if (!sendRequest(s, keepAlive)) {
+                    // Соединение уже закрыто сервером: новое и повтор
+                    closeSensor(s);
+                    r.reconnects++;
+                    if (!sendRequest(s, keepAlive)) {
+                        r.errors++;
+                        closeSensor(s);
+                        s.waiting = false;
+                        s.nextNs = now + HTTP_LOAD_THINK_US * 1000ULL;
+                    }
+                }
+            }
+            busy |= s.waiting;
+        }
+        if (!busy && now >= stop) break;
+
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            const LoadSensor& s = sensors[i];
+            if (!s.waiting) continue;
+            fds[n].fd = s.fd;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            n++;
+        }
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        poll(fds, n, 1);
+
+        for (int i = 0; i < count; i++) {
+            LoadSensor& s = sensors[i];
+            if (!s.waiting) continue;
+            int code = 0;
+            int got = readResponse(s, code);
+            if (got == 0) continue;
+            if (got < 0) {
+                // Соединение закрыто до ответа: запрос потерян вместе с ним
+                closeSensor(s);
+                r.reconnects++;
+                if (!sendRequest(s, keepAlive)) {
+                    r.errors++;
+                    closeSensor(s);
+                    s.waiting = false;
+                }
+                continue;
+            }
+            uint64_t t = sim::hostNs();
+            r.latency.add((t - s.t0) / 1000.0);
+            r.requests++;
+            if (code != 200) r.errors++;
+            s.waiting = false;
+            if (keepAlive && s.closing) r.serverClosed++;
+            if (!keepAlive || s.closing) closeSensor(s);
+            s.nextNs = t + rng() % (HTTP_LOAD_THINK_US * 1000ULL);
+        }
+    }
+    r.seconds = (sim::hostNs() - start) / 1e9;
+
+    for (LoadSensor& s : sensors) closeSensor(s);
+    done = true;
+    control.join();
+    drainSensorInputs();
+    // Закрытые датчиками соединения сетевая задача замечает на следующем проходе
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return r;
+}
+
+void printLoad(int count, const char* label, LoadResult& r, const HttpFrontStats& before) {
+    const HttpFrontStats& st = server.stats();
+    printf("  %d sensors, %s\n", count, label);
+    printf("    requests:          %llu in %.1f s, %.0f req/s, errors %u, lost with connection %u\n",
+           (unsigned long long)r.requests, r.seconds, r.requests / r.seconds, r.errors, r.reconnects);
+    r.latency.print("  request latency", "us");
+    printf("    connections:       accepted %u, evicted %u, max open %u of %d, "
+           "closed by server after reply %u\n", st.accepted - before.accepted, st.evicted - before.evicted,
+           st.maxActive, HTTP_MAX_CONNECTIONS, st.closedForSlots - before.closedForSlots);
+}
+
+void reportLoad(const char* key, LoadResult& r) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s.req_per_s", key);
+    sim::report(name, r.requests / r.seconds, sim::Better::Higher);
+    snprintf(name, sizeof(name), "%s.latency_us", key);
+    r.latency.report(name);
+}
+}
+
+
+SIM_BENCH(http_load) {
+    bootServer();
+    sim::useVirtualClock(false);
+    sim::httpClient().handler = nullptr;
+
+    printf("  think 0..%d us, %d s per run, localhost sockets, real clock\n", HTTP_LOAD_THINK_US,
+           HTTP_LOAD_SECONDS);
+    printf("  connection buffers:  %zu bytes preallocated, keep-alive limit %d connections\n",
+           HttpFront::memoryBytes(), HTTP_MAX_CONNECTIONS);
+
+    // Датчиков не больше ячеек: каждый держит свое соединение
+    HttpFrontStats before = server.stats();
+    LoadResult fit = runLoad(HTTP_MAX_CONNECTIONS, true);
+    printLoad(HTTP_MAX_CONNECTIONS, "keep-alive", fit, before);
+    reportLoad("fit_keepalive", fit);
+
+    before = server.stats();
+    LoadResult ka = runLoad(HTTP_LOAD_SENSORS, true);
+    printLoad(HTTP_LOAD_SENSORS, "keep-alive", ka, before);
+    reportLoad("keepalive", ka);
+
+    before = server.stats();
+    LoadResult cl = runLoad(HTTP_LOAD_SENSORS, false);
+    printLoad(HTTP_LOAD_SENSORS, "Connection: close", cl, before);
+    reportLoad("close", cl);
+
+    sim::useVirtualClock(true);
+}
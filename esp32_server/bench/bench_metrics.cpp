@@ -0,0 +1,70 @@
+// bench_metrics.cpp - цена замеров на горячем пути и ответ GET /metrics
+//
+// Датчик шлет движение с event_us на 0..20 мс раньше приема (задержка
+// WiFi), система на охране: каждое событие включает сирену, и гистограмма
+// motion_to_alarm должна показать эту задержку плюс обработку на сервере.
+#include <random>
+#include "bench_common.h"
+#include "metrics.h"
+
+extern LatencyHistogram motionToAlarm;
+extern LatencyHistogram eventAgeTime;
+
+
+SIM_BENCH(metrics) {
+    bootServer();
+
+    // Одна запись в гистограмму
+    static LatencyHistogram h;
+    const int RECORDS = 1000000;
+    uint64_t t0 = sim::hostNs();
+    for (int i = 0; i < RECORDS; i++) h.record((uint32_t)i & 0xFFFF);
+    double recordNs = (double)(sim::hostNs() - t0) / RECORDS;
+    t0 = sim::hostNs();
+    uint32_t sink = 0;
+    for (int i = 0; i < RECORDS; i++) sink += cycleNow();
+    double cycleNs = (double)(sim::hostNs() - t0) / RECORDS;
+
+    // Движение по HTTP: первый кадр задает сдвиг часов датчика (задержка 0)
+    std::mt19937 rng(11);
+    const int EVENTS = 2000;
+    motionToAlarm.reset();
+    eventAgeTime.reset();
+    uint32_t delayMinUs = UINT32_MAX, delayMaxUs = 0;
+    for (int i = 0; i < EVENTS; i++) {
+        setAlarmState(AlarmState::Armed);
+        uint32_t delayUs = i == 0 ? 0 : 500 + rng() % 20000;
+        delayMinUs = delayUs < delayMinUs ? delayUs : delayMinUs;
+        delayMaxUs = delayUs > delayMaxUs ? delayUs : delayMaxUs;
+        sim::HttpRequest req = sensorEvent("motion", "metrics_pir", "detected");
+        req.args.push_back({"event_us", String((uint32_t)micros() - delayUs)});
+        sim::httpRequest(SERVER_PORT, req);
+        drainSensorInputs();
+        sim::advanceMs(50);
+    }
+    setAlarmState(AlarmState::Disarmed);
+
+    // Ответ /metrics
+    sim::HttpRequest get;
+    get.method = HTTP_GET;
+    get.uri = "/metrics";
+    sim::Samples render;
+    size_t bytes = 0;
+    for (int i = 0; i < 200; i++) {
+        uint64_t r0 = sim::hostNs();
+        sim::HttpResponse resp = sim::httpRequest(SERVER_PORT, get);
+        render.add((sim::hostNs() - r0) / 1000.0);
+        bytes = resp.body.length();
+    }
+
+    printf("  histogram record:    %.1f ns, cycle counter read %.1f ns (%u)\n", recordNs, cycleNs, sink & 1);
+    printf("  network delay:       %u..%u us (uniform)\n", delayMinUs, delayMaxUs);
+    printf("  event age:           p50 <= %u us, p99 <= %u us, mean %.0f us, n=%u\n",
+           eventAgeTime.percentileUs(0.5), eventAgeTime.percentileUs(0.99),
+           (double)eventAgeTime.sumUs() / eventAgeTime.count(), eventAgeTime.count());
+    printf("  motion to alarm:     p50 <= %u us, p99 <= %u us, mean %.0f us, n=%u\n",
+           motionToAlarm.percentileUs(0.5), motionToAlarm.percentileUs(0.99),
+           (double)motionToAlarm.sumUs() / motionToAlarm.count(), motionToAlarm.count());
+    render.print("GET /metrics", "us");
+    printf("  /metrics body:       %zu bytes\n", bytes);
+}
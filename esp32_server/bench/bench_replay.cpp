@@ -0,0 +1,629 @@
+// bench_replay.cpp - воспроизведение трассы входов (input_trace.h) на виртуальных часах
+//
+// Трасса - сегменты <n>.bin из TRACE_DIR платы (LittleFS) или хостовой
+// сборки (native_fs/trace). Путь - $TRACE_PATH, файл или папка. Без него
+// генерируется неделя жизни объекта: 8 датчиков с пульсом раз в 30 с
+// (4 по UDP, 4 по HTTP), охрана по расписанию командами и картами,
+// движения днем и вечером, тревоги со снятием и по таймауту, чужая и
+// отключенная карта, обрыв WiFi с выгрузкой пачки, датчик, пропавший на
+// 4 минуты.
+//
+// Входы идут тем же путем, что на плате: HTTP - sim::httpRequest(), UDP
+// кадры - acceptSensorFrame(), карты - через считыватель, команды -
+// handleTelegramMessage(), WiFi - sim::wifi().available. Между записями
+// часы прыгают шагами до REPLAY_STEP_MS, на каждый шаг - один loop().
+// Выходы - ответы датчикам, смены охраны, сирены и WiFi, сообщения
+// Telegram - пишутся строками со временем от начала трассы:
+//
+//   REPLAY_OUT=out.txt     program --bench replay   - сохранить выходы
+//   REPLAY_EXPECT=out.txt  program --bench replay   - сравнить (output_diffs)
+//
+// Состояние прошивки одно на процесс, а другие бенчмарки его меняют:
+// воспроизведение всегда идет в новом процессе с чистым LittleFS. Таких
+// процессов два, и их выходы должны совпасть до байта (digest_mismatch):
+// задачи считывателя и Telegram отрабатывают при стоящих часах, поэтому
+// время и порядок выходов не зависят от планировщика ПК.
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <FastBot.h>
+#include <WiFi.h>
+#include "bench_common.h"
+#include "input_trace.h"
+#include "rfid_tags.h"
+#include "sensor_proto.h"
+#include "telegram_outbox.h"
+
+#define REPLAY_DAYS 7                  // Сгенерированная трасса
+#define REPLAY_SENSORS 8               // Первые половина - UDP, остальные - HTTP
+#define REPLAY_HEARTBEAT_MS 30000      // HEARTBEAT_INTERVAL датчика
+#define REPLAY_STEP_MS 1000            // Шаг часов без входов: один loop()
+#define REPLAY_ALIGN_MS 10000          // Начало трассы на круглом времени: выходы не зависят от запуска
+#define REPLAY_RFID_WAIT_MS 500        // Карта у считывателя, пока задача считывателя ее не прочитает
+#define REPLAY_SHOW_DIFFS 5
+
+#define DAY_MS 86400000u
+#define HOUR_MS 3600000u
+#define MIN_MS 60000u
+
+extern TelegramOutbox telegram;
+extern InputTrace trace;
+void handleTelegramMessage(FB_msg& msg);
+bool acceptSensorFrame(uint8_t* buf, int size, uint32_t remoteIp);
+bool sirenOn();
+
+namespace {
+// ===== Сгенерированная трасса =====
+struct GenRecord {
+    uint32_t ms;
+    TraceKind kind;
+    std::string data;
+};
+
+uint32_t rng = 20240601;
+uint32_t nextRand(uint32_t n) {
+    rng = rng * 1103515245u + 12345u;
+    return (rng >> 8) % n;
+}
+
+const uint8_t UNKNOWN_CARD[] = {0xDE, 0xAD, 0xBE, 0xEF};
+const uint8_t COURIER_CARD[] = {0x0A, 0x0B, 0x0C, 0x0D};
+
+class WeekTrace {
+public:
+    std::vector<GenRecord> records;
+
+    void sensorEvent(uint32_t ms, int s, SensorEvent ev) {
+        char id[SENSOR_ID_LEN + 1];
+        snprintf(id, sizeof(id), "pir_%d", s + 1);
+        int8_t rssi = (int8_t)(-58 - s - (int)nextRand(6));
+        if (s < REPLAY_SENSORS / 2) {
+            SensorFrame f = {};
+            f.kind = FrameKind::Event;
+            f.event = ev;
+            f.rssi = rssi;
+            f.bootId = (uint16_t)(0x100 + s);   // seq - в encode(), по порядку времени
+            f.eventUs = ms * 1000u - 2000;     // Часы датчика: микросекунды, переполняются
+            memcpy(f.sensorId, id, sizeof(f.sensorId));
+            uint8_t frame[SENSOR_FRAME_SIZE];
+            encodeFrame(f, frame);
+            add(ms, TraceKind::UdpFrame, ip(s) + std::string((const char*)frame, sizeof(frame)));
+            return;
+        }
+        char query[160];
+        snprintf(query, sizeof(query), "type=%s&sensor_id=%s&value=%s&rssi=%d&event_us=%lu", sensorEventName(ev), id,
+                 sensorEventValue(ev), rssi, (unsigned long)(ms * 1000u - 5000));
+        add(ms, TraceKind::HttpEvent, ip(s) + query);
+    }
+
+    // Пачка от HTTP датчика: события, накопленные без связи (время - его millis())
+    void batch(uint32_t ms, int s, const std::vector<std::pair<uint32_t, SensorEvent>>& events) {
+        char text[512];
+        size_t len = snprintf(text, sizeof(text), "pir_%d;%u;%lu;0\n", s + 1, 0x100 + s, (unsigned long)ms);
+        for (const auto& e : events) {
+            len += snprintf(text + len, sizeof(text) - len, "%lu;%s;%u;%lu\n", (unsigned long)++batchSeq_,
+                            sensorEventName(e.second), 0x100 + s, (unsigned long)e.first);
+        }
+        add(ms, TraceKind::HttpBatch, ip(s) + text);
+    }
+
+    void command(uint32_t ms, const char* text) {
+        add(ms, TraceKind::TelegramCommand, std::string("123456789") + '\0' + text);
+    }
+
+    void card(uint32_t ms, const uint8_t* uid, size_t size) {
+        add(ms, TraceKind::RfidUid, std::string((const char*)uid, size));
+    }
+
+    void wifi(uint32_t ms, bool up) { add(ms, TraceKind::Wifi, std::string(1, up ? 1 : 0)); }
+
+    // Сегмент в формате прошивки: тот же заголовок и те же записи
+    std::vector<uint8_t> encode() {
+        std::stable_sort(records.begin(), records.end(),
+                         [](const GenRecord& a, const GenRecord& b) { return a.ms < b.ms; });
+        std::vector<uint8_t> out(TRACE_HEADER_SIZE);
+        traceSegmentHeader(out.data(), 0, true);
+        uint32_t last = 0;
+        for (GenRecord& r : records) {
+            if (r.kind == TraceKind::UdpFrame) {
+                int s = (uint8_t)r.data[3] - 51;  // Последний байт адреса
+                uint32_t seq = ++seq_[s];
+                for (int i = 0; i < 4; i++) r.data[4 + 8 + i] = (char)(seq >> (8 * i));
+            }
+            uint8_t head[TRACE_RECORD_HEAD];
+            size_t n = traceRecordHead(head, r.kind, r.ms - last, r.data.size());
+            out.insert(out.end(), head, head + n);
+            out.insert(out.end(), r.data.begin(), r.data.end());
+            last = r.ms;
+        }
+        return out;
+    }
+
+private:
+    void add(uint32_t ms, TraceKind kind, const std::string& data) { records.push_back({ms, kind, data}); }
+
+    static std::string ip(int s) {
+        uint32_t a = IPAddress(192, 168, 1, 51 + s);
+        return std::string((const char*)&a, sizeof(a));
+    }
+
+    uint32_t seq_[REPLAY_SENSORS] = {};
+    uint32_t batchSeq_ = 0;
+};
+
+// Неделя объекта: расписание охраны, движения, сбои связи
+std::vector<uint8_t> generateWeek(int days) {
+    WeekTrace w;
+    const RFIDTag& admin = authorizedTags[0];
+    const RFIDTag& guard = authorizedTags[1];
+    const uint32_t wifiDown = 3 * HOUR_MS, wifiUp = wifiDown + MIN_MS;
+    const uint32_t outageDay = 2, outageFrom = 15 * HOUR_MS, outageTo = outageFrom + 4 * MIN_MS;
+    const int batchSensor = REPLAY_SENSORS - 3;
+
+    // Пульс: нет связи у всех при обрыве WiFi и у последнего датчика во время пропажи
+    for (int s = 0; s < REPLAY_SENSORS; s++) {
+        for (uint32_t t = 5000 + s * 3700; t < days * DAY_MS; t += REPLAY_HEARTBEAT_MS + nextRand(200)) {
+            uint32_t inDay = t % DAY_MS;
+            if (inDay >= wifiDown && inDay < wifiUp) continue;
+            if (s == REPLAY_SENSORS - 1 && t / DAY_MS == outageDay && inDay >= outageFrom && inDay < outageTo) continue;
+            w.sensorEvent(t, s, SensorEvent::Heartbeat);
+        }
+    }
+
+    w.command(30000, "/zone pir_1 Прихожая");
+    w.command(31000, "/zone pir_2 Кухня");
+    for (int d = 0; d < days; d++) {
+        uint32_t day = d * DAY_MS;
+        w.wifi(day + wifiDown, false);
+        w.wifi(day + wifiUp, true);
+        // Движение, пока не было связи: приходит пачкой уже старым
+        w.batch(day + wifiUp + 5000, batchSensor,
+                {{day + wifiDown + 20000, SensorEvent::Motion}, {day + wifiDown + 23000, SensorEvent::MotionEnd}});
+
+        w.command(day + 7 * HOUR_MS + 30 * MIN_MS, "/disarm");
+        w.card(day + 8 * HOUR_MS + 15 * MIN_MS, admin.uid, admin.uidSize);                // Охрана на день
+        for (int i = 0; i < 3; i++) w.card(day + 9 * HOUR_MS + i * 150, UNKNOWN_CARD, 4);  // Держат у считывателя
+        w.command(day + 12 * HOUR_MS, "/status");
+
+        // Движение под охраной: снятие командой, картой или таймаут тревоги
+        uint32_t at = day + 13 * HOUR_MS + nextRand(120) * MIN_MS;
+        int s = d % REPLAY_SENSORS;
+        w.sensorEvent(at, s, SensorEvent::Motion);
+        w.sensorEvent(at + 3000, s, SensorEvent::MotionEnd);
+        if (d % 3 == 0) {
+            w.command(at + 90000, "/disarm");
+            w.command(at + 5 * MIN_MS, "/arm");
+        } else if (d % 3 == 1) {
+            w.card(at + 40000, guard.uid, guard.uidSize);
+            w.card(at + 5 * MIN_MS, admin.uid, admin.uidSize);
+        }
+
+        if (d == 4) {
+            w.command(day + 10 * HOUR_MS, "/add_card 0A0B0C0D Курьер");
+            w.card(day + 10 * HOUR_MS + 5 * MIN_MS, COURIER_CARD, 4);
+            w.card(day + 10 * HOUR_MS + 6 * MIN_MS, admin.uid, admin.uidSize);
+        }
+        if (d == 5) {
+            w.command(day + 10 * HOUR_MS, "/revoke_card 0A0B0C0D");
+            w.card(day + 10 * HOUR_MS + 5 * MIN_MS, COURIER_CARD, 4);
+        }
+
+        w.card(day + 18 * HOUR_MS, guard.uid, guard.uidSize);                             // Снятие вечером
+        for (int i = 0; i < 12; i++) {
+            uint32_t m = day + 19 * HOUR_MS + nextRand(180) * MIN_MS + nextRand(60000);
+            int ms = nextRand(REPLAY_SENSORS);
+            w.sensorEvent(m, ms, SensorEvent::Motion);
+            w.sensorEvent(m + 2000 + nextRand(3000), ms, SensorEvent::MotionEnd);
+        }
+        w.command(day + 20 * HOUR_MS, "/logs");
+        w.command(day + 20 * HOUR_MS + 30 * MIN_MS, "/logs 2h");
+        w.command(day + 21 * HOUR_MS, "/sensors");
+        w.command(day + 23 * HOUR_MS, "/arm");
+    }
+    return w.encode();
+}
+
+
+// ===== Загрузка трассы =====
+bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) out.insert(out.end(), chunk, chunk + n);
+    fclose(f);
+    return true;
+}
+
+// Файл или папка сегментов; имена <n>.bin по порядку номеров
+std::vector<std::vector<uint8_t>> loadSegments(const char* path) {
+    std::vector<std::vector<uint8_t>> segs;
+    std::vector<std::string> files;
+    if (DIR* d = opendir(path)) {
+        while (dirent* e = readdir(d)) {
+            size_t n = strlen(e->d_name);
+            if (n > 4 && strcmp(e->d_name + n - 4, ".bin") == 0) files.push_back(std::string(path) + "/" + e->d_name);
+        }
+        closedir(d);
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(path);
+    }
+    for (const std::string& f : files) {
+        segs.emplace_back();
+        if (!readFile(f, segs.back())) segs.pop_back();
+    }
+    return segs;
+}
+
+
+// ===== Воспроизведение =====
+class Replay {
+public:
+    std::vector<std::string> lines;
+    std::map<std::string, size_t> kinds;   // Строк выходов по видам
+    uint64_t inputs = 0;
+    uint64_t skipped = 0;              // Записи не для сервера (уровни PIR)
+
+    void begin() {
+        // Задача Telegram идет шагами: один проход после каждого loop()
+        sim::holdTask(telegram.task(), true);
+        // Начало на круглом времени после запуска: millis() в выходах одинаковые при любом запуске
+        uint64_t align = REPLAY_ALIGN_MS * 1000ULL;
+        startUs_ = (sim::nowUs() / align + 1) * align;
+        advanceTo(startUs_);
+        lines.clear();
+        kinds.clear();
+        state_ = security.state();
+        siren_ = sirenOn();
+        wifi_ = WiFi.status() == WL_CONNECTED;
+        dropped_ = telegram.stats().dropped;
+        sent_ = sim::telegram().sentCount;
+    }
+
+    // Время записи - мс от начала трассы
+    void play(uint64_t atMs, const TraceRecord& r) {
+        advanceTo(startUs_ + atMs * 1000);
+        inputs++;
+        switch (r.kind) {
+            case TraceKind::HttpEvent:       httpEvent(r); break;
+            case TraceKind::HttpBatch:       httpBatch(r); break;
+            case TraceKind::UdpFrame:        udpFrame(r); break;
+            case TraceKind::RfidUid:         card(r); return;
+            case TraceKind::TelegramCommand: command(r); break;
+            case TraceKind::Wifi:            sim::wifi().available = r.len && r.data[0]; break;
+            default:
+                skipped++;
+                inputs--;
+                return;
+        }
+        step();
+    }
+
+    void note(const char* kind, const char* text) {
+        char head[32];
+        snprintf(head, sizeof(head), "%10.3f %s ", (sim::nowUs() - startUs_) / 1e6, kind);
+        std::string line = head;
+        for (const char* c = text; *c; c++) {
+            if (*c == '\n') line += "\\n";
+            else line += *c;
+        }
+        lines.push_back(line);
+        kinds[kind]++;
+    }
+
+    uint64_t elapsedMs() const { return (sim::nowUs() - startUs_) / 1000; }
+
+private:
+    void advanceTo(uint64_t us) {
+        for (uint64_t now = sim::nowUs(); now < us; now = sim::nowUs()) {
+            sim::advanceUs(std::min<uint64_t>(us - now, REPLAY_STEP_MS * 1000ULL));
+            step();
+        }
+    }
+
+    void step() {
+        // Карта у считывателя: loop() берет касание, когда задача его прочитала
+        if (sim::rfid().present) settleRfid();
+        loop();
+        observe();
+    }
+
+    // Выходы после каждого loop(): смены состояний и новые сообщения Telegram
+    void observe() {
+        AlarmState state = security.state();
+        if (state != state_) {
+            static const char* NAMES[] = {"disarmed", "armed", "alarm"};
+            note("state", NAMES[(int)state]);
+            state_ = state;
+        }
+        if (sirenOn() != siren_) {
+            siren_ = !siren_;
+            note("siren", siren_ ? "on" : "off");
+        }
+        bool wifi = WiFi.status() == WL_CONNECTED;
+        if (wifi != wifi_) {
+            wifi_ = wifi;
+            note("wifi", wifi ? "connected" : "lost");
+        }
+        OutboxStats st = telegram.stats();
+        if (st.dropped != dropped_) {
+            char text[32];
+            snprintf(text, sizeof(text), "%lu dropped", (unsigned long)(st.dropped - dropped_));
+            note("tg", text);
+            dropped_ = st.dropped;
+        }
+        // Проход задачи Telegram при стоящих часах: уходит все, что можно
+        // отправить сейчас. Сообщение, ждущее лимита чата или повтора, уйдет
+        // на первом шаге после паузы. Команды трасса подает мимо getUpdates,
+        // так что с пустой очередью проход ничего не даст - его пропускаем.
+        if (telegram.pending()) sim::stepTask(telegram.task());
+        std::lock_guard<std::mutex> g(sim::telegram().lock);
+        if (sim::telegram().sentCount == sent_) return;
+        const std::deque<String>& sent = sim::telegram().sent;
+        size_t fresh = std::min<uint64_t>(sim::telegram().sentCount - sent_, sent.size());
+        for (size_t i = sent.size() - fresh; i < sent.size(); i++) note("tg", sent[i].c_str());
+        sent_ = sim::telegram().sentCount;
+    }
+
+    void reply(const sim::HttpResponse& resp) {
+        char text[512];
+        snprintf(text, sizeof(text), "%d %s", resp.code, resp.body.c_str());
+        note("http", text);
+    }
+
+    // [ip 4][аргументы]
+    void httpEvent(const TraceRecord& r) {
+        if (r.len < 4) return;
+        sim::HttpRequest req;
+        req.method = HTTP_POST;
+        req.uri = "/event";
+        req.remote = IPAddress(traceGet32(r.data));
+        std::string query((const char*)r.data + 4, r.len - 4);
+        for (size_t pos = 0; pos < query.size();) {
+            size_t amp = query.find('&', pos);
+            if (amp == std::string::npos) amp = query.size();
+            std::string pair = query.substr(pos, amp - pos);
+            size_t eq = pair.find('=');
+            if (eq != std::string::npos) req.args.push_back({String(pair.substr(0, eq)), String(pair.substr(eq + 1))});
+            pos = amp + 1;
+        }
+        reply(sim::httpRequest(SERVER_PORT, req));
+    }
+
+    void httpBatch(const TraceRecord& r) {
+        if (r.len < 4) return;
+        sim::HttpRequest req;
+        req.method = HTTP_POST;
+        req.uri = "/events";
+        req.remote = IPAddress(traceGet32(r.data));
+        req.args = {{"plain", String(std::string((const char*)r.data + 4, r.len - 4))}};
+        reply(sim::httpRequest(SERVER_PORT, req));
+    }
+
+    void udpFrame(const TraceRecord& r) {
+        if (r.len < 4) return;
+        uint8_t buf[SENSOR_FRAME_SIZE + 1];
+        int size = (int)std::min(r.len - 4, sizeof(buf));
+        memcpy(buf, r.data + 4, size);
+        if (!acceptSensorFrame(buf, size, traceGet32(r.data))) {
+            note("udp", "no ack");
+            return;
+        }
+        SensorFrame ack = {};
+        decodeFrame(buf, SENSOR_FRAME_SIZE, ack);
+        char text[32];
+        snprintf(text, sizeof(text), "ack flags=%u", ack.flags);
+        note("udp", text);
+    }
+
+    // Карта у считывателя до ответа на REQA (раз в RFID_KICK_MS). Запрос,
+    // ушедший до касания, задача должна отработать без карты. Карту задача
+    // убирает до постановки касания в очередь, поэтому после каждого шага
+    // ждем ее, а касание берет следующий loop().
+    void card(const TraceRecord& r) {
+        settleRfid();
+        sim::rfid().tap(r.data, (uint8_t)std::min<size_t>(r.len, 10));
+        for (int i = 0; i < REPLAY_RFID_WAIT_MS; i++) {     // loop() - 1 мс
+            step();
+            settleRfid();
+            if (!sim::rfid().present) {
+                step();
+                return;
+            }
+        }
+        sim::rfid().remove();
+        note("rfid", "not read");
+    }
+
+    // [chatId]\0[текст]
+    void command(const TraceRecord& r) {
+        const char* chat = (const char*)r.data;
+        size_t chatLen = strnlen(chat, r.len);
+        FB_msg msg;
+        msg.chatID = String(std::string(chat, chatLen));
+        msg.text = chatLen < r.len ? String(std::string(chat + chatLen + 1, r.len - chatLen - 1)) : String();
+        handleTelegramMessage(msg);
+    }
+
+    uint64_t startUs_ = 0;
+    AlarmState state_ = AlarmState::Disarmed;
+    bool siren_ = false;
+    bool wifi_ = false;
+    uint32_t dropped_ = 0;
+    uint64_t sent_ = 0;
+};
+
+uint64_t fnv1a(const std::vector<std::string>& lines) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const std::string& l : lines) {
+        for (char c : l) h = (h ^ (uint8_t)c) * 1099511628211ULL;
+        h = (h ^ '\n') * 1099511628211ULL;
+    }
+    return h;
+}
+
+// Число отличающихся строк; первые различия выводятся
+size_t compareOutputs(const std::vector<std::string>& got, const char* path) {
+    std::vector<std::string> want;
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        printf("  cannot read REPLAY_EXPECT=%s\n", path);
+        return got.size();
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        want.push_back(line);
+    }
+    fclose(f);
+    size_t diffs = 0;
+    size_t n = std::max(got.size(), want.size());
+    for (size_t i = 0; i < n; i++) {
+        const std::string* a = i < want.size() ? &want[i] : nullptr;
+        const std::string* b = i < got.size() ? &got[i] : nullptr;
+        if (a && b && *a == *b) continue;
+        if (diffs++ < REPLAY_SHOW_DIFFS) {
+            printf("  line %zu:\n    - %s\n    + %s\n", i + 1, a ? a->c_str() : "(none)", b ? b->c_str() : "(none)");
+        }
+    }
+    return diffs;
+}
+
+// Тот же бенчмарк в новом процессе; echo - вывод как свой. 0 - нет digest.
+uint64_t runChild(const char* exe, const char* results, bool echo) {
+    std::string cmd = std::string("REPLAY_IN_PROCESS=1 ") + (echo ? "" : "env -u REPLAY_OUT -u REPLAY_EXPECT ") + "'" +
+                      exe + "' --bench replay --save " + results + " 2>&1";
+    FILE* p = popen(cmd.c_str(), "r");
+    char line[4096];
+    unsigned long long digest = 0;
+    while (p && fgets(line, sizeof(line), p)) {
+        const char* d = strstr(line, " digest ");
+        if (d) sscanf(d, " digest %llx", &digest);
+        if (echo && strncmp(line, "=== ", 4) != 0) fputs(line, stdout);
+    }
+    if (p) pclose(p);
+    return digest;
+}
+
+// После других бенчмарков: два новых процесса, числа первого - как свои,
+// второй только проверяет, что выходы те же
+void replayInChild() {
+    char exe[512];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    char results[] = "/tmp/replay_results_XXXXXX";
+    int fd = mkstemp(results);
+    if (n <= 0 || fd < 0) {
+        printf("  cannot start a fresh process\n");
+        return;
+    }
+    exe[n] = '\0';
+    close(fd);
+    uint64_t digest = runChild(exe, results, true);
+
+    char line[4096];
+    FILE* f = fopen(results, "r");
+    while (f && fgets(line, sizeof(line), f)) {
+        char key[128];
+        double value;
+        if (sscanf(line, " \"replay.%127[^\"]\": %lf", key, &value) != 2) continue;
+        bool higher = strcmp(key, "speedup") == 0 || strcmp(key, "records") == 0;
+        sim::report(key, value, higher ? sim::Better::Higher : sim::Better::Lower);
+    }
+    if (f) fclose(f);
+
+    uint64_t again = runChild(exe, results, false);
+    unlink(results);
+    bool same = digest && again == digest;
+    printf("  second run: digest %016llx, %s\n", (unsigned long long)again,
+           same ? "same outputs" : "FAIL: outputs differ");
+    sim::report("digest_mismatch", same ? 0 : 1);
+}
+}
+
+
+SIM_BENCH(replay) {
+    if (!getenv("REPLAY_IN_PROCESS")) {
+        replayInChild();
+        return;
+    }
+    bootServer();
+
+    const char* path = getenv("TRACE_PATH");
+    std::vector<std::vector<uint8_t>> segs;
+    if (path) segs = loadSegments(path);
+    else segs.push_back(generateWeek(REPLAY_DAYS));
+    size_t bytes = 0;
+    for (const auto& s : segs) bytes += s.size();
+    if (path) printf("  trace: %s, %zu segments, %zu bytes\n", path, segs.size(), bytes);
+    else printf("  trace: generated, %d days, %d sensors, %zu bytes\n", REPLAY_DAYS, REPLAY_SENSORS, bytes);
+
+    Replay replay;
+    replay.begin();
+    uint32_t recordedBefore = trace.stats().records;
+    uint64_t records = 0, bad = 0, truncated = 0;
+    uint64_t base = 0, lastMs = 0;     // Время трассы; перезагрузка платы - продолжение без скачка
+    uint32_t anchor = 0;
+    bool first = true;
+    uint64_t t0 = sim::hostNs();
+    for (const auto& s : segs) {
+        TraceReader rd(s.data(), s.size());
+        if (!rd.valid()) {
+            bad++;
+            continue;
+        }
+        if (first || rd.boot()) {
+            if (!first) replay.note("trace", "device reboot");
+            base = lastMs;
+            anchor = rd.baseMs();
+            first = false;
+        }
+        TraceRecord r;
+        while (rd.next(r)) {
+            lastMs = base + (uint32_t)(r.ms - anchor);
+            replay.play(lastMs, r);
+            records++;
+        }
+        truncated += rd.truncated();
+    }
+    double hostSec = (sim::hostNs() - t0) / 1e9;
+    sim::holdTask(telegram.task(), false);
+    double traceSec = replay.elapsedMs() / 1000.0;
+    trace.flush();
+    TraceStats ts = trace.stats();
+
+    printf("  records: %llu (%.1f bytes each), %llu inputs, %llu skipped, %llu bad segments, %llu truncated\n",
+           (unsigned long long)records, records ? (double)bytes / records : 0.0, (unsigned long long)replay.inputs,
+           (unsigned long long)replay.skipped, (unsigned long long)bad, (unsigned long long)truncated);
+    printf("  replayed %.1f days in %.2f s host: %.0fx real time, %.1f us per record\n", traceSec / 86400, hostSec,
+           hostSec > 0 ? traceSec / hostSec : 0, records ? hostSec * 1e6 / records : 0);
+    printf("  recorder during replay: %lu inputs re-recorded, %lu dropped\n",
+           (unsigned long)(ts.records - recordedBefore), (unsigned long)ts.dropped);
+
+    printf("  outputs: %zu lines, digest %016llx:", replay.lines.size(), (unsigned long long)fnv1a(replay.lines));
+    for (const auto& k : replay.kinds) printf(" %s %zu", k.first.c_str(), k.second);
+    printf("\n");
+
+    if (const char* out = getenv("REPLAY_OUT")) {
+        FILE* f = fopen(out, "w");
+        for (const std::string& l : replay.lines) {
+            if (f) fprintf(f, "%s\n", l.c_str());
+        }
+        if (f) fclose(f);
+        printf("  outputs saved: %s\n", out);
+    }
+    if (const char* expect = getenv("REPLAY_EXPECT")) {
+        size_t diffs = compareOutputs(replay.lines, expect);
+        printf("  vs %s: %zu differing lines\n", expect, diffs);
+        sim::report("output_diffs", diffs);
+    }
+    sim::report("records", records, sim::Better::Higher);
+    sim::report("speedup", hostSec > 0 ? traceSec / hostSec : 0, sim::Better::Higher);
+    sim::report("us_per_record", records ? hostSec * 1e6 / records : 0);
+}
@@ -0,0 +1,131 @@
+// bench_rfid_index.cpp - поиск карты: хеш-таблица по бинарным UID против
+// старого линейного перебора строк (checkRFIDTag) на 10, 1k и 10k картах
+#include <LittleFS.h>
+#include <random>
+#include <vector>
+#include "hal_bench.h"
+#include "hal_sim.h"
+#include "rfid_index.h"
+
+
+static CardUid randomUid(std::mt19937& rng) {
+    CardUid uid;
+    uid.size = (rng() % 4 == 0) ? 7 : 4;   // Четверть карт - 7-байтовые NTAG
+    for (uint8_t i = 0; i < uid.size; i++) uid.bytes[i] = (uint8_t)rng();
+    if (uid.size == 7) uid.bytes[0] = 0x04;   // NXP
+    return uid;
+}
+
+// Как раньше в checkRFID(): UID собирается в String байт за байтом
+static String uidToString(const CardUid& uid) {
+    String s = "";
+    for (uint8_t i = 0; i < uid.size; i++) {
+        if (uid.bytes[i] < 0x10) s += "0";
+        s += String(uid.bytes[i], HEX);
+        if (i < uid.size - 1) s += " ";
+    }
+    s.toUpperCase();
+    return s;
+}
+
+static void runSize(size_t n) {
+    std::mt19937 rng(12345 + n);
+    std::vector<CardUid> enrolled, strangers;
+    for (size_t i = 0; i < n; i++) enrolled.push_back(randomUid(rng));
+    for (size_t i = 0; i < 1024; i++) strangers.push_back(randomUid(rng));
+
+    size_t slots = 16;
+    while (slots * 3 / 4 < n) slots <<= 1;
+    RfidIndex index;
+    index.begin(slots, n * 32 + 64);
+    char owner[24];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(owner, sizeof(owner), "Сотрудник %zu", i);
+        index.put(enrolled[i], owner, i % 10 != 0);
+    }
+
+    // Хеш-таблица: попадания и промахи
+    const size_t LOOKUPS = 1000000;
+    volatile size_t found = 0;
+    uint64_t allocs = sim::allocCount();
+    uint64_t t0 = sim::hostNs();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        found += index.lookup(enrolled[(i * 7919) % n]).status != CardStatus::Unknown;
+    }
+    uint64_t t1 = sim::hostNs();
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        found += index.lookup(strangers[i & 1023]).status != CardStatus::Unknown;
+    }
+    uint64_t t2 = sim::hostNs();
+    allocs = sim::allocCount() - allocs;
+
+    // Старый способ: строка UID + линейное сравнение String
+    std::vector<String> table;
+    for (size_t i = 0; i < n; i++) table.push_back(uidToString(enrolled[i]));
+    size_t linearLookups = n >= 10000 ? 2000 : 100000;
+    uint64_t t3 = sim::hostNs();
+    for (size_t i = 0; i < linearLookups; i++) {
+        String uid = uidToString(enrolled[(i * 7919) % n]);
+        for (size_t j = 0; j < n; j++) {
+            if (table[j] == uid) { found += 1; break; }
+        }
+    }
+    uint64_t t4 = sim::hostNs();
+
+    // Загрузка базы из LittleFS
+    saveCards(LittleFS, "/bench_cards.txt", index);
+    RfidIndex loaded;
+    loaded.begin(slots, n * 32 + 64);
+    uint64_t t5 = sim::hostNs();
+    int lines = loadCards(LittleFS, "/bench_cards.txt", loaded);
+    uint64_t t6 = sim::hostNs();
+
+    printf("  cards=%-6zu hash hit=%6.1f ns  miss=%6.1f ns  allocs=%llu | linear String=%10.1f ns | "
+           "load %d cards %.2f ms, %zu KB RAM\n",
+           n, (double)(t1 - t0) / LOOKUPS, (double)(t2 - t1) / LOOKUPS, (unsigned long long)allocs,
+           (double)(t4 - t3) / linearLookups, lines, (t6 - t5) / 1e6, index.memoryBytes() / 1024);
+    (void)found;
+}
+
+
+// Самое длинное имя с /add_card (10-байтовый UID, имя кириллицей) и строка
+// старого файла длиннее RFID_LINE_MAX: обе карты читаются, имена - целыми
+// символами, не длиннее RFID_OWNER_MAX
+static void checkLongOwners() {
+    CardUid longUid = {RFID_UID_MAX, {0x04, 1, 2, 3, 4, 5, 6, 7, 8, 9}};
+    char owner[RFID_OWNER_MAX + 1];
+    copyUtf8(owner, sizeof(owner), "Очень длинное имя владельца карты с отчеством и должностью");
+    RfidIndex index;
+    index.begin(8, 256);
+    index.put(longUid, owner, true);
+    saveCards(LittleFS, "/bench_cards_long.txt", index);
+    fs::File f = LittleFS.open("/bench_cards_long.txt", "a");
+    f.print("0A0B0C0D;1;");
+    for (int i = 0; i < 8; i++) f.print("Старый владелец ");
+    f.print("\n");
+    f.close();
+
+    RfidIndex loaded;
+    loaded.begin(8, 512);
+    int lines = loadCards(LittleFS, "/bench_cards_long.txt", loaded);
+    CardUid oldUid = {4, {0x0A, 0x0B, 0x0C, 0x0D}};
+    CardInfo a = loaded.lookup(longUid);
+    CardInfo b = loaded.lookup(oldUid);
+    bool ok = lines == 2 && a.status == CardStatus::Active && strcmp(a.owner, owner) == 0 &&
+              b.status == CardStatus::Active && strlen(b.owner) <= RFID_OWNER_MAX &&
+              strncmp(b.owner, "Старый владелец", strlen("Старый владелец")) == 0 &&
+              (strlen(b.owner) == 0 || ((uint8_t)b.owner[strlen(b.owner) - 1] & 0xC0) != 0xC0);
+    printf("  long owners: %d lines, %zu and %zu bytes (max %d) -> %s\n", lines, strlen(a.owner),
+           strlen(b.owner), RFID_OWNER_MAX, ok ? "ok" : "FAILED");
+    sim::report("long_owner_errors", !ok);
+}
+
+
+SIM_BENCH(rfid_index) {
+    sim::setFsRoot("/tmp/esp32_server_bench_fs");
+    LittleFS.begin(true);
+    runSize(10);
+    runSize(1000);
+    runSize(10000);
+    checkLongOwners();
+}
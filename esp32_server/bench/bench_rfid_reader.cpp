@@ -0,0 +1,161 @@
+// bench_rfid_reader.cpp - SPI без карты и время от касания до решения:
+// старый опрос PICC_IsNewCardPresent() из loop() раз в 100 мс против задачи
+// считывателя, которую будит IRQ (rfid_reader.h)
+//
+// Часы виртуальные, трафик SPI - по модели стоимости операций библиотеки
+// MFRC522 в sim_devices.cpp. Старый путь воспроизводится прямыми вызовами
+// считывателя, пока задача считывателя не шлет REQA (setKickPeriod(0)).
+#include <random>
+#include "bench_common.h"
+#include "metrics.h"
+
+#define OLD_POLL_MS 100                // RFID_READ_DELAY старого checkRFID()
+#define IDLE_SECONDS 60
+#define SWIPES 200
+#define HELD_MS 5000
+#define SPI_CLOCK_HZ 4000000           // MFRC522_SPICLOCK библиотеки
+
+extern MFRC522 rfid;
+extern LatencyHistogram rfidDecisionTime;
+void checkRFID();
+
+static const uint8_t KNOWN[] = {0x23, 0x22, 0x04, 0x35};
+static const uint8_t UNKNOWN[] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+
+static void printBus(const char* label, uint64_t bytes, double seconds) {
+    double perSecond = bytes / seconds;
+    printf("  %-28s %8.0f bytes/s SPI, %5.2f%% of the bus at %d MHz\n", label, perSecond,
+           perSecond * 8 * 100 / SPI_CLOCK_HZ, SPI_CLOCK_HZ / 1000000);
+}
+
+// Старый checkRFID(): опрос раз в OLD_POLL_MS и отсев повторов счетчиком
+// чтений (карта принималась на 1-м и с 3-го чтения подряд)
+struct OldPoller {
+    uint32_t lastPoll = 0;
+    CardUid lastUid = {0, {0}};
+    int readCount = 0;
+
+    // Один проход loop() (1 мс). true - карта принята.
+    bool step() {
+        sim::advanceMs(1);
+        if (millis() - lastPoll < OLD_POLL_MS) return false;
+        lastPoll = millis();
+        if (!rfid.PICC_IsNewCardPresent() || !rfid.PICC_ReadCardSerial()) return false;
+        CardUid uid;
+        uid.size = rfid.uid.size;
+        memcpy(uid.bytes, rfid.uid.uidByte, uid.size);
+        rfid.PICC_HaltA();
+        if (uid == lastUid) {
+            if (++readCount < 3) return false;
+        } else {
+            lastUid = uid;
+            readCount = 1;
+        }
+        return true;
+    }
+};
+
+// Новый путь: проход loop() (1 мс) с касаниями, которые успела прочитать задача
+static void stepNew() {
+    sim::advanceMs(1);
+    settleRfid();
+    checkRFID();
+    runAlarm();
+}
+
+// Касание до решения не дольше limitMs
+static bool decideNew(uint32_t limitMs) {
+    uint32_t decisions = rfidDecisionTime.count();
+    for (uint32_t ms = 0; ms < limitMs; ms++) {
+        stepNew();
+        if (rfidDecisionTime.count() != decisions) return true;
+    }
+    return false;
+}
+
+
+SIM_BENCH(rfid_reader) {
+    bootServer();
+    sim::useVirtualClock(true);
+    setAlarmState(AlarmState::Disarmed);
+    std::mt19937 rng(2024);
+
+    // ===== Старый опрос =====
+    rfidReader.setKickPeriod(0);
+    settleRfid();
+    sim::rfid().remove();
+    OldPoller old;
+    uint64_t bytes0 = sim::rfid().spiBytes;
+    for (int i = 0; i < IDLE_SECONDS * 1000; i++) old.step();
+    uint64_t oldIdle = sim::rfid().spiBytes - bytes0;
+
+    sim::Samples oldSwipe;
+    for (int i = 0; i < SWIPES; i++) {
+        for (uint32_t gap = 300 + rng() % 300; gap; gap--) old.step();
+        sim::rfid().tap(i % 2 ? KNOWN : UNKNOWN, 4);
+        uint32_t t0 = millis();
+        while (!old.step() && millis() - t0 < 1000) {}
+        oldSwipe.add(millis() - t0);
+        sim::rfid().remove();
+    }
+    sim::rfid().tap(KNOWN, 4, true);
+    int oldHeld = 0;
+    for (int ms = 0; ms < HELD_MS; ms++) oldHeld += old.step();
+    sim::rfid().remove();
+    bool oldSecond = false;
+    for (const uint8_t* uid : {UNKNOWN, KNOWN, KNOWN}) {
+        for (int ms = 0; ms < 500; ms++) old.step();
+        sim::rfid().tap(uid, 4);
+        oldSecond = false;
+        for (int ms = 0; ms < 500 && !oldSecond; ms++) oldSecond = old.step();
+        sim::rfid().remove();
+    }
+
+    // ===== Задача считывателя =====
+    rfidReader.setKickPeriod(RFID_KICK_MS);
+    bytes0 = sim::rfid().spiBytes;
+    advanceRfid(IDLE_SECONDS * 1000);
+    uint64_t newIdle = sim::rfid().spiBytes - bytes0;
+
+    sim::Samples newSwipe;
+    uint32_t missed = 0;
+    for (int i = 0; i < SWIPES; i++) {
+        advanceRfid(300 + rng() % 300);
+        sim::rfid().tap(i % 2 ? KNOWN : UNKNOWN, 4);
+        uint32_t t0 = millis();
+        if (!decideNew(1000)) missed++;
+        newSwipe.add(millis() - t0);
+        sim::rfid().remove();
+    }
+
+    RfidReaderStats st0 = rfidReader.stats();
+    advanceRfid(500);
+    sim::rfid().tap(KNOWN, 4, true);
+    uint32_t decisions0 = rfidDecisionTime.count();
+    for (int ms = 0; ms < HELD_MS; ms++) stepNew();
+    uint32_t newHeld = rfidDecisionTime.count() - decisions0;
+    uint32_t repeats = rfidReader.stats().repeats - st0.repeats;
+    sim::rfid().remove();
+    bool newSecond = false;
+    for (const uint8_t* uid : {UNKNOWN, KNOWN, KNOWN}) {
+        advanceRfid(500);
+        sim::rfid().tap(uid, 4);
+        newSecond = decideNew(500);
+        sim::rfid().remove();
+    }
+    setAlarmState(AlarmState::Disarmed);
+
+    printf("  idle %d s, no card:\n", IDLE_SECONDS);
+    printBus("poll every 100 ms (old)", oldIdle, IDLE_SECONDS);
+    printBus("IRQ, REQA every 50 ms", newIdle, IDLE_SECONDS);
+    oldSwipe.print("swipe -> decision (old)", "ms");
+    newSwipe.print("swipe -> decision (IRQ)", "ms");
+    printf("  card held %d s:       old %d decisions, IRQ %u (%u repeats filtered), missed swipes %u\n",
+           HELD_MS / 1000, oldHeld, newHeld, repeats, missed);
+    printf("  second swipe of a card 0.5 s after the first: old %s, IRQ %s\n", oldSecond ? "accepted" : "REJECTED",
+           newSecond ? "accepted" : "REJECTED");
+    sim::report("idle_spi_bytes_per_s", newIdle / (double)IDLE_SECONDS);
+    newSwipe.report("swipe_ms");
+    sim::report("held_decisions", newHeld);
+}
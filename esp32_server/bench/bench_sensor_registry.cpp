@@ -0,0 +1,128 @@
+// bench_sensor_registry.cpp - реестр датчиков: поиск по id, пульс, проверка сроков
+//
+// Сначала сам SensorRegistry на 64 датчиках: проход expire() без просроченных
+// против перебора всей таблицы. Затем прошивка целиком: 64 датчика шлют пульс
+// по HTTP раз в 30 с, один замолкает - через сколько придет сообщение в Telegram.
+#include <chrono>
+#include <random>
+#include <thread>
+#include "bench_common.h"
+#include "sensor_registry.h"
+
+#define BENCH_SILENCE_MS 95000         // SENSOR_SILENCE_MS из config.h
+#define BENCH_HEARTBEAT_MS 30000       // HEARTBEAT_INTERVAL датчика
+
+void checkSensors();
+extern SensorRegistry sensors;
+
+
+SIM_BENCH(sensor_registry) {
+    bootServer();
+    const int N = SENSOR_REGISTRY_SIZE;
+    const int ROUNDS = 2000;
+    char ids[N][SENSOR_ID_LEN + 1];
+    for (int i = 0; i < N; i++) snprintf(ids[i], sizeof(ids[i]), "pir_%02d_hall", i);
+
+    static SensorRegistry reg;
+    reg.begin(BENCH_SILENCE_MS);
+    for (int i = 0; i < N; i++) reg.setZone(reg.intern(ids[i]), i % 2 ? "Этаж 1" : "Этаж 2");
+
+    // Событие от датчика: поиск по id и продление срока
+    std::mt19937 rng(3);
+    sim::Samples seen;
+    uint32_t now = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        int i = rng() % N;
+        now += 10;
+        uint64_t t0 = sim::hostNs();
+        for (int k = 0; k < 100; k++) reg.seen(reg.find(ids[(i + k) % N]), now);
+        seen.add((sim::hostNs() - t0) / 100.0);
+    }
+
+    // Проверка сроков на каждом проходе loop(): просроченных нет
+    sim::Samples tick, scan;
+    size_t expired = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64_t t0 = sim::hostNs();
+        for (int k = 0; k < 100; k++) expired += reg.expire(now, [](uint8_t) {});
+        tick.add((sim::hostNs() - t0) / 100.0);
+
+        // Для сравнения - перебор всей таблицы
+        t0 = sim::hostNs();
+        for (int k = 0; k < 100; k++) {
+            reg.forEach([&](uint8_t h) { expired += (int32_t)(now - reg.lastSeen(h)) > BENCH_SILENCE_MS; });
+        }
+        scan.add((sim::hostNs() - t0) / 100.0);
+    }
+
+    // Все 64 замолчали разом
+    uint64_t e0 = sim::hostNs();
+    size_t all = reg.expire(now + BENCH_SILENCE_MS + 1000, [](uint8_t) {});
+    double allUs = (sim::hostNs() - e0) / 1000.0;
+
+    printf("  registry:            %d sensors, %zu bytes\n", N, SensorRegistry::memoryBytes());
+    seen.print("find + seen", "ns");
+    tick.print("expire, none due", "ns");
+    scan.print("full table scan", "ns");
+    printf("  expire all:          %zu sensors in %.2f us (%zu false expiries)\n", all, allUs, expired);
+
+    // Длинные id и зоны: обрезаются по символу и находят свою же запись
+    static SensorRegistry longReg;
+    longReg.begin(BENCH_SILENCE_MS);
+    const char* longId = "датчик_прихожей_у_двери";
+    const char* longZone = "Прихожая у входной двери дома";
+    uint8_t first = longReg.intern(longId);
+    bool longOk = first != SENSOR_NONE && longReg.intern(longId) == first && longReg.find(longId) == first &&
+                  longReg.count() == 1;
+    for (int i = 0; i < SENSOR_MAX_ZONES + 1; i++) longOk &= longReg.setZone(first, longZone);
+    char cut[SENSOR_ZONE_LEN + 1];
+    copyUtf8(cut, sizeof(cut), longZone);
+    longOk &= strcmp(longReg.zoneName(first), cut) == 0 && strlen(longReg.id(first)) <= SENSOR_ID_LEN;
+    printf("  long id and zone:    \"%s\" / \"%s\" -> %s\n", longReg.id(first), longReg.zoneName(first),
+           longOk ? "ok" : "FAILED");
+    sim::report("long_key_errors", !longOk);
+
+    // Прошивка: 64 датчика по HTTP, один замолкает. Реестр пустой, как на
+    // новой плате: датчики прошлых бенчмарков заняли бы ячейки и молчали бы сами
+    sensors.begin(BENCH_SILENCE_MS);
+    size_t sentBefore = sim::telegram().sentCount;
+    for (int i = 0; i < N; i++) sim::httpRequest(SERVER_PORT, sensorEvent("heartbeat", ids[i], "alive"));
+    drainSensorInputs();
+    uint64_t quietFrom = sim::nowUs() / 1000;
+    uint64_t detectAt = 0, alertAt = 0;
+    const int QUIET = 17;
+    sim::Samples check;
+    for (uint32_t t = 0; t < 5 * BENCH_HEARTBEAT_MS && !detectAt; t += 1000) {
+        sim::advanceMs(1000);
+        if ((t + 1000) % BENCH_HEARTBEAT_MS == 0) {
+            for (int i = 0; i < N; i++) {
+                if (i != QUIET) sim::httpRequest(SERVER_PORT, sensorEvent("heartbeat", ids[i], "alive"));
+            }
+            drainSensorInputs();
+        }
+        uint64_t t0 = sim::hostNs();
+        checkSensors();
+        check.add((sim::hostNs() - t0) / 1000.0);
+        uint8_t quiet = sensors.find(ids[QUIET]);
+        if (detectAt || quiet == SENSOR_NONE || !sensors.silent(quiet)) continue;
+        detectAt = sim::nowUs() / 1000;
+
+        // Задача Telegram отправляет сообщение за реальное время, часы стоят
+        uint64_t waitUntil = sim::hostNs() + 1000000000ULL;
+        while (!alertAt && sim::hostNs() < waitUntil) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> g(sim::telegram().lock);
+            for (const String& m : sim::telegram().sent) {
+                if (m.indexOf(ids[QUIET]) >= 0 && m.indexOf("не выходит") >= 0) alertAt = sim::nowUs() / 1000;
+            }
+        }
+    }
+    check.print("checkSensors()", "us");
+    if (alertAt) {
+        printf("  silent sensor:       detected after %.0f s (limit %d s), telegram after %.0f s\n",
+               (detectAt - quietFrom) / 1000.0, BENCH_SILENCE_MS / 1000, (alertAt - quietFrom) / 1000.0);
+        printf("  telegram messages:   %zu for %d sensors\n", (size_t)(sim::telegram().sentCount - sentBefore), N);
+    } else {
+        printf("  silent sensor:       NO ALERT\n");
+    }
+}
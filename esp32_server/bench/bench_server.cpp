@@ -0,0 +1,197 @@
+// bench_server.cpp - время обработки событий логикой сервера на ПК
+//
+// Профилирование: perf record -g .pio/build/native/program --bench sensor_event
+#include "bench_common.h"
+#include "metrics.h"
+#include "pattern_player.h"
+
+#define BENCH_BUZZER_PIN 25    // BUZZER_PIN из config.h
+
+void handleSensorEvent();
+void checkRFID();
+extern PatternPlayer buzzer;
+extern LatencyHistogram rfidDecisionTime;
+
+
+// Запуск: setup() без ожидания WiFi, сообщение о запуске - после подключения
+SIM_BENCH(boot) {
+    bootServer();
+    const BootResult& r = bootResult();
+    char lines[BOOT_MAX_STAGES * 64];
+    boot.format(lines, sizeof(lines));
+    printf("  stages:\n%s", lines);
+    printf("  setup():               %8.1f ms (was 2500 + up to 10000 WiFi wait)\n", r.setupMs);
+    printf("  ready (all stages):    %8.1f ms\n", r.readyMs);
+    printf("  GET /status before WiFi: %d\n", r.statusBeforeWifi);
+    printf("  boot message with stage breakdown: %s\n", r.announced ? "sent" : "MISSING");
+    sim::report("setup_ms", r.setupMs);
+    sim::report("ready_ms", r.readyMs);
+    sim::report("boot_failures", (r.statusBeforeWifi != 200) + !r.announced);
+}
+
+
+SIM_BENCH(sensor_event) {
+    bootServer();
+    const int N = 20000;
+    sim::Samples t;
+    t.reserve(N);
+
+    uint64_t allocsBefore = sim::allocCount();
+    for (int i = 0; i < N; i++) {
+        setAlarmState((i % 2) == 0 ? AlarmState::Armed : AlarmState::Disarmed);
+        sim::HttpRequest req = sensorEvent("motion", "pir_sensor", "detected");
+        uint64_t t0 = sim::hostNs();
+        sim::HttpResponse resp = sim::httpRequest(SERVER_PORT, req);
+        drainSensorInputs();           // Ответ датчику и обработка в loop() - одно событие
+        t.add((sim::hostNs() - t0) / 1000.0);
+        if (resp.code != 200) printf("  unexpected code %d\n", resp.code);
+        sim::advanceMs(10);
+    }
+    double allocs = (double)(sim::allocCount() - allocsBefore) / N;
+    setAlarmState(AlarmState::Disarmed);
+    t.print("handleSensorEvent + loop()", "us");
+    printf("  allocs per event: %.1f\n", allocs);
+    t.report("latency_us");
+    sim::report("allocs_per_event", allocs);
+}
+
+
+SIM_BENCH(rfid_swipe) {
+    bootServer();
+    const uint8_t known[] = {0x23, 0x22, 0x04, 0x35};
+    const uint8_t unknown[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    const int N = 20000;
+    sim::Samples t;
+    t.reserve(N);
+
+    uint64_t allocsBefore = sim::allocCount();
+    uint32_t decisions0 = rfidDecisionTime.count();
+    for (int i = 0; i < N; i++) {
+        sim::rfid().tap((i % 2) ? known : unknown, 4);
+        advanceRfid(250);      // Та же карта через 500 мс - больше RFID_REPEAT_MS
+        uint64_t t0 = sim::hostNs();
+        checkRFID();
+        runAlarm();                    // Известная карта переключает охрану через автомат
+        t.add((sim::hostNs() - t0) / 1000.0);
+    }
+    double allocs = (double)(sim::allocCount() - allocsBefore) / N;
+    t.print("checkRFID + runAlarm (card present)", "us");
+    printf("  allocs per swipe: %.1f, decisions %u of %d swipes\n", allocs, rfidDecisionTime.count() - decisions0, N);
+    t.report("latency_us");
+    sim::report("allocs_per_swipe", allocs);
+}
+
+
+SIM_BENCH(loop_idle) {
+    bootServer();
+    const int N = 100000;
+    sim::Samples t;
+    t.reserve(N);
+    for (int i = 0; i < N; i++) {
+        uint64_t t0 = sim::hostNs();
+        loop();
+        t.add((sim::hostNs() - t0) / 1000.0);
+    }
+    t.print("loop() without input", "us");
+    t.report("latency_us");
+}
+
+
+// Выгрузка очереди датчика после обрыва связи: пачки по 64 старых события
+SIM_BENCH(sensor_batch) {
+    bootServer();
+    const int BATCHES = 200;
+    const int PER_BATCH = 64;              // STORE_BATCH датчика
+    sim::Samples t;
+    t.reserve(BATCHES);
+    uint32_t seq = 0;
+    int accepted = 0;
+
+    uint64_t t0All = sim::hostNs();
+    for (int b = 0; b < BATCHES; b++) {
+        String body;
+        char line[64];
+        snprintf(line, sizeof(line), "batch_pir;77;%lu;%d\n", 50000000UL, b < BATCHES - 1 ? 1 : 0);
+        body += line;
+        for (int i = 0; i < PER_BATCH; i++) {
+            seq++;
+            snprintf(line, sizeof(line), "%lu;motion;77;%lu\n", (unsigned long)seq, 1000UL + seq * 10000UL);
+            body += line;
+        }
+        sim::HttpRequest req;
+        req.method = HTTP_POST;
+        req.uri = "/events";
+        req.args = {{"plain", body}};
+        uint64_t t0 = sim::hostNs();
+        sim::HttpResponse resp = sim::httpRequest(SERVER_PORT, req);
+        drainSensorInputs();
+        t.add((sim::hostNs() - t0) / 1000.0);
+        if (resp.code != 200) printf("  unexpected code %d\n", resp.code);
+        if (resp.body.indexOf("\"accepted\":64") >= 0) accepted += PER_BATCH;
+    }
+    double totalMs = (sim::hostNs() - t0All) / 1e6;
+
+    // Повтор последней пачки (ответ потерялся) - все события уже учтены
+    String body = "batch_pir;77;50000000;0\n";
+    for (uint32_t s = seq - PER_BATCH + 1; s <= seq; s++) body += String(s) + ";motion;77;1000\n";
+    sim::HttpRequest req;
+    req.method = HTTP_POST;
+    req.uri = "/events";
+    req.args = {{"plain", body}};
+    sim::HttpResponse repeat = sim::httpRequest(SERVER_PORT, req);
+    drainSensorInputs();
+
+    t.print("POST /events (64 events) + loop()", "us");
+    printf("  events accepted:   %d of %d in %.1f ms host time (%.0f events/s)\n", accepted,
+           BATCHES * PER_BATCH, totalMs, BATCHES * PER_BATCH / (totalMs / 1000));
+    printf("  repeated batch:    %s\n", repeat.body.c_str());
+}
+
+
+// Сигналы пищалки не задерживают loop(): раньше писк ошибки RFID стоил 300 мс delay()
+SIM_BENCH(buzzer_patterns) {
+    bootServer();
+    const uint8_t known[] = {0x23, 0x22, 0x04, 0x35};
+    const uint8_t unknown[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    const int N = 1000;
+    sim::Samples device;
+    setAlarmState(AlarmState::Disarmed);
+    sim::advanceMs(1000);
+
+    for (int i = 0; i < N; i++) {
+        sim::rfid().tap(unknown, 4);
+        advanceRfid(1000);                 // Карта прочитана, прошлый сигнал доиграл
+        uint64_t v0 = sim::nowUs();
+        checkRFID();
+        device.add((sim::nowUs() - v0) / 1000.0);
+    }
+    device.print("checkRFID, unknown card", "ms device");
+
+    // Тревога: сирена 200/500 мс по таймеру, писк карты ее не перебивает
+    setAlarmState(AlarmState::Armed);
+    sim::httpRequest(SERVER_PORT, sensorEvent("motion", "pir_sensor", "detected"));
+    drainSensorInputs();
+    uint32_t writes0 = sim::pinWrites(BENCH_BUZZER_PIN);
+    uint32_t rejected0 = buzzer.rejected();
+    advanceRfid(3000 - RFID_KICK_MS);
+    sim::rfid().tap(unknown, 4);
+    advanceRfid(RFID_KICK_MS);
+    checkRFID();
+    sim::advanceMs(4000);
+    uint32_t alarmWrites = sim::pinWrites(BENCH_BUZZER_PIN) - writes0;
+    bool alarmPlaying = buzzer.playing();
+
+    // Снятие с охраны картой: сирена замолкает, звучит писк снятия
+    sim::rfid().tap(known, 4);
+    advanceRfid(200);
+    checkRFID();
+    runAlarm();
+    sim::advanceMs(1000);
+    loop();
+
+    printf("  alarm for 7 s:      %u buzzer writes (10 cycles of 200/500 ms), still playing %s\n", alarmWrites,
+           alarmPlaying ? "yes" : "no");
+    printf("  chirps during alarm rejected: %u\n", buzzer.rejected() - rejected0);
+    printf("  after RFID disarm:  alarm %s, buzzer %s, pin %s\n", security.alarm() ? "on" : "off",
+           buzzer.playing() ? "playing" : "idle", digitalRead(BENCH_BUZZER_PIN) ? "HIGH" : "LOW");
+}
@@ -0,0 +1,149 @@
+// bench_status.cpp - GET /status без пауз: готовый ответ и условный GET
+//
+// 4 панели опрашивают /status по сокетам localhost, каждая на своем
+// соединении keep-alive шлет следующий запрос, как только пришел ответ.
+// Сначала обычные запросы (200 с телом), затем с If-None-Match последнего
+// ETag (304 без тела). Отдельно - обработчик без сокетов (sim::httpRequest):
+// время и выделения памяти на запрос. Перед замером - проверка: после
+// смены охраны старый ETag дает 200 и новый ETag, новый - 304.
+#include <atomic>
+#include <thread>
+#include "bench_common.h"
+#include "http_front.h"
+
+#define STATUS_PANELS 4
+#define STATUS_SECONDS 2
+#define STATUS_DISPATCHES 200000
+
+extern HttpFront server;
+
+namespace {
+struct PollResult {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint32_t> notModified{0};
+    std::atomic<uint32_t> errors{0};
+    double seconds = 0;
+};
+
+// ETag ответа без кавычек вокруг заголовка; "" - заголовка нет
+void etagOf(const char* rx, char* out, size_t size) {
+    out[0] = '\0';
+    const char* h = strcasestr(rx, "\r\nETag: ");
+    if (!h) return;
+    h += 8;
+    size_t len = strcspn(h, "\r");
+    if (len >= size) len = size - 1;
+    memcpy(out, h, len);
+    out[len] = '\0';
+}
+
+// Один запрос по своему соединению; возвращает код, 0 - ошибка
+int getStatus(const char* etag, char* rx, size_t size) {
+    int fd = connectLocal(false);
+    if (fd < 0) return 0;
+    char req[160];
+    int n = snprintf(req, sizeof(req), "GET /status HTTP/1.1\r\nHost: esp32\r\n%s%s%sConnection: close\r\n\r\n",
+                     etag[0] ? "If-None-Match: " : "", etag, etag[0] ? "\r\n" : "");
+    int code = 0;
+    if (send(fd, req, n, MSG_NOSIGNAL) != n || !readHttpResponse(fd, rx, size, code)) code = 0;
+    close(fd);
+    return code;
+}
+
+void runPoll(const char* etag, PollResult& r) {
+    uint64_t start = sim::hostNs();
+    uint64_t stop = start + (uint64_t)STATUS_SECONDS * 1000000000ULL;
+    std::thread panels[STATUS_PANELS];
+    for (std::thread& t : panels) {
+        t = std::thread([&] {
+            int fd = connectLocal(false);
+            char req[160];
+            int n = snprintf(req, sizeof(req), "GET /status HTTP/1.1\r\nHost: esp32\r\n%s%s%s\r\n",
+                             etag[0] ? "If-None-Match: " : "", etag, etag[0] ? "\r\n" : "");
+            char rx[512];
+            int code = 0;
+            while (fd >= 0 && sim::hostNs() < stop) {
+                if (send(fd, req, n, MSG_NOSIGNAL) != n || !readHttpResponse(fd, rx, sizeof(rx), code)) {
+                    r.errors++;
+                    break;
+                }
+                r.requests++;
+                if (code == 304) r.notModified++;
+                else if (code != 200) r.errors++;
+            }
+            if (fd >= 0) close(fd);
+        });
+    }
+    for (std::thread& t : panels) t.join();
+    r.seconds = (sim::hostNs() - start) / 1e9;
+    // Закрытые панелями соединения сетевая задача замечает на следующем проходе
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+// Обработчик без сокетов: нс и выделений памяти на запрос
+double runDispatch(const char* etag, double& allocs) {
+    sim::HttpRequest req;
+    req.uri = "/status";
+    if (etag[0]) req.headers = {{"If-None-Match", etag}};
+    uint64_t a0 = sim::allocCount();
+    uint64_t t0 = sim::hostNs();
+    for (int i = 0; i < STATUS_DISPATCHES; i++) sim::httpRequest(SERVER_PORT, req);
+    double ns = (double)(sim::hostNs() - t0) / STATUS_DISPATCHES;
+    allocs = (double)(sim::allocCount() - a0) / STATUS_DISPATCHES;
+    return ns;
+}
+
+void printPoll(const char* label, const PollResult& r) {
+    printf("  %-22s %llu requests in %.1f s, %.0f req/s, 304: %u, errors %u\n", label,
+           (unsigned long long)r.requests.load(), r.seconds, r.requests / r.seconds, r.notModified.load(),
+           r.errors.load());
+}
+}
+
+
+SIM_BENCH(status_poll) {
+    bootServer();
+    setAlarmState(AlarmState::Disarmed);
+    char rx[1024];
+
+    // ETag меняется вместе с охраной, и только тогда
+    char before[32], after[32], again[32];
+    int first = getStatus("", rx, sizeof(rx));
+    etagOf(rx, before, sizeof(before));
+    security.post(AlarmInput::Arm, EventSource::Telegram);
+    runAlarm();
+    int changed = getStatus(before, rx, sizeof(rx));
+    etagOf(rx, after, sizeof(after));
+    int same = getStatus(after, rx, sizeof(rx));
+    etagOf(rx, again, sizeof(again));
+    security.post(AlarmInput::Disarm, EventSource::Telegram);
+    runAlarm();
+    bool etagOk = before[0] && changed == 200 && strcmp(before, after) != 0 && same == 304 &&
+                  strcmp(after, again) == 0;
+
+    char etag[32];
+    getStatus("", rx, sizeof(rx));
+    etagOf(rx, etag, sizeof(etag));
+    double plainAllocs, condAllocs;
+    double plainNs = runDispatch("", plainAllocs);
+    double condNs = runDispatch(etag, condAllocs);
+
+    sim::useVirtualClock(false);
+    PollResult plain, conditional;
+    runPoll("", plain);
+    runPoll(etag, conditional);
+    sim::useVirtualClock(true);
+
+    printf("  etag %s: %d, after arm %s: %d, again: %d -> %s\n", before[0] ? before : "(none)", first,
+           after[0] ? after : "(none)", changed, same, etagOk ? "ok" : "FAILED");
+    printf("  handler only:          plain %.0f ns, %.1f allocs; If-None-Match %.0f ns, %.1f allocs\n", plainNs,
+           plainAllocs, condNs, condAllocs);
+    printf("  %d panels, keep-alive, no think time, real clock:\n", STATUS_PANELS);
+    printPoll("GET /status", plain);
+    printPoll("with If-None-Match", conditional);
+
+    sim::report("plain.req_per_s", plain.requests / plain.seconds, sim::Better::Higher);
+    sim::report("conditional.req_per_s", conditional.requests / conditional.seconds, sim::Better::Higher);
+    sim::report("handler_ns", plainNs);
+    sim::report("etag_errors", !etagOk);
+}
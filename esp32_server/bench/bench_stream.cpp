@@ -0,0 +1,201 @@
+// bench_stream.cpp - поток событий GET /stream вместо опроса GET /status
+//
+// 4 панели подписаны на /stream по сокетам localhost. Замер - время от смены
+// охраны в loop() (команда /arm или /disarm) до события у каждой панели;
+// для сравнения - опрос /status раз в секунду: в среднем полсекунды до
+// новости и 4 запроса в секунду к серверу, даже когда ничего не меняется.
+// Пятая подписка получает 503. Затем одна панель перестает читать, а от
+// датчиков идет поток движения: loop() не ждет, остальные панели получают
+// все, медленной остаются только свежие события, и, снова начав читать,
+// она видит последнее. Часы реальные.
+#include "bench_common.h"
+#include "http_front.h"
+
+#define PUSH_PANELS HTTP_MAX_STREAMS
+#define PUSH_TOGGLES 200
+#define PUSH_FLOOD 3000
+#define PUSH_FLOOD_GAP_US 100          // Между событиями датчиков
+#define PUSH_SLOW_RCVBUF 2048          // Приемный буфер медленной панели
+#define PUSH_POLL_MS 1000              // Опрос /status, с которым сравниваем
+
+void handleTelegramMessage(FB_msg& msg);
+extern HttpFront server;
+extern std::atomic<uint32_t> pushesLost;
+
+namespace {
+struct Panel {
+    int fd = -1;
+    size_t len = 0;
+    uint32_t lastId = 0;
+    uint32_t events = 0;
+    char state[16] = "";
+    char rx[8192];
+};
+
+// Подписка на /stream; rcvbuf - приемный буфер сокета (0 - как у системы).
+// Возвращает HTTP код, события после заголовков остаются в буфере панели.
+int subscribe(Panel& p, int rcvbuf) {
+    p.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvbuf) setsockopt(p.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(sim::hostPort(SERVER_PORT));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(p.fd, (sockaddr*)&addr, sizeof(addr)) != 0) return 0;
+    const char req[] = "GET /stream HTTP/1.1\r\nHost: esp32\r\nAccept: text/event-stream\r\n\r\n";
+    if (send(p.fd, req, sizeof(req) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(req) - 1)) return 0;
+    p.len = 0;
+    for (;;) {
+        ssize_t n = recv(p.fd, p.rx + p.len, sizeof(p.rx) - 1 - p.len, 0);
+        if (n <= 0) return 0;
+        p.len += n;
+        p.rx[p.len] = '\0';
+        const char* end = strstr(p.rx, "\r\n\r\n");
+        if (!end) continue;
+        int code = atoi(p.rx + 9);
+        size_t head = end + 4 - p.rx;
+        memmove(p.rx, p.rx + head, p.len - head);
+        p.len -= head;
+        fcntl(p.fd, F_SETFL, fcntl(p.fd, F_GETFL, 0) | O_NONBLOCK);
+        return code;
+    }
+}
+
+// Все пришедшие целиком события: последний id и состояние охраны
+void readEvents(Panel& p) {
+    for (;;) {
+        ssize_t n = recv(p.fd, p.rx + p.len, sizeof(p.rx) - 1 - p.len, 0);
+        if (n <= 0) break;
+        p.len += n;
+        if (p.len == sizeof(p.rx) - 1) break;
+    }
+    p.rx[p.len] = '\0';
+    char* start = p.rx;
+    for (char* end; (end = strstr(start, "\n\n")); start = end + 2) {
+        *end = '\0';
+        const char* id = strstr(start, "id: ");
+        const char* data = strstr(start, "\"state\":\"");
+        if (id && data) {
+            p.lastId = strtoul(id + 4, nullptr, 10);
+            p.events++;
+            data += 9;
+            size_t len = strcspn(data, "\"");
+            if (len >= sizeof(p.state)) len = sizeof(p.state) - 1;
+            memcpy(p.state, data, len);
+            p.state[len] = '\0';
+        } else if (data) {
+            p.events++;                // Первое событие подписки - без id
+        }
+    }
+    p.len -= start - p.rx;
+    memmove(p.rx, start, p.len);
+}
+
+void closePanel(Panel& p) {
+    if (p.fd >= 0) close(p.fd);
+    p.fd = -1;
+}
+}
+
+
+SIM_BENCH(state_push) {
+    bootServer();
+    sim::useVirtualClock(false);
+    setAlarmState(AlarmState::Disarmed);
+
+    // Последняя панель потом перестанет читать
+    Panel panels[PUSH_PANELS];
+    int subscribed = 0;
+    for (int i = 0; i < PUSH_PANELS; i++) {
+        subscribed += subscribe(panels[i], i == PUSH_PANELS - 1 ? PUSH_SLOW_RCVBUF : 0) == 200;
+    }
+    Panel extra;
+    int extraCode = subscribe(extra, 0);
+    closePanel(extra);
+
+    // Смена охраны -> событие у каждой панели
+    sim::Samples latency;
+    int missed = 0;
+    for (int i = 0; i < PUSH_TOGGLES; i++) {
+        FB_msg cmd;
+        cmd.chatID = "123456789";
+        cmd.text = i % 2 ? "/disarm" : "/arm";
+        const char* expect = i % 2 ? "disarmed" : "armed";
+        uint64_t t0 = sim::hostNs();
+        handleTelegramMessage(cmd);
+        runAlarm();
+        bool got[PUSH_PANELS] = {};
+        int pending = PUSH_PANELS;
+        while (pending && sim::hostNs() - t0 < 1000000000ULL) {
+            for (int k = 0; k < PUSH_PANELS; k++) {
+                if (got[k]) continue;
+                readEvents(panels[k]);
+                if (strcmp(panels[k].state, expect) != 0) continue;
+                got[k] = true;
+                pending--;
+                latency.add((sim::hostNs() - t0) / 1000.0);
+            }
+        }
+        missed += pending;
+    }
+    setAlarmState(AlarmState::Disarmed);
+
+    // Поток движения; медленная панель не читает
+    Panel& slow = panels[PUSH_PANELS - 1];
+    readEvents(slow);
+    uint32_t slowBefore = slow.events;
+    uint32_t fastBefore = panels[0].events;
+    uint32_t lostBefore = pushesLost;
+    HttpFrontStats mid = server.stats();
+    sim::Samples loopUs;
+    char sensorId[16];
+    for (int i = 0; i < PUSH_FLOOD; i++) {
+        snprintf(sensorId, sizeof(sensorId), "pir_%d", i % 8);
+        sim::httpRequest(SERVER_PORT, sensorEvent("motion", sensorId, "detected"));
+        uint64_t t0 = sim::hostNs();
+        drainSensorInputs();
+        loopUs.add((sim::hostNs() - t0) / 1000.0);
+        for (int k = 0; k < PUSH_PANELS - 1; k++) readEvents(panels[k]);
+        std::this_thread::sleep_for(std::chrono::microseconds(PUSH_FLOOD_GAP_US));
+    }
+    // Быстрые панели дочитывают, медленная начинает читать и догоняет:
+    // ждем, пока у всех один последний id и 50 мс ничего нового
+    uint64_t giveUp = sim::hostNs() + 2000000000ULL;
+    uint64_t quietSince = sim::hostNs();
+    uint32_t latest = 0;
+    while (sim::hostNs() < giveUp && sim::hostNs() - quietSince < 50000000ULL) {
+        for (Panel& p : panels) readEvents(p);
+        bool same = true;
+        for (Panel& p : panels) same &= p.lastId == panels[0].lastId;
+        if (!same || panels[0].lastId != latest) quietSince = sim::hostNs();
+        latest = panels[0].lastId;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const HttpFrontStats& st = server.stats();
+    uint32_t lost = pushesLost - lostBefore;
+    uint32_t fastEvents = panels[0].events - fastBefore;
+    uint32_t slowEvents = slow.events - slowBefore;
+    bool slowCaughtUp = slow.lastId == latest && latest != 0;
+
+    for (Panel& p : panels) closePanel(p);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));   // Сетевая задача замечает закрытие
+    FB_msg clear;
+    clear.text = "/clear_logs";
+    handleTelegramMessage(clear);
+
+    printf("  %d panels subscribed, one more: HTTP %d\n", subscribed, extraCode);
+    latency.print("arm/disarm -> panel", "us");
+    printf("  polling /status every %d ms instead: mean %d ms to notice, %.0f req/s on the server\n",
+           PUSH_POLL_MS, PUSH_POLL_MS / 2, PUSH_PANELS * 1000.0 / PUSH_POLL_MS);
+    printf("  %d motion events, %u lost in loop()->net queue: fast panels got %u, slow panel %u "
+           "(%u stale dropped), slow caught up to id %u: %s\n",
+           PUSH_FLOOD, lost, fastEvents, slowEvents,
+           st.streamDropped - mid.streamDropped, latest, slowCaughtUp ? "yes" : "NO");
+    loopUs.print("loop() per motion event", "us");
+    printf("  subscribers after close: %u, missed toggles: %d\n", (unsigned)server.streams(), missed);
+
+    latency.report("push_latency_us");
+    loopUs.report("loop_event_us");
+    sim::report("slow_caught_up", slowCaughtUp, sim::Better::Higher);
+    sim::useVirtualClock(true);
+}
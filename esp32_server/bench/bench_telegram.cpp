@@ -0,0 +1,283 @@
+// bench_telegram.cpp - время итерации loop(), пока Telegram отправляет сообщения
+//
+// Mock Telegram: каждый sendMessage занимает sendLatencyMs (как HTTPS запрос
+// к api.telegram.org). Фаза "inline" воспроизводит старое поведение - каждое
+// сообщение отправляется прямо из loop(); фаза "outbox" - текущая очередь.
+#include "bench_common.h"
+#include "rfid_index.h"
+#include "sensor_registry.h"
+#include "alert_digest.h"
+#include "telegram_outbox.h"
+
+extern TelegramOutbox telegram;
+
+static const uint32_t SEND_LATENCY_MS = 250;
+static const uint32_t RUN_MS = 6000;
+static const uint32_t EVENT_PERIOD_MS = 500;
+
+
+static void runPhase(const char* label, bool inlineSend) {
+    FastBot inlineBot;
+    sim::Samples iter;
+    int slow = 0;
+    uint32_t start = millis();
+    uint32_t lastEvent = 0;
+    int events = 0;
+
+    while (millis() - start < RUN_MS) {
+        bool motion = false;
+        if (millis() - lastEvent >= EVENT_PERIOD_MS) {
+            lastEvent = millis();
+            // Каждое 4-е событие - новая тревога
+            setAlarmState((events++ % 4) != 0 ? AlarmState::Alarm : AlarmState::Armed);
+            sim::queueHttpRequest(SERVER_PORT, sensorEvent("motion", "pir_sensor", "detected"));
+            motion = true;
+        }
+        // Связь с Telegram пропадает на секунду - отправка уходит в повторы
+        uint32_t t = millis() - start;
+        sim::telegram().online = !(t > 2000 && t < 3000);
+
+        // Все сообщения прохода, в том числе не вставшие в очередь: inline
+        // отправлял бы каждое, лимита чата у него не было
+        OutboxStats s0 = telegram.stats();
+        uint64_t t0 = sim::hostNs();
+        // Движение окна ALERT_WINDOW_MS уходит одной сводкой (alert_digest.h):
+        // сообщение на каждое событие - как до сводок
+        if (motion && inlineSend) inlineBot.sendMessage("🔍 Движение: pir_sensor");
+        else if (motion) telegram.send("🔍 Движение: pir_sensor");
+        loop();
+        if (inlineSend) {
+            OutboxStats s1 = telegram.stats();
+            uint32_t produced = (s1.enqueued + s1.dropped) - (s0.enqueued + s0.dropped);
+            for (uint32_t i = 0; i < produced; i++) inlineBot.sendMessage("inline");
+        }
+        double ms = (sim::hostNs() - t0) / 1e6;
+        if (ms > 10) slow++;
+        iter.add(ms);
+    }
+    sim::telegram().online = true;
+    iter.print(label, "ms");
+    printf("  %-28s iterations > 10 ms: %d, p99.9=%.2f ms\n", "", slow, iter.percentile(99.9));
+}
+
+
+SIM_BENCH(telegram_outbox) {
+    bootServer();
+    OutboxStats s0 = telegram.stats();
+    sim::useVirtualClock(false);
+    sim::telegram().sendLatencyMs = SEND_LATENCY_MS;
+
+    runPhase("loop() inline send", true);
+    runPhase("loop() with outbox", false);
+
+    // Ждем, пока очередь разгрузится
+    uint32_t waitStart = millis();
+    while (telegram.pending() && millis() - waitStart < 30000) delay(10);
+
+    OutboxStats s = telegram.stats();
+    // Максимум доставки копится с запуска (и с прошлых бенчмарков), а последнее
+    // сообщение очереди ждало дольше всех
+    printf("  outbox: enqueued=%u sent=%u retries=%u failed=%u dropped=%u throttled=%u last delivery=%u ms\n",
+           s.enqueued - s0.enqueued, s.sent - s0.sent, s.retries - s0.retries, s.failed - s0.failed,
+           s.dropped - s0.dropped, s.throttled - s0.throttled, s.lastDeliveryMs);
+    sim::telegram().sendLatencyMs = 0;
+    setAlarmState(AlarmState::Disarmed);
+    sim::useVirtualClock(true);
+}
+
+
+// Отчеты по командам Telegram: выделения памяти, время сборки и размеры сообщений.
+// 20 событий в логе, 200 карт, 64 датчика - списки длиннее одного сообщения.
+#define BENCH_REPORT_CARDS 200
+
+void handleTelegramMessage(FB_msg& msg);
+extern RfidIndex cards;
+
+static void runReport(const char* command, int repeats) {
+    FB_msg msg;
+    msg.chatID = "1";
+    msg.text = command;
+    uint32_t enqueued0 = telegram.stats().enqueued;
+    size_t sent0 = sim::telegram().sentCount;
+    sim::Samples t;
+    uint64_t allocs = 0;
+    for (int i = 0; i < repeats; i++) {
+        uint64_t a0 = sim::allocCount();
+        uint64_t t0 = sim::hostNs();
+        handleTelegramMessage(msg);
+        t.add((sim::hostNs() - t0) / 1000.0);
+        allocs += sim::allocCount() - a0;
+        // Очередь на 8 сообщений: ждем отправки, чтобы ничего не потерять
+        uint64_t waitUntil = sim::hostNs() + 2000000000ULL;
+        while (telegram.pending() && sim::hostNs() < waitUntil) delay(1);
+    }
+    uint32_t messages = telegram.stats().enqueued - enqueued0;
+
+    size_t maxBytes = 0;
+    {
+        std::lock_guard<std::mutex> g(sim::telegram().lock);
+        size_t n = sim::telegram().sentCount - sent0;
+        for (size_t i = sim::telegram().sent.size() > n ? sim::telegram().sent.size() - n : 0;
+             i < sim::telegram().sent.size(); i++) {
+            maxBytes = std::max(maxBytes, (size_t)sim::telegram().sent[i].length());
+        }
+    }
+    char label[48];
+    snprintf(label, sizeof(label), "%s", command);
+    t.print(label, "us");
+    printf("  %-28s allocs %.1f, messages %.1f, longest %zu bytes\n", "", (double)allocs / repeats,
+           (double)messages / repeats, maxBytes);
+
+    char key[48];
+    snprintf(key, sizeof(key), "%s.allocs", command + 1);
+    for (char* c = key; *c; c++) if (*c == ' ') *c = '_';
+    sim::report(key, (double)allocs / repeats);
+}
+
+
+SIM_BENCH(telegram_report) {
+    bootServer();
+    for (int i = 0; i < 20; i++) {
+        sim::httpRequest(SERVER_PORT, sensorEvent("motion", "report_pir", "detected"));
+        drainSensorInputs();
+        sim::advanceMs(1000);
+    }
+    for (int i = 0; i < BENCH_REPORT_CARDS; i++) {
+        CardUid uid = {4, {0xB0, 0x00, (uint8_t)(i >> 8), (uint8_t)i}};
+        char owner[32];
+        snprintf(owner, sizeof(owner), "Сотрудник %03d", i);
+        cards.put(uid, owner, i % 7 != 0);
+    }
+    for (int i = 0; i < SENSOR_REGISTRY_SIZE; i++) {
+        char id[24];
+        snprintf(id, sizeof(id), "report_pir_%02d", i);
+        sim::httpRequest(SERVER_PORT, sensorEvent("heartbeat", id, "alive"));
+        drainSensorInputs();
+    }
+
+    runReport("/logs", 50);
+    runReport("/logs 1h", 50);
+    runReport("/list_cards", 20);
+    runReport("/sensors", 20);
+}
+
+
+// Движение в активной зоне: 3 датчика раз в 1.5 с минуту подряд на охране.
+// Раньше каждое движение - сообщение, а лимит чата - 5 подряд и 20 в минуту;
+// теперь первое подробно, остальные - сводкой раз в ALERT_WINDOW_MS.
+#define BURST_SENSORS 3
+#define BURST_PERIOD_MS 1500
+#define BURST_SECONDS 60
+
+extern AlertDigest alerts;
+
+// Задача Telegram отправляет за реальное время; ждем, пока ей нечего слать
+static void settleTelegram() {
+    uint64_t giveUp = sim::hostNs() + 2000000000ULL;
+    for (;;) {
+        OutboxStats s = telegram.stats();
+        if (s.sent + s.failed == s.enqueued || telegram.held() || sim::hostNs() > giveUp) return;
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+}
+
+// Очередь под лимитом чата разгружается по виртуальным часам
+static void drainTelegram() {
+    for (int i = 0; i < 200 && telegram.pending(); i++) {
+        sim::advanceMs(500);
+        loop();
+        settleTelegram();
+    }
+}
+
+SIM_BENCH(alert_digest) {
+    bootServer();
+    sim::useVirtualClock(true);
+    // Окна сводок и очередь, оставшиеся от прошлых бенчмарков
+    sim::advanceMs(ALERT_WINDOW_MS);
+    loop();
+    drainTelegram();
+    setAlarmState(AlarmState::Armed);
+    runAlarm();
+    settleTelegram();
+    OutboxStats before = telegram.stats();
+    uint32_t coalesced0 = alerts.coalesced(), digests0 = alerts.digests();
+    uint64_t sent0 = sim::telegram().sentCount;
+
+    int motions = 0;
+    uint32_t start = millis();
+    uint32_t next[BURST_SENSORS];
+    for (int i = 0; i < BURST_SENSORS; i++) next[i] = start + i * 400;
+    while (millis() - start < BURST_SECONDS * 1000 + ALERT_WINDOW_MS) {
+        for (int i = 0; i < BURST_SENSORS; i++) {
+            if ((int32_t)(millis() - next[i]) < 0 || millis() - start >= BURST_SECONDS * 1000) continue;
+            char id[16];
+            snprintf(id, sizeof(id), "zone_pir_%d", i + 1);
+            sim::httpRequest(SERVER_PORT, sensorEvent("motion", id, "detected"));
+            next[i] += BURST_PERIOD_MS;
+            motions++;
+        }
+        loop();
+        settleTelegram();
+        sim::advanceMs(50);
+    }
+    drainTelegram();
+
+    OutboxStats after = telegram.stats();
+    uint32_t messages = after.enqueued - before.enqueued;
+    printf("  %d motions from %d sensors in %d s: %u messages (%u digests, %u events coalesced)\n", motions,
+           BURST_SENSORS, BURST_SECONDS, messages, alerts.digests() - digests0, alerts.coalesced() - coalesced0);
+    printf("  sent %llu, throttled %u, dropped %u (chat limit %d + 1 per %d ms)\n",
+           (unsigned long long)(sim::telegram().sentCount - sent0), after.throttled - before.throttled,
+           after.dropped - before.dropped, TELEGRAM_RATE_BURST, TELEGRAM_RATE_INTERVAL_MS);
+    {
+        std::lock_guard<std::mutex> g(sim::telegram().lock);
+        const std::deque<String>& sent = sim::telegram().sent;
+        size_t fresh = std::min<uint64_t>(sim::telegram().sentCount - sent0, sent.size());
+        for (size_t i = sent.size() - fresh; i < sent.size(); i++) {
+            const String& m = sent[i];
+            if (m.startsWith("🔍 Движение ×")) {
+                printf("  digest: %s\n", m.substring(0, m.indexOf('\n')).c_str());
+                break;
+            }
+        }
+    }
+    setAlarmState(AlarmState::Disarmed);
+    runAlarm();
+
+    // Тревога за полной очередью, чат уже исчерпал лимит: уходит первой
+    settleTelegramOutbox();
+    for (int i = 0; i < TELEGRAM_RATE_BURST; i++) telegram.send("📋 Отчет");
+    settleTelegram();
+    for (int i = 0; i < OUTBOX_SLOTS; i++) telegram.send("📋 Отчет");
+    settleTelegram();
+    setAlarmState(AlarmState::Armed);
+    uint32_t queued = telegram.pending();
+    uint64_t alarmSent0 = sim::telegram().sentCount;
+    uint32_t alarmAt = millis();
+    sim::httpRequest(SERVER_PORT, sensorEvent("motion", "zone_pir_1", "detected"));
+    drainSensorInputs();
+    long alarmMs = -1;
+    while (alarmMs < 0 && millis() - alarmAt < 60000) {
+        // Задача Telegram просыпается за реальное время: ждем ее, часы стоят
+        uint64_t giveUp = sim::hostNs() + 50000000ULL;
+        while (alarmMs < 0 && sim::hostNs() < giveUp) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> g(sim::telegram().lock);
+            const std::deque<String>& sent = sim::telegram().sent;
+            size_t fresh = std::min<uint64_t>(sim::telegram().sentCount - alarmSent0, sent.size());
+            for (size_t i = sent.size() - fresh; i < sent.size(); i++) {
+                if (sent[i].indexOf("ТРЕВОГА") >= 0) alarmMs = millis() - alarmAt;
+            }
+        }
+        if (alarmMs < 0) sim::advanceMs(100);
+    }
+    printf("  alarm behind %u throttled messages: sent after %ld ms\n", queued, alarmMs);
+    setAlarmState(AlarmState::Disarmed);
+    runAlarm();
+    drainTelegram();
+
+    sim::report("messages", messages);
+    sim::report("dropped", after.dropped - before.dropped);
+    sim::report("alarm_delay_ms", alarmMs < 0 ? 60000 : alarmMs);
+}
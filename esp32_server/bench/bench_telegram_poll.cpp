@@ -0,0 +1,160 @@
+// bench_telegram_poll.cpp - опрос Telegram: время радио против задержки команд
+//
+// Часть 1 - модель суток на PollScheduler: ночь без охраны, день на охране с
+// двумя тревогами (одну снимают /disarm, вторая уходит по таймауту), вечером
+// переписка с ботом. Каждый опрос занимает POLL_BENCH_COST_MS (HTTPS
+// getUpdates на плате). Сравниваются старый опрос раз в 3.6 с по 10 команд
+// и расписание по режиму: доля времени в опросах и задержка команд.
+//
+// Часть 2 - прошивка целиком на настоящих часах против mock Bot API
+// (FastBot на ПК, getUpdates занимает pollLatencyMs): идет тревога,
+// приходит /disarm, замеряется время до снятия с охраны в loop().
+#include <vector>
+#include "bench_common.h"
+#include "telegram_outbox.h"
+#include "telegram_poll.h"
+
+#define POLL_BENCH_COST_MS 300         // Опрос getUpdates на плате (TLS, радио)
+#define POLL_BENCH_STEP_MS 10
+#define POLL_BENCH_LATENCY_MS 150      // getUpdates у mock Bot API в части 2
+#define POLL_BENCH_DISARMS 4
+#define POLL_BENCH_FIXED_DISARMS 2     // Старый опрос: каждая ~2 с реального времени
+#define POLL_BENCH_FASTBOT_MS 3600     // Период FastBot по умолчанию
+#define POLL_BENCH_FASTBOT_LIMIT 10
+
+extern TelegramOutbox telegram;
+
+
+namespace {
+const uint32_t HOUR_MS = 3600000;
+
+struct DayCommand {
+    uint32_t at;
+    int mode;                          // Режим после выполнения, -1 - не меняет
+};
+
+struct DayResult {
+    uint32_t polls = 0;
+    uint64_t busyMs = 0;
+    sim::Samples latency[3];           // По режиму на момент команды, мс
+};
+
+// Сутки: команды и начала тревог, режим меняется по мере выполнения команд
+DayResult runDay(bool adaptive) {
+    std::vector<DayCommand> commands = {
+        {7 * HOUR_MS + 30 * 60000, (int)PollMode::Armed},        // /arm
+        {10 * HOUR_MS + 45000, (int)PollMode::Idle},             // /disarm в тревоге
+        {10 * HOUR_MS + 5 * 60000, (int)PollMode::Armed},        // /arm
+        {18 * HOUR_MS, (int)PollMode::Idle},                     // /disarm
+        {19 * HOUR_MS, -1},                                      // /status
+        {19 * HOUR_MS + 20000, -1},                              // /logs
+        {19 * HOUR_MS + 40000, -1},                              // /logs 2h
+        {19 * HOUR_MS + 70000, -1},                              // /sensors
+        {23 * HOUR_MS, (int)PollMode::Armed},                    // /arm
+    };
+    const uint32_t alarms[] = {10 * HOUR_MS, 14 * HOUR_MS};
+    const uint32_t alarmTimeoutMs = 5 * 60000;
+
+    PollScheduler poll;
+    poll.setFixed(adaptive ? 0 : POLL_BENCH_FASTBOT_MS);
+    DayResult r;
+    PollMode mode = PollMode::Idle;
+    size_t next = 0, nextAlarm = 0;
+    uint32_t alarmAt = 0;
+    // Начало в 00:00 на часах с запасом, чтобы millis() не начинался с нуля
+    const uint32_t base = 1000000;
+    for (uint32_t t = 0; t < 24 * HOUR_MS; t += POLL_BENCH_STEP_MS) {
+        if (nextAlarm < sizeof(alarms) / sizeof(alarms[0]) && t >= alarms[nextAlarm]) {
+            if (mode == PollMode::Armed) {
+                mode = PollMode::Alarm;
+                alarmAt = t;
+            }
+            nextAlarm++;
+        }
+        if (mode == PollMode::Alarm && t - alarmAt >= alarmTimeoutMs) mode = PollMode::Armed;
+        poll.setMode(mode);
+        if (!poll.due(base + t)) continue;
+
+        uint16_t limit = adaptive ? poll.limit(base + t) : POLL_BENCH_FASTBOT_LIMIT;
+        uint16_t received = 0;
+        uint32_t done = t + POLL_BENCH_COST_MS;
+        while (next < commands.size() && commands[next].at <= t && received < limit) {
+            r.latency[(int)mode].add(done - commands[next].at);
+            if (commands[next].mode >= 0) mode = (PollMode)commands[next].mode;
+            next++;
+            received++;
+        }
+        poll.setMode(mode);
+        poll.polled(base + done, true, received, limit);
+        r.polls++;
+        r.busyMs += POLL_BENCH_COST_MS;
+        t = done - POLL_BENCH_STEP_MS;  // Задача занята запросом
+    }
+    return r;
+}
+
+void printDay(const char* label, DayResult& r) {
+    const char* modes[] = {"idle", "armed", "alarm"};
+    printf("  %-10s polls/day %6u, in polls %5.2f%% of time", label, r.polls, r.busyMs * 100.0 / (24.0 * HOUR_MS));
+    for (int m = 0; m < 3; m++) {
+        if (r.latency[m].count()) printf(", %s cmd %.0f ms", modes[m], r.latency[m].mean());
+    }
+    printf("\n");
+}
+
+// /disarm во время тревоги: время от команды до снятия с охраны в loop()
+sim::Samples disarmLatency(uint32_t fixedMs, int repeats, double& dutyPct) {
+    telegram.setPollFixed(fixedMs);
+    sim::Samples ms;
+    uint64_t busy0 = telegram.pollTime().sumUs();
+    uint64_t start = sim::hostNs();
+    for (int i = 0; i < repeats; i++) {
+        setAlarmState(AlarmState::Alarm);
+        // Команда приходит в разной фазе расписания опроса
+        uint64_t wait = sim::hostNs() + (uint64_t)(100 + i * 377 % 500) * 1000000ULL;
+        while (sim::hostNs() < wait) {
+            loop();
+            delay(1);
+        }
+        uint64_t t0 = sim::hostNs();
+        sim::telegram().command("/disarm");
+        uint64_t giveUp = t0 + 10000000000ULL;
+        while (security.armed() && sim::hostNs() < giveUp) {
+            loop();
+            delay(1);
+        }
+        ms.add((sim::hostNs() - t0) / 1e6);
+    }
+    dutyPct = (telegram.pollTime().sumUs() - busy0) / 1000.0 / ((sim::hostNs() - start) / 1e6) * 100;
+    telegram.setPollFixed(0);
+    return ms;
+}
+}
+
+
+SIM_BENCH(telegram_poll) {
+    // ===== Часть 1: модель суток =====
+    DayResult fixed = runDay(false);
+    DayResult adaptive = runDay(true);
+    printDay("fixed 3.6s", fixed);
+    printDay("adaptive", adaptive);
+
+    // ===== Часть 2: прошивка и mock Bot API =====
+    bootServer();
+    sim::useVirtualClock(false);
+    sim::telegram().pollLatencyMs = POLL_BENCH_LATENCY_MS;
+    double fixedDuty = 0, adaptiveDuty = 0;
+    sim::Samples fixedDisarm = disarmLatency(POLL_BENCH_FASTBOT_MS, POLL_BENCH_FIXED_DISARMS, fixedDuty);
+    sim::Samples adaptiveDisarm = disarmLatency(0, POLL_BENCH_DISARMS, adaptiveDuty);
+    sim::telegram().pollLatencyMs = 0;
+    setAlarmState(AlarmState::Disarmed);
+    runAlarm();
+    fixedDisarm.print("/disarm in alarm, fixed 3.6s", "ms");
+    adaptiveDisarm.print("/disarm in alarm, adaptive", "ms");
+    printf("  in polls during alarm: fixed %.1f%%, adaptive %.1f%% (getUpdates %d ms)\n", fixedDuty, adaptiveDuty,
+           POLL_BENCH_LATENCY_MS);
+
+    sim::report("polls_per_day", adaptive.polls);
+    sim::report("idle_command_ms", adaptive.latency[(int)PollMode::Idle].mean());
+    sim::report("alarm_disarm_ms", adaptiveDisarm.mean());
+}
@@ -0,0 +1,100 @@
+// bench_transport.cpp - задержка события датчика: UDP кадр + ACK против HTTP POST /event
+//
+// Ответ датчику отдает сетевая задача прошивки, датчик - отдельный поток,
+// который ходит к ней через настоящие сокеты localhost. Основной поток только
+// разбирает очередь событий: loop() целиком не вызываем, его delay(1) держал
+// бы события в очереди, хотя на задержку ответа датчику уже не влияет.
+// Сетевая задача ждет HTTP и UDP в одном select(): кадр будит ее сразу.
+#include <atomic>
+#include <thread>
+#include <HTTPClient.h>
+#include "bench_common.h"
+#include "udp_link.h"
+
+#define TRANSPORT_EVENTS 2000
+
+namespace {
+std::atomic<bool> fallbackCalled{false};
+
+void onFallback(SensorEvent, const char*, uint32_t) { fallbackCalled = true; }
+
+// Разбираем события, принятые сетевой задачей, пока датчик не закончит
+template <typename F>
+void runWithServer(F sensor) {
+    std::atomic<bool> done{false};
+    std::thread t([&] {
+        sensor();
+        done = true;
+    });
+    while (!done) {
+        if (processSensorInputs() == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        runAlarm();
+    }
+    t.join();
+    drainSensorInputs();
+}
+}
+
+
+SIM_BENCH(transport) {
+    bootServer();
+    sim::useVirtualClock(false);
+    sim::httpClient().handler = nullptr;     // Настоящий TCP запрос к HttpFront
+
+    sim::Samples udpRtt, httpRtt;
+    UdpLinkStats udpStats = {};
+    int httpErrors = 0;
+
+    runWithServer([&] {
+        UdpLink link;
+        if (!link.begin("127.0.0.1", SENSOR_UDP_PORT, onFallback)) return;
+        for (int i = 0; i < TRANSPORT_EVENTS; i++) {
+            uint64_t t0 = sim::hostNs();
+            link.send(SensorEvent::Motion, "bench_pir");
+            while (link.inFlight() > 0) {
+                link.waitAck(UDP_RETRY_MS);   // Как HTTPClient: спим до ответа
+                link.poll();
+            }
+            udpRtt.add((sim::hostNs() - t0) / 1000.0);
+        }
+        udpStats = link.stats();
+    });
+
+    runWithServer([&] {
+        char url[48];
+        snprintf(url, sizeof(url), "http://127.0.0.1:%u/event", SERVER_PORT);
+        for (int i = 0; i < TRANSPORT_EVENTS; i++) {
+            uint64_t t0 = sim::hostNs();
+            HTTPClient http;
+            http.begin(url);
+            http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+            int code = http.POST("type=motion&sensor_id=bench_pir&value=detected");
+            http.end();
+            if (code != 200) httpErrors++;
+            httpRtt.add((sim::hostNs() - t0) / 1000.0);
+        }
+    });
+
+    // Сервер молчит: кадр повторяется и уходит в резервный путь
+    uint64_t f0 = sim::hostNs();
+    UdpLink dead;
+    dead.begin("127.0.0.1", SENSOR_UDP_PORT + 1, onFallback);
+    dead.send(SensorEvent::Motion, "bench_pir");
+    while (!fallbackCalled) {
+        dead.poll();
+        std::this_thread::yield();
+    }
+    double fallbackMs = (sim::hostNs() - f0) / 1e6;
+
+    printf("  events per transport: %d, localhost sockets, real clock\n", TRANSPORT_EVENTS);
+    udpRtt.print("udp frame -> ack", "us");
+    httpRtt.print("http POST /event", "us");
+    printf("  udp acked/sent:    %u/%u, retransmits %u, fallbacks %u\n", udpStats.acked, udpStats.sent,
+           udpStats.retransmits, udpStats.fallbacks);
+    printf("  http errors:       %d\n", httpErrors);
+    printf("  bytes on the wire: udp %d + ack %d, http body %zu + headers\n", SENSOR_FRAME_SIZE,
+           SENSOR_FRAME_SIZE, strlen("type=motion&sensor_id=bench_pir&value=detected"));
+    printf("  fallback to HTTP after %.0f ms without ack (%u retries)\n", fallbackMs, UDP_MAX_RETRIES);
+
+    sim::useVirtualClock(true);
+}
@@ -0,0 +1,160 @@
+// alarm_machine.h - состояние охраны: конечный автомат с очередью входов
+//
+// Охрана, тревога и ее таймаут меняются только здесь. Входы (команды
+// Telegram, карты, движение) кладутся в lock-free очередь из любой задачи,
+// а run() в задаче управления разбирает их строго по порядку очереди:
+// одна и та же последовательность входов всегда дает одни и те же
+// переходы, сколько бы задач их ни присылали. Текущее состояние читается
+// атомарно из любой задачи (ответы датчикам, /status).
+//
+//   Disarmed --Arm/Toggle--> Armed --Motion--> Alarm --Timeout--> Armed
+//   Armed, Alarm --Disarm/Toggle--> Disarmed
+//
+// Сообщения, лог и звук остаются снаружи: run() вызывает обработчик на
+// каждый вход с состояниями до и после (в том числе без перехода).
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "event_log.h"
+#include "lockfree_queue.h"
+
+
+// ===== Настройки =====
+#define ALARM_QUEUE_SLOTS 64           // Входов между проходами run()
+#define ALARM_WHO_LEN 48               // Владелец карты или датчик с зоной
+
+
+enum class AlarmState : uint8_t { Disarmed, Armed, Alarm };
+
+enum class AlarmInput : uint8_t {
+    Arm,        // Поставить на охрану (Telegram)
+    Disarm,     // Снять с охраны (Telegram)
+    Toggle,     // Разрешенная карта: поставить или снять
+    Motion,     // Движение от датчика
+    Timeout     // Тревога длится дольше таймаута (ставит сам run())
+};
+
+constexpr size_t ALARM_STATE_COUNT = (size_t)AlarmState::Alarm + 1;
+constexpr size_t ALARM_INPUT_COUNT = (size_t)AlarmInput::Timeout + 1;
+
+// Таблица переходов: ALARM_NEXT[состояние][вход]
+constexpr AlarmState ALARM_NEXT[ALARM_STATE_COUNT][ALARM_INPUT_COUNT] = {
+    //  Arm                 Disarm                Toggle                Motion              Timeout
+    {AlarmState::Armed, AlarmState::Disarmed, AlarmState::Armed, AlarmState::Disarmed, AlarmState::Disarmed},
+    {AlarmState::Armed, AlarmState::Disarmed, AlarmState::Disarmed, AlarmState::Alarm, AlarmState::Armed},
+    {AlarmState::Alarm, AlarmState::Disarmed, AlarmState::Disarmed, AlarmState::Alarm, AlarmState::Armed},
+};
+
+constexpr AlarmState alarmNext(AlarmState s, AlarmInput in) { return ALARM_NEXT[(size_t)s][(size_t)in]; }
+
+inline const char* alarmStateName(AlarmState s) {
+    switch (s) {
+        case AlarmState::Armed: return "armed";
+        case AlarmState::Alarm: return "alarm";
+        default:                return "disarmed";
+    }
+}
+
+
+// Вход автомата. Автомату нужен только input, остальное - для обработчика
+struct AlarmEvent {
+    AlarmInput input;
+    EventSource source;
+    uint8_t sensor;                    // Датчик (реестр), 0xFF - нет
+    uint32_t mark;                     // Начало замера: micros() чтения карты или приема движения
+    uint32_t ageUs;                    // Движение: возраст события при приеме, UINT32_MAX - неизвестен
+    char who[ALARM_WHO_LEN];           // Владелец карты или датчик
+    char ref[24];                      // Чат Telegram для ответа или UID карты
+};
+
+struct AlarmStats {
+    uint32_t posted;
+    uint32_t dropped;                  // Очередь была полна
+    uint32_t transitions;              // Входов, сменивших состояние
+};
+
+
+class AlarmMachine {
+public:
+    void begin(uint32_t alarmTimeoutMs) { timeoutMs_ = alarmTimeoutMs; }
+
+    // Из любой задачи (не блокирует). false - очередь полна, вход потерян.
+    template <typename F>
+    bool postWith(AlarmInput input, EventSource source, F&& fill) {
+        bool ok = queue_.tryPushWith([&](AlarmEvent& e) {
+            e = AlarmEvent();
+            e.input = input;
+            e.source = source;
+            e.sensor = 0xFF;
+            fill(e);
+        });
+        if (ok) posted_++;
+        else dropped_++;
+        return ok;
+    }
+
+    bool post(AlarmInput input, EventSource source) {
+        return postWith(input, source, [](AlarmEvent&) {});
+    }
+
+    // Только в задаче управления: разбирает очередь, затем таймаут тревоги.
+    // fn(const AlarmEvent&, AlarmState было, AlarmState стало) - на каждый вход.
+    template <typename F>
+    size_t run(uint32_t now, F&& fn) {
+        size_t n = 0;
+        AlarmEvent e;
+        while (queue_.tryPop(e)) {
+            apply(e, now, fn);
+            n++;
+        }
+        if (state() == AlarmState::Alarm && now - alarmSince_ > timeoutMs_) {
+            e = AlarmEvent();
+            e.input = AlarmInput::Timeout;
+            e.source = EventSource::System;
+            e.sensor = 0xFF;
+            apply(e, now, fn);
+            n++;
+        }
+        return n;
+    }
+
+    AlarmState state() const { return state_.load(std::memory_order_acquire); }
+    bool armed() const { return state() != AlarmState::Disarmed; }
+    bool alarm() const { return state() == AlarmState::Alarm; }
+    uint32_t alarmSince() const { return alarmSince_; }
+
+    // Только в задаче управления, без обработчика: восстановление после перезагрузки
+    void restore(AlarmState s, uint32_t now) {
+        state_.store(s, std::memory_order_release);
+        alarmSince_ = now;
+    }
+
+    AlarmStats stats() const {
+        return {posted_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed),
+                transitions_.load(std::memory_order_relaxed)};
+    }
+    size_t pending() const { return queue_.size(); }
+
+private:
+    template <typename F>
+    void apply(const AlarmEvent& e, uint32_t now, F& fn) {
+        AlarmState from = state();
+        AlarmState to = alarmNext(from, e.input);
+        if (to != from) {
+            if (to == AlarmState::Alarm) alarmSince_ = now;
+            state_.store(to, std::memory_order_release);
+            transitions_++;
+        }
+        fn(e, from, to);
+    }
+
+    LockFreeQueue<AlarmEvent, ALARM_QUEUE_SLOTS> queue_;
+    std::atomic<AlarmState> state_{AlarmState::Disarmed};
+    uint32_t alarmSince_ = 0;
+    uint32_t timeoutMs_ = 300000;
+
+    std::atomic<uint32_t> posted_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<uint32_t> transitions_{0};
+};
@@ -0,0 +1,107 @@
+// alert_digest.h - однотипные уведомления за окно - одной сводкой
+//
+// Каждое движение и каждая чужая карта давали отдельное сообщение Telegram:
+// несколько датчиков в одной зоне за секунды выбирали лимит чата и забивали
+// очередь. Теперь первое событие вида уходит сразу и подробно (тревогу
+// автомат охраны шлет сам и тоже сразу), а следующие за ALERT_WINDOW_MS
+// только считаются по ключу - датчику или UID карты. Когда окно истекло,
+// loop() получает его в flush() и отправляет одну сводку:
+// "Движение ×14 от 3 датчиков за 20 с".
+//
+// Только для loop(): без замков и выделений памяти.
+#pragma once
+
+#include <Arduino.h>
+#include <string.h>
+
+
+// ===== Настройки =====
+#define ALERT_WINDOW_MS 20000          // Окно сводки от первого события
+#define ALERT_KEYS 8                   // Ключей в сводке поименно, остальные - одним числом
+#define ALERT_KEY_LEN 32               // ID датчика или UID карты с пробелами
+
+
+enum class AlertKind : uint8_t {
+    Motion,                            // Ключ - ID датчика
+    CardDenied,                        // Ключ - UID неизвестной или отключенной карты
+};
+#define ALERT_KINDS 2
+
+struct AlertKey {
+    char key[ALERT_KEY_LEN];
+    uint16_t count;
+};
+
+struct AlertWindow {
+    bool open;
+    uint32_t openedAt;                 // millis() первого события
+    uint32_t lastAt;
+    uint16_t total;                    // Событий за окно вместе с первым
+    uint8_t keys;                      // Занято entries
+    uint16_t otherCount;               // Событий ключей, не влезших в entries
+    AlertKey entries[ALERT_KEYS];
+};
+
+
+class AlertDigest {
+public:
+    // Событие вида kind; true - первое в окне, его отправить сразу подробно.
+    // Истекшее окно сначала нужно забрать flush(), иначе его сводка пропадет.
+    bool add(AlertKind kind, const char* key, uint32_t now) {
+        AlertWindow& w = windows_[(uint8_t)kind];
+        if (w.open && now - w.openedAt >= ALERT_WINDOW_MS) close(w);
+        bool first = !w.open;
+        if (first) {
+            memset(&w, 0, sizeof(w));
+            w.open = true;
+            w.openedAt = now;
+        } else {
+            coalesced_++;
+        }
+        w.lastAt = now;
+        w.total++;
+        count(w, key);
+        return first;
+    }
+
+    // Истекшие окна; emit(kind, window) - только если после первого были еще события
+    template <typename F>
+    void flush(uint32_t now, F emit) {
+        for (uint8_t k = 0; k < ALERT_KINDS; k++) {
+            AlertWindow& w = windows_[k];
+            if (!w.open || now - w.openedAt < ALERT_WINDOW_MS) continue;
+            if (w.total > 1) emit((AlertKind)k, (const AlertWindow&)w);
+            close(w);
+        }
+    }
+
+    uint32_t coalesced() const { return coalesced_; }    // Событий без своего сообщения
+    uint32_t digests() const { return digests_; }        // Окон со сводкой
+
+private:
+    void count(AlertWindow& w, const char* key) {
+        for (uint8_t i = 0; i < w.keys; i++) {
+            if (strncmp(w.entries[i].key, key, ALERT_KEY_LEN - 1) == 0) {
+                w.entries[i].count++;
+                return;
+            }
+        }
+        if (w.keys < ALERT_KEYS) {
+            AlertKey& e = w.entries[w.keys++];
+            strncpy(e.key, key, ALERT_KEY_LEN - 1);
+            e.key[ALERT_KEY_LEN - 1] = '\0';
+            e.count = 1;
+            return;
+        }
+        w.otherCount++;                // Таблица полна: ключ не запоминаем
+    }
+
+    void close(AlertWindow& w) {
+        if (w.total > 1) digests_++;
+        w.open = false;
+    }
+
+    AlertWindow windows_[ALERT_KINDS] = {};
+    uint32_t coalesced_ = 0;
+    uint32_t digests_ = 0;
+};
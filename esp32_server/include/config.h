@@ -7,16 +7,72 @@
 // RFID
 #define RFID_SS_PIN 5      // SDA пин
 #define RFID_RST_PIN 4     // RST пин
+#define RFID_IRQ_PIN 26    // IRQ пин: ответ карты будит задачу считывателя (rfid_reader.h)
+
+// Быстрое подключение к WiFi (точка, канал и адрес с прошлого запуска, wifi_fast.h)
+#define WIFI_CACHE_FILE "/wifi.bin"
+
+// База RFID карт
+#define RFID_CARDS_FILE "/cards.txt"   // Файл базы в LittleFS
+#define RFID_INDEX_SLOTS 4096          // Ячеек хеш-таблицы (до 3072 карт, 16 байт на ячейку)
+#define RFID_OWNER_POOL 16384          // Байт под имена владельцев
+
+// События датчиков по UDP (порт SENSOR_UDP_PORT из sensor_proto.h)
+#define UDP_PACKETS_PER_LOOP 8         // Кадров за один проход сетевой задачи
+#define BATCH_LIVE_MS 30000            // Событие из пачки моложе - обрабатывается как обычное
+
+// Журнал событий в LittleFS (event_journal.h)
+#define JOURNAL_DIR "/journal"
+#define JOURNAL_SEGMENT_BYTES 32768    // Размер файла сегмента
+#define JOURNAL_MAX_SEGMENTS 16        // До 512 КБ флеша, старые сегменты удаляются
+#define JOURNAL_FLUSH_MS 2000          // Сброс буфера журнала во флеш (тревога - сразу)
+#define LOG_QUERY_LIMIT 50             // Событий в ответе /logs 2h (несколько сообщений)
+#define LOG_HTTP_LIMIT 500             // Предел limit в GET /logs
+
+// Трасса входов для воспроизведения на ПК (input_trace.h)
+#define TRACE_ENABLED true
+#define TRACE_DIR "/trace"
+#define TRACE_SEGMENT_BYTES 16384      // Размер файла сегмента
+#define TRACE_MAX_SEGMENTS 16          // До 256 КБ флеша, старые сегменты удаляются
+#define TRACE_FLUSH_MS 5000            // Сброс буфера трассы во флеш
+
+// Проверка утечек: синтетические входы журнала, датчика и карты (mem_monitor.h, /mem)
+#define MEM_SOAK_MS 0                  // Один вход раз в столько мс, 0 - выключено
+
+// Реестр датчиков (sensor_registry.h)
+#define SENSORS_FILE "/sensors.txt"    // Известные датчики и зоны
+#define SENSOR_REGISTRY_SIZE 64
+#define SENSOR_MAX_ZONES 8
+#define SENSOR_SILENCE_MS 95000        // Три пульса датчика (HEARTBEAT_INTERVAL) и запас
+
+// Задачи: сеть (HTTP, UDP) на ядре 0, управление - loop() на ядре 1
+#define NET_TASK_CORE 0
+#define NET_TASK_STACK 8192
+#define NET_TASK_PRIORITY 1
+#define LOOP_TASK_STACK 8192           // Стек loop() в ядре Arduino (CONFIG_ARDUINO_LOOP_STACK_SIZE)
+#define NET_WAIT_MS 1                  // select() сетевой задачи: столько ждут готовые ответы /logs
+#define SENSOR_INBOX_SLOTS 128         // События датчиков: сеть -> управление
+#define SENSOR_INPUTS_PER_LOOP 32      // Событий за один проход loop()
+#define LOG_QUERY_SLOTS 4              // GET /logs, ждущих журнал, одновременно
+#define PUSH_QUEUE_SLOTS 16            // Изменения состояния для GET /stream: loop() -> сеть
 
 
 // ===== Тайминги (в миллисекундах) =====
-unsigned long alarmStartTime = 0;
 #define BLINK_INTERVAL 1000         // для мигания LED
 #define PIR_COOLDOWN 5000           // время между срабатываниями PIR
 #define ALARM_TIMEOUT 300000        // таймаут тревоги
 
+// Тексты сообщений Telegram и журнала - таблица во флеше (messages.h)
+
 
-// ===== Сообщения для Telegram =====
-const char* ALARM_MESSAGE = "🚨 ТРЕВОГА! Обнаружено движение!";
-const char* SYSTEM_ARMED_MSG = "✅ Система поставлена на охрану";
-const char* SYSTEM_DISARMED_MSG = "🔓 Система снята с охраны";
+// ===== Проверка настроек при сборке =====
+// RfidIndex::begin() отказал бы уже на плате, и база карт осталась бы пустой
+static_assert(RFID_INDEX_SLOTS >= 4 && (RFID_INDEX_SLOTS & (RFID_INDEX_SLOTS - 1)) == 0,
+              "RFID_INDEX_SLOTS - степень двойки");
+static_assert(SENSOR_INPUTS_PER_LOOP <= SENSOR_INBOX_SLOTS, "SENSOR_INPUTS_PER_LOOP больше очереди");
+static_assert(LOG_QUERY_LIMIT <= LOG_HTTP_LIMIT, "LOG_QUERY_LIMIT больше LOG_HTTP_LIMIT");
+static_assert((long long)JOURNAL_SEGMENT_BYTES * JOURNAL_MAX_SEGMENTS <= 1024 * 1024,
+              "Журнал больше 1 МБ флеша");
+static_assert((long long)TRACE_SEGMENT_BYTES * TRACE_MAX_SEGMENTS <= 512 * 1024, "Трасса больше 512 КБ флеша");
+static_assert(ALARM_TIMEOUT >= 60000 && ALARM_TIMEOUT % 60000 == 0,
+              "ALARM_TIMEOUT - целые минуты (сообщение Msg::AlarmTimeout)");
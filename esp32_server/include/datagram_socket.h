@@ -0,0 +1,74 @@
+// datagram_socket.h - UDP сокет, который можно ждать в select()
+//
+// WiFiUDP не отдает свой дескриптор, а сетевой задаче нужно просыпаться
+// и от HTTP, и от UDP кадров датчиков в одном select() (HttpFront::wakeOn).
+// Здесь только то, что нужно приему событий: неблокирующее чтение
+// датаграммы и ответ ее отправителю.
+#pragma once
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef NATIVE_BUILD
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "hal_sim.h"
+#else
+#include <lwip/sockets.h>
+#endif
+
+
+class DatagramSocket {
+public:
+    ~DatagramSocket() { stop(); }
+
+    bool begin(uint16_t port) {
+        if (fd_ >= 0) return true;
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) return false;
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+#ifdef NATIVE_BUILD
+        addr.sin_port = htons(sim::hostPort(port));
+#else
+        addr.sin_port = htons(port);
+#endif
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fd_ = fd;
+        return true;
+    }
+
+    void stop() {
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+    }
+
+    // Следующая датаграмма в buf (лишнее отбрасывается). 0 - очередь пуста.
+    int receive(uint8_t* buf, size_t size) {
+        if (fd_ < 0) return 0;
+        socklen_t len = sizeof(peer_);
+        ssize_t n;
+        do {
+            n = recvfrom(fd_, buf, size, 0, (sockaddr*)&peer_, &len);
+        } while (n < 0 && errno == EINTR);
+        return n > 0 ? (int)n : 0;
+    }
+
+    // Ответ отправителю последней принятой датаграммы
+    bool reply(const uint8_t* buf, size_t len) {
+        return fd_ >= 0 && sendto(fd_, buf, len, 0, (const sockaddr*)&peer_, sizeof(peer_)) == (ssize_t)len;
+    }
+
+    IPAddress remoteIP() const { return IPAddress((uint32_t)peer_.sin_addr.s_addr); }
+    int fd() const { return fd_; }
+
+private:
+    int fd_ = -1;
+    sockaddr_in peer_ = {};
+};
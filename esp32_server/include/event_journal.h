@@ -0,0 +1,482 @@
+// event_journal.h - журнал событий в LittleFS: только дозапись, сегменты, разреженный индекс
+//
+// Кольцо eventLog держит последние события в RAM, журнал - все события за
+// последние segmentBytes * maxSegments байт флеша и переживает перезагрузку.
+//   - записи переменной длины (заголовок 14 байт + текст) копятся в буфере
+//     и уходят во флеш одним write() при заполнении буфера или по flush();
+//   - сегмент (JOURNAL_DIR/<n>.seg) растет до segmentBytes, потом
+//     закрывается, рядом пишется его индекс (<n>.idx) и начинается новый;
+//   - когда сегментов больше maxSegments, самый старый удаляется целиком;
+//   - индекс - время и номер первой записи после каждых JOURNAL_INDEX_STRIDE
+//     байт сегмента. Запрос по времени находит сегмент и точку индекса
+//     бинарным поиском и читает лишнего не больше одного шага индекса.
+// Время записи - "время журнала": мс работы сервера, сквозные через
+// перезагрузки (после запуска отсчет продолжается с последней записи).
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <algorithm>
+#include <vector>
+#include "event_log.h"
+
+#define JOURNAL_RECORD_MAGIC 0xA7
+#define JOURNAL_HEADER_SIZE 14
+#define JOURNAL_INDEX_STRIDE 2048      // Точка индекса на каждые 2 КБ сегмента
+#define JOURNAL_BUFFER_SIZE 1024       // Буфер дозаписи
+#define JOURNAL_READ_CHUNK 1024        // Чтение сегмента кусками
+#define JOURNAL_INDEX_MAGIC 0x4A494458u
+
+
+struct JournalStats {
+    uint32_t appended;                 // Записей добавлено
+    uint32_t flushes;                  // Сбросов буфера во флеш
+    uint32_t flashBytes;               // Байт записано в сегменты
+    uint32_t segmentsDropped;          // Старых сегментов удалено
+    uint32_t corrupted;                // Оборванных записей найдено при загрузке
+    uint32_t readBytes;                // Байт прочитано запросами
+};
+
+
+class EventJournal {
+public:
+    ~EventJournal() {
+        delete[] segments_;
+        delete[] points_;
+    }
+
+    // Загрузка существующих сегментов (индексы запечатанных читаются из .idx)
+    bool begin(fs::FS& fs, const char* dir, size_t segmentBytes, size_t maxSegments) {
+        if (segments_ || maxSegments < 2 || segmentBytes < JOURNAL_INDEX_STRIDE) return false;
+        fs_ = &fs;
+        snprintf(dir_, sizeof(dir_), "%s", dir);
+        segmentBytes_ = segmentBytes;
+        maxSegments_ = maxSegments;
+        pointsPerSegment_ = segmentBytes / JOURNAL_INDEX_STRIDE + 1;
+        segments_ = new Segment[maxSegments];
+        points_ = new IndexPoint[maxSegments * pointsPerSegment_];
+        fs.mkdir(dir_);
+        load();
+        return true;
+    }
+
+    // Добавление записи; время не убывает (меньшее подтягивается к последнему)
+    bool append(uint64_t ts, EventType type, EventSource source, const char* details, bool isAlarm) {
+        if (!segments_) return false;
+        if (ts < lastTs_) ts = lastTs_;
+        char text[LOG_DETAILS_LEN];
+        copyUtf8(text, sizeof(text), details);
+        size_t len = strlen(text);
+        size_t recLen = JOURNAL_HEADER_SIZE + len;
+
+        Segment* seg = segCount_ ? &at(segCount_ - 1) : nullptr;
+        if (!seg || seg->sealed || seg->size + bufUsed_ + recLen > segmentBytes_) {
+            flush();
+            seg = startSegment();
+        }
+        if (bufUsed_ + recLen > JOURNAL_BUFFER_SIZE) flush();
+
+        uint32_t offset = seg->size + bufUsed_;
+        if (offset >= seg->points * JOURNAL_INDEX_STRIDE) {
+            segPoints(*seg)[seg->points++] = {ts, offset, seg->records};
+        }
+        uint8_t* r = buf_ + bufUsed_;
+        r[0] = JOURNAL_RECORD_MAGIC;
+        r[1] = (uint8_t)type;
+        r[2] = (uint8_t)source;
+        r[3] = isAlarm ? 1 : 0;
+        for (int i = 0; i < 8; i++) r[4 + i] = (uint8_t)(ts >> (8 * i));
+        r[12] = (uint8_t)len;
+        memcpy(r + JOURNAL_HEADER_SIZE, text, len);
+        r[13] = recordCrc(r);
+        bufUsed_ += recLen;
+
+        if (seg->records == 0) seg->firstTs = ts;
+        seg->lastTs = ts;
+        seg->records++;
+        lastTs_ = ts;
+        stats_.appended++;
+        return true;
+    }
+
+    // Буфер во флеш (одна запись в файл сегмента)
+    bool flush() {
+        if (bufUsed_ == 0) return true;
+        Segment& seg = at(segCount_ - 1);
+        if (!file_) {
+            char path[48];
+            segmentPath(seg.id, "seg", path, sizeof(path));
+            file_ = fs_->open(path, "a");
+        }
+        size_t written = file_ ? file_.write(buf_, bufUsed_) : 0;
+        if (file_) file_.flush();
+        bool ok = written == bufUsed_;
+        seg.size += written;
+        bufUsed_ = 0;
+        stats_.flushes++;
+        stats_.flashBytes += written;
+        if (!ok) seg.sealed = true;    // Флеш полон или сбой - следующая запись в новый сегмент
+        return ok;
+    }
+
+    // События с from <= время <= to по возрастанию; fn(const LogEntry&) -> false - хватит.
+    // Возвращает число переданных в fn записей
+    template <typename F>
+    size_t query(uint64_t from, uint64_t to, F fn) {
+        size_t visited = 0;
+        for (size_t i = 0; i < segCount_; i++) {
+            const Segment& seg = at(i);
+            if (seg.records == 0 || seg.lastTs < from) continue;
+            if (seg.firstTs > to) break;
+            bool stop = false;
+            readSegment(seg, seekPoint(seg, from), [&](const LogEntry& e) {
+                if (e.timestamp < from) return true;
+                if (e.timestamp > to) {
+                    stop = true;
+                    return false;
+                }
+                visited++;
+                stop = !fn(e);
+                return !stop;
+            });
+            if (stop) break;
+        }
+        return visited;
+    }
+
+    // Последние n событий по возрастанию времени (начало ищется по номерам в индексе)
+    template <typename F>
+    void recent(size_t n, F fn) {
+        if (n == 0) return;
+        size_t i = segCount_;
+        size_t skip = 0;
+        const IndexPoint* start = nullptr;
+        while (i > 0 && !start) {
+            const Segment& seg = at(--i);
+            if (seg.records < n) {
+                n -= seg.records;
+                continue;
+            }
+            uint32_t first = seg.records - n;
+            const IndexPoint* pts = segPoints(seg);
+            start = std::upper_bound(pts, pts + seg.points, first,
+                                     [](uint32_t v, const IndexPoint& p) { return v < p.record; }) - 1;
+            skip = first - start->record;
+        }
+        for (; i < segCount_; i++) {
+            readSegment(at(i), start ? start->offset : 0, [&](const LogEntry& e) {
+                if (skip > 0) {
+                    skip--;
+                    return true;
+                }
+                fn(e);
+                return true;
+            });
+            start = nullptr;
+        }
+    }
+
+    // Удаление всех сегментов (время журнала продолжает идти)
+    void clear() {
+        if (segCount_) nextId_ = at(segCount_ - 1).id + 1;
+        bufUsed_ = 0;
+        file_.close();
+        for (size_t i = 0; i < segCount_; i++) removeSegment(at(i).id);
+        segFirst_ = 0;
+        segCount_ = 0;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (size_t i = 0; i < segCount_; i++) n += at(i).records;
+        return n;
+    }
+    size_t bytes() const {
+        size_t n = bufUsed_;
+        for (size_t i = 0; i < segCount_; i++) n += at(i).size;
+        return n;
+    }
+    size_t segments() const { return segCount_; }
+    size_t pending() const { return bufUsed_; }          // Байт еще не во флеше
+    uint64_t lastTimestamp() const { return lastTs_; }
+    uint64_t firstTimestamp() const { return segCount_ ? at(0).firstTs : 0; }
+    size_t memoryBytes() const {
+        return maxSegments_ * (sizeof(Segment) + pointsPerSegment_ * sizeof(IndexPoint)) + sizeof(buf_);
+    }
+    const JournalStats& stats() const { return stats_; }
+
+private:
+    struct IndexPoint {
+        uint64_t ts;                   // Время записи, с которой начинается шаг
+        uint32_t offset;               // Ее смещение в сегменте
+        uint32_t record;               // Ее номер в сегменте
+    };
+
+    struct Segment {
+        uint32_t id;
+        uint32_t size;                 // Байт во флеше (без буфера)
+        uint32_t records;
+        uint32_t points;
+        uint64_t firstTs;
+        uint64_t lastTs;
+        bool sealed;                   // Дозапись закончена, индекс в .idx
+    };
+
+    // Заголовок файла .idx, за ним points записей IndexPoint
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t records;
+        uint32_t points;
+        uint64_t firstTs;
+        uint64_t lastTs;
+    };
+
+    Segment& at(size_t i) { return segments_[(segFirst_ + i) % maxSegments_]; }
+    const Segment& at(size_t i) const { return segments_[(segFirst_ + i) % maxSegments_]; }
+    IndexPoint* segPoints(const Segment& seg) const { return points_ + (&seg - segments_) * pointsPerSegment_; }
+
+    void segmentPath(uint32_t id, const char* ext, char* buf, size_t size) const {
+        snprintf(buf, size, "%s/%08lx.%s", dir_, (unsigned long)id, ext);
+    }
+
+    // [0] magic [1] тип [2] источник [3] тревога [4..11] время [12] длина [13] crc8 [14..] текст
+    static uint8_t recordCrc(const uint8_t* r) {
+        uint8_t crc = 0;
+        size_t n = JOURNAL_HEADER_SIZE + r[12];
+        for (size_t i = 0; i < n; i++) {
+            if (i == 13) continue;
+            crc ^= r[i];
+            for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    static bool decodeRecord(const uint8_t* r, LogEntry& e) {
+        if (r[0] != JOURNAL_RECORD_MAGIC || r[12] >= LOG_DETAILS_LEN || r[13] != recordCrc(r)) return false;
+        e.type = (EventType)r[1];
+        e.source = (EventSource)r[2];
+        e.isAlarm = r[3] & 1;
+        e.timestamp = 0;
+        for (int i = 0; i < 8; i++) e.timestamp |= (uint64_t)r[4 + i] << (8 * i);
+        memcpy(e.details, r + JOURNAL_HEADER_SIZE, r[12]);
+        e.details[r[12]] = '\0';
+        return true;
+    }
+
+    // Разбор записей в памяти; возвращает разобранные байты, bad - встретилась битая запись
+    template <typename F>
+    static size_t parseRecords(const uint8_t* p, size_t n, F& fn, bool& stop, bool& bad) {
+        size_t pos = 0;
+        LogEntry e;
+        while (!stop && pos + JOURNAL_HEADER_SIZE <= n) {
+            size_t recLen = JOURNAL_HEADER_SIZE + p[pos + 12];
+            if (pos + recLen > n) break;
+            if (!decodeRecord(p + pos, e)) {
+                bad = true;
+                break;
+            }
+            pos += recLen;
+            stop = !fn(pos, e);
+        }
+        return pos;
+    }
+
+    // Записи сегмента с offset до конца (включая еще не сброшенный буфер);
+    // fn(const LogEntry&) -> false - остановиться
+    template <typename F>
+    void readSegment(const Segment& seg, uint32_t offset, F fn) {
+        bool stop = false;
+        bool bad = false;
+        auto step = [&](size_t, const LogEntry& e) { return fn(e); };
+        if (offset < seg.size) {
+            scanFile(seg.id, offset, seg.size, step, stop, bad);
+        }
+        if (!stop && !seg.sealed && &seg == &at(segCount_ - 1)) {
+            parseRecords(buf_, bufUsed_, step, stop, bad);
+        }
+    }
+
+    // Файл сегмента с offset до end кусками по JOURNAL_READ_CHUNK;
+    // fn(size_t конец_записи, const LogEntry&). Возвращает конец последней целой записи
+    template <typename F>
+    size_t scanFile(uint32_t id, size_t offset, size_t end, F& fn, bool& stop, bool& bad) {
+        char path[48];
+        segmentPath(id, "seg", path, sizeof(path));
+        fs::File f = fs_->open(path, "r");
+        if (!f || !f.seek(offset)) return offset;
+        uint8_t chunk[JOURNAL_READ_CHUNK];
+        size_t have = 0;
+        size_t base = offset;          // Смещение chunk[0] в сегменте
+        while (!stop && !bad && base + have < end) {
+            size_t want = std::min(sizeof(chunk) - have, end - base - have);
+            size_t n = f.read(chunk + have, want);
+            stats_.readBytes += n;
+            if (n == 0) break;
+            have += n;
+            auto local = [&](size_t pos, const LogEntry& e) { return fn(base + pos, e); };
+            size_t used = parseRecords(chunk, have, local, stop, bad);
+            if (used == 0 && have == sizeof(chunk)) bad = true;
+            memmove(chunk, chunk + used, have - used);
+            have -= used;
+            base += used;
+        }
+        f.close();
+        return base;
+    }
+
+    // Смещение последней точки индекса со временем < from (записи до нее точно раньше)
+    uint32_t seekPoint(const Segment& seg, uint64_t from) const {
+        const IndexPoint* pts = segPoints(seg);
+        const IndexPoint* p = std::lower_bound(pts, pts + seg.points, from,
+                                               [](const IndexPoint& pt, uint64_t v) { return pt.ts < v; });
+        return p == pts ? 0 : (p - 1)->offset;
+    }
+
+    Segment* startSegment() {
+        if (segCount_) sealSegment(at(segCount_ - 1));
+        if (segCount_ == maxSegments_) dropOldest();
+        uint32_t id = segCount_ ? at(segCount_ - 1).id + 1 : nextId_;
+        segCount_++;
+        Segment& seg = at(segCount_ - 1);
+        seg = {id, 0, 0, 0, 0, 0, false};
+        return &seg;
+    }
+
+    void sealSegment(Segment& seg) {
+        file_.close();
+        if (seg.records == 0) return;
+        seg.sealed = true;
+        char path[48];
+        segmentPath(seg.id, "idx", path, sizeof(path));
+        fs::File f = fs_->open(path, "w");
+        if (!f) return;
+        IndexHeader h = {JOURNAL_INDEX_MAGIC, seg.size, seg.records, seg.points, seg.firstTs, seg.lastTs};
+        f.write((const uint8_t*)&h, sizeof(h));
+        f.write((const uint8_t*)segPoints(seg), seg.points * sizeof(IndexPoint));
+        f.close();
+    }
+
+    void removeSegment(uint32_t id) {
+        char path[48];
+        segmentPath(id, "seg", path, sizeof(path));
+        fs_->remove(path);
+        segmentPath(id, "idx", path, sizeof(path));
+        fs_->remove(path);
+    }
+
+    void dropOldest() {
+        removeSegment(at(0).id);
+        segFirst_ = (segFirst_ + 1) % maxSegments_;
+        segCount_--;
+        stats_.segmentsDropped++;
+    }
+
+    bool readIndex(Segment& seg, size_t fileSize) {
+        char path[48];
+        segmentPath(seg.id, "idx", path, sizeof(path));
+        fs::File f = fs_->open(path, "r");
+        if (!f) return false;
+        IndexHeader h;
+        bool ok = f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == JOURNAL_INDEX_MAGIC &&
+                  h.size <= fileSize && h.points <= pointsPerSegment_ &&
+                  f.read((uint8_t*)segPoints(seg), h.points * sizeof(IndexPoint)) == h.points * sizeof(IndexPoint);
+        f.close();
+        if (!ok) return false;
+        seg.size = h.size;
+        seg.records = h.records;
+        seg.points = h.points;
+        seg.firstTs = h.firstTs;
+        seg.lastTs = h.lastTs;
+        seg.sealed = true;
+        return true;
+    }
+
+    // Индекс заново по содержимому; false - в конце оборванная запись
+    bool rebuildIndex(Segment& seg, size_t fileSize) {
+        IndexPoint* pts = segPoints(seg);
+        bool stop = false;
+        bool bad = false;
+        size_t offset = 0;
+        auto add = [&](size_t end, const LogEntry& e) {
+            if (offset >= seg.points * JOURNAL_INDEX_STRIDE && seg.points < pointsPerSegment_) {
+                pts[seg.points++] = {e.timestamp, (uint32_t)offset, seg.records};
+            }
+            if (seg.records == 0) seg.firstTs = e.timestamp;
+            seg.lastTs = e.timestamp;
+            seg.records++;
+            offset = end;
+            return true;
+        };
+        uint32_t readBefore = stats_.readBytes;
+        seg.size = scanFile(seg.id, 0, fileSize, add, stop, bad);
+        stats_.readBytes = readBefore;  // Загрузка - не запрос
+        return seg.size == fileSize;
+    }
+
+    void load() {
+        std::vector<uint32_t> ids;
+        fs::File dir = fs_->open(dir_, "r");
+        for (fs::File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+            unsigned long id;
+            if (strstr(f.name(), ".seg") && sscanf(f.name(), "%8lx", &id) == 1) ids.push_back((uint32_t)id);
+            f.close();
+        }
+        dir.close();
+        std::sort(ids.begin(), ids.end());
+
+        for (size_t k = 0; k < ids.size(); k++) {
+            char path[48];
+            segmentPath(ids[k], "seg", path, sizeof(path));
+            nextId_ = ids[k] + 1;
+            if (ids.size() - k > maxSegments_) {   // Лимит уменьшили - лишние старые сегменты удаляем
+                removeSegment(ids[k]);
+                continue;
+            }
+            fs::File f = fs_->open(path, "r");
+            size_t fileSize = f ? f.size() : 0;
+            f.close();
+
+            segCount_++;
+            Segment& seg = at(segCount_ - 1);
+            seg = {ids[k], 0, 0, 0, 0, 0, false};
+            bool last = k + 1 == ids.size();
+            if (!last && readIndex(seg, fileSize)) continue;
+            if (!rebuildIndex(seg, fileSize)) {
+                stats_.corrupted++;    // Запись оборвана сбоем питания: дальше пишем в новый сегмент
+                seg.sealed = true;
+            }
+            if (!last) sealSegment(seg);
+            if (seg.records == 0) {
+                removeSegment(seg.id);
+                segCount_--;
+            }
+        }
+        if (segCount_) {
+            lastTs_ = at(segCount_ - 1).lastTs;
+            Segment& tail = at(segCount_ - 1);
+            if (tail.sealed) sealSegment(tail);
+        }
+    }
+
+    fs::FS* fs_ = nullptr;
+    char dir_[24];
+    size_t segmentBytes_ = 0;
+    size_t maxSegments_ = 0;
+    size_t pointsPerSegment_ = 0;
+
+    // Кольцо сегментов (старые удаляются с начала)
+    Segment* segments_ = nullptr;
+    IndexPoint* points_ = nullptr;     // pointsPerSegment_ точек на ячейку кольца
+    size_t segFirst_ = 0;
+    size_t segCount_ = 0;
+    uint32_t nextId_ = 1;
+    uint64_t lastTs_ = 0;
+
+    // Дозапись в последний сегмент
+    fs::File file_;
+    uint8_t buf_[JOURNAL_BUFFER_SIZE];
+    size_t bufUsed_ = 0;
+
+    JournalStats stats_ = {};
+};
@@ -0,0 +1,203 @@
+// event_log.h - кольцевой буфер событий фиксированного размера
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// ===== Тип и источник события =====
+enum class EventType : uint8_t {
+    Motion,
+    Arm,
+    Disarm,
+    Alarm,
+    Rfid,
+    Telegram,
+    System,
+    Error,
+    Other,
+    Tamper,     // Датчик замолчал или вскрыт (в конце - номера в журнале не меняются)
+    Denied      // Неизвестная или отключенная карта
+};
+
+constexpr size_t EVENT_TYPE_COUNT = (size_t)EventType::Denied + 1;
+
+enum class EventSource : uint8_t {
+    Sensor,     // Датчик (id датчика пишется в details)
+    Telegram,
+    Rfid,
+    System,
+    User
+};
+
+
+// ===== Запись лога (POD, без динамической памяти) =====
+#define LOG_DETAILS_LEN 96
+
+struct LogEntry {
+    uint64_t timestamp;             // Время в миллисекундах (64 бита - не переполняется)
+    EventType type;
+    EventSource source;
+    bool isAlarm;                   // Было ли это тревогой
+    char details[LOG_DETAILS_LEN];  // Детали, всегда оканчиваются '\0'
+};
+
+
+// Перевод строкового типа из HTTP запроса в enum
+inline EventType eventTypeFromString(const char* s) {
+    if (strcmp(s, "motion") == 0) return EventType::Motion;
+    if (strcmp(s, "arm") == 0) return EventType::Arm;
+    if (strcmp(s, "disarm") == 0) return EventType::Disarm;
+    if (strcmp(s, "alarm") == 0) return EventType::Alarm;
+    if (strcmp(s, "rfid") == 0) return EventType::Rfid;
+    if (strcmp(s, "telegram") == 0) return EventType::Telegram;
+    if (strcmp(s, "system") == 0) return EventType::System;
+    if (strcmp(s, "error") == 0) return EventType::Error;
+    if (strcmp(s, "tamper") == 0) return EventType::Tamper;
+    if (strcmp(s, "denied") == 0) return EventType::Denied;
+    return EventType::Other;
+}
+
+inline const char* eventTypeName(EventType t) {
+    switch (t) {
+        case EventType::Motion:   return "motion";
+        case EventType::Arm:      return "arm";
+        case EventType::Disarm:   return "disarm";
+        case EventType::Alarm:    return "alarm";
+        case EventType::Rfid:     return "rfid";
+        case EventType::Telegram: return "telegram";
+        case EventType::System:   return "system";
+        case EventType::Error:    return "error";
+        case EventType::Tamper:   return "tamper";
+        case EventType::Denied:   return "denied";
+        default:                  return "other";
+    }
+}
+
+// Значок события в сообщениях Telegram (индекс - EventType)
+constexpr const char* EVENT_ICONS[] = {
+    "👋",   // Motion
+    "🔒",   // Arm
+    "🔓",   // Disarm
+    "🚨",   // Alarm
+    "📇",   // Rfid
+    "📌",   // Telegram
+    "📌",   // System
+    "⚠️",   // Error
+    "📌",   // Other
+    "📵",   // Tamper
+    "⛔",   // Denied
+};
+static_assert(sizeof(EVENT_ICONS) / sizeof(EVENT_ICONS[0]) == EVENT_TYPE_COUNT, "EVENT_ICONS must cover EventType");
+
+inline const char* eventIcon(EventType t) {
+    return (size_t)t < EVENT_TYPE_COUNT ? EVENT_ICONS[(size_t)t] : EVENT_ICONS[(size_t)EventType::Other];
+}
+
+inline const char* eventSourceName(EventSource s) {
+    switch (s) {
+        case EventSource::Sensor:   return "sensor";
+        case EventSource::Telegram: return "telegram";
+        case EventSource::Rfid:     return "rfid";
+        case EventSource::System:   return "system";
+        default:                    return "user";
+    }
+}
+
+
+// Копирование строки с обрезкой по границе символа UTF-8
+// (чтобы не отправить в Telegram половину кириллической буквы)
+inline void copyUtf8(char* dst, size_t dstSize, const char* src) {
+    size_t n = strlen(src);
+    if (n >= dstSize) {
+        n = dstSize - 1;
+        // Отступаем назад, пока стоим на байте-продолжении 10xxxxxx
+        while (n > 0 && (static_cast<uint8_t>(src[n]) & 0xC0) == 0x80) n--;
+    }
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+// Строка длиной len, обрезанная snprintf посреди символа UTF-8: неполный
+// последний символ отбрасывается. Возвращает новую длину.
+inline size_t trimUtf8(char* s, size_t len) {
+    size_t i = len;
+    while (i > 0 && len - i < 3 && (static_cast<uint8_t>(s[i - 1]) & 0xC0) == 0x80) i--;
+    if (i == 0) return len;
+    uint8_t lead = static_cast<uint8_t>(s[i - 1]);
+    size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    if (len - (i - 1) >= need) return len;
+    s[i - 1] = '\0';
+    return i - 1;
+}
+
+// vsnprintf с обрезкой по границе символа UTF-8; возвращает длину результата
+inline size_t vformatUtf8(char* dst, size_t size, const char* fmt, va_list args) {
+    int n = vsnprintf(dst, size, fmt, args);
+    if (n < 0) {
+        dst[0] = '\0';
+        return 0;
+    }
+    return (size_t)n < size ? (size_t)n : trimUtf8(dst, size - 1);
+}
+
+// snprintf с обрезкой по границе символа UTF-8 - для деталей журнала и
+// сообщений с именами, которые могут не влезть в буфер
+__attribute__((format(printf, 3, 4)))
+inline size_t formatUtf8(char* dst, size_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t n = vformatUtf8(dst, size, fmt, args);
+    va_end(args);
+    return n;
+}
+
+
+// ===== Кольцевой буфер =====
+// Добавление O(1) без сдвига и без выделения памяти.
+// Индекс 0 при чтении - самое новое событие.
+template <size_t N>
+class EventRing {
+public:
+    static_assert(N > 0, "EventRing capacity must be positive");
+
+    // Добавляет запись (самая старая перезаписывается при переполнении)
+    LogEntry& append() {
+        head_ = (head_ + 1 == N) ? 0 : head_ + 1;
+        if (count_ < N) count_++;
+        return entries_[head_];
+    }
+
+    void push(uint64_t timestamp, EventType type, EventSource source,
+              const char* details, bool isAlarm) {
+        LogEntry& e = append();
+        e.timestamp = timestamp;
+        e.type = type;
+        e.source = source;
+        e.isAlarm = isAlarm;
+        copyUtf8(e.details, sizeof(e.details), details);
+    }
+
+    // i = 0 - самая новая запись, i = size() - 1 - самая старая
+    const LogEntry& newest(size_t i) const {
+        size_t idx = (i <= head_) ? head_ - i : head_ + N - i;
+        return entries_[idx];
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    static constexpr size_t capacity() { return N; }
+
+    void clear() {
+        count_ = 0;
+        head_ = N - 1;
+    }
+
+private:
+    LogEntry entries_[N];
+    size_t head_ = N - 1;   // Позиция последней записанной ячейки
+    size_t count_ = 0;
+};
@@ -0,0 +1,841 @@
+// http_front.h - неблокирующий HTTP сервер на много соединений
+//
+// Замена синхронного WebServer: handleClient() одним select() проверяет
+// все соединения и обслуживает те, где есть данные. Медленный клиент
+// не задерживает остальных - его недочитанный запрос просто ждет в буфере.
+// Соединения держатся открытыми (keep-alive), буферы выделены заранее:
+// HTTP_MAX_CONNECTIONS ячеек с приемным буфером на запрос целиком.
+// Обработчики пишутся как для WebServer: on(), arg(), hasArg(), send().
+//
+// Keep-alive - не больше HTTP_MAX_CONNECTIONS (12) соединений. Если за
+// последние HTTP_SCARCE_MS новые соединения ждали в очереди listen() при всех
+// занятых ячейках, ответы уходят с Connection: close: ячейка освобождается
+// сразу после ответа, а не держится, пока клиент готовит следующий запрос, и
+// ни один запрос не теряется. Вытесняется только соединение, которое уже получило ответ и
+// молчит дольше HTTP_EVICT_IDLE_MS; только что принятое, еще без запроса,
+// не закрывается никогда.
+//
+// Ответ можно отложить: обработчик берет defer() и возвращается, ответ
+// готовит другая задача, а задача сервера отдает его complete(). Остальные
+// соединения тем временем обслуживаются как обычно.
+//
+// Соединение можно сделать потоком событий (Server-Sent Events): обработчик
+// зовет stream(), и дальше publish() рассылает событие всем подписчикам.
+// Подписчиков не больше HTTP_MAX_STREAMS. Клиент, который не успевает
+// читать, не задерживает ни задачу, ни остальных: пока его сокет занят,
+// для него хранится только последнее событие, более старые отбрасываются.
+#pragma once
+
+#include <Arduino.h>
+#include <WebServer.h>                 // HTTPMethod
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <strings.h>
+#ifdef NATIVE_BUILD
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <mutex>
+#include "hal_sim.h"
+#else
+#include <lwip/sockets.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define HTTP_MAX_CONNECTIONS 12        // lwIP дает 16 сокетов на все (UDP, Telegram, DNS)
+#define HTTP_LISTEN_BACKLOG 32        // Ждут свободной ячейки, а не повтора SYN через секунду
+#define HTTP_RX_BUFFER 3072            // Запрос целиком (пачка /events - около 2.3 КБ)
+#define HTTP_TX_BUFFER 512             // Заголовки и короткий ответ, длинное тело - из String
+#define HTTP_MAX_ARGS 16
+#define HTTP_MAX_HEADERS 12
+#define HTTP_MAX_EXTRA_HEADERS 4       // sendHeader() на один ответ
+#define HTTP_IDLE_TIMEOUT_MS 15000     // Молчащее соединение закрывается
+#define HTTP_EVICT_IDLE_MS 1000        // Молчащее дольше уступает ячейку новому соединению
+#define HTTP_SCARCE_MS 1000            // Столько после очереди за ячейкой ответы - с Connection: close
+#define HTTP_DEFER_TIMEOUT_MS 5000     // Отложенный ответ не пришел - 503
+#define HTTP_MAX_STREAMS 4             // Подписчиков потока событий одновременно
+#define HTTP_STREAM_EVENT 320          // Одно событие SSE целиком (с "event:" и "data:")
+#define HTTP_STREAM_PING_MS 10000      // Комментарий в тихий поток: соединение живо
+#define HTTP_NATIVE_STREAM_SNDBUF 5744 // ПК: буфер отправки подписчика, как TCP_SND_BUF lwIP
+
+static_assert(HTTP_STREAM_EVENT <= HTTP_TX_BUFFER, "Событие SSE уходит из буфера tx соединения");
+
+
+struct HttpFrontStats {
+    uint32_t accepted;                 // Принято соединений
+    uint32_t requests;                 // Обработано запросов
+    uint32_t evicted;                  // Закрыто ради нового соединения
+    uint32_t closedForSlots;           // Ответов с Connection: close, пока ждали новые соединения
+    uint32_t timedOut;                 // Закрыто по HTTP_IDLE_TIMEOUT_MS
+    uint32_t rejected;                 // Ответ 400/413
+    uint32_t deferred;                 // Отложенных ответов
+    uint32_t deferTimeouts;            // Отложенный ответ не дождались
+    uint32_t maxActive;                // Наибольшее число одновременных соединений
+    uint32_t streamsOpened;            // Подписок на поток событий
+    uint32_t streamsRejected;          // Подписка отклонена: занято HTTP_MAX_STREAMS
+    uint32_t streamEvents;             // Событий, ушедших подписчикам
+    uint32_t streamDropped;            // Событий, замененных более свежими (клиент не успевал)
+};
+
+
+class HttpFront {
+public:
+    typedef std::function<void()> THandlerFunction;
+
+    // Адрес клиента (как WiFiClient у WebServer)
+    struct Peer {
+        IPAddress ip;
+        IPAddress remoteIP() const { return ip; }
+    };
+
+    explicit HttpFront(uint16_t port = 80) : port_(port) {
+#ifdef NATIVE_BUILD
+        sim::registerHttpHandler(port, [this](const sim::HttpRequest& req) { return dispatch(req); });
+#endif
+    }
+    ~HttpFront() { stop(); }
+
+    void begin() {
+        if (listenFd_ >= 0) return;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+#ifdef NATIVE_BUILD
+        addr.sin_port = htons(sim::hostPort(port_));
+#else
+        addr.sin_port = htons(port_);
+#endif
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, HTTP_LISTEN_BACKLOG) != 0) {
+            close(fd);
+            return;
+        }
+        setNonBlocking(fd);
+        listenFd_ = fd;
+    }
+
+    void stop() {
+        for (Connection& c : conns_) {
+            if (c.fd >= 0) closeConnection(c);
+        }
+        if (listenFd_ >= 0) close(listenFd_);
+        listenFd_ = -1;
+    }
+
+    // Чужой сокет, данные в котором тоже прерывают ожидание в handleClient()
+    // (UDP датчиков в той же задаче). -1 - не нужен.
+    void wakeOn(int fd) { wakeFd_ = fd; }
+
+    // Обслуживание всех соединений; waitMs - сколько ждать активности в select()
+    void handleClient(uint32_t waitMs = 0) {
+        if (listenFd_ < 0) return;
+#ifdef NATIVE_BUILD
+        sim::HttpRequest queued;     // Запрос из sim::queueHttpRequest() - без сокета
+        if (sim::popQueuedHttpRequest(port_, queued)) dispatch(queued);
+#endif
+        fd_set readFds, writeFds;
+        FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
+        FD_SET(listenFd_, &readFds);
+        int maxFd = listenFd_;
+        if (wakeFd_ >= 0) {
+            FD_SET(wakeFd_, &readFds);
+            if (wakeFd_ > maxFd) maxFd = wakeFd_;
+        }
+        for (Connection& c : conns_) {
+            if (c.fd < 0) continue;
+            if (pendingTx(c)) FD_SET(c.fd, &writeFds);
+            else FD_SET(c.fd, &readFds);
+            if (c.fd > maxFd) maxFd = c.fd;
+        }
+        timeval tv;
+        tv.tv_sec = waitMs / 1000;
+        tv.tv_usec = (waitMs % 1000) * 1000;
+        int ready = select(maxFd + 1, &readFds, &writeFds, nullptr, &tv);
+#ifdef NATIVE_BUILD
+        std::lock_guard<std::mutex> guard(simLock_);
+#endif
+        uint32_t now = millis();
+        // Новые соединения ждут, а ячеек нет: ответы - с Connection: close
+        if (ready > 0 && FD_ISSET(listenFd_, &readFds) && active() == HTTP_MAX_CONNECTIONS) {
+            backlogSeen_ = true;
+            backlogAt_ = now;
+        }
+
+        if (ready > 0) {
+            for (Connection& c : conns_) {
+                if (c.fd < 0) continue;
+                if (FD_ISSET(c.fd, &writeFds)) {
+                    c.lastActiveMs = now;
+                    sendPending(c);
+                    if (c.fd >= 0 && !pendingTx(c)) serveBuffered(c);
+                } else if (FD_ISSET(c.fd, &readFds)) {
+                    c.lastActiveMs = now;
+                    receive(c);
+                }
+            }
+            if (FD_ISSET(listenFd_, &readFds)) acceptConnections(now);
+        }
+
+        for (Connection& c : conns_) {
+            if (c.fd >= 0 && c.ticket && now - c.deferredAt > HTTP_DEFER_TIMEOUT_MS) {
+                stats_.deferTimeouts++;
+                finishDeferred(c, 503, "text/plain", "Timeout");
+            } else if (c.fd >= 0 && c.stream >= 0) {
+                // Поток: тишину прерывает комментарий, а клиент, который не читает, закрывается
+                if (!pendingTx(c) && now - c.lastActiveMs > HTTP_STREAM_PING_MS) {
+                    c.txLen = snprintf(c.tx, sizeof(c.tx), ": ping\n\n");
+                    c.txPos = 0;
+                    c.lastActiveMs = now;
+                    sendPending(c);
+                } else if (pendingTx(c) && now - c.lastActiveMs > HTTP_IDLE_TIMEOUT_MS) {
+                    closeConnection(c);
+                    stats_.timedOut++;
+                }
+            } else if (c.fd >= 0 && !c.ticket && now - c.lastActiveMs > HTTP_IDLE_TIMEOUT_MS) {
+                closeConnection(c);
+                stats_.timedOut++;
+            }
+        }
+    }
+
+    void on(const String& uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction fn) { routes_.push_back({uri, method, fn}); }
+    void onNotFound(THandlerFunction fn) { notFound_ = fn; }
+
+    // ===== Данные текущего запроса =====
+    String arg(const String& name) const {
+        const char* v = findArg(name.c_str());
+        return v ? String(v) : String();
+    }
+    String arg(int i) const { return i >= 0 && i < req_.argCount ? String(req_.argValues[i]) : String(); }
+    String argName(int i) const { return i >= 0 && i < req_.argCount ? String(req_.argNames[i]) : String(); }
+    int args() const { return req_.argCount; }
+    bool hasArg(const String& name) const { return findArg(name.c_str()) != nullptr; }
+    String header(const String& name) const {
+        for (int i = 0; i < req_.headerCount; i++) {
+            if (strcasecmp(req_.headerNames[i], name.c_str()) == 0) return String(req_.headerValues[i]);
+        }
+        return String();
+    }
+    bool hasHeader(const String& name) const {
+        for (int i = 0; i < req_.headerCount; i++) {
+            if (strcasecmp(req_.headerNames[i], name.c_str()) == 0) return true;
+        }
+        return false;
+    }
+    HTTPMethod method() const { return req_.method; }
+    String uri() const { return String(req_.uri); }
+    Peer client() const { return {req_.remote}; }
+
+    // ===== Ответ =====
+    void sendHeader(const String& name, const String& value, bool first = false) {
+        if (extraCount_ == HTTP_MAX_EXTRA_HEADERS) return;
+        if (first) {
+            for (int i = extraCount_; i > 0; i--) extra_[i] = extra_[i - 1];
+            extra_[0] = {name, value};
+        } else {
+            extra_[extraCount_] = {name, value};
+        }
+        extraCount_++;
+    }
+
+    void send(int code, const char* contentType = nullptr, const String& content = String()) {
+        code_ = code;
+        contentType_ = contentType ? contentType : "";
+        body_ = content;
+    }
+    void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+
+    // Из обработчика: ответ придет позже. 0 - отложить нельзя (запрос без
+    // соединения), тогда обработчик отвечает сразу.
+    uint32_t defer() {
+        if (!current_) return 0;
+        uint32_t ticket = (++deferSeq_ << 8) | (uint32_t)(current_ - conns_);
+        current_->ticket = ticket;
+        current_->deferredAt = millis();
+        deferred_ = true;
+        stats_.deferred++;
+        return ticket;
+    }
+
+    // Отложенный ответ; вызывать в задаче сервера. false - соединение уже
+    // закрыто или ответ отдан по таймауту.
+    bool complete(uint32_t ticket, int code, const char* contentType, const String& content) {
+#ifdef NATIVE_BUILD
+        std::lock_guard<std::mutex> guard(simLock_);
+#endif
+        uint32_t slot = ticket & 0xFF;
+        if (slot >= HTTP_MAX_CONNECTIONS || !ticket) return false;
+        Connection& c = conns_[slot];
+        if (c.fd < 0 || c.ticket != ticket) return false;
+        finishDeferred(c, code, contentType, content);
+        return true;
+    }
+
+    // Из обработчика: соединение становится потоком событий, ответ - заголовки
+    // text/event-stream и first (готовое событие или nullptr). false -
+    // подписчиков уже HTTP_MAX_STREAMS или запрос без соединения.
+    bool stream(const char* first = nullptr) {
+        if (!current_) return false;
+        int8_t slot = -1;
+        for (int8_t i = 0; i < HTTP_MAX_STREAMS; i++) {
+            if (!streams_[i].used) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            stats_.streamsRejected++;
+            return false;
+        }
+        streams_[slot].used = true;
+        streams_[slot].nextLen = 0;
+        Connection& c = *current_;
+        c.stream = slot;
+        c.closeAfterSend = false;
+#ifdef NATIVE_BUILD
+        // Буфер отправки как у lwIP (TCP_SND_BUF): иначе ядро ПК примет мегабайты
+        // событий за клиента, который не читает, и отбрасывать будет нечего
+        int sndbuf = HTTP_NATIVE_STREAM_SNDBUF;
+        setsockopt(c.fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+#endif
+        int n = snprintf(c.tx, sizeof(c.tx),
+                         "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n\r\n%s", first ? first : "");
+        c.txLen = n < (int)sizeof(c.tx) ? n : sizeof(c.tx) - 1;
+        c.txPos = 0;
+        c.bodyPos = 0;
+        streamed_ = true;
+        streamCount_++;
+        stats_.streamsOpened++;
+        return true;
+    }
+
+    // Событие всем подписчикам; вызывать в задаче сервера. Подписчик, чей
+    // сокет еще занят прошлым событием, получит это, когда освободится.
+    void publish(const char* event, const char* data) {
+#ifdef NATIVE_BUILD
+        std::lock_guard<std::mutex> guard(simLock_);
+#endif
+        if (streamCount_ == 0) return;
+        char text[HTTP_STREAM_EVENT];
+        int n = snprintf(text, sizeof(text), "id: %lu\nevent: %s\ndata: %s\n\n", (unsigned long)++eventSeq_, event,
+                         data);
+        if (n <= 0 || n >= (int)sizeof(text)) return;   // Не влезло - обрезанное событие клиент не разберет
+        uint32_t now = millis();
+        for (Connection& c : conns_) {
+            if (c.fd < 0 || c.stream < 0) continue;
+            StreamSlot& slot = streams_[c.stream];
+            if (pendingTx(c)) {
+                if (slot.nextLen) stats_.streamDropped++;
+                memcpy(slot.next, text, n);
+                slot.nextLen = n;
+                continue;
+            }
+            memcpy(c.tx, text, n);
+            c.txLen = n;
+            c.txPos = 0;
+            c.lastActiveMs = now;
+            stats_.streamEvents++;
+            sendPending(c);
+        }
+    }
+
+    // Подписчиков сейчас (из любой задачи)
+    uint8_t streams() const { return streamCount_.load(std::memory_order_relaxed); }
+
+    size_t active() const {
+        size_t n = 0;
+        for (const Connection& c : conns_) n += c.fd >= 0;
+        return n;
+    }
+    const HttpFrontStats& stats() const { return stats_; }
+    static constexpr size_t memoryBytes() { return sizeof(Connection) * HTTP_MAX_CONNECTIONS; }
+
+#ifdef NATIVE_BUILD
+    // Запрос без сокета (бенчмарки: sim::httpRequest)
+    sim::HttpResponse dispatch(const sim::HttpRequest& r) {
+        std::lock_guard<std::mutex> guard(simLock_);
+        req_ = {};
+        req_.method = r.method;
+        req_.uri = r.uri.c_str();
+        req_.remote = r.remote;
+        for (const auto& kv : r.args) {
+            if (req_.argCount == HTTP_MAX_ARGS) break;
+            req_.argNames[req_.argCount] = kv.first.c_str();
+            req_.argValues[req_.argCount++] = kv.second.c_str();
+        }
+        for (const auto& kv : r.headers) {
+            if (req_.headerCount == HTTP_MAX_HEADERS) break;
+            req_.headerNames[req_.headerCount] = kv.first.c_str();
+            req_.headerValues[req_.headerCount++] = kv.second.c_str();
+        }
+        route();
+        sim::HttpResponse resp;
+        resp.code = code_;
+        resp.contentType = contentType_;
+        resp.body = body_;
+        for (int i = 0; i < extraCount_; i++) resp.headers.push_back({extra_[i].name, extra_[i].value});
+        body_ = String();
+        return resp;
+    }
+#endif
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction fn;
+    };
+
+    struct Header {
+        String name;
+        String value;
+    };
+
+    // Разобранный запрос: указатели в приемный буфер соединения
+    struct Request {
+        HTTPMethod method;
+        const char* uri;
+        IPAddress remote;
+        uint8_t argCount;
+        uint8_t headerCount;
+        const char* argNames[HTTP_MAX_ARGS];
+        const char* argValues[HTTP_MAX_ARGS];
+        const char* headerNames[HTTP_MAX_HEADERS];
+        const char* headerValues[HTTP_MAX_HEADERS];
+    };
+
+    struct Connection {
+        int fd = -1;
+        IPAddress remote;
+        uint32_t lastActiveMs = 0;
+        uint32_t ticket = 0;           // Ждет отложенного ответа
+        uint32_t deferredAt = 0;
+        bool closeAfterSend = false;
+        int8_t stream = -1;            // Ячейка streams_, -1 - обычное соединение
+        uint32_t served = 0;           // Запросов на этом соединении
+        size_t rxLen = 0;
+        size_t txLen = 0;
+        size_t txPos = 0;
+        size_t bodyPos = 0;
+        String txBody;                 // Тело, не поместившееся в tx
+        char rx[HTTP_RX_BUFFER + 1];   // +1 - место под '\0' после тела
+        char tx[HTTP_TX_BUFFER];
+    };
+
+    // Подписчик потока событий: следующее событие, пока сокет занят текущим
+    struct StreamSlot {
+        bool used = false;
+        uint16_t nextLen = 0;
+        char next[HTTP_STREAM_EVENT];
+    };
+
+    static void setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    static bool pendingTx(const Connection& c) { return c.txPos < c.txLen || c.bodyPos < c.txBody.length(); }
+
+    void closeConnection(Connection& c) {
+        close(c.fd);
+        c.fd = -1;
+        if (c.stream >= 0) {
+            streams_[c.stream].used = false;
+            c.stream = -1;
+            streamCount_--;
+        }
+        c.ticket = 0;
+        c.rxLen = 0;
+        c.txLen = c.txPos = c.bodyPos = 0;
+        c.txBody = String();
+    }
+
+    void acceptConnections(uint32_t now) {
+        for (;;) {
+            Connection* slot = nullptr;
+            Connection* oldestIdle = nullptr;
+            for (Connection& c : conns_) {
+                if (c.fd < 0) {
+                    slot = &c;
+                    break;
+                }
+                if (c.served && c.rxLen == 0 && !pendingTx(c) && !c.ticket && c.stream < 0 &&
+                    now - c.lastActiveMs >= HTTP_EVICT_IDLE_MS &&
+                    (!oldestIdle || c.lastActiveMs < oldestIdle->lastActiveMs)) {
+                    oldestIdle = &c;
+                }
+            }
+            if (!slot && !oldestIdle) return;  // Остальные ждут в очереди listen()
+
+            sockaddr_in addr;
+            socklen_t len = sizeof(addr);
+            int fd = accept(listenFd_, (sockaddr*)&addr, &len);
+            if (fd < 0) return;
+            if (!slot) {
+                closeConnection(*oldestIdle);
+                stats_.evicted++;
+                slot = oldestIdle;
+            }
+            setNonBlocking(fd);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            slot->fd = fd;
+            slot->remote = IPAddress((uint32_t)addr.sin_addr.s_addr);
+            slot->lastActiveMs = now;
+            slot->closeAfterSend = false;
+            slot->served = 0;
+            stats_.accepted++;
+            size_t n = active();
+            if (n > stats_.maxActive) stats_.maxActive = n;
+        }
+    }
+
+    void receive(Connection& c) {
+        size_t space = HTTP_RX_BUFFER - c.rxLen;
+        if (space == 0) {
+            reject(c, 413, "Request too large");
+            return;
+        }
+        ssize_t n = recv(c.fd, c.rx + c.rxLen, space, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            closeConnection(c);
+            return;
+        }
+        if (n < 0) return;
+        if (c.stream >= 0) return;     // Подписчик ничего не присылает, лишнее отбрасываем
+        c.rxLen += n;
+        serveBuffered(c);
+    }
+
+    // Все полностью принятые запросы из буфера (пока ответ уходит сразу)
+    void serveBuffered(Connection& c) {
+        while (c.fd >= 0 && c.rxLen > 0 && !pendingTx(c) && !c.ticket && c.stream < 0) {
+            size_t used = 0;
+            int result = parseAndServe(c, used);
+            if (result == 0) {
+                if (c.rxLen == HTTP_RX_BUFFER) reject(c, 413, "Request too large");
+                return;
+            }
+            if (result < 0) {
+                reject(c, 400, "Bad request");
+                return;
+            }
+            memmove(c.rx, c.rx + used, c.rxLen - used);
+            c.rxLen -= used;
+            sendPending(c);
+        }
+    }
+
+    static const char* findHeaderEnd(const char* p, size_t n) {
+        for (size_t i = 0; i + 3 < n; i++) {
+            if (p[i] == '\r' && p[i + 1] == '\n' && p[i + 2] == '\r' && p[i + 3] == '\n') return p + i;
+        }
+        return nullptr;
+    }
+
+    // Content-Length без изменения буфера (запрос может быть еще не целиком)
+    static long contentLength(const char* p, const char* end) {
+        for (const char* line = p; line < end;) {
+            const char* eol = (const char*)memchr(line, '\n', end - line);
+            if (!eol) eol = end;
+            if (eol - line > 15 && strncasecmp(line, "Content-Length:", 15) == 0) return atol(line + 15);
+            line = eol + 1;
+        }
+        return 0;
+    }
+
+    static void urlDecode(char* s) {
+        char* out = s;
+        for (; *s; s++) {
+            if (*s == '+') {
+                *out++ = ' ';
+            } else if (*s == '%' && isxdigit((uint8_t)s[1]) && isxdigit((uint8_t)s[2])) {
+                char hex[3] = {s[1], s[2], 0};
+                *out++ = (char)strtol(hex, nullptr, 16);
+                s += 2;
+            } else {
+                *out++ = *s;
+            }
+        }
+        *out = '\0';
+    }
+
+    // "a=1&b=2" -> аргументы (на месте)
+    void parseArgs(char* s) {
+        while (s && *s && req_.argCount < HTTP_MAX_ARGS) {
+            char* next = strchr(s, '&');
+            if (next) *next++ = '\0';
+            char* eq = strchr(s, '=');
+            if (eq) *eq++ = '\0';
+            urlDecode(s);
+            if (eq) urlDecode(eq);
+            req_.argNames[req_.argCount] = s;
+            req_.argValues[req_.argCount++] = eq ? eq : s + strlen(s);
+            s = next;
+        }
+    }
+
+    static HTTPMethod parseMethod(const char* m) {
+        if (strcmp(m, "GET") == 0) return HTTP_GET;
+        if (strcmp(m, "POST") == 0) return HTTP_POST;
+        if (strcmp(m, "PUT") == 0) return HTTP_PUT;
+        if (strcmp(m, "DELETE") == 0) return HTTP_DELETE;
+        if (strcmp(m, "PATCH") == 0) return HTTP_PATCH;
+        if (strcmp(m, "OPTIONS") == 0) return HTTP_OPTIONS;
+        return HTTP_HEAD;
+    }
+
+    // 1 - обработан (used - его длина), 0 - принят не целиком, -1 - не HTTP
+    int parseAndServe(Connection& c, size_t& used) {
+        const char* headEnd = findHeaderEnd(c.rx, c.rxLen);
+        if (!headEnd) return 0;
+        long bodyLen = contentLength(c.rx, headEnd);
+        size_t bodyStart = headEnd - c.rx + 4;
+        if (bodyLen < 0 || bodyStart + bodyLen > HTTP_RX_BUFFER) return -1;
+        if (bodyStart + bodyLen > c.rxLen) return 0;
+        used = bodyStart + bodyLen;
+
+        // Разбор на месте: строки заголовков режутся '\0', после тела - временный '\0'
+        char savedAfterBody = c.rx[used];
+        c.rx[used] = '\0';
+        c.rx[headEnd - c.rx] = '\0';
+        req_ = {};
+        req_.remote = c.remote;
+        char* eol = strstr(c.rx, "\r\n");
+        if (eol) *eol = '\0';
+        char* save = nullptr;
+        char* method = strtok_r(c.rx, " ", &save);
+        char* uri = method ? strtok_r(nullptr, " ", &save) : nullptr;
+        char* version = uri ? strtok_r(nullptr, " ", &save) : nullptr;
+        if (!version) {
+            c.rx[used] = savedAfterBody;
+            return -1;
+        }
+        req_.method = parseMethod(method);
+        bool keepAlive = strcmp(version, "HTTP/1.1") == 0;
+        const char* contentType = "";
+        for (char* h = eol ? eol + 2 : nullptr; h && *h;) {
+            char* next = strstr(h, "\r\n");
+            if (next) {
+                *next = '\0';
+                next += 2;
+            }
+            char* colon = strchr(h, ':');
+            if (colon && req_.headerCount < HTTP_MAX_HEADERS) {
+                *colon++ = '\0';
+                while (*colon == ' ') colon++;
+                req_.headerNames[req_.headerCount] = h;
+                req_.headerValues[req_.headerCount++] = colon;
+                if (strcasecmp(h, "Connection") == 0) keepAlive = strcasecmp(colon, "close") != 0 &&
+                                                           (keepAlive || strcasecmp(colon, "keep-alive") == 0);
+                if (strcasecmp(h, "Content-Type") == 0) contentType = colon;
+            }
+            h = next;
+        }
+
+        char* query = strchr(uri, '?');
+        if (query) *query++ = '\0';
+        req_.uri = uri;
+        parseArgs(query);
+        char* body = c.rx + bodyStart;
+        if (bodyLen > 0) {
+            if (strncasecmp(contentType, "application/x-www-form-urlencoded", 33) == 0) {
+                parseArgs(body);
+            } else if (req_.argCount < HTTP_MAX_ARGS) {
+                req_.argNames[req_.argCount] = "plain";     // Как у WebServer: тело целиком
+                req_.argValues[req_.argCount++] = body;
+            }
+        }
+
+        current_ = &c;
+        route();
+        current_ = nullptr;
+        c.rx[used] = savedAfterBody;
+        bool scarce = backlogSeen_ && millis() - backlogAt_ < HTTP_SCARCE_MS;
+        c.closeAfterSend = (!keepAlive || scarce) && c.stream < 0;   // Поток живет до закрытия клиентом
+        if (keepAlive && scarce && c.stream < 0) stats_.closedForSlots++;
+        c.served++;
+        stats_.requests++;
+        if (deferred_) {
+            deferred_ = false;         // Ответ придет через complete()
+            return 1;
+        }
+        if (streamed_) {
+            streamed_ = false;         // Заголовки уже в tx, дальше - события через publish()
+            return 1;
+        }
+        writeResponse(c);
+        return 1;
+    }
+
+    void finishDeferred(Connection& c, int code, const char* contentType, const String& content) {
+        c.ticket = 0;
+        c.lastActiveMs = millis();
+        code_ = code;
+        contentType_ = contentType ? contentType : "";
+        body_ = content;
+        extraCount_ = 0;
+        writeResponse(c);
+        sendPending(c);
+        if (c.fd >= 0 && !pendingTx(c)) serveBuffered(c);
+    }
+
+    void route() {
+        code_ = 0;
+        contentType_ = "";
+        extraCount_ = 0;
+        for (const Route& r : routes_) {
+            if (r.uri == req_.uri && (r.method == HTTP_ANY || r.method == req_.method)) {
+                r.fn();
+                if (code_ == 0 && !deferred_ && !streamed_) send(500, "text/plain", "No response");
+                return;
+            }
+        }
+        if (notFound_) notFound_();
+        if (code_ == 0) send(404, "text/plain", "Not found");
+    }
+
+    static const char* statusText(int code) {
+        switch (code) {
+            case 200: return "OK";
+            case 204: return "No Content";
+            case 304: return "Not Modified";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 413: return "Payload Too Large";
+            case 503: return "Service Unavailable";
+            default:  return code >= 500 ? "Internal Server Error" : "OK";
+        }
+    }
+
+    // Заголовки и короткое тело - в tx, длинное тело остается в String
+    void writeResponse(Connection& c) {
+        const char* connection = c.closeAfterSend ? "close" : "keep-alive";
+        int n;
+        if (code_ == 304) {
+            // Тела нет, а Content-Length у 304 - длина того ответа 200, которого клиент не просил
+            body_ = String();
+            n = snprintf(c.tx, sizeof(c.tx), "HTTP/1.1 304 %s\r\nConnection: %s\r\n", statusText(code_), connection);
+        } else {
+            n = snprintf(c.tx, sizeof(c.tx),
+                         "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: %s\r\n",
+                         code_, statusText(code_), contentType_.length() ? contentType_.c_str() : "text/plain",
+                         (unsigned)body_.length(), connection);
+        }
+        for (int i = 0; i < extraCount_ && n < (int)sizeof(c.tx); i++) {
+            n += snprintf(c.tx + n, sizeof(c.tx) - n, "%s: %s\r\n", extra_[i].name.c_str(), extra_[i].value.c_str());
+        }
+        if (n < (int)sizeof(c.tx)) n += snprintf(c.tx + n, sizeof(c.tx) - n, "\r\n");
+        if (n >= (int)sizeof(c.tx)) n = sizeof(c.tx) - 1;     // Заголовки обрезаны - лучше, чем переполнение
+        c.txLen = n;
+        c.txPos = 0;
+        c.bodyPos = 0;
+        if (n + body_.length() <= sizeof(c.tx)) {
+            memcpy(c.tx + n, body_.c_str(), body_.length());
+            c.txLen += body_.length();
+            c.txBody = String();
+        } else {
+            c.txBody = body_;
+        }
+        body_ = String();
+    }
+
+    void sendPending(Connection& c) {
+        while (c.txPos < c.txLen) {
+            ssize_t n = ::send(c.fd, c.tx + c.txPos, c.txLen - c.txPos, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+                closeConnection(c);
+                return;
+            }
+            c.txPos += n;
+        }
+        while (c.bodyPos < c.txBody.length()) {
+            ssize_t n = ::send(c.fd, c.txBody.c_str() + c.bodyPos, c.txBody.length() - c.bodyPos, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+                closeConnection(c);
+                return;
+            }
+            c.bodyPos += n;
+        }
+        c.txBody = String();
+        c.txLen = c.txPos = c.bodyPos = 0;
+        if (c.closeAfterSend) {
+            closeConnection(c);
+            return;
+        }
+        // Подписчик освободился: последнее событие, пришедшее пока сокет был занят
+        if (c.stream >= 0 && streams_[c.stream].nextLen) {
+            StreamSlot& slot = streams_[c.stream];
+            memcpy(c.tx, slot.next, slot.nextLen);
+            c.txLen = slot.nextLen;
+            slot.nextLen = 0;
+            stats_.streamEvents++;
+            sendPending(c);
+        }
+    }
+
+    void reject(Connection& c, int code, const char* text) {
+        stats_.rejected++;
+        code_ = code;
+        contentType_ = "text/plain";
+        body_ = text;
+        extraCount_ = 0;
+        c.closeAfterSend = true;
+        c.rxLen = 0;
+        writeResponse(c);
+        sendPending(c);
+    }
+
+    const char* findArg(const char* name) const {
+        for (int i = 0; i < req_.argCount; i++) {
+            if (strcmp(req_.argNames[i], name) == 0) return req_.argValues[i];
+        }
+        return nullptr;
+    }
+
+    uint16_t port_;
+    int listenFd_ = -1;
+    std::vector<Route> routes_;
+    THandlerFunction notFound_;
+    Connection conns_[HTTP_MAX_CONNECTIONS];
+    bool backlogSeen_ = false;         // Новые соединения ждали свободной ячейки...
+    uint32_t backlogAt_ = 0;           // ...последний раз тогда
+
+    // Текущий запрос и ответ
+    Request req_ = {};
+    Connection* current_ = nullptr;    // Соединение запроса (нет у dispatch())
+    bool deferred_ = false;
+    bool streamed_ = false;
+    uint32_t deferSeq_ = 0;
+    int wakeFd_ = -1;
+    int code_ = 0;
+    String contentType_;
+    String body_;
+    Header extra_[HTTP_MAX_EXTRA_HEADERS];
+    int extraCount_ = 0;
+
+    StreamSlot streams_[HTTP_MAX_STREAMS];
+    std::atomic<uint8_t> streamCount_{0};
+    uint32_t eventSeq_ = 0;
+
+    HttpFrontStats stats_ = {};
+#ifdef NATIVE_BUILD
+    std::mutex simLock_;               // dispatch() из потока бенчмарка и задача сервера
+#endif
+};
@@ -0,0 +1,165 @@
+// mem_monitor.h - куча и стеки задач: выборки в кольце фиксированного размера
+//
+// Раз в MEM_SAMPLE_MS loop() снимает свободную кучу, наибольший свободный
+// блок (дробление), минимум свободной кучи с запуска, занятую PSRAM и запас
+// стека каждой задачи (high water mark). Кольцо хранит сутки выборок и
+// отдается по GET /mem и командой /mem.
+//
+// Утечку выдает не уровень кучи, а ее потолок: кольцо делится на
+// MEM_TREND_PARTS частей, и если наибольшая свободная куча каждой части
+// ниже прошлой хотя бы на MEM_LEAK_MIN_BYTES, куча убывает монотонно.
+// Временные выделения (ответ HTTP, отчет Telegram) на потолок не влияют.
+//
+// Пишет кольцо только loop(), читать можно из любой задачи: snapshot()
+// повторяет копирование, если запись шла в это время (счетчик seq_).
+// Задачи регистрируются в setup(), /mem может прийти уже тогда - их число
+// атомарное и растет после того, как ячейка заполнена.
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "metrics.h"
+
+
+// ===== Настройки =====
+#define MEM_SAMPLE_MS 900000           // Выборка раз в 15 мин
+#define MEM_SAMPLES 96                 // Сутки выборок
+#define MEM_MAX_TASKS 6
+#define MEM_TREND_PARTS 4              // Части кольца для проверки убывания (по 6 ч)
+#define MEM_LEAK_MIN_BYTES 512         // Потолок части ниже прошлой хотя бы на столько
+#define MEM_STACK_WARN_BYTES 512       // Запас стека меньше - предупреждение в /mem
+
+
+struct MemSample {
+    uint32_t uptimeS;
+    uint32_t freeHeap;
+    uint32_t maxBlock;                 // Наибольший свободный блок
+    uint32_t minFree;                  // Минимум свободной кучи с запуска
+    uint32_t psramUsed;
+    uint16_t stackFree[MEM_MAX_TASKS]; // Запас стека задач, байт (порядок watchTask())
+};
+
+// Потолок кучи по частям кольца, от старых к новым
+struct MemTrend {
+    uint8_t parts;                     // 0 - выборок мало для вывода
+    uint32_t partMs;                   // Длительность одной части
+    uint32_t ceiling[MEM_TREND_PARTS];
+    bool declining;
+};
+
+
+class MemMonitor {
+public:
+    // Задача под контролем стека; stackBytes - размер из xTaskCreatePinnedToCore()
+    void watchTask(const char* name, TaskHandle_t task, uint32_t stackBytes) {
+        uint8_t i = tasks_.load(std::memory_order_relaxed);
+        if (i == MEM_MAX_TASKS || !task) return;
+        names_[i] = name;
+        handles_[i] = task;
+        stacks_[i] = stackBytes;
+        tasks_.store(i + 1, std::memory_order_release);
+    }
+
+    // Из loop(): true - сделана новая выборка
+    bool poll(uint32_t nowMs) {
+        if (count_ > 0 && nowMs - lastMs_ < MEM_SAMPLE_MS) return false;
+        lastMs_ = nowMs;
+        sample(nowMs);
+        return true;
+    }
+
+    void sample(uint32_t nowMs) {
+        MemSample s = current(nowMs);
+        seq_.fetch_add(1, std::memory_order_acq_rel);   // Нечетный - идет запись
+        ring_[head_] = s;
+        head_ = (head_ + 1) % MEM_SAMPLES;
+        if (count_ < MEM_SAMPLES) count_++;
+        seq_.fetch_add(1, std::memory_order_release);
+        declining_.store(trend().declining, std::memory_order_relaxed);
+    }
+
+    // Состояние прямо сейчас (не попадает в кольцо)
+    MemSample current(uint32_t nowMs) const {
+        MemSample s = {};
+        s.uptimeS = nowMs / 1000;
+        s.freeHeap = ESP.getFreeHeap();
+        s.maxBlock = ESP.getMaxAllocHeap();
+        s.minFree = ESP.getMinFreeHeap();
+        s.psramUsed = ESP.getPsramSize() - ESP.getFreePsram();
+        for (uint8_t i = 0, n = tasks(); i < n; i++) {
+            UBaseType_t free = uxTaskGetStackHighWaterMark(handles_[i]);
+            s.stackFree[i] = free > UINT16_MAX ? UINT16_MAX : (uint16_t)free;
+        }
+        return s;
+    }
+
+    // Копия кольца от старых выборок к новым; возвращает их число
+    size_t snapshot(MemSample* out, size_t max) const {
+        for (;;) {
+            uint32_t seq = seq_.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            size_t n = count_ < max ? count_ : max;
+            size_t first = (head_ + MEM_SAMPLES - n) % MEM_SAMPLES;
+            for (size_t i = 0; i < n; i++) out[i] = ring_[(first + i) % MEM_SAMPLES];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == seq) return n;
+        }
+    }
+
+    // Потолок кучи по частям кольца (только loop())
+    MemTrend trend() const {
+        MemTrend t = {};
+        size_t per = count_ / MEM_TREND_PARTS;
+        if (per < 2) return t;
+        size_t first = (head_ + MEM_SAMPLES - per * MEM_TREND_PARTS) % MEM_SAMPLES;
+        for (uint8_t p = 0; p < MEM_TREND_PARTS; p++) {
+            uint32_t ceiling = 0;
+            for (size_t i = 0; i < per; i++) {
+                const MemSample& s = ring_[(first + p * per + i) % MEM_SAMPLES];
+                if (s.freeHeap > ceiling) ceiling = s.freeHeap;
+            }
+            t.ceiling[p] = ceiling;
+        }
+        t.parts = MEM_TREND_PARTS;
+        t.partMs = per * MEM_SAMPLE_MS;
+        t.declining = true;
+        for (uint8_t p = 1; p < MEM_TREND_PARTS; p++) {
+            if (t.ceiling[p] + MEM_LEAK_MIN_BYTES > t.ceiling[p - 1]) t.declining = false;
+        }
+        return t;
+    }
+
+    // Итог trend() на последней выборке (любая задача)
+    bool declining() const { return declining_.load(std::memory_order_relaxed); }
+    size_t count() const { return count_; }
+    uint8_t tasks() const { return tasks_.load(std::memory_order_acquire); }
+    const char* taskName(uint8_t i) const { return names_[i]; }
+    uint32_t taskStack(uint8_t i) const { return stacks_[i]; }
+
+private:
+    MemSample ring_[MEM_SAMPLES] = {};
+    size_t head_ = 0;
+    size_t count_ = 0;
+    uint32_t lastMs_ = 0;
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<bool> declining_{false};
+
+    const char* names_[MEM_MAX_TASKS] = {};
+    TaskHandle_t handles_[MEM_MAX_TASKS] = {};
+    uint32_t stacks_[MEM_MAX_TASKS] = {};
+    std::atomic<uint8_t> tasks_{0};
+};
+
+
+// Запас стека задач для /metrics: одна метрика с меткой task
+inline void writeTaskStacks(String& out, const char* name, const char* help, const MemMonitor& mem) {
+    writeMetricHeader(out, name, help, "gauge");
+    MemSample now = mem.current(millis());
+    char line[128];
+    for (uint8_t i = 0; i < mem.tasks(); i++) {
+        snprintf(line, sizeof(line), "%s{task=\"%s\"} %u\n", name, mem.taskName(i), (unsigned)now.stackFree[i]);
+        out += line;
+    }
+}
@@ -0,0 +1,136 @@
+// messages.h - тексты сообщений Telegram и журнала одной таблицей
+//
+// Таблица - constexpr массив указателей на строковые литералы: на ESP32 и
+// строки, и сам массив лежат во флеше (.rodata, читается через кэш), в .data
+// и в куче их нет. Сообщения с именами и числами - шаблоны printf: их
+// собирает TelegramOutbox::sendf() прямо в ячейку очереди или snprintf в
+// буфер на стеке, без цепочек временных String, которые дробят кучу.
+//
+//   telegram.sendf("", messageText(Msg::SensorBack), label);
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum class Msg : uint8_t {
+    // Команды Telegram
+    Help,               // %s - состояние охраны
+    Busy,
+    LogEmpty,
+    RangeEmpty,
+    LogsUsage,
+    LogCleared,
+    LogClearedReply,
+    SoundTest,
+    RfidStatus,         // %s модуль, %x версия, %lu касаний, %lu повторов, %s карта, %lu карт
+    AddCardUsage,
+    CardsFull,
+    CardAdded,          // %s владелец
+    CardAddedLog,
+    RevokeCardUsage,
+    CardRevoked,
+    CardRevokedLog,
+    ZoneUsage,
+    SensorsFull,
+    ZonesFull,          // %u зон
+    ZoneSet,            // %s датчик (зона)
+    ZoneSetLog,
+    // Охрана
+    ArmReply,
+    DisarmReply,
+    ArmedLog,
+    DisarmedLog,
+    CardToggle,         // %s UID, %s владелец, %s действие (ArmedLog/DisarmedLog)
+    CardToggleLog,      // %s владелец, %s включил/выключил
+    AlarmLog,           // %s датчик
+    AlarmReply,         // %s датчик (зона)
+    AlarmTimeout,       // %lu минут
+    // Карты у считывателя
+    CardUnknown,        // %s UID, %s UID без пробелов
+    CardUnknownLog,
+    CardDisabled,
+    CardDisabledLog,
+    // Датчики
+    MotionDetails,      // %s датчик (зона), %s значение, %s IP
+    SensorBack,         // %s датчик (зона)
+    SensorBackLog,      // %s id
+    SensorSilent,       // %s датчик (зона), %lu секунд
+    SensorSilentLog,    // %s id, %lu секунд
+    StaleDelivered,     // %s id, %d событий
+    // Память (mem_monitor.h)
+    MemDeclining,       // %lu часов, %lu байт было, %lu байт стало
+    MemDecliningLog,    // %lu байт было, %lu байт стало
+    SoakLog,            // %lu номер входа
+};
+
+constexpr const char* const MESSAGES[] = {
+    // Help
+    "🚨 *Охранная система*\n\n"
+    "Статус: %s\n\n"
+    "Команды:\n"
+    "/status - Статус\n"
+    "/arm - Включить систему сигнализации\n"
+    "/disarm - Выключить систему сигнализации\n"
+    "/logs - Последние 10 событий\n"
+    "/logs 2h - События за 2 часа (журнал)\n"
+    "/clear_logs - Очистить лог\n"
+    "/list_cards - RFID карты\n"
+    "/add_card UID Имя - Добавить карту\n"
+    "/revoke_card UID - Отключить карту\n"
+    "/sensors - Датчики и зоны\n"
+    "/zone ID Зона - Назначить зону датчику\n"
+    "/mem - Память и стеки задач\n",
+    "❌ Система занята, повторите команду",
+    "📭 Лог пуст",
+    "📭 За этот интервал событий нет",
+    "Использование: /logs 2h или /logs 3h 2h (s, m, h, d)",
+    "Лог очищен",
+    "🧹 Лог очищен",
+    "🔊 Тест звука выполнен",
+    "📊 RFID статус:\nМодуль: %s 0x%x\nКасаний: %lu, повторов: %lu\nПоследняя карта: %s\nВсего карт в базе: %lu",
+    "Использование: /add_card 23220435 Имя",
+    "❌ База карт заполнена",
+    "✅ Карта добавлена: %s",
+    "Добавлена карта: %s",
+    "❓ Карта не найдена. Использование: /revoke_card 23220435",
+    "⛔ Карта отключена: %s",
+    "Отключена карта: %s",
+    "Использование: /zone pir_sensor Прихожая",
+    "❌ Реестр датчиков заполнен",
+    "❌ Зон не больше %u",
+    "✅ Датчик %s",
+    "Зона датчика: %s",
+    // Охрана
+    "✅ Система сигнализации включена",
+    "🔓 Система сигнализации выключена",
+    "Система сигнализации включена",
+    "Система сигнализации выключена",
+    "📇 RFID карта:\nUID: %s\n✅ Карта: %s\nДействие: %s",
+    "RFID: %s %s систему сигнализации",
+    "%s: Обнаружено движение! Тревога!",
+    "🚨🚨🚨 ТРЕВОГА! 🚨🚨🚨\nОбнаружено движение!\nДатчик: %s\nВключена звуковая сигнализация",
+    "⏰ Тревога автоматически отключена\nПрошло %lu мин",
+    // Карты у считывателя
+    "📇 RFID карта:\nUID: %s\n❓ Неизвестная карта!\nДобавить: /add_card %s Имя",
+    "RFID_ERROR: Неизвестная карта %s",
+    "📇 RFID карта:\nUID: %s\n⛔ Карта отключена!",
+    "RFID_ERROR: Отключенная карта %s",
+    // Датчики
+    "🔍 Детали движения:\nДатчик: %s\nЗначение: %s\nIP источника: %s",
+    "✅ Датчик %s снова на связи",
+    "%s: снова на связи",
+    "⚠️ Датчик %s не выходит на связь больше %lu с\nВозможен обрыв питания или глушение WiFi",
+    "%s: нет связи %lu с",
+    "📦 Датчик %s снова на связи\nДоставлено событий, накопленных без связи: %d\nПодробности в /logs",
+    // Память
+    "⚠️ Потолок свободной кучи убывал все последние %lu ч\nБыло %lu, стало %lu байт\nВозможна утечка, подробности в /mem",
+    "Куча убывает: потолок %lu -> %lu байт",
+    "Проверка утечек: вход %lu",
+};
+static_assert(sizeof(MESSAGES) / sizeof(MESSAGES[0]) == (size_t)Msg::SoakLog + 1,
+              "MESSAGES must cover Msg");
+
+constexpr const char* messageText(Msg m) {
+    return MESSAGES[(size_t)m];
+}
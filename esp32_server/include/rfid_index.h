@@ -0,0 +1,285 @@
+// rfid_index.h - база RFID карт: хеш-таблица по бинарным UID
+//
+// UID хранится как есть (4, 7 или 10 байт), без строк. Поиск - открытая
+// адресация с линейным пробированием, в среднем одно сравнение.
+// Имена владельцев лежат в общем пуле строк. Память выделяется один раз
+// в begin(), дальше добавление и поиск кучу не трогают.
+//
+// На флеше база хранится текстом в LittleFS (RFID_CARDS_FILE):
+//   UID;статус;владелец      статус: 1 - активна, 0 - отключена
+//   23220435;1;Администратор
+// Изменения во время работы дописываются в конец файла (последняя строка
+// для UID главнее), при загрузке файл сжимается, если в нем много повторов.
+// Имя владельца - до RFID_OWNER_MAX байт: длиннее /add_card обрезает по
+// символу, а loadCards - строки старых файлов.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <FS.h>
+#include "event_log.h"
+
+#define RFID_UID_MAX 10
+#define RFID_OWNER_MAX 64              // Байт имени владельца без '\0'
+// Самая длинная строка файла без '\n': "UID;1;владелец\r"
+#define RFID_LINE_MAX (RFID_UID_MAX * 2 + 3 + RFID_OWNER_MAX + 1)
+
+
+struct CardUid {
+    uint8_t size;                      // 4, 7 или 10 байт
+    uint8_t bytes[RFID_UID_MAX];
+
+    bool operator==(const CardUid& o) const {
+        return size == o.size && memcmp(bytes, o.bytes, size) == 0;
+    }
+};
+
+enum class CardStatus : uint8_t { Unknown, Disabled, Active };
+
+struct CardInfo {
+    CardStatus status;
+    const char* owner;                 // "" для неизвестной карты
+};
+
+
+// Разбор UID из hex: "23220435", "23 22 04 35", "23:22:04:35"
+inline bool parseUid(const char* s, CardUid& out) {
+    out.size = 0;
+    int hi = -1;
+    for (; *s; s++) {
+        char c = *s;
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else if (c == ' ' || c == ':' || c == '-') {
+            if (hi >= 0) return false;  // Разделитель посреди байта
+            continue;
+        }
+        else return false;
+
+        if (hi < 0) {
+            hi = v;
+        } else {
+            if (out.size == RFID_UID_MAX) return false;
+            out.bytes[out.size++] = (uint8_t)(hi << 4 | v);
+            hi = -1;
+        }
+    }
+    return hi < 0 && (out.size == 4 || out.size == 7 || out.size == 10);
+}
+
+// Вывод UID в виде "23 22 04 35" (sep = 0 - без пробелов)
+inline const char* formatUid(const CardUid& uid, char* buf, size_t size, char sep = ' ') {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (uint8_t i = 0; i < uid.size; i++) {
+        size_t need = (i > 0 && sep) ? 3 : 2;
+        if (n + need >= size) break;
+        if (i > 0 && sep) buf[n++] = sep;
+        buf[n++] = HEX_DIGITS[uid.bytes[i] >> 4];
+        buf[n++] = HEX_DIGITS[uid.bytes[i] & 0x0F];
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+
+class RfidIndex {
+public:
+    enum class Result : uint8_t { Ok, TableFull, PoolFull, BadUid };
+
+    ~RfidIndex() {
+        delete[] slots_;
+        delete[] pool_;
+    }
+
+    // slots - степень двойки; заполняется не более чем на 3/4
+    bool begin(size_t slots, size_t poolBytes) {
+        if (slots_ || slots < 4 || (slots & (slots - 1)) != 0 || poolBytes < 2) return false;
+        slots_ = new Slot[slots];
+        pool_ = new char[poolBytes];
+        capacity_ = slots;
+        poolSize_ = poolBytes;
+        clear();
+        return true;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < capacity_; i++) slots_[i].size = 0;
+        pool_[0] = '\0';               // Смещение 0 - пустое имя
+        poolUsed_ = 1;
+        count_ = 0;
+    }
+
+    CardInfo lookup(const CardUid& uid) const {
+        const Slot* s = find(uid);
+        if (!s) return {CardStatus::Unknown, ""};
+        return {s->active ? CardStatus::Active : CardStatus::Disabled, pool_ + s->owner};
+    }
+
+    // Добавление или изменение карты
+    Result put(const CardUid& uid, const char* owner, bool active) {
+        if (uid.size == 0 || uid.size > RFID_UID_MAX) return Result::BadUid;
+        Slot* s = find(uid);
+        if (!s) {
+            if ((count_ + 1) * 4 > capacity_ * 3) return Result::TableFull;
+            s = &slots_[hash(uid) & (capacity_ - 1)];
+            while (s->size != 0) s = next(s);
+            s->owner = 0;
+        }
+        // Имя пишем в пул только если оно поменялось
+        if (strcmp(pool_ + s->owner, owner) != 0) {
+            size_t len = strlen(owner) + 1;
+            if (poolUsed_ + len > poolSize_) return Result::PoolFull;
+            memcpy(pool_ + poolUsed_, owner, len);
+            s->owner = (uint32_t)poolUsed_;
+            poolUsed_ += len;
+        }
+        if (s->size == 0) {
+            s->size = uid.size;
+            memcpy(s->key, uid.bytes, uid.size);
+            count_++;
+        }
+        s->active = active;
+        return Result::Ok;
+    }
+
+    bool setActive(const CardUid& uid, bool active) {
+        Slot* s = find(uid);
+        if (!s) return false;
+        s->active = active;
+        return true;
+    }
+
+    // Обход всех карт: fn(const CardUid&, const char* owner, bool active)
+    template <typename F>
+    void forEach(F fn) const {
+        CardUid uid;
+        for (size_t i = 0; i < capacity_; i++) {
+            const Slot& s = slots_[i];
+            if (s.size == 0) continue;
+            uid.size = s.size;
+            memcpy(uid.bytes, s.key, s.size);
+            fn(uid, pool_ + s.owner, (bool)s.active);
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t capacity() const { return capacity_ * 3 / 4; }
+    size_t memoryBytes() const { return capacity_ * sizeof(Slot) + poolSize_; }
+
+private:
+    struct Slot {
+        uint8_t key[RFID_UID_MAX];
+        uint8_t size;                  // 0 - пустая ячейка
+        uint8_t active;
+        uint32_t owner;                // Смещение имени в пуле
+    };
+
+    // FNV-1a с перемешиванием (у 7-байтовых UID первый байт - производитель)
+    static uint32_t hash(const CardUid& uid) {
+        uint32_t h = 2166136261u ^ uid.size;
+        for (uint8_t i = 0; i < uid.size; i++) {
+            h ^= uid.bytes[i];
+            h *= 16777619u;
+        }
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    Slot* next(Slot* s) const { return (s + 1 == slots_ + capacity_) ? slots_ : s + 1; }
+
+    Slot* find(const CardUid& uid) const {
+        if (!slots_) return nullptr;
+        Slot* s = &slots_[hash(uid) & (capacity_ - 1)];
+        while (s->size != 0) {
+            if (s->size == uid.size && memcmp(s->key, uid.bytes, uid.size) == 0) return s;
+            s = next(s);
+        }
+        return nullptr;
+    }
+
+    Slot* slots_ = nullptr;
+    char* pool_ = nullptr;
+    size_t capacity_ = 0;
+    size_t poolSize_ = 0;
+    size_t poolUsed_ = 0;
+    size_t count_ = 0;
+};
+
+
+// ===== Хранение в LittleFS =====
+
+// Одна строка файла: "UID;статус;владелец\n"
+inline bool writeCardLine(fs::File& f, const CardUid& uid, const char* owner, bool active) {
+    char hex[RFID_UID_MAX * 2 + 1];
+    formatUid(uid, hex, sizeof(hex), 0);
+    return f.printf("%s;%d;%s\n", hex, active ? 1 : 0, owner) > 0;
+}
+
+// Перезапись файла текущим содержимым базы (через временный файл)
+inline bool saveCards(fs::FS& fs, const char* path, const RfidIndex& index) {
+    char tmp[48];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fs::File f = fs.open(tmp, "w");
+    if (!f) return false;
+    f.print("# UID;status;owner\n");
+    bool ok = true;
+    index.forEach([&](const CardUid& uid, const char* owner, bool active) {
+        ok = writeCardLine(f, uid, owner, active) && ok;
+    });
+    f.close();
+    if (!ok) return false;
+    fs.remove(path);
+    return fs.rename(tmp, path);
+}
+
+// Дописывание изменения в конец файла
+inline bool appendCard(fs::FS& fs, const char* path, const CardUid& uid, const char* owner, bool active) {
+    fs::File f = fs.open(path, "a");
+    if (!f) return false;
+    bool ok = writeCardLine(f, uid, owner, active);
+    f.close();
+    return ok;
+}
+
+// Загрузка базы; возвращает число прочитанных строк (-1 - файла нет)
+inline int loadCards(fs::FS& fs, const char* path, RfidIndex& index) {
+    fs::File f = fs.open(path, "r");
+    if (!f) return -1;
+    char line[RFID_LINE_MAX + 2];
+    int lines = 0;
+    while (f.available()) {
+        size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[n] = '\0';
+        if (n > RFID_LINE_MAX) {
+            // Строка длиннее любой записанной: хвост имени отбрасываем
+            while (f.available() && f.read() != '\n') {}
+        }
+        if (n == 0 || line[0] == '#') continue;
+
+        char* status = strchr(line, ';');
+        if (!status) continue;
+        *status++ = '\0';
+        char* owner = strchr(status, ';');
+        if (!owner) continue;
+        *owner++ = '\0';
+        size_t ownerLen = strlen(owner);
+        if (ownerLen > 0 && owner[ownerLen - 1] == '\r') owner[--ownerLen] = '\0';
+        if (ownerLen > RFID_OWNER_MAX) {
+            owner[RFID_OWNER_MAX] = '\0';
+            trimUtf8(owner, RFID_OWNER_MAX);
+        }
+
+        CardUid uid;
+        if (!parseUid(line, uid)) continue;
+        index.put(uid, owner, status[0] == '1');
+        lines++;
+    }
+    f.close();
+    return lines;
+}
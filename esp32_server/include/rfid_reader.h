@@ -0,0 +1,253 @@
+// rfid_reader.h - считыватель RC522 в своей задаче, будит ее линия IRQ
+//
+// Раньше loop() раз в 100 мс звал PICC_IsNewCardPresent(): без карты
+// библиотека шлет REQA и до таймаута чипа (25 мс) читает ComIrqReg по SPI,
+// то есть шина и ядро заняты четверть времени впустую. Теперь чип сам
+// сообщает об ответе карты: раз в RFID_KICK_MS esp_timer будит задачу, она
+// тремя записями регистров запускает REQA и уходит спать. Если карта
+// ответила, RC522 опускает IRQ, прерывание будит задачу, и только тогда
+// идут чтение UID и HaltA.
+//
+// Повторные чтения отсеивает RecentUids: карта, которую видели меньше
+// RFID_REPEAT_MS назад, - та же, что еще лежит у считывателя (окно
+// продлевается каждым чтением). Убрать и снова поднести карту - новое
+// касание. Касания уходят в loop() через lock-free очередь (pop()).
+// После begin() SPI и MFRC522 трогает только задача считывателя.
+#pragma once
+
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "lockfree_queue.h"
+#include "rfid_index.h"
+
+
+// ===== Настройки =====
+#define RFID_KICK_MS 50                // REQA без карты: 3 записи регистров
+#define RFID_REPEAT_MS 400             // Та же карта раньше - повтор, а не касание
+#define RFID_CHECK_MS 10000            // Проверка VersionReg, сбой - повторная инициализация
+#define RFID_RECENT_SLOTS 4            // UID в окне повторов
+#define RFID_SWIPE_SLOTS 8             // Касаний в очереди (степень двойки)
+#define RFID_TASK_CORE 0               // Ядро сети (loop() работает на ядре 1)
+#define RFID_TASK_STACK 4096
+#define RFID_TASK_PRIORITY 2           // Выше сети: чтение карты - несколько мс SPI
+
+
+// Последние прочитанные UID с временем чтения, без выделений памяти
+template <size_t N>
+class RecentUids {
+public:
+    // true - новое касание. Повтор продлевает окно: карту держат у считывателя.
+    bool fresh(const CardUid& uid, uint32_t nowUs, uint32_t windowUs) {
+        Entry* victim = &entries_[0];
+        for (Entry& e : entries_) {
+            if (e.used && e.uid == uid) {
+                bool repeat = nowUs - e.seenUs < windowUs;
+                e.seenUs = nowUs;
+                return !repeat;
+            }
+            // Новый UID занимает пустую ячейку или самую старую
+            if (!victim->used) continue;
+            if (!e.used || (int32_t)(e.seenUs - victim->seenUs) < 0) victim = &e;
+        }
+        victim->used = true;
+        victim->uid = uid;
+        victim->seenUs = nowUs;
+        return true;
+    }
+
+private:
+    struct Entry {
+        bool used;
+        CardUid uid;
+        uint32_t seenUs;
+    };
+
+    Entry entries_[N] = {};
+};
+
+
+struct RfidSwipe {
+    uint32_t readUs;                   // micros() запроса REQA, на который ответила карта
+    CardUid uid;
+};
+
+struct RfidReaderStats {
+    uint32_t kicks;                    // Запусков REQA
+    uint32_t irqs;                     // Пробуждений по IRQ
+    uint32_t swipes;                   // Касаний в очередь
+    uint32_t repeats;                  // Чтений той же карты в окне RFID_REPEAT_MS
+    uint32_t failed;                   // IRQ без прочитанного UID (помеха, карту убрали)
+    uint32_t dropped;                  // Очередь касаний была полна
+    uint32_t resets;                   // Повторных инициализаций чипа
+};
+
+
+class RfidReader {
+public:
+    explicit RfidReader(MFRC522& rfid) : rfid_(rfid) {}
+
+    // Чип уже прошел PCD_Init(). IRQ RC522 - выход с открытым стоком, активный 0.
+    void begin(uint8_t irqPin) {
+        instance_ = this;
+        version_ = rfid_.PCD_ReadRegister(MFRC522::VersionReg);
+        enableIrq();
+        xTaskCreatePinnedToCore(taskEntry, "rfid", RFID_TASK_STACK, this, RFID_TASK_PRIORITY, &task_,
+                                RFID_TASK_CORE);
+        pinMode(irqPin, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(irqPin), onIrq, FALLING);
+        esp_timer_create_args_t args = {};
+        args.callback = onKick;
+        args.arg = this;
+        args.name = "rfid";
+        esp_timer_create(&args, &timer_);
+        setKickPeriod(RFID_KICK_MS);
+    }
+
+    // Пауза между запросами REQA; 0 - считыватель не опрашивает карты
+    void setKickPeriod(uint32_t ms) {
+        if (esp_timer_is_active(timer_)) esp_timer_stop(timer_);
+        if (ms) esp_timer_start_periodic(timer_, ms * 1000ULL);
+    }
+
+    // Следующее касание (из loop())
+    bool pop(RfidSwipe& s) { return swipes_.tryPop(s); }
+
+    // Нет необработанных пробуждений: все ответившие карты уже в очереди
+    bool idle() const { return wake_.load() == 0 && !busy_.load(); }
+
+    // VersionReg при последней проверке: 0x91/0x92 - RC522 на связи
+    uint8_t version() const { return version_; }
+    bool online() const { return version_ != 0x00 && version_ != 0xFF; }
+    TaskHandle_t task() const { return task_; }
+
+    RfidReaderStats stats() const {
+        RfidReaderStats s;
+        s.kicks = kicks_;
+        s.irqs = irqs_;
+        s.swipes = queued_;
+        s.repeats = repeats_;
+        s.failed = failed_;
+        s.dropped = dropped_;
+        s.resets = resets_;
+        return s;
+    }
+
+private:
+    static const uint8_t WAKE_IRQ = 1;
+    static const uint8_t WAKE_KICK = 2;
+
+    static void taskEntry(void* arg) {
+        static_cast<RfidReader*>(arg)->run();
+    }
+
+    static void IRAM_ATTR onIrq() {
+        RfidReader* self = instance_;
+        self->wake_.fetch_or(WAKE_IRQ);
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->task_, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+
+    // Колбэк esp_timer: SPI здесь нельзя (задержал бы другие таймеры), только будим задачу
+    static void onKick(void* arg) {
+        RfidReader* self = (RfidReader*)arg;
+        self->kickUs_ = micros();
+        self->wake_.fetch_or(WAKE_KICK);
+        xTaskNotifyGive(self->task_);
+    }
+
+    void run() {
+        for (;;) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            busy_ = true;
+            for (uint8_t w = wake_.exchange(0); w; w = wake_.exchange(0)) {
+                if (w & WAKE_IRQ) readCard();
+                if (w & WAKE_KICK) kick();
+            }
+            busy_ = false;
+        }
+    }
+
+    // Прерывание по приему кадра (RxIEn), линия IRQ инвертирована: активный 0
+    void enableIrq() {
+        rfid_.PCD_WriteRegister(MFRC522::ComIEnReg, 0xA0);
+        rfid_.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);
+    }
+
+    // REQA в эфир; ответ карты поднимет IRQ, без карты чип молчит
+    void kick() {
+        uint32_t now = kickUs_;
+        sentUs_ = now;
+        if (now - checkedUs_ >= RFID_CHECK_MS * 1000UL) {
+            checkedUs_ = now;
+            version_ = rfid_.PCD_ReadRegister(MFRC522::VersionReg);
+            if (!online()) {
+                // Помеха по питанию сбрасывает регистры RC522: настраиваем заново
+                rfid_.PCD_Init();
+                enableIrq();
+                version_ = rfid_.PCD_ReadRegister(MFRC522::VersionReg);
+                resets_++;
+            }
+        }
+        rfid_.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+        rfid_.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+        rfid_.PCD_WriteRegister(MFRC522::BitFramingReg, 0x87);   // StartSend, 7 бит короткого кадра
+        kicks_++;
+    }
+
+    void readCard() {
+        irqs_++;
+        uint32_t at = sentUs_;         // Карта ответила на последний REQA
+        bool ok = rfid_.PICC_ReadCardSerial();
+        CardUid uid;
+        if (ok) {
+            uid.size = rfid_.uid.size > RFID_UID_MAX ? RFID_UID_MAX : rfid_.uid.size;
+            memcpy(uid.bytes, rfid_.uid.uidByte, uid.size);
+            rfid_.PICC_HaltA();
+        }
+        // Кадры выбора карты тоже подняли IRQ: сбрасываем и их, и флаг пробуждения
+        rfid_.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);
+        wake_.fetch_and((uint8_t)~WAKE_IRQ);
+
+        if (!ok) {
+            failed_++;
+            return;
+        }
+        if (!recent_.fresh(uid, at, RFID_REPEAT_MS * 1000UL)) {
+            repeats_++;
+            return;
+        }
+        bool queued = swipes_.tryPushWith([&](RfidSwipe& s) {
+            s.readUs = at;
+            s.uid = uid;
+        });
+        if (queued) queued_++;
+        else dropped_++;
+    }
+
+    MFRC522& rfid_;
+    TaskHandle_t task_ = nullptr;
+    esp_timer_handle_t timer_ = nullptr;
+    RecentUids<RFID_RECENT_SLOTS> recent_;   // Только в задаче считывателя
+    uint32_t sentUs_ = 0;              // micros() таймера последнего отправленного REQA
+    uint32_t checkedUs_ = 0;
+    LockFreeQueue<RfidSwipe, RFID_SWIPE_SLOTS> swipes_;
+
+    std::atomic<uint8_t> wake_{0};     // WAKE_IRQ | WAKE_KICK, ждущие задачу
+    std::atomic<bool> busy_{false};
+    std::atomic<uint32_t> kickUs_{0};
+    std::atomic<uint8_t> version_{0};
+    std::atomic<uint32_t> kicks_{0};
+    std::atomic<uint32_t> irqs_{0};
+    std::atomic<uint32_t> queued_{0};
+    std::atomic<uint32_t> repeats_{0};
+    std::atomic<uint32_t> failed_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<uint32_t> resets_{0};
+
+    static inline RfidReader* instance_ = nullptr;
+};
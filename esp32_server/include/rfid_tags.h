@@ -1,40 +1,30 @@
-// rfid_tags.h - список разрешенных RFID карт
+// rfid_tags.h - начальный список разрешенных RFID карт
+//
+// Используется только при первом запуске: если в LittleFS еще нет файла
+// RFID_CARDS_FILE, карты отсюда попадают в базу и сохраняются в файл.
+// Дальше карты добавляются и отключаются командами /add_card и /revoke_card.
 #pragma once
 
-#include <Arduino.h>
+#include <stdint.h>
 
 
 // ===== Структура для хранения информации о карте =====
 struct RFIDTag {
-    String uid;        // UID карты (например: "A1 B2 C3 D4")
-    String owner;      // Владелец карты
+    uint8_t uid[10];   // UID карты (4, 7 или 10 байт)
+    uint8_t uidSize;
+    const char* owner; // Владелец карты
     bool active;       // Активна ли карта
 };
 
 
 // ===== СПИСОК РАЗРЕШЕННЫХ КАРТ =====
 // ⚠️ ЗАМЕНИТЕ НА UID ВАШИХ КАРТ!
-RFIDTag authorizedTags[] = {
-    {"23 22 04 35", "Администратор", true},  // Ваша первая карта
-    {"83 7F 13 14", "Охранник", true},       // Ваш брелок
-    {"12 34 56 78", "Гость", false}          // Отключенная карта
+const RFIDTag authorizedTags[] = {
+    {{0x23, 0x22, 0x04, 0x35}, 4, "Администратор", true},  // Ваша первая карта
+    {{0x83, 0x7F, 0x13, 0x14}, 4, "Охранник", true},       // Ваш брелок
+    {{0x12, 0x34, 0x56, 0x78}, 4, "Гость", false}          // Отключенная карта
 };
 
 
 // ===== Количество карт в списке =====
 const int tagCount = sizeof(authorizedTags) / sizeof(authorizedTags[0]);
-
-
-// ===== Функция проверки карты =====
-String checkRFIDTag(String uid) {
-    for (int i = 0; i < tagCount; i++) {
-        if (authorizedTags[i].uid == uid) {
-            if (authorizedTags[i].active) {
-                return authorizedTags[i].owner; // Возвращаем имя владельца
-            } else {
-                return "disabled"; // Карта отключена
-            }
-        }
-    }
-    return "unknown"; // Неизвестная карта
-}
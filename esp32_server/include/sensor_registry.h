@@ -0,0 +1,322 @@
+// sensor_registry.h - реестр датчиков: зоны, пульс и контроль молчания
+//
+// Таблица фиксированного размера, каждое поле - отдельный массив
+// (проход по одному полю не тянет в кеш остальные). Строка id хранится
+// один раз, дальше датчик - это номер строки (uint8_t), поиск по id -
+// открытая адресация в таблице вдвое больше числа датчиков.
+//
+// Срок ответа у всех датчиков одинаковый (последний сигнал + silenceMs),
+// поэтому список датчиков в порядке последнего сигнала уже упорядочен
+// по сроку. seen() переносит датчик в хвост списка, expire() снимает
+// просроченные с головы: работа пропорциональна числу просроченных.
+//
+// На флеше (SENSORS_FILE) хранятся известные датчики и их зоны:
+//   id;зона
+//   pir_sensor;Прихожая
+// После перезагрузки сервера они сразу под контролем: датчик, который
+// так и не вышел на связь, будет замечен через silenceMs.
+//
+// id длиннее SENSOR_ID_LEN и зона длиннее SENSOR_ZONE_LEN обрезаются по
+// границе символа UTF-8 один раз - до хеша и сравнения: тот же длинный id
+// находит свою запись, а не заводит новую.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <FS.h>
+#include "event_log.h"
+#include "sensor_proto.h"
+
+// ===== Настройки (можно переопределить в config.h) =====
+#ifndef SENSOR_REGISTRY_SIZE
+#define SENSOR_REGISTRY_SIZE 64        // Датчиков в таблице
+#endif
+#ifndef SENSOR_MAX_ZONES
+#define SENSOR_MAX_ZONES 8
+#endif
+#define SENSOR_CLOCK_WINDOW_MS 300000  // Окно минимума задержки (уход кварцев за окно - доли мс)
+#define SENSOR_CLOCK_JUMP_US 10000000  // Больше - часы датчика сбросились, оценка заново
+#define SENSOR_ZONE_LEN 31             // Байт UTF-8 в имени зоны
+#define SENSOR_NONE 0xFF               // Нет датчика / нет зоны
+
+
+class SensorRegistry {
+public:
+    void begin(uint32_t silenceMs) {
+        silenceMs_ = silenceMs;
+        count_ = 0;
+        zoneCount_ = 0;
+        head_ = tail_ = SENSOR_NONE;
+        memset(hash_, 0, sizeof(hash_));
+    }
+
+    // Номер датчика по id, SENSOR_NONE - не зарегистрирован
+    uint8_t find(const char* id) const {
+        char key[SENSOR_ID_LEN + 1];
+        id = keyOf(id, key, sizeof(key));
+        for (size_t i = hashOf(id) % HASH_SLOTS;; i = (i + 1) % HASH_SLOTS) {
+            uint8_t v = hash_[i];
+            if (v == 0) return SENSOR_NONE;
+            if (strcmp(ids_[v - 1], id) == 0) return v - 1;
+        }
+    }
+
+    // Номер датчика, новый регистрируется (added = true). SENSOR_NONE - таблица полна
+    uint8_t intern(const char* id, bool* added = nullptr) {
+        if (added) *added = false;
+        char key[SENSOR_ID_LEN + 1];
+        id = keyOf(id, key, sizeof(key));
+        size_t i = hashOf(id) % HASH_SLOTS;
+        for (; hash_[i] != 0; i = (i + 1) % HASH_SLOTS) {
+            if (strcmp(ids_[hash_[i] - 1], id) == 0) return hash_[i] - 1;
+        }
+        if (count_ == SENSOR_REGISTRY_SIZE || id[0] == '\0') return SENSOR_NONE;
+        uint8_t h = count_++;
+        memcpy(ids_[h], id, strlen(id) + 1);
+        hash_[i] = h + 1;
+        lastSeen_[h] = 0;
+        deadline_[h] = 0;
+        events_[h] = 0;
+        gaps_[h] = 0;
+        lastSeq_[h] = 0;
+        bootId_[h] = 0;
+        rssi_[h] = 0;
+        clockMin_[h] = clockPrev_[h] = clockWindowAt_[h] = 0;
+        zone_[h] = SENSOR_NONE;
+        flags_[h] = 0;
+        prev_[h] = next_[h] = SENSOR_NONE;
+        if (added) *added = true;
+        return h;
+    }
+
+    // Сигнал от датчика (событие или пульс); true - датчик молчал и вернулся
+    bool seen(uint8_t h, uint32_t now) {
+        bool back = (flags_[h] & FLAG_SILENT) != 0;
+        flags_[h] = (flags_[h] & ~FLAG_SILENT) | FLAG_HEARD;
+        lastSeen_[h] = now;
+        events_[h]++;
+        watch(h, now);
+        return back;
+    }
+
+    // Датчик известен, но еще не отозвался (загружен с флеша)
+    void expect(uint8_t h, uint32_t now) { watch(h, now); }
+
+    // Номер кадра UDP: пропуски в нумерации - потерянные кадры
+    void trackSeq(uint8_t h, uint16_t bootId, uint32_t seq) {
+        if (bootId != bootId_[h]) {
+            bootId_[h] = bootId;       // Датчик перезагрузился (или впервые с запуска сервера)
+            lastSeq_[h] = seq;
+            flags_[h] &= ~FLAG_CLOCK;  // Часы датчика начались заново
+            return;
+        }
+        if (seq > lastSeq_[h]) {
+            gaps_[h] += seq - lastSeq_[h] - 1;
+            lastSeq_[h] = seq;
+        } else if (gaps_[h] > 0) {
+            gaps_[h]--;                // Опоздавший кадр закрыл пропуск
+        }
+    }
+
+    void setRssi(uint8_t h, int8_t rssi) { rssi_[h] = rssi; }
+
+    // Возраст события при приеме, мкс: (прием - событие) за вычетом сдвига
+    // часов датчика. Сдвиг - минимум (прием - событие) за два последних окна
+    // SENSOR_CLOCK_WINDOW_MS: самый быстрый кадр считается дошедшим сразу,
+    // поэтому возраст не включает минимальную задержку сети (доли мс в WiFi).
+    uint32_t eventAgeUs(uint8_t h, uint32_t eventUs, uint32_t recvUs, uint32_t nowMs) {
+        uint32_t delta = recvUs - eventUs;
+        if (!(flags_[h] & FLAG_CLOCK)) {
+            flags_[h] |= FLAG_CLOCK;
+            clockMin_[h] = clockPrev_[h] = delta;
+            clockWindowAt_[h] = nowMs;
+            return 0;
+        }
+        if (nowMs - clockWindowAt_[h] > SENSOR_CLOCK_WINDOW_MS) {
+            clockPrev_[h] = clockMin_[h];
+            clockMin_[h] = delta;
+            clockWindowAt_[h] = nowMs;
+        } else if ((int32_t)(delta - clockMin_[h]) < 0) {
+            clockMin_[h] = delta;
+        }
+        uint32_t base = (int32_t)(clockPrev_[h] - clockMin_[h]) < 0 ? clockPrev_[h] : clockMin_[h];
+        uint32_t age = delta - base;
+        if (age > SENSOR_CLOCK_JUMP_US) {
+            clockMin_[h] = clockPrev_[h] = delta;
+            return 0;
+        }
+        return age;
+    }
+
+    // Зона по имени; false - зон больше SENSOR_MAX_ZONES
+    bool setZone(uint8_t h, const char* name) {
+        char key[SENSOR_ZONE_LEN + 1];
+        name = keyOf(name, key, sizeof(key));
+        uint8_t z = SENSOR_NONE;
+        for (uint8_t i = 0; i < zoneCount_; i++) {
+            if (strcmp(zones_[i], name) == 0) z = i;
+        }
+        // Зона, из которой ушли все датчики, освобождается
+        if (z == SENSOR_NONE && zoneCount_ == SENSOR_MAX_ZONES) {
+            for (uint8_t i = 0; i < zoneCount_ && z == SENSOR_NONE; i++) {
+                bool used = false;
+                for (uint8_t j = 0; j < count_; j++) used |= j != h && zone_[j] == i;
+                if (!used) z = i;
+            }
+            if (z == SENSOR_NONE) return false;
+            memcpy(zones_[z], name, strlen(name) + 1);
+        } else if (z == SENSOR_NONE) {
+            z = zoneCount_++;
+            memcpy(zones_[z], name, strlen(name) + 1);
+        }
+        zone_[h] = z;
+        return true;
+    }
+
+    // Снимает с контроля датчики без сигнала дольше silenceMs: fn(номер)
+    template <typename F>
+    size_t expire(uint32_t now, F fn) {
+        size_t n = 0;
+        while (head_ != SENSOR_NONE && (int32_t)(deadline_[head_] - now) <= 0) {
+            uint8_t h = head_;
+            unlink(h);
+            flags_[h] |= FLAG_SILENT;
+            n++;
+            fn(h);
+        }
+        return n;
+    }
+
+    template <typename F>
+    void forEach(F fn) const {
+        for (uint8_t h = 0; h < count_; h++) fn(h);
+    }
+
+    const char* id(uint8_t h) const { return ids_[h]; }
+    const char* zoneName(uint8_t h) const { return zone_[h] == SENSOR_NONE ? "" : zones_[zone_[h]]; }
+    uint32_t lastSeen(uint8_t h) const { return lastSeen_[h]; }
+    uint32_t events(uint8_t h) const { return events_[h]; }
+    uint32_t gaps(uint8_t h) const { return gaps_[h]; }
+    int8_t rssi(uint8_t h) const { return rssi_[h]; }
+    bool heard(uint8_t h) const { return flags_[h] & FLAG_HEARD; }
+    bool silent(uint8_t h) const { return flags_[h] & FLAG_SILENT; }
+    size_t count() const { return count_; }
+    size_t silentCount() const {
+        size_t n = 0;
+        for (uint8_t h = 0; h < count_; h++) n += (flags_[h] & FLAG_SILENT) != 0;
+        return n;
+    }
+    static constexpr size_t memoryBytes() { return sizeof(SensorRegistry); }
+
+private:
+    static constexpr size_t HASH_SLOTS = SENSOR_REGISTRY_SIZE * 2;
+    static constexpr uint8_t FLAG_HEARD = 0x01;    // Был сигнал с запуска сервера
+    static constexpr uint8_t FLAG_SILENT = 0x02;   // Срок вышел, ждем возвращения
+    static constexpr uint8_t FLAG_CLOCK = 0x04;    // Есть оценка сдвига часов
+
+    // Строка, которая поместится в буфер размера size: короткая - как есть,
+    // длинная - копия в buf, обрезанная по символу
+    static const char* keyOf(const char* s, char* buf, size_t size) {
+        if (strnlen(s, size) < size) return s;
+        copyUtf8(buf, size, s);
+        return buf;
+    }
+
+    static uint32_t hashOf(const char* s) {
+        uint32_t h = 2166136261u;      // FNV-1a
+        while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+        return h;
+    }
+
+    // Новый срок и перенос в хвост списка
+    void watch(uint8_t h, uint32_t now) {
+        if (prev_[h] != SENSOR_NONE || head_ == h) unlink(h);
+        deadline_[h] = now + silenceMs_;
+        prev_[h] = tail_;
+        next_[h] = SENSOR_NONE;
+        if (tail_ != SENSOR_NONE) next_[tail_] = h;
+        else head_ = h;
+        tail_ = h;
+    }
+
+    void unlink(uint8_t h) {
+        if (prev_[h] != SENSOR_NONE) next_[prev_[h]] = next_[h];
+        else head_ = next_[h];
+        if (next_[h] != SENSOR_NONE) prev_[next_[h]] = prev_[h];
+        else tail_ = prev_[h];
+        prev_[h] = next_[h] = SENSOR_NONE;
+    }
+
+    static_assert(SENSOR_REGISTRY_SIZE < SENSOR_NONE, "Sensor handle must fit in uint8_t");
+
+    // Горячие поля: срок и список проверяются на каждом проходе loop()
+    uint32_t deadline_[SENSOR_REGISTRY_SIZE];
+    uint8_t prev_[SENSOR_REGISTRY_SIZE];
+    uint8_t next_[SENSOR_REGISTRY_SIZE];
+    uint8_t flags_[SENSOR_REGISTRY_SIZE];
+    uint8_t head_ = SENSOR_NONE;
+    uint8_t tail_ = SENSOR_NONE;
+    uint8_t count_ = 0;
+    uint8_t zoneCount_ = 0;
+    uint32_t silenceMs_ = 0;
+
+    // Обновляются при событии
+    uint32_t lastSeen_[SENSOR_REGISTRY_SIZE];
+    uint32_t events_[SENSOR_REGISTRY_SIZE];
+    uint32_t gaps_[SENSOR_REGISTRY_SIZE];
+    uint32_t lastSeq_[SENSOR_REGISTRY_SIZE];
+    uint16_t bootId_[SENSOR_REGISTRY_SIZE];
+    int8_t rssi_[SENSOR_REGISTRY_SIZE];        // дБм, 0 - неизвестно
+    uint32_t clockMin_[SENSOR_REGISTRY_SIZE];  // Минимум (прием - событие) в текущем окне
+    uint32_t clockPrev_[SENSOR_REGISTRY_SIZE]; // ... и в прошлом
+    uint32_t clockWindowAt_[SENSOR_REGISTRY_SIZE];
+    uint8_t zone_[SENSOR_REGISTRY_SIZE];
+
+    // Холодные: id и имена зон нужны только для сообщений
+    uint8_t hash_[HASH_SLOTS];                 // Номер датчика + 1, 0 - пусто
+    char ids_[SENSOR_REGISTRY_SIZE][SENSOR_ID_LEN + 1];
+    char zones_[SENSOR_MAX_ZONES][SENSOR_ZONE_LEN + 1];
+};
+
+
+// ===== Хранение в LittleFS =====
+
+// Перезапись файла (через временный файл); датчиков немного, файл маленький
+inline bool saveSensors(fs::FS& fs, const char* path, const SensorRegistry& reg) {
+    char tmp[48];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fs::File f = fs.open(tmp, "w");
+    if (!f) return false;
+    f.print("# id;zone\n");
+    bool ok = true;
+    reg.forEach([&](uint8_t h) { ok = f.printf("%s;%s\n", reg.id(h), reg.zoneName(h)) > 0 && ok; });
+    f.close();
+    if (!ok) return false;
+    fs.remove(path);
+    return fs.rename(tmp, path);
+}
+
+// Загрузка известных датчиков, они сразу ставятся на контроль; -1 - файла нет
+inline int loadSensors(fs::FS& fs, const char* path, SensorRegistry& reg, uint32_t now) {
+    fs::File f = fs.open(path, "r");
+    if (!f) return -1;
+    char line[64];
+    int loaded = 0;
+    while (f.available()) {
+        size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[n] = '\0';
+        if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+        if (n == 0 || line[0] == '#') continue;
+
+        char* zone = strchr(line, ';');
+        if (zone) *zone++ = '\0';
+        uint8_t h = reg.intern(line);
+        if (h == SENSOR_NONE) continue;
+        if (zone && *zone) reg.setZone(h, zone);
+        reg.expect(h, now);
+        loaded++;
+    }
+    f.close();
+    return loaded;
+}
@@ -0,0 +1,69 @@
+// state_push.h - изменения состояния для подписчиков GET /stream
+//
+// Панели наблюдения опрашивали GET /status раз в секунду и все равно
+// узнавали о тревоге с задержкой. Теперь они подписываются на поток
+// Server-Sent Events: охрана и тревога, движение, карты у считывателя,
+// датчики на связи и без связи приходят сразу.
+//
+// loop() кладет в очередь только факты (StatePush, без String и JSON) и
+// только если кто-то подписан; полная очередь - изменение теряется, loop()
+// не ждет. JSON собирает сетевая задача и рассылает HttpFront::publish().
+// Каждое событие несет полное состояние, поэтому подписчику, который не
+// успевает читать, хватает последнего - остальные HttpFront отбрасывает.
+#pragma once
+
+#include <Arduino.h>
+#include "alarm_machine.h"
+#include "event_log.h"
+
+
+enum class PushKind : uint8_t {
+    State,      // Охрана или тревога: subject - кто, detail - откуда (eventSourceName)
+    Motion,     // subject - датчик, detail - значение
+    Card,       // subject - UID, detail - active, unknown или disabled
+    Sensor      // subject - датчик, detail - online или silent
+};
+
+constexpr const char* PUSH_EVENTS[] = {"state", "motion", "card", "sensor"};
+static_assert(sizeof(PUSH_EVENTS) / sizeof(PUSH_EVENTS[0]) == (size_t)PushKind::Sensor + 1,
+              "PUSH_EVENTS must cover PushKind");
+
+struct StatePush {
+    PushKind kind;
+    AlarmState state;
+    uint8_t sensors;                   // В реестре
+    uint8_t silent;                    // Из них без связи
+    uint32_t uptimeS;
+    char subject[ALARM_WHO_LEN];
+    char detail[24];
+};
+
+// Строка в JSON без экранирования: кавычки, '\' и управляющие символы - '_'
+inline void copyJsonSafe(char* dst, size_t size, const char* src) {
+    copyUtf8(dst, size, src);
+    for (char* c = dst; *c; c++) {
+        if (*c == '"' || *c == '\\' || (uint8_t)*c < 0x20) *c = '_';
+    }
+}
+
+// Факты -> StatePush (loop())
+inline void fillStatePush(StatePush& p, PushKind kind, AlarmState state, uint8_t sensors, uint8_t silent,
+                          const char* subject, const char* detail) {
+    p.kind = kind;
+    p.state = state;
+    p.sensors = sensors;
+    p.silent = silent;
+    p.uptimeS = millis() / 1000;
+    copyJsonSafe(p.subject, sizeof(p.subject), subject);
+    copyJsonSafe(p.detail, sizeof(p.detail), detail);
+}
+
+// Данные события (строка data: в SSE); возвращает длину как snprintf
+inline int formatStatePush(const StatePush& p, char* out, size_t size) {
+    return snprintf(out, size,
+                    "{\"state\":\"%s\",\"armed\":%s,\"alarm\":%s,\"sensors\":%u,\"silent\":%u,\"uptime\":%lu,"
+                    "\"subject\":\"%s\",\"detail\":\"%s\"}",
+                    alarmStateName(p.state), p.state != AlarmState::Disarmed ? "true" : "false",
+                    p.state == AlarmState::Alarm ? "true" : "false", (unsigned)p.sensors, (unsigned)p.silent,
+                    (unsigned long)p.uptimeS, p.subject, p.detail);
+}
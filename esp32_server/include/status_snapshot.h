@@ -0,0 +1,117 @@
+// status_snapshot.h - готовый ответ GET /status с версией для условного GET
+//
+// Панели и датчики спрашивают состояние намного чаще, чем оно меняется.
+// Поэтому JSON собирает loop() - только при смене охраны, числа датчиков или
+// датчиков без связи и не чаще раза в секунду ради uptime. Сетевая задача
+// копирует готовый ответ и ничего не форматирует.
+//
+// Буферов два: loop() пишет в тот, что сейчас не отдается, и атомарно
+// публикует его номер (gen_). Читатель повторяет копирование, только если за
+// это время loop() успел начать запись в его буфер (writing_), то есть дважды.
+//
+// ETag слабый (W/"загрузка-версия"): версия растет только при смене состояния,
+// uptime в теле при этом идет, но ответ с тем же ETag значит то же самое.
+// Клиент с If-None-Match получает 304 без тела.
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "alarm_machine.h"
+
+
+#define STATUS_JSON_MAX 112
+#define STATUS_ETAG_MAX 24
+
+
+// Копия опубликованного ответа
+struct StatusView {
+    AlarmState state;
+    uint16_t len;
+    char etag[STATUS_ETAG_MAX];        // С кавычками и W/
+    char json[STATUS_JSON_MAX];
+};
+
+
+class StatusSnapshot {
+public:
+    // Метка загрузки в ETag: версия после перезагрузки начинается заново
+    void begin(uint16_t bootTag) { bootTag_ = bootTag; }
+
+    // Из loop() (и setup() до первого запроса); true - ответ пересобран
+    bool update(AlarmState state, uint8_t sensors, uint8_t silent, uint32_t nowMs) {
+        uint32_t uptimeS = nowMs / 1000;
+        bool changed = version_ == 0 || state != state_ || sensors != sensors_ || silent != silent_;
+        if (!changed && uptimeS == uptimeS_) return false;
+        if (changed) version_++;
+        state_ = state;
+        sensors_ = sensors;
+        silent_ = silent;
+        uptimeS_ = uptimeS;
+
+        uint32_t gen = gen_.load(std::memory_order_relaxed) + 1;
+        writing_.store(gen, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        StatusView& s = slots_[gen & 1];
+        s.state = state;
+        snprintf(s.etag, sizeof(s.etag), "W/\"%04x-%lu\"", (unsigned)bootTag_, (unsigned long)version_);
+        int n = snprintf(s.json, sizeof(s.json), "{\"armed\":%s,\"uptime\":%lu,\"sensors\":%u,\"silent\":%u}",
+                         state != AlarmState::Disarmed ? "true" : "false", (unsigned long)uptimeS,
+                         (unsigned)sensors, (unsigned)silent);
+        s.len = n < (int)sizeof(s.json) ? n : sizeof(s.json) - 1;
+        gen_.store(gen, std::memory_order_release);
+        published_.store(state, std::memory_order_relaxed);
+        builds_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Любая задача: последний опубликованный ответ
+    void read(StatusView& out) const {
+        for (;;) {
+            uint32_t gen = gen_.load(std::memory_order_acquire);
+            const StatusView& s = slots_[gen & 1];
+            out.state = s.state;
+            out.len = s.len < sizeof(out.json) ? s.len : sizeof(out.json) - 1;
+            memcpy(out.etag, s.etag, sizeof(out.etag));
+            memcpy(out.json, s.json, out.len);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (writing_.load(std::memory_order_relaxed) - gen < 2) break;
+        }
+        out.etag[sizeof(out.etag) - 1] = '\0';
+        out.json[out.len] = '\0';
+    }
+
+    // If-None-Match (список или *) совпадает с etag - ответ 304. Сравнение
+    // слабое, как велит RFC 9110: W/ у клиента не важен.
+    static bool notModified(const char* ifNoneMatch, const char* etag) {
+        if (!ifNoneMatch || !*ifNoneMatch) return false;
+        if (strcmp(ifNoneMatch, "*") == 0) return true;
+        const char* opaque = strncmp(etag, "W/", 2) == 0 ? etag + 2 : etag;
+        return strstr(ifNoneMatch, opaque) != nullptr;
+    }
+
+    // Ответ датчику на событие: от состояния зависит только охрана и тревога
+    const char* sensorReply() const {
+        switch (published_.load(std::memory_order_relaxed)) {
+            case AlarmState::Alarm: return "{\"status\":\"ok\",\"armed\":true,\"alarm\":true}";
+            case AlarmState::Armed: return "{\"status\":\"ok\",\"armed\":true,\"alarm\":false}";
+            default: return "{\"status\":\"ok\",\"armed\":false,\"alarm\":false}";
+        }
+    }
+
+    uint32_t builds() const { return builds_.load(std::memory_order_relaxed); }
+
+private:
+    StatusView slots_[2] = {};
+    std::atomic<uint32_t> gen_{0};     // Номер последней записи, буфер - gen & 1
+    std::atomic<uint32_t> writing_{0}; // Номер записи, которая идет или прошла
+    std::atomic<uint32_t> builds_{0};
+    std::atomic<AlarmState> published_{AlarmState::Disarmed};
+
+    // Только loop()
+    uint16_t bootTag_ = 0;
+    uint32_t version_ = 0;
+    AlarmState state_ = AlarmState::Disarmed;
+    uint8_t sensors_ = 0;
+    uint8_t silent_ = 0;
+    uint32_t uptimeS_ = 0;
+};
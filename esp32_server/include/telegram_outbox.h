@@ -0,0 +1,367 @@
+// telegram_outbox.h - асинхронная работа с Telegram в отдельной задаче
+//
+// Все обращения к FastBot (sendMessage и опрос tick) выполняет одна задача
+// на сетевом ядре. Основной цикл только кладет сообщения в очередь и
+// забирает пришедшие команды - HTTPS запросы его больше не тормозят.
+// Когда опрашивать бота и сколько команд брать, решает PollScheduler
+// (telegram_poll.h) по режиму охраны, который ставит loop(). Отправка в
+// каждый чат ограничена ведром жетонов (ChatRateLimit): Telegram режет
+// больше 20 сообщений в минуту в группу и больше одного в секунду в чат.
+// Тревога идет своей очередью (sendUrgentf): она уходит раньше обычных
+// сообщений, не ждет жетона и не теряется, когда обычная очередь полна.
+#pragma once
+
+#include <Arduino.h>
+#include <FastBot.h>
+#include <stdarg.h>
+#include "event_log.h"
+#include "lockfree_queue.h"
+#include "metrics.h"
+#include "telegram_poll.h"
+
+
+// ===== Настройки =====
+#define OUTBOX_SLOTS 8                 // Сообщений в очереди на отправку
+#define OUTBOX_URGENT_SLOTS 2          // Сообщений о тревоге: тревога и ее таймаут
+#define OUTBOX_MSG_LEN 2048            // Максимальная длина сообщения в байтах
+#define OUTBOX_MAX_ATTEMPTS 5          // Попыток отправки до отказа
+#define OUTBOX_BACKOFF_BASE 500        // Первая пауза перед повтором, мс
+#define OUTBOX_BACKOFF_MAX 30000       // Максимальная пауза, мс
+#define INBOX_SLOTS 8                  // Входящих команд в очереди
+#define INBOX_TEXT_LEN 128
+#define TELEGRAM_RATE_BURST 5          // Сообщений в чат подряд без паузы
+#define TELEGRAM_RATE_INTERVAL_MS 3000 // Дальше одно в 3 с (20 в минуту)
+#define TELEGRAM_RATE_CHATS 4          // Чатов с отдельным ведром
+#define TELEGRAM_TASK_CORE 0           // Ядро сети (loop() работает на ядре 1)
+#define TELEGRAM_TASK_STACK 8192
+#define TELEGRAM_TASK_PRIORITY 1
+
+
+// Ведро жетонов на чат в виде GCRA: одно число на чат - время, когда ведро
+// снова полное без учета запаса. Только для задачи Telegram.
+class ChatRateLimit {
+public:
+    // 0 - отправлять можно (жетон взят), иначе сколько мс ждать жетона
+    uint32_t take(const char* chatId, uint32_t now) {
+        Slot& s = slot(chatId, now);
+        const uint32_t burst = (TELEGRAM_RATE_BURST - 1) * TELEGRAM_RATE_INTERVAL_MS;
+        int32_t early = (int32_t)(s.tat - now) - (int32_t)burst;
+        if (early > 0) return (uint32_t)early;
+        charge(s, now);
+        return 0;
+    }
+
+    // Жетон без ожидания (тревога): следующие сообщения чата учтут и его
+    void force(const char* chatId, uint32_t now) { charge(slot(chatId, now), now); }
+
+private:
+    struct Slot {
+        char chatId[24];
+        uint32_t tat;                  // Теоретическое время прихода следующего сообщения
+    };
+
+    static void charge(Slot& s, uint32_t now) {
+        s.tat = ((int32_t)(s.tat - now) > 0 ? s.tat : now) + TELEGRAM_RATE_INTERVAL_MS;
+    }
+
+    // Чат по id; новый занимает ячейку с самым свободным ведром
+    Slot& slot(const char* chatId, uint32_t now) {
+        Slot* victim = &slots_[0];
+        for (Slot& s : slots_) {
+            if (strcmp(s.chatId, chatId) == 0) return s;
+            if ((int32_t)(s.tat - victim->tat) < 0) victim = &s;
+        }
+        copyUtf8(victim->chatId, sizeof(victim->chatId), chatId);
+        victim->tat = now;
+        return *victim;
+    }
+
+    Slot slots_[TELEGRAM_RATE_CHATS] = {};
+};
+
+
+struct OutboxMessage {
+    uint32_t enqueuedAt;               // millis() постановки в очередь
+    char chatId[24];                   // Пусто - чат по умолчанию
+    char text[OUTBOX_MSG_LEN];
+};
+
+struct TelegramCommand {
+    char chatId[24];
+    char text[INBOX_TEXT_LEN];
+};
+
+struct OutboxStats {
+    uint32_t polls;                    // Опросов getUpdates
+    uint32_t pollIntervalMs;           // Текущая пауза между опросами
+    uint32_t enqueued;
+    uint32_t sent;
+    uint32_t dropped;                  // Очередь была полна
+    uint32_t failed;                   // Исчерпаны попытки
+    uint32_t retries;
+    uint32_t throttled;                // Сообщений, ждавших жетона своего чата
+    uint32_t lastDeliveryMs;           // Время от постановки до доставки
+    uint32_t maxDeliveryMs;
+};
+
+
+class TelegramOutbox {
+public:
+    explicit TelegramOutbox(FastBot& bot) : bot_(bot) {}
+
+    // Запуск задачи; после этого FastBot трогать из других задач нельзя.
+    // defaultChat - чат сообщений без chatId (тот же, что bot.setChatID):
+    // у него с ответами на команды одно ведро.
+    void begin(const char* defaultChat = "") {
+        copyUtf8(defaultChat_, sizeof(defaultChat_), defaultChat);
+        instance_ = this;
+        bot_.attach(onUpdate);
+        xTaskCreatePinnedToCore(taskEntry, "telegram", TELEGRAM_TASK_STACK, this,
+                                TELEGRAM_TASK_PRIORITY, &task_, TELEGRAM_TASK_CORE);
+    }
+
+    // Поставить сообщение в очередь (не блокирует). false - очередь полна.
+    bool send(const char* text, const char* chatId = "") {
+        uint32_t now = millis();
+        bool ok = outbox_.tryPushWith([&](OutboxMessage& m) {
+            m.enqueuedAt = now;
+            copyUtf8(m.chatId, sizeof(m.chatId), chatId);
+            copyUtf8(m.text, sizeof(m.text), text);
+        });
+        if (ok) enqueued_++;
+        else dropped_++;
+        return ok;
+    }
+
+    bool send(const String& text, const String& chatId = "") {
+        return send(text.c_str(), chatId.c_str());
+    }
+
+    bool send(const char* text, const String& chatId) {
+        return send(text, chatId.c_str());
+    }
+
+    // Сообщение по шаблону printf (messages.h) собирается сразу в ячейке
+    // очереди: ни буфера на стеке, ни String
+    bool sendf(const char* chatId, const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        bool ok = pushf(outbox_, chatId, fmt, args);
+        va_end(args);
+        return ok;
+    }
+
+    // Сообщение о тревоге: своя очередь, уходит первым и без лимита чата
+    bool sendUrgentf(const char* chatId, const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        bool ok = pushf(urgent_, chatId, fmt, args);
+        va_end(args);
+        return ok;
+    }
+
+    // Забрать следующую пришедшую команду (вызывается из loop())
+    bool popCommand(FB_msg& msg) {
+        TelegramCommand cmd;
+        if (!inbox_.tryPop(cmd)) return false;
+        msg = FB_msg();
+        msg.chatID = cmd.chatId;
+        msg.text = cmd.text;
+        return true;
+    }
+
+    OutboxStats stats() const {
+        OutboxStats s;
+        s.polls = polls_;
+        s.pollIntervalMs = pollIntervalMs_;
+        s.enqueued = enqueued_;
+        s.sent = sent_;
+        s.dropped = dropped_;
+        s.failed = failed_;
+        s.retries = retries_;
+        s.throttled = throttled_;
+        s.lastDeliveryMs = lastDeliveryMs_;
+        s.maxDeliveryMs = maxDeliveryMs_;
+        return s;
+    }
+
+    // Режим опроса по состоянию охраны (из loop())
+    void setPollMode(PollMode mode) { poll_.setMode(mode); }
+    // Постоянная пауза опроса вместо расписания, 0 - по расписанию
+    void setPollFixed(uint32_t periodMs) { poll_.setFixed(periodMs); }
+
+    size_t pending() const {
+        return outbox_.size() + urgent_.size() + (normal_.has ? 1 : 0) + (alarm_.has ? 1 : 0);
+    }
+    TaskHandle_t task() const { return task_; }
+    // Первое сообщение ждет паузы (лимит чата или повтор), остальные - за ним
+    bool held() const {
+        uint32_t until = heldUntil_;
+        return until != 0 && (int32_t)(millis() - until) < 0;
+    }
+    const LatencyHistogram& sendTime() const { return sendTime_; }
+    const LatencyHistogram& pollTime() const { return pollTime_; }
+
+private:
+    // Сообщение, которое задача Telegram отправляет: держится, пока не уйдет
+    // или не кончатся попытки. Жетон чата берется один раз на сообщение.
+    struct Lane {
+        OutboxMessage msg;
+        std::atomic<bool> has{false};
+        uint8_t attempts = 0;
+        bool charged = false;
+        uint32_t nextAttemptAt = 0;
+    };
+
+    template <size_t N>
+    bool pushf(LockFreeQueue<OutboxMessage, N>& queue, const char* chatId, const char* fmt, va_list args) {
+        uint32_t now = millis();
+        bool ok = queue.tryPushWith([&](OutboxMessage& m) {
+            m.enqueuedAt = now;
+            copyUtf8(m.chatId, sizeof(m.chatId), chatId);
+            va_list copy;
+            va_copy(copy, args);
+            vformatUtf8(m.text, sizeof(m.text), fmt, copy);
+            va_end(copy);
+        });
+        if (ok) enqueued_++;
+        else dropped_++;
+        return ok;
+    }
+
+    static void taskEntry(void* arg) {
+        static_cast<TelegramOutbox*>(arg)->run();
+    }
+
+    // Вызывается FastBot внутри tick(), то есть в задаче Telegram
+    static void onUpdate(FB_msg& msg) {
+        instance_->received_++;
+        instance_->inbox_.tryPushWith([&](TelegramCommand& c) {
+            copyUtf8(c.chatId, sizeof(c.chatId), msg.chatID.c_str());
+            copyUtf8(c.text, sizeof(c.text), msg.text.c_str());
+        });
+    }
+
+    void run() {
+        for (;;) {
+            bool sentSomething = trySendCurrent();
+            pollUpdates();
+            if (!sentSomething) vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+
+    // Опрос getUpdates, когда велит расписание. Пачка не больше свободного
+    // места во входящей очереди: лишние команды FastBot уже не вернет.
+    void pollUpdates() {
+        uint32_t now = millis();
+        if (!poll_.due(now)) return;
+        size_t room = INBOX_SLOTS - inbox_.size();
+        uint16_t limit = poll_.limit(now);
+        if (limit > room) limit = room;
+        if (limit == 0) return;
+
+        bot_.setLimit(limit);
+        received_ = 0;
+        uint32_t t0 = cycleNow();
+        uint8_t status = bot_.tickManual();
+        pollTime_.recordCycles(t0);
+        now = millis();
+        poll_.polled(now, status == 1, received_, limit);
+        polls_++;
+        pollIntervalMs_ = poll_.interval(now);
+    }
+
+    // Одна попытка отправки. Пока есть тревога, обычное сообщение ждет, даже
+    // если уже взято из очереди.
+    bool trySendCurrent() {
+        if (alarm_.has || take(urgent_, alarm_)) return attempt(alarm_, false);
+        if (normal_.has || take(outbox_, normal_)) return attempt(normal_, true);
+        return false;
+    }
+
+    template <size_t N>
+    bool take(LockFreeQueue<OutboxMessage, N>& queue, Lane& lane) {
+        if (!queue.tryPop(lane.msg)) return false;
+        lane.attempts = 0;
+        lane.charged = false;
+        lane.nextAttemptAt = millis();
+        lane.has = true;
+        return true;
+    }
+
+    // limited - ждать жетона чата; тревога берет его без ожидания
+    bool attempt(Lane& lane, bool limited) {
+        if ((int32_t)(millis() - lane.nextAttemptAt) < 0) return false;
+        const char* chat = lane.msg.chatId[0] ? lane.msg.chatId : defaultChat_;
+        if (!lane.charged) {
+            uint32_t wait = 0;
+            if (limited) wait = rate_.take(chat, millis());
+            else rate_.force(chat, millis());
+            if (wait) {
+                lane.nextAttemptAt = millis() + wait;
+                heldUntil_ = lane.nextAttemptAt;
+                throttled_++;
+                return false;
+            }
+            lane.charged = true;
+        }
+        heldUntil_ = 0;
+
+        uint32_t t0 = cycleNow();
+        uint8_t status = bot_.sendMessage(lane.msg.text, lane.msg.chatId);
+        sendTime_.recordCycles(t0);
+        lane.attempts++;
+        if (status == 1) {
+            uint32_t delivery = millis() - lane.msg.enqueuedAt;
+            lastDeliveryMs_ = delivery;
+            if (delivery > maxDeliveryMs_) maxDeliveryMs_ = delivery;
+            sent_++;
+            lane.has = false;
+            return true;
+        }
+
+        if (lane.attempts >= OUTBOX_MAX_ATTEMPTS) {
+            failed_++;
+            lane.has = false;
+            return false;
+        }
+        // Экспоненциальная пауза: 0.5, 1, 2, 4... с, но не больше OUTBOX_BACKOFF_MAX
+        uint32_t backoff = OUTBOX_BACKOFF_BASE << (lane.attempts - 1);
+        if (backoff > OUTBOX_BACKOFF_MAX) backoff = OUTBOX_BACKOFF_MAX;
+        lane.nextAttemptAt = millis() + backoff;
+        heldUntil_ = lane.nextAttemptAt;
+        retries_++;
+        return false;
+    }
+
+    FastBot& bot_;
+    LockFreeQueue<OutboxMessage, OUTBOX_SLOTS> outbox_;
+    LockFreeQueue<OutboxMessage, OUTBOX_URGENT_SLOTS> urgent_;
+    LockFreeQueue<TelegramCommand, INBOX_SLOTS> inbox_;
+
+    // Состояние задачи Telegram
+    TaskHandle_t task_ = nullptr;
+    Lane normal_;
+    Lane alarm_;
+    PollScheduler poll_;
+    ChatRateLimit rate_;
+    char defaultChat_[24] = "";
+    uint16_t received_ = 0;            // Команд за текущий опрос
+
+    // Статистика (атомарные: счетчики пишут разные задачи)
+    std::atomic<uint32_t> enqueued_{0};
+    std::atomic<uint32_t> sent_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<uint32_t> failed_{0};
+    std::atomic<uint32_t> retries_{0};
+    std::atomic<uint32_t> throttled_{0};
+    std::atomic<uint32_t> heldUntil_{0};    // millis() конца паузы первого сообщения, 0 - не ждет
+    std::atomic<uint32_t> lastDeliveryMs_{0};
+    std::atomic<uint32_t> maxDeliveryMs_{0};
+    std::atomic<uint32_t> polls_{0};
+    std::atomic<uint32_t> pollIntervalMs_{0};
+    LatencyHistogram sendTime_;        // Один вызов sendMessage (HTTPS запрос)
+    LatencyHistogram pollTime_;        // Один опрос getUpdates
+
+    static inline TelegramOutbox* instance_ = nullptr;
+};
@@ -0,0 +1,123 @@
+// telegram_poll.h - расписание опроса Telegram (getUpdates) по состоянию охраны
+//
+// Каждый опрос - HTTPS запрос: сотни мс радио и процессора. Раньше бот
+// опрашивался раз в 3.6 с всегда. Теперь пауза зависит от режима: снята с
+// охраны и команд нет - редко; на охране - чаще; в обоих режимах чем
+// дольше тишина, тем реже. Тревога или недавняя команда (идет переписка) -
+// часто, чтобы /disarm во время тревоги доходил за доли секунды. Пришла
+// полная пачка - следующий опрос сразу, без паузы. Ошибка опроса - пауза
+// растет вдвое.
+//
+// Планировщиком пользуется только задача Telegram; режим пишет loop().
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+
+// ===== Настройки =====
+#define POLL_ALARM_MS 500              // Пауза во время тревоги
+#define POLL_ACTIVE_MS 1000            // Последняя команда не раньше POLL_ACTIVE_WINDOW_MS
+#define POLL_ACTIVE_WINDOW_MS 60000
+#define POLL_ARMED_MS 3000             // На охране
+#define POLL_ARMED_MAX_MS 8000
+#define POLL_IDLE_MS 4000              // Снята с охраны, команд нет
+#define POLL_IDLE_MAX_MS 30000
+#define POLL_QUIET_STEP_MS 300000      // Каждые 5 минут без команд и смен режима пауза растет вдвое
+#define POLL_ERROR_MAX_MS 30000        // Пауза после ошибок подряд
+#define POLL_ERROR_ALARM_MAX_MS 4000   // То же во время тревоги
+#define POLL_LIMIT_IDLE 3              // Команд за один опрос без переписки
+#define POLL_LIMIT_BUSY 8              // В тревоге, в переписке и после полной пачки
+
+
+enum class PollMode : uint8_t {
+    Idle,                              // Снята с охраны
+    Armed,
+    Alarm,
+};
+
+
+class PollScheduler {
+public:
+    // Из loop(): режим по состоянию охраны
+    void setMode(PollMode mode) { mode_.store((uint8_t)mode, std::memory_order_relaxed); }
+    PollMode mode() const { return (PollMode)mode_.load(std::memory_order_relaxed); }
+
+    // Постоянная пауза вместо расписания (0 - по расписанию)
+    void setFixed(uint32_t periodMs) { fixedMs_.store(periodMs, std::memory_order_relaxed); }
+
+    // Пора опрашивать: первый опрос, хвост очереди или прошла пауза
+    bool due(uint32_t now) const {
+        return !polled_ || backlog_ || now - lastPollAt_ >= interval(now);
+    }
+
+    // Пауза от последнего опроса, мс
+    uint32_t interval(uint32_t now) const {
+        uint32_t fixed = fixedMs_.load(std::memory_order_relaxed);
+        uint32_t base = fixed ? fixed : baseInterval(now);
+        if (errors_ == 0) return base;
+        uint32_t cap = mode() == PollMode::Alarm ? POLL_ERROR_ALARM_MAX_MS : POLL_ERROR_MAX_MS;
+        uint32_t backoff = base << (errors_ < 6 ? errors_ : 6);
+        if (backoff > cap) backoff = cap;
+        return backoff > base ? backoff : base;
+    }
+
+    // Сколько команд забирать за опрос
+    uint16_t limit(uint32_t now) const { return busy(now) ? POLL_LIMIT_BUSY : POLL_LIMIT_IDLE; }
+
+    // Итог опроса: ok - ответ получен, received команд из limit
+    void polled(uint32_t now, bool ok, uint16_t received, uint16_t limit) {
+        polled_ = true;
+        lastPollAt_ = now;
+        PollMode m = mode();
+        if (m != lastMode_) {
+            lastMode_ = m;
+            quietSince_ = now;
+        }
+        if (!ok) {
+            if (errors_ < 255) errors_++;
+            backlog_ = false;
+            return;
+        }
+        errors_ = 0;
+        backlog_ = received > 0 && received >= limit;
+        if (received > 0) {
+            lastCommandAt_ = now;
+            quietSince_ = now;
+            hadCommand_ = true;
+        }
+    }
+
+    uint8_t errors() const { return errors_; }
+
+private:
+    bool active(uint32_t now) const {
+        return hadCommand_ && now - lastCommandAt_ < POLL_ACTIVE_WINDOW_MS;
+    }
+
+    bool busy(uint32_t now) const {
+        return mode() == PollMode::Alarm || active(now) || backlog_;
+    }
+
+    uint32_t baseInterval(uint32_t now) const {
+        if (mode() == PollMode::Alarm) return POLL_ALARM_MS;
+        if (active(now)) return POLL_ACTIVE_MS;
+        uint32_t steps = (now - quietSince_) / POLL_QUIET_STEP_MS;
+        if (steps > 8) steps = 8;
+        bool armed = mode() == PollMode::Armed;
+        uint32_t pause = (armed ? POLL_ARMED_MS : POLL_IDLE_MS) << steps;
+        uint32_t cap = armed ? POLL_ARMED_MAX_MS : POLL_IDLE_MAX_MS;
+        return pause < cap ? pause : cap;
+    }
+
+    std::atomic<uint8_t> mode_{(uint8_t)PollMode::Idle};
+    std::atomic<uint32_t> fixedMs_{0};
+    bool polled_ = false;
+    bool backlog_ = false;             // Прошлый опрос забрал полную пачку
+    bool hadCommand_ = false;
+    uint8_t errors_ = 0;               // Ошибок опроса подряд
+    uint32_t lastPollAt_ = 0;
+    uint32_t lastCommandAt_ = 0;
+    uint32_t quietSince_ = 0;          // Последняя команда или смена режима
+    PollMode lastMode_ = PollMode::Idle;
+};
@@ -0,0 +1,135 @@
+// telegram_report.h - длинные ответы Telegram без String
+//
+// Текст пишется в заранее выделенный буфер размером с сообщение очереди
+// (OUTBOX_MSG_LEN байт, это и меньше лимита Telegram в 4096 символов).
+// Резать можно только по концу строки: когда очередная строка не влезает,
+// готовые строки уходят отдельным сообщением, а начатая переносится в
+// следующее - разметка *жирный* внутри строки не разрывается.
+// Сообщений в одном отчете не больше REPORT_MAX_MESSAGES, чтобы не занять
+// всю очередь; что не влезло, заменяется строкой "... и еще N строк".
+//
+//   report.begin(msg.chatID.c_str());
+//   report.add("📋 Карты:").endLine();
+//   report.addf("%d. %s", i, owner).endLine();
+//   report.finish();
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "telegram_outbox.h"
+
+
+// ===== Настройки =====
+#define REPORT_MAX_MESSAGES 4          // Сообщений на один отчет (очередь - OUTBOX_SLOTS)
+#define REPORT_TAIL_RESERVE 64         // Место под "... и еще N строк" в последнем
+
+
+class TelegramReport {
+public:
+    explicit TelegramReport(TelegramOutbox& out) : out_(out) {}
+
+    // Новый отчет в чат chatId (пусто - чат по умолчанию)
+    void begin(const char* chatId = "") {
+        copyUtf8(chatId_, sizeof(chatId_), chatId);
+        len_ = 0;
+        cut_ = 0;
+        messages_ = 0;
+        skipped_ = 0;
+        full_ = false;
+    }
+
+    TelegramReport& add(const char* s) {
+        size_t n = strlen(s);
+        while (!full_ && len_ + n > limit()) {
+            if (messages_ + 1 >= REPORT_MAX_MESSAGES) {
+                // Последнее сообщение: начатая строка не влезает, дальше только считаем строки
+                len_ = cut_;
+                full_ = true;
+                return *this;
+            }
+            if (cut_ == 0) {
+                // Строка длиннее сообщения - режем по символу UTF-8
+                size_t part = limit() - len_;
+                while (part > 0 && ((uint8_t)s[part] & 0xC0) == 0x80) part--;
+                memcpy(buf_ + len_, s, part);
+                len_ += part;
+                s += part;
+                n -= part;
+                cut_ = len_;
+            }
+            flush();
+        }
+        if (full_) return *this;
+        memcpy(buf_ + len_, s, n);
+        len_ += n;
+        return *this;
+    }
+
+    TelegramReport& add(char c) {
+        char s[2] = {c, '\0'};
+        return add(s);
+    }
+
+    TelegramReport& addf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char s[160];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(s, sizeof(s), fmt, args);
+        va_end(args);
+        return add(s);
+    }
+
+    // Конец строки - здесь сообщение можно разрезать
+    TelegramReport& endLine() {
+        if (full_) {
+            skipped_++;
+            return *this;
+        }
+        add('\n');
+        cut_ = len_;
+        return *this;
+    }
+
+    // Отправить остаток; возвращает число сообщений в отчете
+    uint8_t finish() {
+        if (full_) {
+            // Резерв под эту строку оставлен в limit()
+            len_ = cut_;
+            len_ += snprintf(buf_ + len_, sizeof(buf_) - len_, "... и еще %u строк",
+                             (unsigned)(skipped_ ? skipped_ : 1));
+        }
+        cut_ = len_;
+        if (len_ > 0) flush();
+        return messages_;
+    }
+
+    uint8_t messages() const { return messages_; }
+
+private:
+    // Последнее сообщение держит место под строку о пропущенном
+    size_t limit() const {
+        size_t size = sizeof(buf_) - 1;
+        return messages_ + 1 >= REPORT_MAX_MESSAGES ? size - REPORT_TAIL_RESERVE : size;
+    }
+
+    // Отправляет готовые строки buf_[0..cut_), начатая строка сдвигается в начало
+    void flush() {
+        char saved = buf_[cut_];
+        buf_[cut_] = '\0';
+        if (out_.send(buf_, chatId_)) messages_++;
+        else full_ = true;             // Очередь полна - остальное не отправить
+        buf_[cut_] = saved;
+        memmove(buf_, buf_ + cut_, len_ - cut_);
+        len_ -= cut_;
+        cut_ = 0;
+    }
+
+    TelegramOutbox& out_;
+    char chatId_[24];
+    char buf_[OUTBOX_MSG_LEN];
+    size_t len_ = 0;
+    size_t cut_ = 0;                   // Конец последней целой строки
+    uint8_t messages_ = 0;
+    uint16_t skipped_ = 0;             // Строк, не попавших в отчет
+    bool full_ = false;
+};
@@ -1,188 +1,299 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <FastBot.h>
-#include <vector>
+#include <esp_timer.h>
 #include <SPI.h>
 #include <MFRC522.h>
+#include <LittleFS.h>
 #include "secrets.h"
 #include "config.h"
+#include "messages.h"
 #include "rfid_tags.h"
-
-// ===== СТРУКТУРА ДЛЯ ЛОГОВ =====
-struct LogEntry {
-    unsigned long timestamp;  // Время в миллисекундах
-    String eventType;         // Тип события: motion, arm, disarm, rfid
-    String source;            // Источник: sensor1, telegram, rfid
-    String details;           // Детали: "Движение в комнате", "Карта: A1 B2 C3 D4"
-    bool isAlarm;             // Было ли это тревогой
-};
+#include "rfid_index.h"
+#include "rfid_reader.h"
+#include "event_log.h"
+#include "event_journal.h"
+#include "telegram_outbox.h"
+#include "telegram_report.h"
+#include "sensor_proto.h"
+#include "sensor_registry.h"
+#include "pattern_player.h"
+#include "http_front.h"
+#include "datagram_socket.h"
+#include "metrics.h"
+#include "alarm_machine.h"
+#include "boot_timer.h"
+#include "wifi_fast.h"
+#include "input_trace.h"
+#include "alert_digest.h"
+#include "mem_monitor.h"
+#include "state_push.h"
+#include "status_snapshot.h"
 
 // ===== Глобальные переменные =====
-WebServer server(80);
+HttpFront server(80);           // Неблокирующий HTTP, много соединений с keep-alive
 FastBot bot(BOT_TOKEN);
-bool systemArmed = false;
-bool alarmActive = false;
-String lastEvent = "";
+TelegramOutbox telegram(bot);   // Отправка и опрос Telegram в отдельной задаче
+TelegramReport report(telegram); // Длинные ответы: буфер на одно сообщение, без String
+AlarmMachine security;          // Охрана и тревога: входы из всех задач, переходы в loop()
+DatagramSocket sensorUdp;       // Бинарные события от датчиков
+SeqTracker<SENSOR_REGISTRY_SIZE> sensorSeq; // Отсев повторных UDP кадров
+SeqTracker<16> batchSeq;        // Отсев повторов в пачках /events
+SensorRegistry sensors;         // Известные датчики: зоны, пульс, RSSI
+WifiFastConnect wifiLink;       // WiFi по кэшу точки и адреса, setup() не ждет
+BootTimer boot;                 // Этапы запуска (отчет в Serial, Telegram и /metrics)
+InputTrace trace;               // Входы для воспроизведения на ПК (--bench replay)
+AlertDigest alerts;             // Движение и чужие карты за окно - одной сводкой
+MemMonitor memMonitor;          // Куча и стеки задач раз в 15 мин (GET /mem, /mem)
+TaskHandle_t netTaskHandle = nullptr;
+uint8_t bootWifi = BOOT_NO_STAGE;
+uint8_t bootAnnounce = BOOT_NO_STAGE;
+
+
+// ===== Метрики (GET /metrics) =====
+LatencyHistogram loopTime;          // Один проход loop()
+LatencyHistogram sensorEventTime;   // Обработка события датчика в loop()
+LatencyHistogram inboxWaitTime;     // Прием сетевой задачей -> начало обработки
+LatencyHistogram rfidDecisionTime;  // Чтение карты -> решение и звук
+LatencyHistogram eventAgeTime;      // Событие на датчике -> прием сервером
+LatencyHistogram motionToAlarm;     // Фронт PIR -> сирена включена
 
 
 // ===== RFID =====
 MFRC522 rfid(RFID_SS_PIN, RFID_RST_PIN);
-unsigned long lastRFIDRead = 0;
-String lastCardUID = "";
-int cardReadCount = 0;
+RfidReader rfidReader(rfid);    // Задача считывателя: SPI только когда IRQ сообщил о карте
+CardUid lastCardUID = {0, {0}};
+RfidIndex cards;            // База карт (загружается из LittleFS)
 
 
-// ===== Вспомогательная функция для времени =====
-String getTimeString() {
-    unsigned long seconds = millis() / 1000;
-    unsigned long minutes = seconds / 60;
-    seconds %= 60;
-    unsigned long hours = minutes / 60;
-    minutes %= 60;
-    String timeStr = "";
-    if (hours < 10) timeStr += "0";
-    timeStr += String(hours) + ":";
-    if (minutes < 10) timeStr += "0";
-    timeStr += String(minutes) + ":";
-    if (seconds < 10) timeStr += "0";
-    timeStr += String(seconds);
-    return timeStr;
+// ===== Логирование =====
+const int MAX_LOG_SIZE = 20; // Последние события в RAM (все остальные - в журнале)
+EventRing<MAX_LOG_SIZE> eventLog;
+EventJournal journal;           // Журнал событий в LittleFS, переживает перезагрузку
+uint64_t logTimeBase = 0;       // Время журнала на момент запуска
+
+// Время с момента запуска в мс (64 бита, в отличие от millis())
+uint64_t uptimeMs() {
+    return (uint64_t)esp_timer_get_time() / 1000ULL;
 }
 
+// Время журнала: продолжает отсчет с последней записи до перезагрузки
+uint64_t logTime() {
+    return logTimeBase + uptimeMs();
+}
 
-// ===== Логирование =====
-std::vector<LogEntry> eventLog;
-const int MAX_LOG_SIZE = 20; // Максимальное количество сохраняемых логов
+// Загрузка журнала; последние события из него сразу видны в /logs
+void initJournal() {
+    if (!journal.begin(LittleFS, JOURNAL_DIR, JOURNAL_SEGMENT_BYTES, JOURNAL_MAX_SEGMENTS)) {
+        Serial.println("❌ Журнал событий недоступен");
+        return;
+    }
+    if (journal.size() > 0) {
+        logTimeBase = journal.lastTimestamp() + 1;
+    }
+    journal.recent(MAX_LOG_SIZE, [](const LogEntry& e) {
+        eventLog.push(e.timestamp, e.type, e.source, e.details, e.isAlarm);
+    });
+    Serial.print("✅ Событий в журнале: ");
+    Serial.println((unsigned long)journal.size());
+}
 
 // Добавление в логи
-void addToLog(String type, String source, String details, bool isAlarm = false) {
-    LogEntry entry;
-    entry.timestamp = millis();
-    entry.eventType = type;
-    entry.source = source;
-    entry.details = details;
-    entry.isAlarm = isAlarm;
-    
-    // Добавляем в начало вектора (новые события сверху)
-    eventLog.insert(eventLog.begin(), entry);
-    
-    // Ограничиваем размер
-    if (eventLog.size() > MAX_LOG_SIZE) {
-        eventLog.pop_back(); // Удаляем самое старое
+void addToLog(EventType type, EventSource source, const char* details, bool isAlarm = false) {
+    uint64_t ts = logTime();
+    eventLog.push(ts, type, source, details, isAlarm);
+    journal.append(ts, type, source, details, isAlarm);
+    if (isAlarm) {
+        journal.flush();        // Тревога должна пережить отключение питания
     }
     
     // Вывод в Serial для отладки
     Serial.print("📝 Лог: [");
-    Serial.print(type);
+    Serial.print(eventTypeName(type));
     Serial.print("] ");
-    Serial.print(source);
+    Serial.print(eventSourceName(source));
     Serial.print(" - ");
     Serial.println(details);
 }
 
-// Получение последних n событий (n <= MAX_LOG_SIZE)
-String getLastEvents(int count) {
+// Детали по шаблону из messages.h
+void addToLogf(EventType type, EventSource source, const char* fmt, ...) {
+    char details[LOG_DETAILS_LEN];
+    va_list args;
+    va_start(args, fmt);
+    vformatUtf8(details, sizeof(details), fmt, args);
+    va_end(args);
+    addToLog(type, source, details);
+}
+
+// Строка события для Telegram
+void appendLogLine(TelegramReport& out, const LogEntry& e, uint64_t now) {
+    // Время: секунды, минуты или часы назад
+    unsigned long secondsAgo = (unsigned long)((now - e.timestamp) / 1000);
+    if (secondsAgo < 60) {
+        out.addf("│ %s [%lu сек назад]", eventIcon(e.type), secondsAgo).endLine();
+    } else if (secondsAgo < 3600) {
+        out.addf("│ %s [%lu мин назад]", eventIcon(e.type), secondsAgo / 60).endLine();
+    } else {
+        out.addf("│ %s [%lu ч назад]", eventIcon(e.type), secondsAgo / 3600).endLine();
+    }
+    out.add("│  ").add(eventSourceName(e.source)).add(": ").add(e.details).endLine();
+}
+
+// Последние n событий (n <= MAX_LOG_SIZE) в чат chatId
+void reportLastEvents(int count, const char* chatId) {
     if (eventLog.empty()) {
-        return "📭 Лог пуст";
+        telegram.send(messageText(Msg::LogEmpty), chatId);
+        return;
     }
     
-    String result = "📋 *Последние события*\n\n";
-    result += "┌─────────────────────\n";
+    report.begin(chatId);
+    report.add("📋 *Последние события*").endLine().endLine();
+    report.add("┌─────────────────────").endLine();
     
     int maxCount = min(count, (int)eventLog.size());
+    uint64_t now = logTime();
     for (int i = 0; i < maxCount; i++) {
-        LogEntry e = eventLog[i];
-        
-        // Форматируем время (секунды назад)
-        unsigned long secondsAgo = (millis() - e.timestamp) / 1000;
-        String timeStr;
-        if (secondsAgo < 60) {
-            timeStr = String(secondsAgo) + " сек назад";
-        } else if (secondsAgo < 3600) {
-            timeStr = String(secondsAgo / 60) + " мин назад";
-        } else {
-            timeStr = String(secondsAgo / 3600) + " ч назад";
-        }
-        
-        // Иконка в зависимости от типа
-        String icon;
-        if (e.eventType == "rfid") {
-            if (e.details.indexOf("ERROR") >= 0) icon = "⛔";
-            else if (e.details.indexOf("включил") >= 0) icon = "🔒";
-            else if (e.details.indexOf("выключил") >= 0) icon = "🔓";
-            else icon = "📇";
-        }
-        else if (e.eventType == "motion") icon = "👋";
-        else if (e.eventType == "arm") icon = "🔒";
-        else if (e.eventType == "disarm") icon = "🔓";
-        else if (e.eventType == "alarm") icon = "🚨";
-        else if (e.eventType == "rfid") icon = "💳";
-        else if (e.eventType == "error") icon = "⚠️";
-        else icon = "📌";
-        
-        result += "│ ";
-        result += icon + " ";
-        result += "[" + timeStr + "]\n";
-        result += "│  " + e.source + ": " + e.details + "\n";
-        
+        appendLogLine(report, eventLog.newest(i), now);
         if (i < maxCount - 1) {
-            result += "├─────────────────────\n";
+            report.add("├─────────────────────").endLine();
         }
     }
     
-    result += "└─────────────────────\n";
-    result += "📊 Всего событий: " + String(eventLog.size());
+    report.add("└─────────────────────").endLine();
+    report.addf("📊 Всего событий: %lu", (unsigned long)journal.size());
+    report.finish();
+}
+
+// Длительность "90s", "30m", "2h", "1d" (без суффикса - минуты) в мс; 0 - ошибка
+uint64_t parseDurationMs(const char* s) {
+    char* end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s) return 0;
+    switch (*end) {
+        case 's': return v * 1000ULL;
+        case 'h': return v * 3600000ULL;
+        case 'd': return v * 86400000ULL;
+        default:  return v * 60000ULL;
+    }
+}
+
+// События журнала за интервал [now - fromAgo, now - toAgo] от старых к новым
+void reportEventsRange(uint64_t fromAgo, uint64_t toAgo, const char* chatId) {
+    uint64_t now = logTime();
+    uint64_t from = fromAgo < now ? now - fromAgo : 0;
+    uint64_t to = toAgo < now ? now - toAgo : 0;
     
-    return result;
+    report.begin(chatId);
+    report.add("📋 *События за интервал*").endLine().endLine();
+    report.add("┌─────────────────────").endLine();
+    int shown = 0;
+    size_t total = journal.query(from, to, [&](const LogEntry& e) {
+        if (shown == LOG_QUERY_LIMIT) return true;  // Дальше только считаем
+        if (shown > 0) report.add("├─────────────────────").endLine();
+        appendLogLine(report, e, now);
+        shown++;
+        return true;
+    });
+    if (total == 0) {
+        // Отчет еще не отправлялся: заголовок просто не уходит
+        telegram.send(messageText(Msg::RangeEmpty), chatId);
+        return;
+    }
+    report.add("└─────────────────────").endLine();
+    if (total > (size_t)shown) {
+        report.addf("... и еще %lu", (unsigned long)(total - shown)).endLine();
+    }
+    report.addf("📊 За интервал: %lu", (unsigned long)total);
+    report.finish();
 }
 
 
 // ===== Пьезо-пищалка =====
-void playSound(String sound) {
-    if (sound == "alarm") {
-        // Прерывистый сигнал (будет обрабатываться в loop)
-        alarmActive = true;
-    }
-    else if (sound == "boot") {
-        digitalWrite(BUZZER_PIN, HIGH);
-        delay(50);
-        digitalWrite(BUZZER_PIN, LOW);
-        delay(50);
-        digitalWrite(BUZZER_PIN, HIGH);
-        delay(50);
-        digitalWrite(BUZZER_PIN, LOW);
-    }
-    else if (sound == "rfid_ok") {
-        digitalWrite(BUZZER_PIN, HIGH);
-        delay(50);
-        digitalWrite(BUZZER_PIN, LOW);
-    }
-    else if (sound == "rfid_error") {
-        for(int i = 0; i < 3; i++) {
-            digitalWrite(BUZZER_PIN, HIGH);
-            delay(50);
-            digitalWrite(BUZZER_PIN, LOW);
-            delay(50);
-        }
+// Сигналы - таблицы длительностей (вкл, выкл, ...), играются по таймеру
+constexpr uint16_t BOOT_STEPS[] = {50, 50, 50};
+constexpr uint16_t CHIRP_STEPS[] = {50, 50};
+constexpr uint16_t ARM_STEPS[] = {50, 50, 150};
+constexpr uint16_t DISARM_STEPS[] = {150};
+constexpr uint16_t ALARM_STEPS[] = {200, 500};
+
+constexpr Pattern SOUND_BOOT = makePattern(BOOT_STEPS, PATTERN_PRIO_CHIRP);
+constexpr Pattern SOUND_RFID_OK = makePattern(CHIRP_STEPS, PATTERN_PRIO_CHIRP);
+constexpr Pattern SOUND_RFID_ERROR = makePattern(CHIRP_STEPS, PATTERN_PRIO_CHIRP, 3);
+constexpr Pattern SOUND_ARM = makePattern(ARM_STEPS, PATTERN_PRIO_CHIRP);
+constexpr Pattern SOUND_DISARM = makePattern(DISARM_STEPS, PATTERN_PRIO_CHIRP);
+constexpr Pattern SOUND_ALARM = makePattern(ALARM_STEPS, PATTERN_PRIO_ALARM, 0);  // До снятия тревоги
+
+PatternPlayer buzzer;
+
+// Сирена следует за состоянием автомата (тревогу снимают Disarm, карта и таймаут)
+void handleBuzzer() {
+    bool alarmActive = security.alarm();
+    if (alarmActive && !buzzer.playing(SOUND_ALARM)) {
+        buzzer.play(SOUND_ALARM);
+    } else if (!alarmActive && buzzer.playing(SOUND_ALARM)) {
+        buzzer.stop(SOUND_ALARM);
     }
 }
 
-void handleBuzzer() {
-    static unsigned long lastBuzzerToggle = 0;
-    static bool buzzerState = false;
-    
-    if (alarmActive) {
-        // Прерывистый сигнал тревоги
-        if (millis() - lastBuzzerToggle > (buzzerState ? 200 : 500)) {
-            buzzerState = !buzzerState;
-            digitalWrite(BUZZER_PIN, buzzerState ? HIGH : LOW);
-            lastBuzzerToggle = millis();
-        }
+bool sirenOn() {
+    return buzzer.playing(SOUND_ALARM);
+}
+
+
+// ===== Сводки уведомлений (alert_digest.h) =====
+// "🔍 Движение ×14 от 3 датчиков за 20 с" и список ключей со счетчиками
+void sendAlertDigest(AlertKind kind, const AlertWindow& w) {
+    char text[160 + ALERT_KEYS * (ALERT_KEY_LEN + SENSOR_ZONE_LEN + 16)];
+    unsigned seconds = (w.lastAt - w.openedAt + 999) / 1000;
+    if (seconds == 0) seconds = 1;
+    const char* more = w.otherCount ? "+" : "";
+    int len;
+    if (kind == AlertKind::Motion) {
+        len = snprintf(text, sizeof(text), "🔍 Движение ×%u от %u%s %s за %u с:\n", w.total, w.keys, more,
+                       w.keys == 1 && !w.otherCount ? "датчика" : "датчиков", seconds);
     } else {
-        // Убеждаемся что сирена выключена
-        digitalWrite(BUZZER_PIN, LOW);
+        len = snprintf(text, sizeof(text), "📇 Чужие карты ×%u (%u%s UID) за %u с:\n", w.total, w.keys, more,
+                       seconds);
+    }
+    for (uint8_t i = 0; i < w.keys && len < (int)sizeof(text); i++) {
+        const AlertKey& e = w.entries[i];
+        uint8_t h = kind == AlertKind::Motion ? sensors.find(e.key) : SENSOR_NONE;
+        if (h != SENSOR_NONE && sensors.zoneName(h)[0]) {
+            len += snprintf(text + len, sizeof(text) - len, "• %s (%s) ×%u\n", e.key, sensors.zoneName(h), e.count);
+        } else {
+            len += snprintf(text + len, sizeof(text) - len, "• %s ×%u\n", e.key, e.count);
+        }
     }
+    if (w.otherCount && len < (int)sizeof(text)) {
+        snprintf(text + len, sizeof(text) - len, "• другие ×%u\n", w.otherCount);
+    }
+    telegram.send(text);
+}
+
+// Окна сводок, истекшие к этому моменту
+void flushAlerts() {
+    alerts.flush(millis(), sendAlertDigest);
+}
+
+// Движение или чужая карта: true - первое событие в окне, подробное сообщение сразу
+bool noteAlert(AlertKind kind, const char* key) {
+    flushAlerts();
+    return alerts.add(kind, key, millis());
+}
+
+
+// ===== Поток событий GET /stream (state_push.h) =====
+LockFreeQueue<StatePush, PUSH_QUEUE_SLOTS> statePushes;   // loop() -> сетевая задача
+std::atomic<uint32_t> pushesLost{0};   // Очередь была полна
+
+// Изменение подписчикам; без подписчиков - ничего
+void pushState(PushKind kind, const char* subject, const char* detail) {
+    if (server.streams() == 0) return;
+    bool queued = statePushes.tryPushWith([&](StatePush& p) {
+        fillStatePush(p, kind, security.state(), sensors.count(), sensors.silentCount(), subject, detail);
+    });
+    if (!queued) pushesLost++;
 }
 
 
@@ -195,98 +306,257 @@ void initRFID() {
     Serial.println("✅ RFID модуль инициализирован");
     Serial.print("Версия прошивки: 0x");
     Serial.println(rfid.PCD_ReadRegister(rfid.VersionReg), HEX);
+    rfidReader.begin(RFID_IRQ_PIN);   // Дальше SPI трогает только задача считывателя
 }
 
-void checkRFID() {
-    // Проверяем с нужной периодичностью
-    if (millis() - lastRFIDRead < RFID_READ_DELAY) {
-        return;
+// Загрузка базы карт из LittleFS (при первом запуске - из rfid_tags.h)
+void initCardIndex() {
+    if (!LittleFS.begin(true)) {
+        Serial.println("❌ LittleFS не смонтирован, база карт только в памяти");
     }
-    lastRFIDRead = millis();
+    cards.begin(RFID_INDEX_SLOTS, RFID_OWNER_POOL);
     
-    // Проверяем наличие новой карты
-    if (!rfid.PICC_IsNewCardPresent()) {
-        return;
+    int lines = loadCards(LittleFS, RFID_CARDS_FILE, cards);
+    if (lines < 0) {
+        for (int i = 0; i < tagCount; i++) {
+            CardUid uid;
+            uid.size = authorizedTags[i].uidSize;
+            memcpy(uid.bytes, authorizedTags[i].uid, uid.size);
+            cards.put(uid, authorizedTags[i].owner, authorizedTags[i].active);
+        }
+        saveCards(LittleFS, RFID_CARDS_FILE, cards);
+    } else if (lines > (int)cards.count() * 2 + 16) {
+        saveCards(LittleFS, RFID_CARDS_FILE, cards); // Сжимаем накопившиеся изменения
     }
     
-    // Пытаемся прочитать карту
-    if (!rfid.PICC_ReadCardSerial()) {
-        return;
+    Serial.print("✅ Карт в базе: ");
+    Serial.println((unsigned long)cards.count());
+}
+
+// Изменение карты: сразу в памяти и строкой в конец файла
+bool updateCard(const CardUid& uid, const char* owner, bool active) {
+    if (cards.put(uid, owner, active) != RfidIndex::Result::Ok) {
+        return false;
     }
-    
-    // Получаем UID карты в формате "A1 B2 C3 D4"
-    String uid = "";
-    for (byte i = 0; i < rfid.uid.size; i++) {
-        if (rfid.uid.uidByte[i] < 0x10) uid += "0";
-        uid += String(rfid.uid.uidByte[i], HEX);
-        if (i < rfid.uid.size - 1) uid += " ";
-    }
-    uid.toUpperCase();
-    
-    // Защита от повторного чтения одной карты
-    if (uid == lastCardUID) {
-        cardReadCount++;
-        if (cardReadCount < 3) { // Пропускаем повторные чтения
-            rfid.PICC_HaltA();
-            return;
-        }
-    } else {
+    appendCard(LittleFS, RFID_CARDS_FILE, uid, owner, active);
+    return true;
+}
+
+// Касание карты от задачи считывателя: повторы той же карты она уже отсеяла.
+// soak - карта проверки утечек: разбор и журнал те же, но без трассы,
+// автомата, панелей /stream, Telegram и писка
+void handleCard(const RfidSwipe& swipe, bool soak = false) {
+    const CardUid& uid = swipe.uid;
+    if (!soak) {
+        trace.record(TraceKind::RfidUid, uid.bytes, uid.size);
         lastCardUID = uid;
-        cardReadCount = 1;
     }
     
+    // Строка "A1 B2 C3 D4" нужна только для сообщений
+    char uidStr[RFID_UID_MAX * 3];
+    formatUid(uid, uidStr, sizeof(uidStr));
     Serial.print("\n📇 RFID карта обнаружена! UID: ");
-    Serial.println(uid);
+    Serial.println(uidStr);
     
     // Проверяем карту
-    String owner = checkRFIDTag(uid);
-    
-    // Формируем сообщение для Telegram
-    String cardMsg = "📇 RFID карта:\n";
-    cardMsg += "UID: " + uid + "\n";
+    CardInfo card = cards.lookup(uid);
+    if (!soak) {
+        pushState(PushKind::Card, uidStr, card.status == CardStatus::Active ? "active" :
+                                          card.status == CardStatus::Unknown ? "unknown" : "disabled");
+    }
+    if (card.status == CardStatus::Active) {
+        if (soak) return;
+        // Разрешенная карта: охрану переключает автомат, ответ - в onAlarmEvent()
+        bool posted = security.postWith(AlarmInput::Toggle, EventSource::Rfid, [&](AlarmEvent& e) {
+            e.mark = swipe.readUs;
+            copyUtf8(e.who, sizeof(e.who), card.owner);
+            copyUtf8(e.ref, sizeof(e.ref), uidStr);
+        });
+        if (!posted) buzzer.play(SOUND_RFID_ERROR);
+        return;
+    }
     
-    if (owner == "unknown") {
+    if (card.status == CardStatus::Unknown) {
         // Неизвестная карта
-        cardMsg += "❓ Неизвестная карта!";
-        bot.sendMessage(cardMsg);
-        playSound("rfid_error");
+        char uidCompact[RFID_UID_MAX * 2 + 1];
+        formatUid(uid, uidCompact, sizeof(uidCompact), 0);
+        if (!soak && noteAlert(AlertKind::CardDenied, uidStr)) {
+            telegram.sendf("", messageText(Msg::CardUnknown), uidStr, uidCompact);
+        }
+        if (!soak) buzzer.play(SOUND_RFID_ERROR);
         
         // Логируем попытку доступа
-        addToLog("rfid", "system", "RFID_ERROR: Неизвестная карта " + uid, false);
+        addToLogf(EventType::Denied, EventSource::Rfid, messageText(Msg::CardUnknownLog), uidStr);
     }
-    else if (owner == "disabled") {
+    else {
         // Отключенная карта
-        cardMsg += "⛔ Карта отключена!";
-        bot.sendMessage(cardMsg);
-        playSound("rfid_error");
+        if (!soak && noteAlert(AlertKind::CardDenied, uidStr)) {
+            telegram.sendf("", messageText(Msg::CardDisabled), uidStr);
+        }
+        if (!soak) buzzer.play(SOUND_RFID_ERROR);
         
-        addToLog("rfid", "system", "RFID_ERROR: Отключенная карта " + uid, false);
+        addToLogf(EventType::Denied, EventSource::Rfid, messageText(Msg::CardDisabledLog), uidStr);
     }
-    else {
-        // Разрешенная карта - переключаем охрану
-        systemArmed = !systemArmed;
-        
-        cardMsg += "✅ Карта: " + owner + "\n";
-        cardMsg += "Действие: " + String(systemArmed ? "Система сигнализации включена" : "Система сигнализации выключена");
-        
-        bot.sendMessage(cardMsg);
-        
-        if (systemArmed) {
-            playSound("arm");
-            addToLog("rfid", "system", "RFID: " + owner + " включил систему сигнализации", false);
-        } else {
-            playSound("disarm");
-            addToLog("rfid", "system", "RFID: " + owner + " выключил систему сигнализации", false);
-            alarmActive = false; // Сбрасываем тревогу если была
-        }
+    rfidDecisionTime.record(micros() - swipe.readUs);
+}
+
+void checkRFID() {
+    RfidSwipe swipe;
+    while (rfidReader.pop(swipe)) handleCard(swipe);
+}
+
+
+// ===== Реестр датчиков =====
+void initSensors() {
+    sensors.begin(SENSOR_SILENCE_MS);
+    int loaded = loadSensors(LittleFS, SENSORS_FILE, sensors, millis());
+    Serial.print("✅ Известных датчиков: ");
+    Serial.println(loaded < 0 ? 0 : loaded);
+}
+
+// "pir_sensor (Прихожая)" для сообщений
+#define SENSOR_LABEL_LEN (SENSOR_ID_LEN + SENSOR_ZONE_LEN + 4)
+
+const char* sensorLabel(uint8_t h, char* buf, size_t size) {
+    if (sensors.zoneName(h)[0]) snprintf(buf, size, "%s (%s)", sensors.id(h), sensors.zoneName(h));
+    else snprintf(buf, size, "%s", sensors.id(h));
+    return buf;
+}
+
+// Любой сигнал от датчика: новый датчик запоминается, вернувшийся - в лог
+uint8_t touchSensor(const char* sensorId) {
+    bool added;
+    uint8_t h = sensors.intern(sensorId, &added);
+    if (h == SENSOR_NONE) return h;    // Таблица полна: событие обработаем, но без контроля
+    if (added) saveSensors(LittleFS, SENSORS_FILE, sensors);
+    if (sensors.seen(h, millis())) {
+        char label[SENSOR_LABEL_LEN];
+        addToLogf(EventType::System, EventSource::Sensor, messageText(Msg::SensorBackLog), sensorId);
+        telegram.sendf("", messageText(Msg::SensorBack), sensorLabel(h, label, sizeof(label)));
+        pushState(PushKind::Sensor, sensorId, "online");
     }
-    
-    // Останавливаем чтение карты
-    rfid.PICC_HaltA();
+    return h;
 }
 
+// Датчики без сигнала дольше SENSOR_SILENCE_MS: обрыв, разряд или глушение
+void checkSensors() {
+    sensors.expire(millis(), [](uint8_t h) {
+        char details[LOG_DETAILS_LEN];
+        formatUtf8(details, sizeof(details), messageText(Msg::SensorSilentLog), sensors.id(h),
+                   (unsigned long)(SENSOR_SILENCE_MS / 1000));
+        addToLog(EventType::Tamper, EventSource::Sensor, details, security.armed());
+        char label[SENSOR_LABEL_LEN];
+        telegram.sendf("", messageText(Msg::SensorSilent), sensorLabel(h, label, sizeof(label)),
+                       (unsigned long)(SENSOR_SILENCE_MS / 1000));
+        pushState(PushKind::Sensor, sensors.id(h), "silent");
+        Serial.print("⚠️ Датчик молчит: ");
+        Serial.println(sensors.id(h));
+    });
+}
+
+
+// ===== Обмен между задачами =====
+// Сетевая задача (ядро 0) принимает HTTP и UDP и сразу отвечает датчикам;
+// loop() (ядро 1) ведет реестр, лог, журнал, RFID и сирену. Между ними
+// только lock-free очереди, состояние охраны читается из автомата атомарно.
+
+enum class InputKind : uint8_t {
+    Live,       // Обычное событие (HTTP, UDP, свежее из пачки)
+    Stale,      // Из пачки, накопленной без связи: только в лог
+    BatchEnd,   // Выгрузка пачек закончилась
+    Soak        // Проверка утечек: без реестра датчиков, /stream, Telegram и автомата
+};
+
+// Событие датчика, принятое сетевой задачей
+struct SensorInput {
+    InputKind kind;
+    int8_t rssi;                       // дБм, 0 - неизвестно
+    bool hasSeq;                       // UDP кадр: учет потерянных кадров
+    uint16_t bootId;
+    uint32_t seq;
+    uint32_t eventUs;                  // Время события на часах датчика, 0 - неизвестно
+    uint32_t recvUs;                   // micros() приема
+    uint32_t ageMs;                    // Stale: возраст события, UINT32_MAX - неизвестен
+    uint32_t remoteIp;
+    char sensorId[SENSOR_ID_LEN + 1];
+    char type[16];
+    char value[24];
+};
+
+// GET /logs: журнал читает loop(), ответ отправляет сетевая задача
+struct LogQuery {
+    uint32_t ticket;                   // HttpFront::defer()
+    uint64_t from;
+    uint64_t to;
+    bool hasTo;                        // Нет - до текущего времени журнала
+    long limit;
+};
 
-// ===== Обработчик POST запросов от датчиков =====
+struct HttpReply {
+    uint32_t ticket;
+    String body;
+};
+
+LockFreeQueue<SensorInput, SENSOR_INBOX_SLOTS> sensorInbox;
+LockFreeQueue<LogQuery, LOG_QUERY_SLOTS> logQueries;
+LockFreeQueue<HttpReply, LOG_QUERY_SLOTS> httpReplies;
+int logQueriesPending = 0;      // Только сетевая задача
+
+// Сводка реестра для /status и /metrics (пишет loop())
+std::atomic<uint8_t> sensorCount{0};
+std::atomic<uint8_t> silentSensorCount{0};
+StatusSnapshot statusSnapshot;  // Готовый ответ /status (status_snapshot.h)
+uint32_t statusNotModified = 0; // Ответов 304 (только сетевая задача)
+
+// Пересобрать ответ /status, если состояние изменилось (loop())
+void refreshStatus() {
+    statusSnapshot.update(security.state(), sensors.count(), sensors.silentCount(), millis());
+}
+
+// Автомат получает не больше одного входа на событие: очередь вмещает проход loop()
+static_assert(ALARM_QUEUE_SLOTS >= SENSOR_INPUTS_PER_LOOP + INBOX_SLOTS + 1,
+              "ALARM_QUEUE_SLOTS меньше входов за один проход loop()");
+
+
+// ===== События от датчиков: сетевая задача =====
+SensorInput makeInput(InputKind kind, const char* sensorId, const char* type, const char* value, IPAddress remote) {
+    SensorInput in = {};
+    in.kind = kind;
+    in.recvUs = micros();
+    in.ageMs = UINT32_MAX;
+    in.remoteIp = (uint32_t)remote;
+    copyUtf8(in.sensorId, sizeof(in.sensorId), sensorId);
+    copyUtf8(in.type, sizeof(in.type), type);
+    copyUtf8(in.value, sizeof(in.value), value);
+    return in;
+}
+
+// Писатель очереди один (сетевая задача): место не уменьшится до push
+size_t inboxFree() {
+    return SENSOR_INBOX_SLOTS - sensorInbox.size();
+}
+
+// Ответ датчику: состояние на момент приема, событие еще в очереди
+void sendSensorReply() {
+    server.send(200, "application/json", statusSnapshot.sensorReply());
+}
+
+
+// ===== Трасса входов (input_trace.h) =====
+// Адрес отправителя - первые 4 байта записи
+void traceHttpEvent() {
+    char query[256];
+    size_t len = 0;
+    for (int i = 0; i < server.args() && len < sizeof(query); i++) {
+        len += snprintf(query + len, sizeof(query) - len, "%s%s=%s", i ? "&" : "", server.argName(i).c_str(),
+                        server.arg(i).c_str());
+    }
+    uint32_t ip = server.client().remoteIP();
+    trace.record(TraceKind::HttpEvent, &ip, sizeof(ip), query, min(len, sizeof(query) - 1));
+}
+
+
+// ===== Обработчик POST запросов от датчиков (резервный путь) =====
 void handleSensorEvent() {
     Serial.println("\n═══════════════════════════════════");
     Serial.println("📥 ПОЛУЧЕН HTTP ЗАПРОС");
@@ -306,204 +576,918 @@ void handleSensorEvent() {
         Serial.print(" = ");
         Serial.println(server.arg(i));
     }
+    traceHttpEvent();
     if (!server.hasArg("type") || !server.hasArg("sensor_id")) {
         server.send(400, "text/plain", "Missing parameters");
         return;
     }
     
-    String eventType = server.arg("type");
-    String sensorId = server.arg("sensor_id");
-    String value = server.arg("value");
+    SensorInput in = makeInput(InputKind::Live, server.arg("sensor_id").c_str(), server.arg("type").c_str(),
+                               server.arg("value").c_str(), server.client().remoteIP());
+    in.eventUs = server.hasArg("event_us") ? strtoul(server.arg("event_us").c_str(), nullptr, 10) : 0;
+    in.rssi = server.hasArg("rssi") ? (int8_t)server.arg("rssi").toInt() : 0;
+    if (!sensorInbox.tryPush(in)) {
+        server.send(503, "text/plain", "Busy");  // Датчик повторит
+        return;
+    }
     
+    sendSensorReply();
+    Serial.println("═══════════════════════════════════\n");
+}
+
+
+// ===== Пачка событий, накопленных датчиком без связи =====
+// Тело (text/plain): "sensor_id;bootId;millis;есть_еще", затем строки
+// "seq;событие;bootId;millis_события". Время события восстанавливается по
+// разнице часов датчика; свежие события обрабатываются как обычные,
+// старые только пишутся в лог.
+void handleSensorBatch() {
+    const String& body = server.arg("plain");
+    uint32_t sender = server.client().remoteIP();
+    trace.record(TraceKind::HttpBatch, &sender, sizeof(sender), body.c_str(), body.length());
+    const char* p = body.c_str();
+    char sensorId[SENSOR_ID_LEN + 1];
+    unsigned bootId;
+    unsigned long sensorNow;
+    int more;
+    if (sscanf(p, "%16[^;];%u;%lu;%d", sensorId, &bootId, &sensorNow, &more) != 4) {
+        server.send(400, "text/plain", "Bad batch header");
+        return;
+    }
+
+    // Пачка ставится в очередь целиком или не ставится (повтор после 503 безопасен):
+    // строки, пульс отправителя и конец выгрузки
+    size_t lines = 0;
+    for (const char* c = strchr(p, '\n'); c; c = strchr(c + 1, '\n')) lines++;
+    if (inboxFree() < lines + 2) {
+        server.send(503, "text/plain", "Busy");
+        return;
+    }
+    IPAddress remote = server.client().remoteIP();
+    sensorInbox.tryPush(makeInput(InputKind::Live, sensorId, "heartbeat", "alive", remote));  // Выгрузка сама по себе - признак жизни
+
+    int accepted = 0;
+    int duplicates = 0;
+    for (p = strchr(p, '\n'); p && *++p; p = strchr(p, '\n')) {
+        unsigned long seq, eventMs;
+        unsigned eventBoot;
+        char name[16];
+        if (sscanf(p, "%lu;%15[^;];%u;%lu", &seq, name, &eventBoot, &eventMs) != 4) continue;
+
+        // seq очереди сквозной между перезагрузками датчика, поэтому bootId = 0
+        SensorFrame frame = {};
+        frame.seq = seq;
+        memcpy(frame.sensorId, sensorId, sizeof(frame.sensorId));
+        if (!batchSeq.accept(frame, millis())) {
+            duplicates++;
+            continue;
+        }
+        accepted++;
+
+        // Возраст события известен, только если датчик с тех пор не перезагружался
+        bool ageKnown = eventBoot == bootId && sensorNow >= eventMs;
+        unsigned long age = ageKnown ? sensorNow - eventMs : 0;
+        if (ageKnown && age <= BATCH_LIVE_MS) {
+            SensorEvent event;
+            const char* value = sensorEventFromName(name, event) ? sensorEventValue(event) : "";
+            sensorInbox.tryPush(makeInput(InputKind::Live, sensorId, name, value, remote));
+            continue;
+        }
+        SensorInput in = makeInput(InputKind::Stale, sensorId, name, "", remote);
+        in.ageMs = ageKnown ? age : UINT32_MAX;
+        sensorInbox.tryPush(in);
+    }
+    if (!more) sensorInbox.tryPush(makeInput(InputKind::BatchEnd, sensorId, "", "", remote));
+
+    char response[64];
+    snprintf(response, sizeof(response), "{\"status\":\"ok\",\"accepted\":%d,\"duplicates\":%d}", accepted,
+             duplicates);
+    server.send(200, "application/json", response);
+}
+
+
+// ===== UDP события от датчиков (основной путь) =====
+// Бинарные кадры sensor_proto.h: без TCP соединения и разбора формы.
+// ACK уходит сразу после постановки в очередь и несет флаги охраны и тревоги.
+
+// Кадр события от датчика; true - в buf готов ACK для ответа
+bool acceptSensorFrame(uint8_t* buf, int size, uint32_t remoteIp) {
+    SensorFrame frame;
+    if (size != SENSOR_FRAME_SIZE || !decodeFrame(buf, size, frame) || frame.kind != FrameKind::Event) {
+        return false;
+    }
+    trace.record(TraceKind::UdpFrame, &remoteIp, sizeof(remoteIp), buf, SENSOR_FRAME_SIZE);
+    // Очередь полна: без ACK, датчик повторит кадр
+    if (inboxFree() == 0) return false;
+    // Повтор уже принятого кадра только подтверждаем
+    if (sensorSeq.accept(frame, millis())) {
+        SensorInput in = makeInput(InputKind::Live, frame.sensorId, sensorEventName(frame.event),
+                                   sensorEventValue(frame.event), IPAddress(remoteIp));
+        in.eventUs = frame.eventUs;
+        in.rssi = frame.rssi;
+        in.hasSeq = true;
+        in.bootId = frame.bootId;
+        in.seq = frame.seq;
+        sensorInbox.tryPush(in);
+    }
+
+    AlarmState state = security.state();
+    frame.kind = FrameKind::Ack;
+    frame.flags = (state != AlarmState::Disarmed ? ACK_FLAG_ARMED : 0) |
+                  (state == AlarmState::Alarm ? ACK_FLAG_ALARM : 0);
+    encodeFrame(frame, buf);
+    return true;
+}
+
+void handleSensorUdp() {
+    uint8_t buf[SENSOR_FRAME_SIZE + 1];    // Байт сверх кадра - признак чужой датаграммы
+    for (int i = 0; i < UDP_PACKETS_PER_LOOP; i++) {
+        int size = sensorUdp.receive(buf, sizeof(buf));
+        if (size <= 0) return;
+        if (acceptSensorFrame(buf, size, sensorUdp.remoteIP())) sensorUdp.reply(buf, SENSOR_FRAME_SIZE);
+    }
+}
+
+
+// ===== События от датчиков: loop() =====
+int deliveredStale = 0;         // Старых событий за текущую выгрузку пачек
+
+void processSensorEvent(const SensorInput& in) {
+    bool soak = in.kind == InputKind::Soak;
+    // Перезагрузку датчика (новый bootId) учитываем до оценки его часов
+    uint8_t h = sensors.find(in.sensorId);
+    if (h != SENSOR_NONE && in.hasSeq) sensors.trackSeq(h, in.bootId, in.seq);
+    if (!soak) h = touchSensor(in.sensorId);   // Синтетический датчик в реестр и файл не попадает
+    if (h != SENSOR_NONE && in.rssi) sensors.setRssi(h, in.rssi);
+    bool ageKnown = h != SENSOR_NONE && in.eventUs != 0;
+    uint32_t ageUs = ageKnown ? sensors.eventAgeUs(h, in.eventUs, in.recvUs, millis()) : 0;
+    if (ageKnown) eventAgeTime.record(ageUs);
+    if (strcmp(in.type, "heartbeat") == 0) return;  // Пульс только продлевает срок датчика
+
     Serial.print("📡 От датчика: ");
-    Serial.print(sensorId);
+    Serial.print(in.sensorId);
     Serial.print(" - ");
-    Serial.println(eventType);
-    addToLog(eventType, sensorId, value, false);
+    Serial.println(in.type);
+    char details[LOG_DETAILS_LEN];
+    formatUtf8(details, sizeof(details), "%s: %s", in.sensorId, in.value);
+    addToLog(eventTypeFromString(in.type), EventSource::Sensor, details);
 
     // Движение
-    if (eventType == "motion") {
-        String debugMsg = "🔍 Детали движения:\n";
-        debugMsg += "Датчик: " + sensorId + "\n";
-        debugMsg += "Значение: " + value + "\n"; 
-        debugMsg += "IP источника: " + server.client().remoteIP().toString();
-        bot.sendMessage(debugMsg);
-        if (systemArmed && !alarmActive) {
-            alarmActive = true;
-            alarmStartTime = millis();
-
-            addToLog("alarm", sensorId, "Обнаружено движение! Тревога!", true);
-
-            playSound("alarm"); // Запускаем сирену
-        
-            // Отправляем в Telegram
-            String alarmMsg = "🚨🚨🚨 ТРЕВОГА! 🚨🚨🚨\n";
-            alarmMsg += "Обнаружено движение!\n";
-            alarmMsg += "Включена звуковая сигнализация";
-            
-            bot.sendMessage(alarmMsg);
-            
+    if (strcmp(in.type, "motion") == 0) {
+        if (soak) return;
+        pushState(PushKind::Motion, in.sensorId, in.value);
+        // Подробно - только первое движение окна, остальные уйдут сводкой
+        if (noteAlert(AlertKind::Motion, in.sensorId)) {
+            char label[SENSOR_LABEL_LEN];
+            char ip[16];
+            IPAddress remote(in.remoteIp);
+            snprintf(ip, sizeof(ip), "%u.%u.%u.%u", remote[0], remote[1], remote[2], remote[3]);
+            telegram.sendf("", messageText(Msg::MotionDetails),
+                           h != SENSOR_NONE ? sensorLabel(h, label, sizeof(label)) : in.sensorId, in.value, ip);
+        }
+
+        // Тревогу решает автомат: движение встает в очередь вместе с картами и командами
+        security.postWith(AlarmInput::Motion, EventSource::Sensor, [&](AlarmEvent& e) {
+            e.sensor = h;
+            e.mark = in.recvUs;
+            e.ageUs = ageKnown ? ageUs : UINT32_MAX;
+            copyUtf8(e.who, sizeof(e.who), in.sensorId);
+        });
+    }
+}
+
+// Старое событие из пачки: только в лог, тревогу не вызывает
+void logStaleEvent(const SensorInput& in) {
+    char details[LOG_DETAILS_LEN];
+    if (in.ageMs != UINT32_MAX) {
+        formatUtf8(details, sizeof(details), "%s: %s (без связи, %lu с назад)", in.sensorId, in.type,
+                   (unsigned long)(in.ageMs / 1000));
+    } else {
+        formatUtf8(details, sizeof(details), "%s: %s (без связи, до перезагрузки датчика)", in.sensorId, in.type);
+    }
+    uint64_t now = logTime();
+    uint64_t ts = in.ageMs != UINT32_MAX && in.ageMs < now ? now - in.ageMs : now;
+    eventLog.push(ts, eventTypeFromString(in.type), EventSource::Sensor, details, false);
+    journal.append(ts, eventTypeFromString(in.type), EventSource::Sensor, details, false);  // В журнале - время доставки
+    deliveredStale++;
+}
+
+void finishBatch(const SensorInput& in) {
+    if (deliveredStale == 0) return;
+    telegram.sendf("", messageText(Msg::StaleDelivered), in.sensorId, deliveredStale);
+    deliveredStale = 0;
+}
+
+// События, принятые сетевой задачей; возвращает, сколько разобрано
+int processSensorInputs() {
+    SensorInput in;
+    int n = 0;
+    while (n < SENSOR_INPUTS_PER_LOOP && sensorInbox.tryPop(in)) {
+        uint32_t t0 = cycleNow();
+        inboxWaitTime.record(micros() - in.recvUs);
+        switch (in.kind) {
+            case InputKind::Live:
+            case InputKind::Soak:     processSensorEvent(in); break;
+            case InputKind::Stale:    logStaleEvent(in); break;
+            case InputKind::BatchEnd: finishBatch(in); break;
+        }
+        sensorEventTime.recordCycles(t0);
+        n++;
+    }
+    return n;
+}
+
+
+// ===== Последствия переходов автомата охраны =====
+// Вызывается security.run() на каждый вход, в порядке очереди
+void onAlarmEvent(const AlarmEvent& e, AlarmState from, AlarmState to) {
+    switch (e.input) {
+        case AlarmInput::Arm:
+            telegram.send(messageText(Msg::ArmReply), e.ref);
+            if (from == AlarmState::Disarmed) {
+                addToLog(EventType::Arm, EventSource::Telegram, messageText(Msg::ArmedLog));
+            }
+            break;
+
+        case AlarmInput::Disarm:
+            telegram.send(messageText(Msg::DisarmReply), e.ref);
+            if (from != AlarmState::Disarmed) {
+                addToLog(EventType::Disarm, EventSource::Telegram, messageText(Msg::DisarmedLog));
+            }
+            break;
+
+        case AlarmInput::Toggle: {
+            bool armed = to != AlarmState::Disarmed;
+            telegram.sendf("", messageText(Msg::CardToggle), e.ref, e.who,
+                           messageText(armed ? Msg::ArmedLog : Msg::DisarmedLog));
+
+            char details[LOG_DETAILS_LEN];
+            formatUtf8(details, sizeof(details), messageText(Msg::CardToggleLog), e.who, armed ? "включил" : "выключил");
+            if (armed) {
+                buzzer.play(SOUND_ARM);
+                addToLog(EventType::Arm, EventSource::Rfid, details);
+            } else {
+                handleBuzzer();      // Сирена смолкает, иначе писк снятия не прозвучит
+                buzzer.play(SOUND_DISARM);
+                addToLog(EventType::Disarm, EventSource::Rfid, details);
+            }
+            rfidDecisionTime.record(micros() - e.mark);
+            break;
+        }
+
+        case AlarmInput::Motion: {
+            if (from != AlarmState::Armed || to != AlarmState::Alarm) break;
+            char details[LOG_DETAILS_LEN];
+            formatUtf8(details, sizeof(details), messageText(Msg::AlarmLog), e.who);
+            addToLog(EventType::Alarm, EventSource::Sensor, details, true);
+
+            handleBuzzer(); // Запускаем сирену
+            if (e.ageUs != UINT32_MAX) motionToAlarm.record(e.ageUs + (micros() - e.mark));
+
+            // В Telegram - первым, мимо лимита чата
+            char label[SENSOR_LABEL_LEN];
+            telegram.sendUrgentf("", messageText(Msg::AlarmReply),
+                                 e.sensor != SENSOR_NONE ? sensorLabel(e.sensor, label, sizeof(label)) : e.who);
+
             Serial.println("🚨 АКТИВИРОВАНА ТРЕВОГА! 🚨");
+            break;
         }
+
+        case AlarmInput::Timeout:
+            // Автоматическое отключение тревоги через ALARM_TIMEOUT
+            telegram.sendUrgentf("", messageText(Msg::AlarmTimeout), (unsigned long)(ALARM_TIMEOUT / 60000));
+            Serial.println("Тревога автоматически отключена");
+            break;
+    }
+    if (from != to) {
+        refreshStatus();
+        pushState(PushKind::State, e.who, eventSourceName(e.source));
     }
-    
-    // Ответ
-    String response = "{\"status\":\"ok\",\"armed\":";
-    response += systemArmed ? "true" : "false";
-    response += ",\"alarm\":";
-    response += alarmActive ? "true" : "false";
-    response += "}";
-    
-    server.send(200, "application/json", response);
-    Serial.println("═══════════════════════════════════\n");
+}
+
+void runAlarm() {
+    security.run(millis(), onAlarmEvent);
+    // Опрос Telegram чаще на охране и в тревоге (telegram_poll.h)
+    telegram.setPollMode(security.alarm() ? PollMode::Alarm : security.armed() ? PollMode::Armed : PollMode::Idle);
 }
 
 
 // ===== Получение статуса =====
+// Ответ собран в loop(); тот же ETag в If-None-Match - 304 без тела
 void handleStatus() {
-    String status = "{\"armed\":" + String(systemArmed ? "true" : "false") + 
-                   ",\"uptime\":" + String(millis() / 1000) + "}";
-    server.send(200, "application/json", status);
+    StatusView view;
+    statusSnapshot.read(view);
+    server.sendHeader("ETag", view.etag);
+    if (StatusSnapshot::notModified(server.header("If-None-Match").c_str(), view.etag)) {
+        statusNotModified++;
+        server.send(304);
+        return;
+    }
+    server.send(200, "application/json", view.json);
+}
+
+
+// GET /stream: подписка на изменения (text/event-stream). Первое событие -
+// текущее состояние, его сетевая задача берет из атомарных сводок.
+void handleStream() {
+    StatePush p;
+    fillStatePush(p, PushKind::State, security.state(), sensorCount, silentSensorCount, "", "subscribe");
+    char data[HTTP_STREAM_EVENT - 32];
+    formatStatePush(p, data, sizeof(data));
+    char first[HTTP_STREAM_EVENT];
+    snprintf(first, sizeof(first), "event: state\ndata: %s\n\n", data);
+    if (!server.stream(first)) server.send(503, "text/plain", "Too many subscribers");
+}
+
+// Изменения из loop() - всем подписчикам (сетевая задача)
+void publishStatePushes() {
+    StatePush p;
+    char data[HTTP_STREAM_EVENT - 32];
+    while (statePushes.tryPop(p)) {
+        formatStatePush(p, data, sizeof(data));
+        server.publish(PUSH_EVENTS[(size_t)p.kind], data);
+    }
+}
+
+
+// ===== Память (mem_monitor.h) =====
+// GET /mem: состояние сейчас и выборки за сутки от старых к новым. Кольцо
+// пишет loop(), сетевая задача читает копию.
+void handleMem() {
+    static MemSample samples[MEM_SAMPLES];   // Только сетевая задача
+    size_t n = memMonitor.snapshot(samples, MEM_SAMPLES);
+    MemSample now = memMonitor.current(millis());
+    uint8_t tasks = memMonitor.tasks();
+    String out;
+    out.reserve(512 + n * (48 + tasks * 6));
+    char line[320];
+    snprintf(line, sizeof(line),
+             "{\"uptime\":%lu,\"heap\":{\"size\":%lu,\"free\":%lu,\"min_free\":%lu,\"max_block\":%lu},"
+             "\"psram\":{\"size\":%lu,\"used\":%lu},\"declining\":%s,\"tasks\":[",
+             (unsigned long)now.uptimeS, (unsigned long)ESP.getHeapSize(), (unsigned long)now.freeHeap,
+             (unsigned long)now.minFree, (unsigned long)now.maxBlock, (unsigned long)ESP.getPsramSize(),
+             (unsigned long)now.psramUsed, memMonitor.declining() ? "true" : "false");
+    out += line;
+    for (uint8_t i = 0; i < tasks; i++) {
+        snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"stack\":%lu,\"free\":%u}", i ? "," : "",
+                 memMonitor.taskName(i), (unsigned long)memMonitor.taskStack(i), (unsigned)now.stackFree[i]);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "],\"interval\":%lu,\"columns\":[\"uptime\",\"free\",\"max_block\",\"min_free\","
+             "\"psram_used\"", (unsigned long)(MEM_SAMPLE_MS / 1000));
+    out += line;
+    for (uint8_t i = 0; i < tasks; i++) {
+        snprintf(line, sizeof(line), ",\"stack_%s\"", memMonitor.taskName(i));
+        out += line;
+    }
+    out += "],\"samples\":[";
+    for (size_t k = 0; k < n; k++) {
+        const MemSample& s = samples[k];
+        int len = snprintf(line, sizeof(line), "%s[%lu,%lu,%lu,%lu,%lu", k ? "," : "", (unsigned long)s.uptimeS,
+                           (unsigned long)s.freeHeap, (unsigned long)s.maxBlock, (unsigned long)s.minFree,
+                           (unsigned long)s.psramUsed);
+        for (uint8_t i = 0; i < tasks; i++) {
+            len += snprintf(line + len, sizeof(line) - len, ",%u", (unsigned)s.stackFree[i]);
+        }
+        snprintf(line + len, sizeof(line) - len, "]");
+        out += line;
+    }
+    out += "]}";
+    server.send(200, "application/json", out);
+}
+
+// Команда /mem: то же кратко, с потолком кучи по частям суток
+void reportMemory(const char* chatId) {
+    MemSample now = memMonitor.current(millis());
+    MemTrend t = memMonitor.trend();
+    report.begin(chatId);
+    report.add("🧠 *Память*").endLine();
+    report.addf("Куча: свободно %lu из %lu байт", (unsigned long)now.freeHeap, (unsigned long)ESP.getHeapSize())
+        .endLine();
+    report.addf("Наибольший блок: %lu, минимум с запуска: %lu", (unsigned long)now.maxBlock,
+                (unsigned long)now.minFree).endLine();
+    if (ESP.getPsramSize()) {
+        report.addf("PSRAM: занято %lu из %lu байт", (unsigned long)now.psramUsed, (unsigned long)ESP.getPsramSize())
+            .endLine();
+    }
+    if (t.parts) {
+        report.addf("Потолок кучи по %lu ч:", (unsigned long)(t.partMs / 3600000));
+        for (uint8_t p = 0; p < t.parts; p++) report.addf(" %lu", (unsigned long)t.ceiling[p]);
+        report.endLine();
+        if (t.declining) report.add("⚠️ Убывает - возможна утечка").endLine();
+    } else {
+        report.addf("Выборок: %u, тренд - с %u", (unsigned)memMonitor.count(), (unsigned)(MEM_TREND_PARTS * 2))
+            .endLine();
+    }
+    report.endLine().add("Стек задач, запас:").endLine();
+    for (uint8_t i = 0; i < memMonitor.tasks(); i++) {
+        report.addf("%s: %u из %lu байт%s", memMonitor.taskName(i), (unsigned)now.stackFree[i],
+                    (unsigned long)memMonitor.taskStack(i), now.stackFree[i] < MEM_STACK_WARN_BYTES ? " ⚠️" : "")
+            .endLine();
+    }
+    report.finish();
+}
+
+// Выборка раз в MEM_SAMPLE_MS; об убывающей куче - один раз, пока не выправится
+void checkMemory() {
+    static bool warned = false;
+    if (!memMonitor.poll(millis())) return;
+    if (!memMonitor.declining()) {
+        warned = false;
+        return;
+    }
+    if (warned) return;
+    warned = true;
+    MemTrend t = memMonitor.trend();
+    unsigned long from = t.ceiling[0];
+    unsigned long to = t.ceiling[t.parts - 1];
+    addToLogf(EventType::Error, EventSource::System, messageText(Msg::MemDecliningLog), from, to);
+    telegram.sendf("", messageText(Msg::MemDeclining), (unsigned long)(t.partMs / 3600000 * t.parts), from, to);
+}
+
+
+// ===== Проверка утечек (MEM_SOAK_MS) =====
+// Синтетические входы по путям настоящих: запись журнала (addToLog), событие
+// датчика "soak" - как его разбирает handleSensorEvent, и чужая карта - как
+// ее отдает checkRFID. Режим оставляют на часы и смотрят в /mem: потолок
+// кучи убывать не должен. Следов входы не оставляют: датчик "soak" не
+// попадает в реестр (и не "замолкает" потом), тревогу и охрану не трогает,
+// в /stream, Telegram и зуммер ничего не идет.
+uint32_t soakIntervalMs = MEM_SOAK_MS;
+uint32_t soakInputs = 0;
+
+void soakStep() {
+    static uint32_t lastSoak = 0;
+    if (soakIntervalMs == 0 || millis() - lastSoak < soakIntervalMs) return;
+    lastSoak = millis();
+    soakInputs++;
+    addToLogf(EventType::System, EventSource::System, messageText(Msg::SoakLog), (unsigned long)soakInputs);
+    processSensorEvent(makeInput(InputKind::Soak, "soak", "motion", "detected", IPAddress(127, 0, 0, 1)));
+    RfidSwipe swipe = {(uint32_t)micros(), {4, {0x50, 0x4B, 0x00, (uint8_t)(soakInputs & 3)}}};
+    handleCard(swipe, true);
+}
+
+
+// ===== Метрики в формате Prometheus =====
+void handleMetrics() {
+    String out;
+    out.reserve(12288);
+    writeGauge(out, "alarm_uptime_seconds", "Время работы", millis() / 1000.0, "counter");
+    AlarmStats alarmStats = security.stats();
+    writeGauge(out, "alarm_armed", "Система на охране", security.armed());
+    writeGauge(out, "alarm_active", "Идет тревога", security.alarm());
+    writeGauge(out, "alarm_inputs_total", "Входов автомата охраны", alarmStats.posted, "counter");
+    writeGauge(out, "alarm_inputs_dropped_total", "Входов, потерянных на полной очереди", alarmStats.dropped, "counter");
+    writeGauge(out, "alarm_transitions_total", "Смен состояния охраны", alarmStats.transitions, "counter");
+    writeGauge(out, "alarm_sensor_inbox", "Событий датчиков в очереди loop()", sensorInbox.size());
+    writeGauge(out, "alarm_sensors", "Датчиков в реестре", sensorCount);
+    writeGauge(out, "alarm_sensors_silent", "Датчиков без связи", silentSensorCount);
+    writeGauge(out, "alarm_free_heap_bytes", "Свободная куча", ESP.getFreeHeap());
+    writeGauge(out, "alarm_heap_min_free_bytes", "Минимум свободной кучи с запуска", ESP.getMinFreeHeap());
+    writeGauge(out, "alarm_heap_max_block_bytes", "Наибольший свободный блок кучи", ESP.getMaxAllocHeap());
+    writeGauge(out, "alarm_heap_declining", "Потолок свободной кучи убывает (mem_monitor.h)", memMonitor.declining());
+    writeGauge(out, "alarm_psram_used_bytes", "Занято PSRAM", ESP.getPsramSize() - ESP.getFreePsram());
+    writeTaskStacks(out, "alarm_task_stack_free_bytes", "Запас стека задачи (high water mark)", memMonitor);
+    writeGauge(out, "alarm_telegram_pending", "Сообщений в очереди Telegram", telegram.pending());
+    const HttpFrontStats& http = server.stats();
+    writeGauge(out, "alarm_stream_subscribers", "Подписчиков GET /stream", server.streams());
+    writeGauge(out, "alarm_stream_rejected_total", "Подписок, отклоненных по HTTP_MAX_STREAMS",
+               http.streamsRejected, "counter");
+    writeGauge(out, "alarm_stream_events_total", "Событий, ушедших подписчикам", http.streamEvents, "counter");
+    writeGauge(out, "alarm_stream_dropped_total", "Событий, замененных свежими у медленного подписчика",
+               http.streamDropped, "counter");
+    writeGauge(out, "alarm_stream_lost_total", "Изменений, не вставших в очередь loop() -> сеть", pushesLost,
+               "counter");
+    writeGauge(out, "alarm_status_builds_total", "Сборок ответа /status", statusSnapshot.builds(), "counter");
+    writeGauge(out, "alarm_status_not_modified_total", "Ответов 304 на GET /status", statusNotModified, "counter");
+    OutboxStats telegramStats = telegram.stats();
+    writeGauge(out, "alarm_telegram_throttled_total", "Сообщений, ждавших лимита чата", telegramStats.throttled,
+               "counter");
+    writeGauge(out, "alarm_alerts_coalesced_total", "Уведомлений, ушедших в сводку", alerts.coalesced(), "counter");
+    writeGauge(out, "alarm_telegram_polls_total", "Опросов Telegram (getUpdates)", telegramStats.polls, "counter");
+    writeGauge(out, "alarm_telegram_poll_interval_seconds", "Текущая пауза опроса Telegram",
+               telegramStats.pollIntervalMs / 1000.0);
+    RfidReaderStats rfidStats = rfidReader.stats();
+    writeGauge(out, "alarm_rfid_swipes_total", "Касаний RFID карт", rfidStats.swipes, "counter");
+    writeGauge(out, "alarm_rfid_repeats_total", "Повторных чтений карты у считывателя", rfidStats.repeats,
+               "counter");
+    writeGauge(out, "alarm_rfid_online", "RC522 отвечает (VersionReg)", rfidReader.online());
+    const WifiLinkStats& wifi = wifiLink.stats();
+    writeGauge(out, "alarm_wifi_connect_seconds", "Последнее подключение к WiFi", wifi.lastConnectMs / 1000.0);
+    writeGauge(out, "alarm_wifi_fast_misses_total", "Кэш точки не подошел, обычное подключение",
+               wifi.fastMisses, "counter");
+    TraceStats traceStats = trace.stats();
+    writeGauge(out, "alarm_trace_records_total", "Входов записано в трассу", traceStats.records, "counter");
+    writeGauge(out, "alarm_trace_dropped_total", "Входов, потерянных на полном буфере трассы",
+               traceStats.dropped, "counter");
+    writeGauge(out, "alarm_boot_ready_seconds", "Запуск: все этапы готовы (0 - еще нет)", boot.readyUs() / 1e6);
+    writeBootStages(out, "alarm_boot_stage_done_seconds", "Запуск: конец этапа от сброса", boot);
+    writeHistogram(out, "alarm_loop_seconds", "Один проход loop()", loopTime);
+    writeHistogram(out, "alarm_sensor_inbox_wait_seconds", "Прием события -> обработка в loop()", inboxWaitTime);
+    writeHistogram(out, "alarm_sensor_event_seconds", "Обработка события датчика в loop()", sensorEventTime);
+    writeHistogram(out, "alarm_sensor_event_age_seconds", "Событие на датчике -> прием сервером", eventAgeTime);
+    writeHistogram(out, "alarm_motion_to_alarm_seconds", "Фронт PIR -> сирена включена", motionToAlarm);
+    writeHistogram(out, "alarm_rfid_decision_seconds", "Чтение RFID карты -> решение", rfidDecisionTime);
+    writeHistogram(out, "alarm_telegram_send_seconds", "Один вызов sendMessage", telegram.sendTime());
+    writeHistogram(out, "alarm_telegram_poll_seconds", "Один опрос getUpdates", telegram.pollTime());
+    server.send(200, "text/plain; version=0.0.4", out);
+}
+
+
+// ===== Журнал событий по HTTP =====
+// GET /logs?from=<мс>&to=<мс>&limit=<n> - время журнала (поле now в ответе).
+// Журнал принадлежит loop(): сетевая задача откладывает ответ и ставит
+// запрос в очередь, готовый JSON возвращается через httpReplies.
+void handleLogs() {
+    if (logQueriesPending >= LOG_QUERY_SLOTS) {
+        server.send(503, "text/plain", "Busy");
+        return;
+    }
+    LogQuery q;
+    q.from = server.hasArg("from") ? strtoull(server.arg("from").c_str(), nullptr, 10) : 0;
+    q.hasTo = server.hasArg("to");
+    q.to = q.hasTo ? strtoull(server.arg("to").c_str(), nullptr, 10) : 0;
+    q.limit = server.hasArg("limit") ? server.arg("limit").toInt() : LOG_QUERY_LIMIT;
+    if (q.limit <= 0 || q.limit > LOG_HTTP_LIMIT) q.limit = LOG_HTTP_LIMIT;
+    q.ticket = server.defer();
+    if (q.ticket == 0) {
+        server.send(503, "text/plain", "Busy");  // Запрос без соединения отложить нельзя
+        return;
+    }
+    logQueries.tryPush(q);             // Место есть: в работе меньше LOG_QUERY_SLOTS
+    logQueriesPending++;
+}
+
+// Запросы журнала из сетевой задачи (loop())
+void serveLogQueries() {
+    LogQuery q;
+    while (logQueries.tryPop(q)) {
+        uint64_t now = logTime();
+        uint64_t to = q.hasTo ? q.to : now;
+        String response = "{\"now\":" + String((unsigned long long)now) + ",\"events\":[";
+        long count = 0;
+        bool more = false;
+        journal.query(q.from, to, [&](const LogEntry& e) {
+            if (count == q.limit) {
+                more = true;
+                return false;
+            }
+            if (count++ > 0) response += ",";
+            response += "{\"ts\":" + String((unsigned long long)e.timestamp);
+            response += ",\"type\":\"";
+            response += eventTypeName(e.type);
+            response += "\",\"source\":\"";
+            response += eventSourceName(e.source);
+            response += "\",\"alarm\":";
+            response += e.isAlarm ? "true" : "false";
+            response += ",\"details\":\"";
+            for (const char* c = e.details; *c; c++) {
+                if (*c == '"' || *c == '\\') response += '\\';
+                if ((uint8_t)*c >= 0x20) response += *c;
+            }
+            response += "\"}";
+            return true;
+        });
+        response += "],\"more\":";
+        response += more ? "true" : "false";
+        response += "}";
+        // Очередь ответов не меньше очереди запросов: место есть всегда
+        httpReplies.tryPushWith([&](HttpReply& r) {
+            r.ticket = q.ticket;
+            r.body = std::move(response);
+        });
+    }
+}
+
+// Готовые ответы loop() уходят клиентам (сетевая задача)
+void completeHttpReplies() {
+    while (httpReplies.tryPopWith([](HttpReply& r) {
+        server.complete(r.ticket, 200, "application/json", r.body);
+        r.body = String();
+    })) {
+        logQueriesPending--;
+    }
 }
 
 
 // ===== Telegram команды =====
 void handleTelegramMessage(FB_msg& msg) {
-    addToLog("telegram", "user", "Команда: " + msg.text, false);
+    trace.record(TraceKind::TelegramCommand, msg.chatID.c_str(), msg.chatID.length() + 1, msg.text.c_str(),
+                 msg.text.length());
+    char logLine[LOG_DETAILS_LEN];
+    formatUtf8(logLine, sizeof(logLine), "Команда: %s", msg.text.c_str());  // Длинная команда режется по символу
+    addToLog(EventType::Telegram, EventSource::User, logLine);
 
+    const char* chatId = msg.chatID.c_str();
     if (msg.text == "/start") {
-        String welcome = "🚨 *Охранная система*\n\n";
-        welcome += "Статус: " + String(systemArmed ? "🔴 НА ОХРАНЕ" : "🟢 ВЫКЛ") + "\n\n";
-        welcome += "Команды:\n";
-        welcome += "/status - Статус\n";
-        welcome += "/arm - Включить систему сигнализации\n";
-        welcome += "/disarm - Выключить систему сигнализации\n";
-        welcome += "/logs - Последние 10 событий\n";
-        welcome += "/clear_logs - Очистить лог\n";
-        bot.sendMessage(welcome, msg.chatID);
-    }
-
-    if (msg.text == "/arm") {
-        systemArmed = true;
-        bot.sendMessage("✅ Система сигнализации включена", msg.chatID);
-        addToLog("arm", "telegram", "Система сигнализации выключена", false);
-    } 
-    else if (msg.text == "/disarm") {
-        systemArmed = false;
-        alarmActive = false;
-        bot.sendMessage("🔓 Система сигнализации выключена", msg.chatID);
-        addToLog("disarm", "telegram", "Система сигнализации выключена", false);
+        telegram.sendf(chatId, messageText(Msg::Help), security.armed() ? "🔴 НА ОХРАНЕ" : "🟢 ВЫКЛ");
+    }
+
+    if (msg.text == "/arm" || msg.text == "/disarm") {
+        // Ответ и запись в лог - после перехода автомата (onAlarmEvent)
+        AlarmInput input = msg.text == "/arm" ? AlarmInput::Arm : AlarmInput::Disarm;
+        bool posted = security.postWith(input, EventSource::Telegram, [&](AlarmEvent& e) {
+            copyUtf8(e.ref, sizeof(e.ref), msg.chatID.c_str());
+        });
+        if (!posted) telegram.send(messageText(Msg::Busy), chatId);
     }
      else if (msg.text == "/logs") {
-        String logs = getLastEvents(10);
-        bot.sendMessage(logs, msg.chatID);
+        reportLastEvents(10, chatId);
+    }
+    else if (msg.text.startsWith("/logs ")) {
+        // /logs 2h - за последние 2 часа, /logs 3h 2h - с 3 до 2 часов назад
+        String args = msg.text.substring(6);
+        args.trim();
+        int space = args.indexOf(' ');
+        uint64_t fromAgo = parseDurationMs(args.c_str());
+        uint64_t toAgo = space < 0 ? 0 : parseDurationMs(args.c_str() + space + 1);
+        if (fromAgo == 0 || (space >= 0 && toAgo == 0) || toAgo >= fromAgo) {
+            telegram.send(messageText(Msg::LogsUsage), chatId);
+        } else {
+            reportEventsRange(fromAgo, toAgo, chatId);
+        }
     }
     else if (msg.text == "/clear_logs") {
         eventLog.clear();
-        addToLog("system", "telegram", "Лог очищен", false);
-        bot.sendMessage("🧹 Лог очищен", msg.chatID);
+        journal.clear();
+        addToLog(EventType::System, EventSource::Telegram, messageText(Msg::LogCleared));
+        telegram.send(messageText(Msg::LogClearedReply), chatId);
     }
     else if (msg.text == "/test_sound") {
-        playSound("boot");
-        bot.sendMessage("🔊 Тест звука выполнен", msg.chatID);
+        buzzer.play(SOUND_BOOT);
+        telegram.send(messageText(Msg::SoundTest), chatId);
     }
     else if (msg.text == "/rfid_status") {
-        String rfidInfo = "📊 RFID статус:\n";
-        rfidInfo += "Модуль: " + String(rfid.PCD_PerformSelfTest() ? "✅" : "❌") + "\n";
-        rfidInfo += "Последняя карта: " + lastCardUID + "\n";
-        rfidInfo += "Всего карт в базе: " + String(tagCount);
-        bot.sendMessage(rfidInfo);
+        char uidStr[RFID_UID_MAX * 3];
+        // Самопроверка чипа сбросила бы его настройки: состояние знает задача считывателя
+        RfidReaderStats rs = rfidReader.stats();
+        telegram.sendf("", messageText(Msg::RfidStatus), rfidReader.online() ? "✅" : "❌",
+                       (unsigned)rfidReader.version(), (unsigned long)rs.swipes, (unsigned long)rs.repeats,
+                       formatUid(lastCardUID, uidStr, sizeof(uidStr)), (unsigned long)cards.count());
     }
     else if (msg.text == "/list_cards") {
-        String list = "📋 Разрешенные карты:\n";
-        for (int i = 0; i < tagCount; i++) {
-            list += String(i+1) + ". " + authorizedTags[i].uid;
-            list += " - " + authorizedTags[i].owner;
-            list += authorizedTags[i].active ? " ✅" : " ❌";
-            list += "\n";
+        // Длинный список уходит несколькими сообщениями
+        report.begin();
+        report.add("📋 Разрешенные карты:").endLine();
+        int i = 0;
+        cards.forEach([&](const CardUid& uid, const char* owner, bool active) {
+            char uidStr[RFID_UID_MAX * 3];
+            report.addf("%d. %s - %s %s", ++i, formatUid(uid, uidStr, sizeof(uidStr)), owner, active ? "✅" : "❌");
+            report.endLine();
+        });
+        report.finish();
+    }
+    else if (msg.text.startsWith("/add_card")) {
+        // /add_card 23220435 Имя владельца
+        String args = msg.text.substring(9);
+        args.trim();
+        int space = args.indexOf(' ');
+        String owner = space < 0 ? String() : args.substring(space + 1);
+        owner.trim();
+        owner.replace(";", ",");       // ';' - разделитель в файле базы
+        CardUid uid;
+        if (space < 0 || !parseUid(args.substring(0, space).c_str(), uid) || owner.length() == 0) {
+            telegram.send(messageText(Msg::AddCardUsage), chatId);
+        } else {
+            char name[RFID_OWNER_MAX + 1];     // Строка файла базы не длиннее RFID_LINE_MAX
+            copyUtf8(name, sizeof(name), owner.c_str());
+            if (!updateCard(uid, name, true)) {
+                telegram.send(messageText(Msg::CardsFull), chatId);
+            } else {
+                telegram.sendf(chatId, messageText(Msg::CardAdded), name);
+                addToLogf(EventType::Rfid, EventSource::Telegram, messageText(Msg::CardAddedLog), name);
+            }
         }
-        bot.sendMessage(list);
+    }
+    else if (msg.text.startsWith("/revoke_card")) {
+        // /revoke_card 23220435
+        String args = msg.text.substring(12);
+        args.trim();
+        CardUid uid;
+        CardInfo card = {CardStatus::Unknown, ""};
+        if (parseUid(args.c_str(), uid)) {
+            card = cards.lookup(uid);
+        }
+        if (card.status == CardStatus::Unknown) {
+            telegram.send(messageText(Msg::RevokeCardUsage), chatId);
+        } else {
+            updateCard(uid, card.owner, false);  // Имя то же: в пуле оно не переписывается
+            telegram.sendf(chatId, messageText(Msg::CardRevoked), card.owner);
+            addToLogf(EventType::Rfid, EventSource::Telegram, messageText(Msg::CardRevokedLog), card.owner);
+        }
+    }
+    else if (msg.text == "/mem") {
+        reportMemory(chatId);
+    }
+    else if (msg.text == "/sensors") {
+        report.begin(chatId);
+        report.add("📡 Датчики:").endLine();
+        if (sensors.count() == 0) report.add("пока ни один не выходил на связь").endLine();
+        unsigned long now = millis();
+        int i = 0;
+        sensors.forEach([&](uint8_t h) {
+            report.addf("%d. %s", ++i, sensors.id(h));
+            if (sensors.zoneName(h)[0]) report.add(" (").add(sensors.zoneName(h)).add(")");
+            if (sensors.silent(h)) report.add(" ❌ молчит");
+            else if (!sensors.heard(h)) report.add(" ⏳ ждем сигнала");
+            else report.add(" ✅");
+            if (sensors.heard(h)) report.addf(", %lu с назад", (now - sensors.lastSeen(h)) / 1000);
+            if (sensors.rssi(h)) report.addf(", %d дБм", sensors.rssi(h));
+            if (sensors.gaps(h)) report.addf(", потеряно кадров: %lu", (unsigned long)sensors.gaps(h));
+            report.endLine();
+        });
+        report.finish();
+    }
+    else if (msg.text.startsWith("/zone")) {
+        // /zone pir_sensor Прихожая
+        String args = msg.text.substring(5);
+        args.trim();
+        int space = args.indexOf(' ');
+        String zone = space < 0 ? String() : args.substring(space + 1);
+        zone.trim();
+        zone.replace(";", ",");        // ';' - разделитель в файле датчиков
+        String id = space < 0 ? String() : args.substring(0, space);
+        bool added = false;
+        uint8_t h = id.length() ? sensors.intern(id.c_str(), &added) : SENSOR_NONE;
+        if (zone.length() == 0 || id.length() == 0) {
+            telegram.send(messageText(Msg::ZoneUsage), chatId);
+        } else if (h == SENSOR_NONE) {
+            telegram.send(messageText(Msg::SensorsFull), chatId);
+        } else if (!sensors.setZone(h, zone.c_str())) {
+            telegram.sendf(chatId, messageText(Msg::ZonesFull), (unsigned)SENSOR_MAX_ZONES);
+        } else {
+            if (added) sensors.expect(h, millis());  // Заранее заведенный датчик тоже под контролем
+            saveSensors(LittleFS, SENSORS_FILE, sensors);
+            char label[SENSOR_LABEL_LEN];
+            sensorLabel(h, label, sizeof(label));
+            telegram.sendf(chatId, messageText(Msg::ZoneSet), label);
+            addToLogf(EventType::System, EventSource::Telegram, messageText(Msg::ZoneSetLog), label);
+        }
+    }
+}
+
+
+// Команды, принятые задачей Telegram, выполняются в основном цикле
+void processTelegramCommands() {
+    FB_msg msg;
+    while (telegram.popCommand(msg)) {
+        handleTelegramMessage(msg);
+    }
+}
+
+
+// ===== Сетевая задача (ядро 0) =====
+// HTTP и UDP от датчиков не ждут loop(): ответ уходит сразу, как только
+// событие встало в очередь sensorInbox. Один select() ждет и HTTP, и UDP
+// кадры (wakeOn), а NET_WAIT_MS ограничивает задержку ответов из loop().
+void netLoop() {
+    server.handleClient(NET_WAIT_MS);  // HTTP: все соединения с данными
+    handleSensorUdp();                 // События датчиков по UDP
+    completeHttpReplies();             // Отложенные ответы (/logs)
+    publishStatePushes();              // Изменения состояния подписчикам /stream
+}
+
+void netTask(void*) {
+    for (;;) {
+        netLoop();
     }
 }
 
 
 // ===== Стартовая настройка =====
 void setup() {
+    uint8_t bootSetup = boot.start("setup");
     pinMode(BUZZER_PIN, OUTPUT);
-    digitalWrite(BUZZER_PIN, LOW); // Выключена
+    buzzer.begin(BUZZER_PIN, "buzzer"); // Выключена
     Serial.begin(115200);
-    delay(2500);
     
     Serial.println("\n\n\n");
     Serial.println("═══════════════════════════════════════");
     Serial.println("   Охранная система - запуск");
     Serial.println("═══════════════════════════════════════");
-    initRFID();
-
-    Serial.println("[1] Serial инициализирован");
     
-    // WiFi подключение
-    Serial.print("[2] Подключаюсь к WiFi: ");
+    // WiFi подключается в фоне, пока читаются карты и журнал; loop() отметит готовность
+    Serial.print("[1] Подключаюсь к WiFi: ");
     Serial.println(WIFI_SSID);
+    if (!LittleFS.begin(true)) Serial.println("    ❌ LittleFS не смонтирован, кэш WiFi недоступен");
+    bootWifi = boot.start("wifi");
+    wifiLink.begin(LittleFS, WIFI_CACHE_FILE, WIFI_SSID, WIFI_PASS);
+    if (wifiLink.fast()) Serial.println("    По кэшу: точка, канал и адрес с прошлого запуска");
+    if (TRACE_ENABLED) trace.begin(LittleFS, TRACE_DIR, TRACE_SEGMENT_BYTES, TRACE_MAX_SEGMENTS);
     
-    WiFi.begin(WIFI_SSID, WIFI_PASS);
-    
-    Serial.print("[3] Жду подключения");
-    for(int i = 0; i < 20; i++) {
-        if (WiFi.status() == WL_CONNECTED) break;
-        Serial.print(".");
-        delay(500);
-    }
-    Serial.println();
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("[4] ✅ Wi-Fi подключен ");
-        Serial.print("    IP: ");
-        Serial.println(WiFi.localIP());
-    } else {
-        Serial.println("[4] ❌ Wi-Fi не подключен");
-        Serial.println("    Проверьте SSID/пароль в secrets.h");
-    }
+    uint8_t stage = boot.start("rfid");
+    initRFID();
+    boot.done(stage);
+    stage = boot.start("storage");
+    initCardIndex();
+    initJournal();
+    initSensors();
+    boot.done(stage);
     
-    // Настраиваем веб-сервер
+    // Веб-сервер и прием событий слушают сразу: сокеты заработают с подключением WiFi
+    Serial.println("[2] Запуск веб-сервера и сетевой задачи");
+    stage = boot.start("http");
     server.on("/event", HTTP_POST, handleSensorEvent);
+    server.on("/events", HTTP_POST, handleSensorBatch);
+    statusSnapshot.begin((uint16_t)esp_random());
+    refreshStatus();
     server.on("/status", HTTP_GET, handleStatus);
+    server.on("/logs", HTTP_GET, handleLogs);
+    server.on("/metrics", HTTP_GET, handleMetrics);
+    server.on("/mem", HTTP_GET, handleMem);
+    server.on("/stream", HTTP_GET, handleStream);
     server.begin();
+    sensorUdp.begin(SENSOR_UDP_PORT);
+    server.wakeOn(sensorUdp.fd());
+    security.begin(ALARM_TIMEOUT);
+    xTaskCreatePinnedToCore(netTask, "net", NET_TASK_STACK, nullptr, NET_TASK_PRIORITY, &netTaskHandle,
+                            NET_TASK_CORE);
+    boot.done(stage);
     
-    // Настраиваем бота
+    // Настраиваем бота; сообщение о запуске - после подключения WiFi (announceBoot)
     bot.setChatID(ADMIN_CHAT_ID);
-    bot.attach(handleTelegramMessage);
-    bot.sendMessage("🟢 Сервер запущен. IP: " + WiFi.localIP().toString());
+    telegram.begin(ADMIN_CHAT_ID);
+    bootAnnounce = boot.start("announce");
 
-    Serial.println("[5] Настройка завершена");
-    Serial.println("═══════════════════════════════════════\n");
+    // Стеки всех задач - в выборках памяти (GET /mem, /mem)
+    memMonitor.watchTask("loop", xTaskGetCurrentTaskHandle(), LOOP_TASK_STACK);
+    memMonitor.watchTask("net", netTaskHandle, NET_TASK_STACK);
+    memMonitor.watchTask("telegram", telegram.task(), TELEGRAM_TASK_STACK);
+    memMonitor.watchTask("rfid", rfidReader.task(), RFID_TASK_STACK);
 
-    playSound("boot");
+    Serial.println("[3] Настройка завершена, WiFi и Telegram - в фоне");
+    Serial.printf("    Куча: свободно %lu байт, наибольший блок %lu\n", (unsigned long)ESP.getFreeHeap(),
+                  (unsigned long)ESP.getMaxAllocHeap());
+    boot.done(bootSetup);
+
+    buzzer.play(SOUND_BOOT);
+}
+
+// Сообщение о запуске с разбивкой по этапам: один раз, когда WiFi подключился
+void announceBoot() {
+    if (boot.finished(bootAnnounce)) return;
+    boot.done(bootAnnounce);
+    
+    char text[96 + BOOT_MAX_STAGES * 64];
+    int len = snprintf(text, sizeof(text), "🟢 Сервер запущен. IP: %s\n⏱ Готов за %lu мс от сброса:\n",
+                       WiFi.localIP().toString().c_str(), (unsigned long)(boot.readyUs() / 1000));
+    boot.format(text + len, sizeof(text) - len);
+    telegram.send(text);
+    
+    Serial.println("═══════════════════════════════════════");
+    Serial.print(text);
+    Serial.println("═══════════════════════════════════════\n");
 }
 
 
 // ===== Основа =====
 void loop() {
-    server.handleClient();  // Обработка HTTP-запросов
-    bot.tick();             // Обработка Telegram-сообщений
+    uint32_t loopStart = cycleNow();
+    processSensorInputs();  // События датчиков, принятые сетевой задачей
+    processTelegramCommands(); // Обработка Telegram-сообщений
     checkRFID();          // Проверяем RFID карты
+    runAlarm();             // Входы автомата по порядку очереди и таймаут тревоги
     handleBuzzer();         // Обработка звука
+    checkSensors();         // Датчики, пропустившие пульс (только просроченные)
+    flushAlerts();          // Сводки движения и чужих карт за истекшие окна
+    serveLogQueries();      // GET /logs из сетевой задачи
+    checkMemory();          // Выборка кучи и стеков (mem_monitor.h)
+    soakStep();             // Синтетические входы, если включена проверка утечек
+    sensorCount = sensors.count();
+    silentSensorCount = sensors.silentCount();
+    refreshStatus();        // Ответ /status, если что-то изменилось или прошла секунда
 
-    // Автоматическое отключение тревоги через 5 минут
-    if (alarmActive && (millis() - alarmStartTime > ALARM_TIMEOUT)) {
-        alarmActive = false;
-        bot.sendMessage("⏰ Тревога автоматически отключена\nПрошло 5 минут");
-        Serial.println("Тревога автоматически отключена");
+    // Журнал пишется во флеш пачками, а не на каждое событие
+    static unsigned long lastJournalFlush = 0;
+    if (millis() - lastJournalFlush > JOURNAL_FLUSH_MS) {
+        journal.flush();
+        lastJournalFlush = millis();
+    }
+    static unsigned long lastTraceFlush = 0;
+    if (millis() - lastTraceFlush > TRACE_FLUSH_MS) {
+        trace.flush();
+        lastTraceFlush = millis();
     }
 
-    // Проверка Wi-Fi
-    if (WiFi.status() != WL_CONNECTED) {
-        static unsigned long lastReconnect = 0;
-        if (millis() - lastReconnect > 30000) { // Каждые 30 секунд
+    // Wi-Fi: подключение после запуска и переподключение (wifi_fast.h)
+    switch (wifiLink.poll()) {
+        case WifiChange::Connected:
+            Serial.print("✅ Wi-Fi подключен за ");
+            Serial.print(wifiLink.stats().lastConnectMs);
+            Serial.print(" мс, IP: ");
+            Serial.println(WiFi.localIP());
+            boot.done(bootWifi);
+            announceBoot();
+            trace.record(TraceKind::Wifi, 1);
+            break;
+        case WifiChange::Lost:
             Serial.println("🔄 Потеря WiFi, переподключение...");
-            WiFi.reconnect();
-            lastReconnect = millis();
-        }
+            trace.record(TraceKind::Wifi, 0);
+            break;
+        default:
+            break;
+    }
 
-    delay(10);
+    loopTime.recordCycles(loopStart);
+    delay(1); // Все долгие операции вынесены из loop(), достаточно отдать один тик
 }
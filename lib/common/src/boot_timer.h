@@ -0,0 +1,120 @@
+// boot_timer.h - этапы запуска и их время
+//
+// setup() не ждет ни WiFi, ни прогрева PIR, ни Telegram: медленные этапы
+// идут параллельно и заканчиваются уже в loop(). Здесь отмечается, когда
+// каждый этап начался и закончился (micros() от сброса), чтобы после
+// просадки питания было видно, на что ушли секунды до готовности.
+//
+//   uint8_t wifi = boot.start("wifi");
+//   ...
+//   boot.done(wifi);                    // В loop(), когда WiFi подключился
+//   if (boot.ready()) boot.format(buf, sizeof(buf));
+//
+// Пишет только задача управления (setup() и loop()), /metrics читает из
+// любой задачи: отметки - атомарные 32-битные числа.
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "metrics.h"
+
+
+// ===== Настройки =====
+#define BOOT_MAX_STAGES 8
+#define BOOT_NO_STAGE 0xFF
+
+
+class BootTimer {
+public:
+    // Этап начинается сейчас; name - строковый литерал
+    uint8_t start(const char* name) {
+        if (count_ >= BOOT_MAX_STAGES) return BOOT_NO_STAGE;
+        Stage& s = stages_[count_];
+        s.name = name;
+        s.startUs = micros();
+        s.doneUs = 0;
+        count_.store(count_ + 1, std::memory_order_release);
+        return count_ - 1;
+    }
+
+    // Этап закончен (повторный вызов ничего не меняет)
+    void done(uint8_t id) {
+        if (id >= count_ || stages_[id].doneUs) return;
+        uint32_t now = micros();
+        stages_[id].doneUs.store(now ? now : 1, std::memory_order_release);
+    }
+
+    bool finished(uint8_t id) const { return id < count_ && stages_[id].doneUs; }
+
+    // Все этапы закончены
+    bool ready() const {
+        for (uint8_t i = 0; i < count_; i++) {
+            if (!stages_[i].doneUs) return false;
+        }
+        return count_ > 0;
+    }
+
+    // Момент готовности (конец последнего этапа), 0 - еще не готов
+    uint32_t readyUs() const {
+        uint32_t last = 0;
+        for (uint8_t i = 0; i < count_; i++) {
+            uint32_t d = stages_[i].doneUs;
+            if (!d) return 0;
+            last = max(last, d);
+        }
+        return last;
+    }
+
+    uint8_t count() const { return count_; }
+    const char* name(uint8_t id) const { return stages_[id].name; }
+    uint32_t startUs(uint8_t id) const { return stages_[id].startUs; }
+    uint32_t doneUs(uint8_t id) const { return stages_[id].doneUs; }
+
+    // Длительность этапа; незаконченный - до текущего момента
+    uint32_t durationUs(uint8_t id) const {
+        uint32_t d = stages_[id].doneUs;
+        return (d ? d : micros()) - stages_[id].startUs;
+    }
+
+    // Отчет по строке на этап: "  wifi      0.412 -> 1.873 с (1461 мс)"
+    size_t format(char* buf, size_t size) const {
+        size_t len = 0;
+        buf[0] = '\0';
+        for (uint8_t i = 0; i < count_ && len + 1 < size; i++) {
+            uint32_t d = stages_[i].doneUs;
+            int n;
+            if (d) {
+                n = snprintf(buf + len, size - len, "  %-9s %6.3f -> %6.3f с (%lu мс)\n", stages_[i].name,
+                             stages_[i].startUs / 1e6, d / 1e6, (unsigned long)(durationUs(i) / 1000));
+            } else {
+                n = snprintf(buf + len, size - len, "  %-9s %6.3f -> ... (%lu мс)\n", stages_[i].name,
+                             stages_[i].startUs / 1e6, (unsigned long)(durationUs(i) / 1000));
+            }
+            if (n < 0) break;
+            len = min(len + (size_t)n, size - 1);
+        }
+        return len;
+    }
+
+private:
+    struct Stage {
+        const char* name;
+        uint32_t startUs;
+        std::atomic<uint32_t> doneUs;  // 0 - этап еще идет
+    };
+
+    Stage stages_[BOOT_MAX_STAGES] = {};
+    std::atomic<uint8_t> count_{0};
+};
+
+
+// Конец каждого этапа от сброса: name{stage="wifi"}, и момент готовности
+inline void writeBootStages(String& out, const char* name, const char* help, const BootTimer& boot) {
+    writeMetricHeader(out, name, help, "gauge");
+    char line[128];
+    for (uint8_t i = 0; i < boot.count(); i++) {
+        if (!boot.doneUs(i)) continue;
+        snprintf(line, sizeof(line), "%s{stage=\"%s\"} %.6f\n", name, boot.name(i), boot.doneUs(i) / 1e6);
+        out += line;
+    }
+}
@@ -0,0 +1,304 @@
+// input_trace.h - запись входов прошивки в компактную двоичную трассу
+//
+// Чтобы повторить случай с объекта, не дожидаясь нового движения или
+// карты, прошивка пишет все свои входы: уровни PIR, события датчиков
+// (HTTP, пачки, UDP кадры), UID карт, команды Telegram и состояние WiFi.
+// На ПК трасса проигрывается на виртуальных часах (--bench replay).
+//
+// Запись - тип, время от предыдущей записи и длина (varint), затем данные:
+//   [тип 1][dt мс varint][длина varint][данные]
+// Пульс датчика по UDP - 39 байт, уровень PIR - 4 байта.
+//
+//   - record() вызывается из любой задачи: запись кодируется в буфер RAM
+//     под мьютексом, флеш не трогается; буфер полон - запись теряется
+//     (счетчик dropped);
+//   - flush() из loop() переносит буфер в сегмент TRACE_DIR/<n>.bin;
+//     сегмент растет до segmentBytes, самые старые удаляются;
+//   - заголовок сегмента: время первой записи отсчитывается от baseMs,
+//     флаг TRACE_FLAG_BOOT - первый сегмент после перезагрузки.
+// TraceReader разбирает сегмент из памяти - на плате и на ПК одинаково.
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <mutex>
+
+// ===== Настройки =====
+#define TRACE_MAGIC 0x31435254u        // "TRC1"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 12
+#define TRACE_FLAG_BOOT 0x01
+#define TRACE_BUFFER_BYTES 4096        // Записи в RAM до flush()
+#define TRACE_MAX_PAYLOAD 1024         // Длиннее - обрезается (большая пачка /events)
+#define TRACE_RECORD_HEAD 11           // Тип и два varint
+
+
+enum class TraceKind : uint8_t {
+    PirLevel = 1,                      // [уровень]: выход PIR сменился (отсчет 1 кГц)
+    HttpEvent = 2,                     // [ip 4][аргументы "type=motion&sensor_id=..."]
+    HttpBatch = 3,                     // [ip 4][тело POST /events]
+    UdpFrame = 4,                      // [ip 4][кадр SENSOR_FRAME_SIZE]
+    RfidUid = 5,                       // [байты UID]: карта прочитана
+    TelegramCommand = 6,               // [chatId]\0[текст]
+    Wifi = 7                           // [1 - подключен, 0 - потерян]
+};
+
+struct TraceStats {
+    uint32_t records;                  // Записей принято
+    uint32_t dropped;                  // Буфер был полон
+    uint32_t flashBytes;               // Байт записано в сегменты
+    uint32_t segmentsDropped;          // Старых сегментов удалено
+};
+
+// Запись из TraceReader; data указывает внутрь сегмента
+struct TraceRecord {
+    TraceKind kind;
+    uint32_t ms;                       // millis() на плате
+    const uint8_t* data;
+    size_t len;
+};
+
+
+// ===== Формат =====
+inline size_t traceVarint(uint8_t* out, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// 0 - данные кончились или число длиннее 32 бит
+inline size_t traceReadVarint(const uint8_t* p, size_t avail, uint32_t& v) {
+    v = 0;
+    for (size_t i = 0; i < avail && i < 5; i++) {
+        v |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+// Заголовок записи; возвращает его длину (не больше TRACE_RECORD_HEAD)
+inline size_t traceRecordHead(uint8_t* out, TraceKind kind, uint32_t dtMs, size_t len) {
+    out[0] = (uint8_t)kind;
+    size_t n = 1 + traceVarint(out + 1, dtMs);
+    return n + traceVarint(out + n, (uint32_t)len);
+}
+
+inline void tracePut32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+inline uint32_t traceGet32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// [0] magic [4] версия [5] флаги [6..7] резерв [8] baseMs
+inline void traceSegmentHeader(uint8_t* out, uint32_t baseMs, bool boot) {
+    tracePut32(out, TRACE_MAGIC);
+    out[4] = TRACE_VERSION;
+    out[5] = boot ? TRACE_FLAG_BOOT : 0;
+    out[6] = out[7] = 0;
+    tracePut32(out + 8, baseMs);
+}
+
+
+// ===== Чтение сегмента =====
+class TraceReader {
+public:
+    TraceReader(const uint8_t* data, size_t size) : data_(data), size_(size) {
+        valid_ = size >= TRACE_HEADER_SIZE && traceGet32(data) == TRACE_MAGIC && data[4] == TRACE_VERSION;
+        if (!valid_) return;
+        boot_ = data[5] & TRACE_FLAG_BOOT;
+        ms_ = traceGet32(data + 8);
+        pos_ = TRACE_HEADER_SIZE;
+    }
+
+    bool valid() const { return valid_; }
+    bool boot() const { return boot_; }              // Первый сегмент после перезагрузки
+    uint32_t baseMs() const { return valid_ ? traceGet32(data_ + 8) : 0; }
+    bool truncated() const { return truncated_; }    // Оборванная последняя запись
+
+    bool next(TraceRecord& r) {
+        if (!valid_ || pos_ >= size_) return false;
+        uint32_t dt, len;
+        size_t n = 1, k;
+        if ((k = traceReadVarint(data_ + pos_ + n, size_ - pos_ - n, dt)) == 0) return stop();
+        n += k;
+        if ((k = traceReadVarint(data_ + pos_ + n, size_ - pos_ - n, len)) == 0) return stop();
+        n += k;
+        if (len > size_ - pos_ - n) return stop();
+        ms_ += dt;
+        r.kind = (TraceKind)data_[pos_];
+        r.ms = ms_;
+        r.data = data_ + pos_ + n;
+        r.len = len;
+        pos_ += n + len;
+        return true;
+    }
+
+private:
+    bool stop() {
+        truncated_ = true;
+        pos_ = size_;
+        return false;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    uint32_t ms_ = 0;
+    bool valid_ = false;
+    bool boot_ = false;
+    bool truncated_ = false;
+};
+
+
+// ===== Запись =====
+class InputTrace {
+public:
+    // Продолжает нумерацию сегментов с прошлого запуска; до begin() record() ничего не пишет
+    bool begin(fs::FS& fs, const char* dir, size_t segmentBytes, size_t maxSegments) {
+        if (maxSegments < 2 || segmentBytes < TRACE_HEADER_SIZE + TRACE_MAX_PAYLOAD + TRACE_RECORD_HEAD) return false;
+        std::lock_guard<std::mutex> g(lock_);
+        fs_ = &fs;
+        snprintf(dir_, sizeof(dir_), "%s", dir);
+        segmentBytes_ = segmentBytes;
+        maxSegments_ = maxSegments;
+        fs.mkdir(dir_);
+        scan();
+        lastMs_ = flushedMs_ = millis();
+        segSize_ = 0;                  // Первый flush() откроет новый сегмент с флагом перезагрузки
+        bootSegment_ = true;
+        return true;
+    }
+
+    // Из любой задачи; false - трасса не начата или буфер полон
+    bool record(TraceKind kind, const void* head, size_t headLen, const void* body = nullptr, size_t bodyLen = 0) {
+        if (headLen > TRACE_MAX_PAYLOAD) headLen = TRACE_MAX_PAYLOAD;
+        if (bodyLen > TRACE_MAX_PAYLOAD - headLen) bodyLen = TRACE_MAX_PAYLOAD - headLen;
+        std::lock_guard<std::mutex> g(lock_);
+        if (!fs_) return false;
+        if (used_ + TRACE_RECORD_HEAD + headLen + bodyLen > sizeof(buf_)) {
+            stats_.dropped++;
+            return false;
+        }
+        uint32_t now = millis();
+        used_ += traceRecordHead(buf_ + used_, kind, now - lastMs_, headLen + bodyLen);
+        memcpy(buf_ + used_, head, headLen);
+        if (bodyLen) memcpy(buf_ + used_ + headLen, body, bodyLen);
+        used_ += headLen + bodyLen;
+        lastMs_ = now;
+        stats_.records++;
+        return true;
+    }
+
+    bool record(TraceKind kind, uint8_t value) { return record(kind, &value, 1); }
+
+    // Из loop(): буфер - в сегменты. Записи не режутся между сегментами.
+    void flush() {
+        size_t n;
+        {
+            std::lock_guard<std::mutex> g(lock_);
+            if (!fs_ || used_ == 0) return;
+            memcpy(out_, buf_, used_);
+            n = used_;
+            used_ = 0;
+        }
+        size_t from = 0;
+        size_t pos = 0;
+        while (pos < n) {
+            uint32_t dt, len;
+            size_t k1 = traceReadVarint(out_ + pos + 1, n - pos - 1, dt);
+            size_t k2 = traceReadVarint(out_ + pos + 1 + k1, n - pos - 1 - k1, len);
+            size_t recLen = 1 + k1 + k2 + len;
+            if (segSize_ == 0 || segSize_ + (pos - from) + recLen > segmentBytes_) {
+                writeSegment(out_ + from, pos - from);
+                from = pos;
+                startSegment();
+            }
+            flushedMs_ += dt;
+            pos += recLen;
+        }
+        writeSegment(out_ + from, pos - from);
+    }
+
+    TraceStats stats() {
+        std::lock_guard<std::mutex> g(lock_);
+        return stats_;
+    }
+
+    size_t segments() const { return nextId_ - firstId_; }
+
+private:
+    void segmentPath(uint32_t id, char* buf, size_t size) const {
+        snprintf(buf, size, "%s/%08lx.bin", dir_, (unsigned long)id);
+    }
+
+    // Номера сегментов идут подряд: нужны только первый и следующий
+    void scan() {
+        bool any = false;
+        fs::File dir = fs_->open(dir_, "r");
+        for (fs::File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+            unsigned long id;
+            if (strstr(f.name(), ".bin") && sscanf(f.name(), "%8lx", &id) == 1) {
+                if (!any || id < firstId_) firstId_ = (uint32_t)id;
+                if (!any || id >= nextId_) nextId_ = (uint32_t)id + 1;
+                any = true;
+            }
+            f.close();
+        }
+        dir.close();
+    }
+
+    void startSegment() {
+        while (nextId_ - firstId_ >= maxSegments_) {
+            char path[48];
+            segmentPath(firstId_++, path, sizeof(path));
+            fs_->remove(path);
+            std::lock_guard<std::mutex> g(lock_);
+            stats_.segmentsDropped++;
+        }
+        uint8_t header[TRACE_HEADER_SIZE];
+        traceSegmentHeader(header, flushedMs_, bootSegment_);
+        bootSegment_ = false;
+        char path[48];
+        segmentPath(nextId_++, path, sizeof(path));
+        fs::File f = fs_->open(path, "w");
+        segSize_ = f ? f.write(header, sizeof(header)) : 0;
+        if (f) f.close();
+        if (segSize_ == 0) segSize_ = segmentBytes_;  // Флеш полон: следующий flush() попробует снова
+        std::lock_guard<std::mutex> g(lock_);
+        stats_.flashBytes += segSize_ == segmentBytes_ ? 0 : sizeof(header);
+    }
+
+    void writeSegment(const uint8_t* data, size_t len) {
+        if (len == 0) return;
+        char path[48];
+        segmentPath(nextId_ - 1, path, sizeof(path));
+        fs::File f = fs_->open(path, "a");
+        size_t written = f ? f.write(data, len) : 0;
+        if (f) f.close();
+        segSize_ += len;               // Не дописанное не повторяем: сегмент все равно закроется
+        std::lock_guard<std::mutex> g(lock_);
+        stats_.flashBytes += written;
+    }
+
+    std::mutex lock_;
+    fs::FS* fs_ = nullptr;
+    char dir_[24] = "";
+    size_t segmentBytes_ = 0;
+    size_t maxSegments_ = 0;
+    uint32_t firstId_ = 0;
+    uint32_t nextId_ = 0;
+    size_t segSize_ = 0;               // Текущий сегмент, только flush()
+    bool bootSegment_ = false;
+    uint32_t lastMs_ = 0;              // Время последней записи в буфере
+    uint32_t flushedMs_ = 0;           // ...и последней записи, ушедшей в сегмент
+    uint8_t buf_[TRACE_BUFFER_BYTES];
+    uint8_t out_[TRACE_BUFFER_BYTES];  // Копия буфера для записи во флеш без мьютекса
+    size_t used_ = 0;
+    TraceStats stats_ = {};
+};
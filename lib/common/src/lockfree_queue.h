@@ -0,0 +1,92 @@
+// lockfree_queue.h - ограниченная lock-free очередь (несколько писателей и читателей)
+//
+// Кольцо из N ячеек с номерами последовательности (схема Д. Вьюкова).
+// Ни одна операция не блокирует и не выделяет память, поэтому очередь
+// годится для обмена между задачами FreeRTOS на разных ядрах.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+
+template <typename T, size_t N>
+class LockFreeQueue {
+public:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "LockFreeQueue size must be a power of two");
+
+    LockFreeQueue() {
+        for (size_t i = 0; i < N; i++) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // Запись прямо в ячейку: fill(T&) заполняет элемент. false - очередь полна.
+    template <typename F>
+    bool tryPushWith(F&& fill) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        fill(cell->value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T& value) {
+        return tryPushWith([&](T& slot) { slot = value; });
+    }
+
+    // Чтение из ячейки: take(T&) забирает элемент. false - очередь пуста.
+    template <typename F>
+    bool tryPopWith(F&& take) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        take(cell->value);
+        cell->seq.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        return tryPopWith([&](T& slot) { out = slot; });
+    }
+
+    // Примерный размер (точен, только если очередь никто не трогает)
+    size_t size() const {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        size_t h = head_.load(std::memory_order_relaxed);
+        return t >= h ? t - h : 0;
+    }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    Cell cells_[N];
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+};
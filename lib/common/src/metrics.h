@@ -0,0 +1,114 @@
+// metrics.h - гистограммы задержек для горячих путей и вывод /metrics
+//
+// Время замеряется счетчиком тактов процессора (ESP.getCycleCount(),
+// одна инструкция), а не micros(). Счетчик у каждого ядра свой и
+// переполняется за 17 с на 240 МГц, поэтому начало и конец замера должны
+// быть в одной задаче, а долгие интервалы меряются через micros().
+//
+// Корзины фиксированные, по степеням двойки: верхняя граница корзины i -
+// 2^i мкс (1 мкс ... 16.8 с), дальше +Inf. record() - несколько сложений,
+// без памяти и блокировок, писать можно из любой задачи.
+//
+//   static LatencyHistogram loopTime;
+//   uint32_t t0 = cycleNow();
+//   ...
+//   loopTime.record(cyclesToUs(cycleNow() - t0));
+//   writeHistogram(out, "alarm_loop_seconds", "Время прохода loop()", loopTime);
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#define METRIC_BUCKETS 25              // 2^0 ... 2^24 мкс
+
+
+inline uint32_t cycleNow() { return ESP.getCycleCount(); }
+
+inline uint32_t cyclesToUs(uint32_t cycles) {
+    static const uint32_t mhz = ESP.getCpuFreqMHz();
+    return cycles / mhz;
+}
+
+
+class LatencyHistogram {
+public:
+    void record(uint32_t us) {
+        uint8_t i = us <= 1 ? 0 : 32 - __builtin_clz(us - 1);   // Первая граница >= us
+        if (i > METRIC_BUCKETS) i = METRIC_BUCKETS;             // Последняя ячейка - +Inf
+        counts_[i].fetch_add(1, std::memory_order_relaxed);
+        sumUs_.fetch_add(us, std::memory_order_relaxed);
+    }
+
+    void recordCycles(uint32_t startCycles) { record(cyclesToUs(cycleNow() - startCycles)); }
+
+    uint32_t count() const {
+        uint32_t n = 0;
+        for (const auto& c : counts_) n += c.load(std::memory_order_relaxed);
+        return n;
+    }
+    uint32_t bucket(uint8_t i) const { return counts_[i].load(std::memory_order_relaxed); }
+    uint64_t sumUs() const { return sumUs_.load(std::memory_order_relaxed); }
+
+    // Оценка перцентиля по корзинам (верхняя граница корзины), мкс
+    uint32_t percentileUs(double p) const {
+        uint32_t total = count();
+        if (total == 0) return 0;
+        uint32_t need = (uint32_t)(total * p + 0.5);
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+            seen += bucket(i);
+            if (seen >= need) return 1u << i;
+        }
+        return UINT32_MAX;
+    }
+
+    void reset() {
+        for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+        sumUs_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> counts_[METRIC_BUCKETS + 1] = {};
+    std::atomic<uint64_t> sumUs_{0};
+};
+
+
+// ===== Текстовый формат Prometheus =====
+
+inline void writeMetricHeader(String& out, const char* name, const char* help, const char* type) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+inline void writeGauge(String& out, const char* name, const char* help, double value, const char* type = "gauge") {
+    writeMetricHeader(out, name, help, type);
+    char line[96];
+    snprintf(line, sizeof(line), "%s %.10g\n", name, value);
+    out += line;
+}
+
+inline void writeHistogram(String& out, const char* name, const char* help, const LatencyHistogram& h) {
+    writeMetricHeader(out, name, help, "histogram");
+    char line[128];
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < METRIC_BUCKETS; i++) {
+        cumulative += h.bucket(i);
+        snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %lu\n", name, (double)(1u << i) / 1e6,
+                 (unsigned long)cumulative);
+        out += line;
+    }
+    cumulative += h.bucket(METRIC_BUCKETS);
+    snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %lu\n", name, (unsigned long)cumulative);
+    out += line;
+    snprintf(line, sizeof(line), "%s_sum %.6f\n", name, h.sumUs() / 1e6);
+    out += line;
+    snprintf(line, sizeof(line), "%s_count %lu\n", name, (unsigned long)cumulative);
+    out += line;
+}
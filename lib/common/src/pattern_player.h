@@ -0,0 +1,129 @@
+// pattern_player.h - звуковые и световые сигналы по таблице без delay()
+//
+// Сигнал - constexpr массив длительностей в мс: вкл, выкл, вкл, ...
+// Шаги переключает однократный esp_timer, play() сразу возвращается.
+// У сигнала есть приоритет: тревога прерывает короткий писк, а писк
+// во время тревоги не звучит. Вне сигнала выход в состоянии setIdle().
+//
+//   constexpr uint16_t BEEP_STEPS[] = {50, 50};
+//   constexpr Pattern SOUND_BEEP = makePattern(BEEP_STEPS, PATTERN_PRIO_CHIRP, 3);
+//   buzzer.play(SOUND_BEEP);
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+#include <mutex>
+
+#define PATTERN_PRIO_STATUS 0          // Индикация состояния (мигание светодиода)
+#define PATTERN_PRIO_CHIRP 1           // Короткие подтверждения
+#define PATTERN_PRIO_ALARM 3           // Тревога
+
+
+struct Pattern {
+    const uint16_t* steps;             // Длительности: четные шаги - вкл, нечетные - выкл
+    uint8_t count;
+    uint8_t priority;
+    uint8_t repeats;                   // Сколько раз проиграть, 0 - до stop()
+};
+
+template <size_t N>
+constexpr Pattern makePattern(const uint16_t (&steps)[N], uint8_t priority, uint8_t repeats = 1) {
+    static_assert(N > 0 && N < 256, "Pattern must have 1..255 steps");
+    return {steps, (uint8_t)N, priority, repeats};
+}
+
+
+class PatternPlayer {
+public:
+    void begin(uint8_t pin, const char* name = "pattern") {
+        pin_ = pin;
+        esp_timer_create_args_t args = {};
+        args.callback = onTick;
+        args.arg = this;
+        args.name = name;
+        esp_timer_create(&args, &timer_);
+        digitalWrite(pin_, LOW);
+    }
+
+    // false - сейчас звучит сигнал важнее
+    bool play(const Pattern& p) {
+        std::lock_guard<std::mutex> g(lock_);
+        const Pattern* cur = current_;
+        if (cur && cur->priority > p.priority) {
+            rejected_++;
+            return false;
+        }
+        esp_timer_stop(timer_);
+        current_ = &p;
+        step_ = 0;
+        round_ = 0;
+        played_++;
+        applyStep();
+        return true;
+    }
+
+    // Остановка, только если играет именно p (тревогу не снимет чужой stop)
+    void stop(const Pattern& p) {
+        std::lock_guard<std::mutex> g(lock_);
+        if (current_ == &p) finish();
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> g(lock_);
+        if (current_) finish();
+    }
+
+    // Состояние выхода вне сигналов (светодиод горит - WiFi подключен)
+    void setIdle(bool on) {
+        std::lock_guard<std::mutex> g(lock_);
+        if (idle_ == on) return;
+        idle_ = on;
+        if (!current_) digitalWrite(pin_, on ? HIGH : LOW);
+    }
+
+    bool playing() const { return current_ != nullptr; }
+    bool playing(const Pattern& p) const { return current_ == &p; }
+    uint32_t played() const { return played_; }
+    uint32_t rejected() const { return rejected_; }      // Перебиты более важным сигналом
+
+private:
+    static void onTick(void* arg) {
+        PatternPlayer* self = static_cast<PatternPlayer*>(arg);
+        std::lock_guard<std::mutex> g(self->lock_);
+        // Таймер уже перезапущен play(): этот вызов относится к прошлому сигналу
+        if (esp_timer_is_active(self->timer_)) return;
+        const Pattern* p = self->current_;
+        if (!p) return;
+        if (++self->step_ == p->count) {
+            self->step_ = 0;
+            if (p->repeats && ++self->round_ == p->repeats) {
+                self->finish();
+                return;
+            }
+        }
+        self->applyStep();
+    }
+
+    void applyStep() {
+        const Pattern* p = current_;
+        digitalWrite(pin_, step_ % 2 == 0 ? HIGH : LOW);
+        esp_timer_start_once(timer_, (uint64_t)p->steps[step_] * 1000);
+    }
+
+    void finish() {
+        esp_timer_stop(timer_);
+        current_ = nullptr;
+        digitalWrite(pin_, idle_ ? HIGH : LOW);
+    }
+
+    uint8_t pin_ = 0;
+    esp_timer_handle_t timer_ = nullptr;
+    std::mutex lock_;
+    std::atomic<const Pattern*> current_{nullptr};
+    uint8_t step_ = 0;
+    uint8_t round_ = 0;
+    bool idle_ = false;
+    std::atomic<uint32_t> played_{0};
+    std::atomic<uint32_t> rejected_{0};
+};
@@ -0,0 +1,185 @@
+// sensor_proto.h - бинарный протокол датчик -> сервер поверх UDP
+//
+// Кадр фиксированного размера (32 байта, little-endian), без разбора текста:
+//   0  magic 0xA7     1  версия     2  тип кадра     3  код события
+//   4  bootId (u16)   6  флаги      7  RSSI датчика, дБм (i8, 0 - неизвестно)
+//   8  seq (u32)      12 время события на часах датчика, мкс (u32)
+//   16 sensorId, 16 байт, дополняется нулями
+// Датчик шлет EVENT, сервер отвечает ACK с тем же sensorId/bootId/seq.
+// Повторы одного seq сервер подтверждает, но обрабатывает только первый.
+// bootId меняется при каждой перезагрузке датчика, seq тогда идет с 1.
+// Время события - фронт PIR для движения, момент отправки для остальных:
+// по кадрам пульса сервер оценивает сдвиг часов и считает возраст события.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SENSOR_UDP_PORT 4210
+#define SENSOR_FRAME_SIZE 32
+#define SENSOR_FRAME_MAGIC 0xA7
+#define SENSOR_FRAME_VERSION 2         // 2: время события в мкс вместо мс отправки
+#define SENSOR_ID_LEN 16
+
+enum class FrameKind : uint8_t { Event = 1, Ack = 2 };
+
+enum class SensorEvent : uint8_t { Motion = 1, MotionEnd = 2, Heartbeat = 3, Tamper = 4 };
+
+// Флаги ACK: состояние сервера, чтобы датчику не нужен был отдельный запрос
+#define ACK_FLAG_ARMED 0x01
+#define ACK_FLAG_ALARM 0x02
+
+struct SensorFrame {
+    FrameKind kind;
+    SensorEvent event;
+    uint8_t flags;
+    int8_t rssi;
+    uint16_t bootId;
+    uint32_t seq;
+    uint32_t eventUs;                  // micros() датчика: фронт PIR или отправка
+    char sensorId[SENSOR_ID_LEN + 1];
+};
+
+
+// Имена событий совпадают с полем type в HTTP /event
+inline const char* sensorEventName(SensorEvent e) {
+    switch (e) {
+        case SensorEvent::Motion:    return "motion";
+        case SensorEvent::MotionEnd: return "motion_end";
+        case SensorEvent::Heartbeat: return "heartbeat";
+        case SensorEvent::Tamper:    return "tamper";
+    }
+    return "other";
+}
+
+// Поле value в HTTP /event
+inline const char* sensorEventValue(SensorEvent e) {
+    switch (e) {
+        case SensorEvent::Motion:    return "detected";
+        case SensorEvent::MotionEnd: return "clear";
+        case SensorEvent::Heartbeat: return "alive";
+        case SensorEvent::Tamper:    return "open";
+    }
+    return "";
+}
+
+inline bool sensorEventFromName(const char* name, SensorEvent& out) {
+    for (uint8_t i = 1; i <= 4; i++) {
+        if (strcmp(name, sensorEventName((SensorEvent)i)) == 0) {
+            out = (SensorEvent)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// ===== Кодирование =====
+inline void encodeFrame(const SensorFrame& f, uint8_t* buf) {
+    buf[0] = SENSOR_FRAME_MAGIC;
+    buf[1] = SENSOR_FRAME_VERSION;
+    buf[2] = (uint8_t)f.kind;
+    buf[3] = (uint8_t)f.event;
+    buf[4] = (uint8_t)f.bootId;
+    buf[5] = (uint8_t)(f.bootId >> 8);
+    buf[6] = f.flags;
+    buf[7] = (uint8_t)f.rssi;
+    for (int i = 0; i < 4; i++) {
+        buf[8 + i] = (uint8_t)(f.seq >> (8 * i));
+        buf[12 + i] = (uint8_t)(f.eventUs >> (8 * i));
+    }
+    size_t len = strnlen(f.sensorId, SENSOR_ID_LEN);
+    memcpy(buf + 16, f.sensorId, len);
+    memset(buf + 16 + len, 0, SENSOR_ID_LEN - len);
+}
+
+// false - чужой или поврежденный кадр
+inline bool decodeFrame(const uint8_t* buf, size_t len, SensorFrame& f) {
+    if (len != SENSOR_FRAME_SIZE || buf[0] != SENSOR_FRAME_MAGIC || buf[1] != SENSOR_FRAME_VERSION) return false;
+    if (buf[2] != (uint8_t)FrameKind::Event && buf[2] != (uint8_t)FrameKind::Ack) return false;
+    f.kind = (FrameKind)buf[2];
+    f.event = (SensorEvent)buf[3];
+    f.bootId = (uint16_t)(buf[4] | buf[5] << 8);
+    f.flags = buf[6];
+    f.rssi = (int8_t)buf[7];
+    f.seq = 0;
+    f.eventUs = 0;
+    for (int i = 0; i < 4; i++) {
+        f.seq |= (uint32_t)buf[8 + i] << (8 * i);
+        f.eventUs |= (uint32_t)buf[12 + i] << (8 * i);
+    }
+    memcpy(f.sensorId, buf + 16, SENSOR_ID_LEN);
+    f.sensorId[SENSOR_ID_LEN] = '\0';
+    return f.sensorId[0] != '\0';
+}
+
+
+// ===== Отсев повторов на сервере =====
+// Для каждого датчика - последний обработанный seq и окно из 32 предыдущих
+// (кадры могут прийти не по порядку). Таблица маленькая и фиксированная:
+// при переполнении вытесняется самый давний датчик.
+template <size_t N>
+class SeqTracker {
+public:
+    // true - кадр новый и его нужно обработать
+    bool accept(const SensorFrame& f, uint32_t now) {
+        Peer* p = nullptr;
+        Peer* oldest = &peers_[0];
+        for (size_t i = 0; i < N; i++) {
+            if (peers_[i].used && strcmp(peers_[i].id, f.sensorId) == 0) {
+                p = &peers_[i];
+                break;
+            }
+            if (!peers_[i].used) {
+                if (oldest->used) oldest = &peers_[i];
+            } else if (oldest->used && peers_[i].seenAt < oldest->seenAt) {
+                oldest = &peers_[i];
+            }
+        }
+        if (!p) {
+            p = oldest;
+            p->used = true;
+            memcpy(p->id, f.sensorId, sizeof(p->id));
+            p->bootId = f.bootId;
+            p->lastSeq = 0;
+            p->window = 0;
+        }
+        p->seenAt = now;
+        if (p->bootId != f.bootId) {
+            p->bootId = f.bootId;     // Датчик перезагрузился
+            p->lastSeq = 0;
+            p->window = 0;
+        }
+        if (f.seq > p->lastSeq) {
+            uint32_t shift = f.seq - p->lastSeq;
+            p->window = shift >= 32 ? 0 : p->window << shift;
+            p->window |= 1;           // Бит 0 - сам lastSeq
+            p->lastSeq = f.seq;
+            return true;
+        }
+        // Кадр пришел не по порядку: окно помнит 32 последних номера
+        uint32_t age = p->lastSeq - f.seq;
+        if (age >= 32 || (p->window & (1u << age))) {
+            duplicates_++;
+            return false;
+        }
+        p->window |= 1u << age;
+        return true;
+    }
+
+    uint32_t duplicates() const { return duplicates_; }
+
+private:
+    struct Peer {
+        bool used = false;
+        char id[SENSOR_ID_LEN + 1];
+        uint16_t bootId;
+        uint32_t lastSeq;
+        uint32_t window;              // Принятые lastSeq, lastSeq-1 ... lastSeq-31
+        uint32_t seenAt;
+    };
+
+    Peer peers_[N];
+    uint32_t duplicates_ = 0;
+};
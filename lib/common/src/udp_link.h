@@ -0,0 +1,175 @@
+// udp_link.h - отправка событий датчика по UDP с подтверждением и повторами
+//
+// send() кодирует кадр и сразу отправляет его, не дожидаясь ответа.
+// poll() из loop() принимает ACK и повторяет неподтвержденные кадры:
+// через UDP_RETRY_MS, потом с удвоением паузы. Если за UDP_MAX_RETRIES
+// повторов ACK не пришел, событие отдается в fallback (HTTP /event).
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "sensor_proto.h"
+#include "metrics.h"
+
+
+// ===== Настройки (можно переопределить в config.h) =====
+#ifndef UDP_RETRY_MS
+#define UDP_RETRY_MS 30                // Первая пауза перед повтором
+#endif
+#ifndef UDP_MAX_RETRIES
+#define UDP_MAX_RETRIES 4              // Повторов до перехода на HTTP
+#endif
+#define UDP_LINK_SLOTS 4               // Кадров в полете одновременно
+
+
+struct UdpLinkStats {
+    uint32_t sent;
+    uint32_t acked;
+    uint32_t retransmits;
+    uint32_t fallbacks;                // Ушли через fallback
+    uint32_t lastRttUs;                // От первой отправки до ACK
+};
+
+
+class UdpLink {
+public:
+    typedef void (*FallbackFn)(SensorEvent event, const char* sensorId, uint32_t eventUs);
+
+    bool begin(const char* serverIp, uint16_t port, FallbackFn fallback) {
+        if (!server_.fromString(serverIp)) return false;
+        port_ = port;
+        fallback_ = fallback;
+        bootId_ = (uint16_t)(esp_random() | 1);
+        return udp_.begin(0) == 1;     // Любой локальный порт
+    }
+
+    // false - все слоты заняты или сокет не готов; событие сразу уходит в fallback
+    // rssi - уровень WiFi датчика для реестра сервера (0 - не передавать)
+    // eventUs - micros() фронта PIR, 0 - событие происходит сейчас
+    bool send(SensorEvent event, const char* sensorId, int8_t rssi = 0, uint32_t eventUs = 0) {
+        if (eventUs == 0) eventUs = micros();
+        Slot* slot = nullptr;
+        for (Slot& s : slots_) {
+            if (!s.used) {
+                slot = &s;
+                break;
+            }
+        }
+        if (!slot || port_ == 0) {
+            toFallback(event, sensorId, eventUs);
+            return false;
+        }
+
+        SensorFrame f;
+        f.kind = FrameKind::Event;
+        f.event = event;
+        f.flags = 0;
+        f.rssi = rssi;
+        f.bootId = bootId_;
+        f.seq = ++seq_;
+        f.eventUs = eventUs;
+        strncpy(f.sensorId, sensorId, SENSOR_ID_LEN);
+        f.sensorId[SENSOR_ID_LEN] = '\0';
+        encodeFrame(f, slot->frame);
+
+        slot->used = true;
+        slot->seq = f.seq;
+        slot->event = event;
+        slot->eventUs = eventUs;
+        memcpy(slot->sensorId, f.sensorId, sizeof(slot->sensorId));
+        slot->attempts = 0;
+        slot->firstSentUs = micros();
+        transmit(*slot);
+        stats_.sent++;
+        return true;
+    }
+
+    void poll() {
+        // Все пришедшие ACK
+        uint8_t buf[SENSOR_FRAME_SIZE];
+        while (udp_.parsePacket() > 0) {
+            int n = udp_.read(buf, sizeof(buf));
+            SensorFrame ack;
+            if (!decodeFrame(buf, n, ack) || ack.kind != FrameKind::Ack || ack.bootId != bootId_) continue;
+            serverFlags_ = ack.flags;
+            haveServerState_ = true;
+            for (Slot& s : slots_) {
+                if (s.used && s.seq == ack.seq) {
+                    stats_.lastRttUs = micros() - s.firstSentUs;
+                    rtt_.record(stats_.lastRttUs);
+                    stats_.acked++;
+                    s.used = false;
+                }
+            }
+        }
+
+        // Повторы и переход на fallback
+        uint32_t now = millis();
+        for (Slot& s : slots_) {
+            if (!s.used || (int32_t)(now - s.nextAt) < 0) continue;
+            if (s.attempts > UDP_MAX_RETRIES) {
+                s.used = false;
+                toFallback(s.event, s.sensorId, s.eventUs);
+                continue;
+            }
+            transmit(s);
+            stats_.retransmits++;
+        }
+    }
+
+    size_t inFlight() const {
+        size_t n = 0;
+        for (const Slot& s : slots_) n += s.used ? 1 : 0;
+        return n;
+    }
+
+    // Состояние сервера из последнего ACK (ACK_FLAG_*)
+    bool haveServerState() const { return haveServerState_; }
+    uint8_t serverFlags() const { return serverFlags_; }
+    const UdpLinkStats& stats() const { return stats_; }
+    const LatencyHistogram& rtt() const { return rtt_; }   // Первая отправка -> ACK
+
+#ifdef NATIVE_BUILD
+    // Хостовые бенчмарки: ждать ACK, не крутясь в poll()
+    bool waitAck(uint32_t timeoutMs) { return udp_.waitPacket(timeoutMs); }
+#endif
+
+private:
+    struct Slot {
+        bool used = false;
+        uint8_t attempts;
+        SensorEvent event;
+        uint32_t seq;
+        uint32_t nextAt;               // millis() следующего повтора
+        uint32_t firstSentUs;
+        uint32_t eventUs;
+        char sensorId[SENSOR_ID_LEN + 1];
+        uint8_t frame[SENSOR_FRAME_SIZE];
+    };
+
+    void transmit(Slot& s) {
+        udp_.beginPacket(server_, port_);
+        udp_.write(s.frame, sizeof(s.frame));
+        udp_.endPacket();
+        // 30, 60, 120... мс
+        s.nextAt = millis() + ((uint32_t)UDP_RETRY_MS << s.attempts);
+        s.attempts++;
+    }
+
+    void toFallback(SensorEvent event, const char* sensorId, uint32_t eventUs) {
+        stats_.fallbacks++;
+        if (fallback_) fallback_(event, sensorId, eventUs);
+    }
+
+    WiFiUDP udp_;
+    IPAddress server_;
+    uint16_t port_ = 0;
+    uint16_t bootId_ = 0;
+    uint32_t seq_ = 0;
+    FallbackFn fallback_ = nullptr;
+    Slot slots_[UDP_LINK_SLOTS];
+    uint8_t serverFlags_ = 0;
+    bool haveServerState_ = false;
+    UdpLinkStats stats_ = {};
+    LatencyHistogram rtt_;
+};
@@ -0,0 +1,173 @@
+// wifi_fast.h - подключение к WiFi без ожидания в setup()
+//
+// Обычное подключение - сканирование всех каналов, ассоциация и DHCP -
+// занимает секунды. После успешного подключения точка доступа (BSSID),
+// канал и полученный адрес сохраняются во флеш; при следующем запуске
+// WiFi.begin() сразу идет на этот канал и точку, а адрес ставится
+// статически через WiFi.config(), без DHCP.
+//
+// Если за WIFI_FAST_TIMEOUT_MS быстрое подключение не удалось (точку
+// перенесли на другой канал, сменили роутер), кэш сбрасывается и идет
+// обычное подключение с DHCP. Дальше при обрывах - WiFi.reconnect()
+// раз в WIFI_RETRY_MS.
+//
+//   wifiLink.begin(LittleFS, WIFI_CACHE_FILE, WIFI_SSID, WIFI_PASS);
+//   ...
+//   switch (wifiLink.poll()) {            // В loop(), не блокирует
+//       case WifiChange::Connected: ...
+//       case WifiChange::Lost: ...
+//   }
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <WiFi.h>
+
+
+// ===== Настройки =====
+#define WIFI_FAST_TIMEOUT_MS 3000      // Быстрое подключение по кэшу, затем обычное
+#define WIFI_RETRY_MS 30000            // Переподключение после обрыва
+#define WIFI_FAST_STATIC_IP true       // false - адрес всегда по DHCP, кэш только BSSID и канал
+#define WIFI_CACHE_MAGIC 0x57464331    // "WFC1"
+
+
+enum class WifiChange : uint8_t { None, Connected, Lost };
+
+struct WifiLinkStats {
+    uint32_t fastAttempts;             // Запусков с кэшем точки и адреса
+    uint32_t fastMisses;               // Из них не подключились, ушли на обычное
+    uint32_t connects;
+    uint32_t drops;
+    uint32_t lastConnectMs;            // begin() или обрыв -> подключение
+};
+
+
+class WifiFastConnect {
+public:
+    // Запускает подключение и сразу возвращается
+    void begin(fs::FS& fs, const char* cachePath, const char* ssid, const char* pass) {
+        fs_ = &fs;
+        path_ = cachePath;
+        ssid_ = ssid;
+        pass_ = pass;
+        up_ = false;
+        WiFi.mode(WIFI_STA);
+        WiFi.setAutoReconnect(true);
+        if (loadCache()) {
+            startFast();
+        } else {
+            startFull();
+        }
+    }
+
+    // Следит за подключением; изменение возвращается один раз
+    WifiChange poll() {
+        uint32_t now = millis();
+        bool connected = WiFi.status() == WL_CONNECTED;
+        if (connected && !up_) {
+            up_ = true;
+            stats_.connects++;
+            stats_.lastConnectMs = now - startedAt_;
+            fast_ = false;
+            saveCache();
+            return WifiChange::Connected;
+        }
+        if (!connected && up_) {
+            up_ = false;
+            stats_.drops++;
+            startedAt_ = retryAt_ = now;
+            return WifiChange::Lost;
+        }
+        if (!connected) {
+            if (fast_ && now - startedAt_ > WIFI_FAST_TIMEOUT_MS) {
+                // Кэш устарел: обычное подключение со сканированием и DHCP
+                stats_.fastMisses++;
+                cacheValid_ = false;
+                WiFi.disconnect();
+                startFull();
+            } else if (!fast_ && now - retryAt_ > WIFI_RETRY_MS) {
+                WiFi.reconnect();
+                retryAt_ = now;
+            }
+        }
+        return WifiChange::None;
+    }
+
+    bool connected() const { return up_; }
+    bool fast() const { return fast_; }        // Идет быстрое подключение по кэшу
+    const WifiLinkStats& stats() const { return stats_; }
+
+private:
+    struct Cache {
+        uint32_t magic;
+        uint32_t ssidHash;             // Кэш другой сети не подходит
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint8_t reserved;
+        uint32_t ip, gateway, subnet, dns;
+    };
+
+    static uint32_t hash(const char* s) {
+        uint32_t h = 2166136261u;      // FNV-1a
+        while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+        return h;
+    }
+
+    void startFast() {
+        stats_.fastAttempts++;
+        fast_ = true;
+        startedAt_ = retryAt_ = millis();
+        if (WIFI_FAST_STATIC_IP && cache_.ip) {
+            WiFi.config(IPAddress(cache_.ip), IPAddress(cache_.gateway), IPAddress(cache_.subnet),
+                        IPAddress(cache_.dns));
+        }
+        WiFi.begin(ssid_, pass_, cache_.channel, cache_.bssid);
+    }
+
+    void startFull() {
+        fast_ = false;
+        startedAt_ = retryAt_ = millis();
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());   // Нули - снова DHCP
+        WiFi.begin(ssid_, pass_);
+    }
+
+    bool loadCache() {
+        fs::File f = fs_->open(path_, "r");
+        cacheValid_ = f && f.read((uint8_t*)&cache_, sizeof(cache_)) == sizeof(cache_) &&
+                      cache_.magic == WIFI_CACHE_MAGIC && cache_.ssidHash == hash(ssid_) && cache_.channel;
+        return cacheValid_;
+    }
+
+    // Пишем только если что-то изменилось: флеш не изнашивается на каждом запуске
+    void saveCache() {
+        Cache c = {};
+        c.magic = WIFI_CACHE_MAGIC;
+        c.ssidHash = hash(ssid_);
+        const uint8_t* bssid = WiFi.BSSID();
+        if (bssid) memcpy(c.bssid, bssid, sizeof(c.bssid));
+        c.channel = (uint8_t)WiFi.channel();
+        c.ip = WiFi.localIP();
+        c.gateway = WiFi.gatewayIP();
+        c.subnet = WiFi.subnetMask();
+        c.dns = WiFi.dnsIP();
+        if (cacheValid_ && memcmp(&c, &cache_, sizeof(c)) == 0) return;
+        fs::File f = fs_->open(path_, "w");
+        if (!f) return;
+        f.write((const uint8_t*)&c, sizeof(c));
+        f.close();
+        cache_ = c;
+        cacheValid_ = true;
+    }
+
+    fs::FS* fs_ = nullptr;
+    const char* path_ = "";
+    const char* ssid_ = "";
+    const char* pass_ = "";
+    Cache cache_ = {};
+    bool cacheValid_ = false;
+    bool fast_ = false;
+    bool up_ = false;
+    uint32_t startedAt_ = 0;
+    uint32_t retryAt_ = 0;
+    WifiLinkStats stats_ = {};
+};
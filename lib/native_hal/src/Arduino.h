@@ -0,0 +1,115 @@
+// Arduino.h - минимальное ядро Arduino для хостовой (native) сборки
+//
+// Реализует только то подмножество API, которое используют прошивки:
+// время, GPIO, Serial, String и объект ESP. Состояние "железа" управляется
+// из бенчмарков через hal_sim.h.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "WString.h"
+#include "IPAddress.h"
+#include "freertos/FreeRTOS.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+using std::min;
+using std::max;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT          0x01
+#define OUTPUT         0x03
+#define INPUT_PULLUP   0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define IRAM_ATTR
+
+
+// ===== Время =====
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+
+// ===== GPIO =====
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+// Прерывание вызывается синхронно из sim::setPin() при смене уровня
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+
+// ===== Serial =====
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() const { return true; }
+
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { char b[2] = {c, 0}; return write(b); }
+    size_t print(int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned char v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, (unsigned int)decimals)); }
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+
+    template <typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + write("\n"); }
+    template <typename T>
+    size_t println(const T& v, int base) { size_t n = print(v, base); return n + write("\n"); }
+    size_t println() { return write("\n"); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    size_t write(const char* s);
+};
+
+extern HardwareSerial Serial;
+
+
+// ===== Информация о чипе =====
+class EspClass {
+public:
+    const char* getChipModel() { return "native"; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getCycleCount();            // Такты по реальному времени ПК (часы прошивки не влияют)
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();           // Минимум свободной кучи с запуска (или с sim::resetHeapPeak())
+    uint32_t getMaxAllocHeap();          // Наибольший блок; на ПК дробления нет - равен свободной куче
+    uint32_t getHeapSize();
+    uint32_t getPsramSize() { return 0; }    // PSRAM на ПК - обычная куча, отдельно не считается
+    uint32_t getFreePsram() { return 0; }
+    void restart();
+};
+
+extern EspClass ESP;
+
+uint32_t esp_random();                   // Аппаратный ГСЧ (на ПК - std::random_device)
+
+// PSRAM (на ПК - обычная куча)
+inline bool psramFound() { return true; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+
+
+// Точки входа прошивки
+void setup();
+void loop();
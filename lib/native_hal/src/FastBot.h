@@ -0,0 +1,47 @@
+// FastBot.h - Telegram бот (API GyverLibs/FastBot) для хостовой сборки
+//
+// Исходящие сообщения складываются в sim::telegram(), входящие команды
+// подкладываются туда же и раздаются в tick(). Задержку HTTPS запроса
+// можно имитировать через sendLatencyMs / pollLatencyMs.
+#pragma once
+
+#include "Arduino.h"
+
+struct FB_msg {
+    String userID;
+    String username;
+    String chatID;
+    int32_t messageID = 0;
+    String text;
+    String data;
+    bool query = false;
+    bool edited = false;
+    bool isBot = false;
+    bool OTA = false;
+};
+
+
+class FastBot {
+public:
+    explicit FastBot(const String& token = "") : token_(token) {}
+
+    void setToken(const String& token) { token_ = token; }
+    void setChatID(const String& chatID) { chatID_ = chatID; }
+    void setChatID(const char* chatID) { chatID_ = chatID; }
+    void attach(void (*handler)(FB_msg& msg)) { handler_ = handler; }
+    void detach() { handler_ = nullptr; }
+    void setPeriod(uint16_t period) { period_ = period; }
+    void setLimit(uint16_t limit) { limit_ = limit; }
+
+    uint8_t tick();
+    uint8_t tickManual();
+    uint8_t sendMessage(const String& msg, const String& id = "");
+
+private:
+    String token_;
+    String chatID_;
+    void (*handler_)(FB_msg& msg) = nullptr;
+    uint16_t period_ = 3600;
+    uint16_t limit_ = 10;
+    uint32_t lastPoll_ = 0;
+};
@@ -0,0 +1,35 @@
+// HTTPClient.h - HTTP клиент для хостовой сборки
+//
+// Запрос уходит по настоящему TCP (порт через sim::hostPort), если в
+// sim::httpClient() не задан handler, подменяющий сервер.
+#pragma once
+
+#include "Arduino.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_READ_TIMEOUT       (-11)
+
+
+class HTTPClient {
+public:
+    bool begin(const String& url) { url_ = url; return true; }
+    void end() { url_ = String(); headers_ = String(); }
+    void addHeader(const String& name, const String& value) { headers_ += name + ": " + value + "\r\n"; }
+    void setTimeout(uint16_t ms) { timeoutMs_ = ms; }
+    void setReuse(bool reuse) { (void)reuse; }
+
+    int POST(const String& payload) { return request("POST", payload); }
+    int POST(const uint8_t* payload, size_t size) {
+        return POST(String(std::string((const char*)payload, size)));
+    }
+    int GET() { return request("GET", String()); }
+    String getString() { return response_; }
+
+private:
+    int request(const char* method, const String& payload);
+
+    String url_;
+    String headers_;
+    uint16_t timeoutMs_ = 5000;
+    String response_;
+};
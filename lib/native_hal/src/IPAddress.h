@@ -0,0 +1,43 @@
+// IPAddress.h - IPv4 адрес для хостовой сборки
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "WString.h"
+
+
+class IPAddress {
+public:
+    IPAddress() : addr_{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr_{a, b, c, d} {}
+    explicit IPAddress(uint32_t v)
+        : addr_{(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)} {}
+
+    // Как в Arduino: младший байт - первый октет
+    operator uint32_t() const {
+        return addr_[0] | (addr_[1] << 8) | (addr_[2] << 16) | ((uint32_t)addr_[3] << 24);
+    }
+    uint8_t operator[](int i) const { return addr_[i]; }
+    uint8_t& operator[](int i) { return addr_[i]; }
+    bool operator==(const IPAddress& o) const { return (uint32_t)*this == (uint32_t)o; }
+
+    bool fromString(const char* s) {
+        unsigned a, b, c, d;
+        char tail;
+        if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+            return false;
+        }
+        *this = IPAddress((uint8_t)a, (uint8_t)b, (uint8_t)c, (uint8_t)d);
+        return true;
+    }
+    bool fromString(const String& s) { return fromString(s.c_str()); }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr_[0], addr_[1], addr_[2], addr_[3]);
+        return String(buf);
+    }
+
+private:
+    uint8_t addr_[4];
+};
@@ -0,0 +1,68 @@
+// MFRC522.h - считыватель RC522 для хостовой сборки
+//
+// Карты "подносятся" через sim::rfid().tap(); счетчики SPI трафика
+// позволяют оценить нагрузку на шину от опроса. Линия IRQ (sim::rfid().irqPin)
+// опускается, когда карта ответила на REQA, запущенный записью регистров.
+#pragma once
+
+#include "Arduino.h"
+
+
+class MFRC522 {
+public:
+    enum PCD_Register : uint8_t {
+        CommandReg = 0x01 << 1,
+        ComIEnReg = 0x02 << 1,
+        DivIEnReg = 0x03 << 1,
+        ComIrqReg = 0x04 << 1,
+        DivIrqReg = 0x05 << 1,
+        FIFODataReg = 0x09 << 1,
+        FIFOLevelReg = 0x0A << 1,
+        BitFramingReg = 0x0D << 1,
+        VersionReg = 0x37 << 1
+    };
+
+    enum PCD_Command : uint8_t {
+        PCD_Idle = 0x00,
+        PCD_Transceive = 0x0C,
+        PCD_SoftReset = 0x0F
+    };
+
+    enum PICC_Command : uint8_t {
+        PICC_CMD_REQA = 0x26,
+        PICC_CMD_WUPA = 0x52,
+        PICC_CMD_HLTA = 0x50
+    };
+
+    enum StatusCode : uint8_t {
+        STATUS_OK,
+        STATUS_ERROR,
+        STATUS_COLLISION,
+        STATUS_TIMEOUT,
+        STATUS_NO_ROOM,
+        STATUS_INTERNAL_ERROR,
+        STATUS_INVALID,
+        STATUS_CRC_WRONG,
+        STATUS_MIFARE_NACK = 0xff
+    };
+
+    typedef struct {
+        uint8_t size;
+        uint8_t uidByte[10];
+        uint8_t sak;
+    } Uid;
+
+    Uid uid;
+
+    MFRC522(uint8_t ssPin, uint8_t rstPin) : uid{0, {0}, 0} { (void)ssPin; (void)rstPin; }
+
+    void PCD_Init();
+    void PCD_DumpVersionToSerial();
+    uint8_t PCD_ReadRegister(PCD_Register reg);
+    void PCD_WriteRegister(PCD_Register reg, uint8_t value);
+    bool PCD_PerformSelfTest();
+
+    bool PICC_IsNewCardPresent();
+    bool PICC_ReadCardSerial();
+    StatusCode PICC_HaltA();
+};
@@ -0,0 +1,10 @@
+// SPI.h - заглушка шины SPI для хостовой сборки
+#pragma once
+
+class SPIClass {
+public:
+    void begin() {}
+    void end() {}
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,115 @@
+// WString.h - Arduino String для хостовой сборки (обертка над std::string)
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+
+class String {
+public:
+    String() {}
+    String(const char* s) : s_(s ? s : "") {}
+    String(const std::string& s) : s_(s) {}
+    explicit String(char c) : s_(1, c) {}
+    explicit String(unsigned char v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(int v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(unsigned int v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(long v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(unsigned long v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(long long v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(unsigned long long v, unsigned char base = DEC) : s_(toBase(v, base)) {}
+    explicit String(float v, unsigned int decimals = 2) : s_(toFixed(v, decimals)) {}
+    explicit String(double v, unsigned int decimals = 2) : s_(toFixed(v, decimals)) {}
+
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    const char* c_str() const { return s_.c_str(); }
+    bool reserve(unsigned int size) { s_.reserve(size); return true; }
+
+    String& operator+=(const String& rhs) { s_ += rhs.s_; return *this; }
+    String& operator+=(const char* rhs) { s_ += rhs; return *this; }
+    String& operator+=(char c) { s_ += c; return *this; }
+    String& operator+=(int v) { s_ += toBase(v, DEC); return *this; }
+    String& operator+=(unsigned int v) { s_ += toBase(v, DEC); return *this; }
+    String& operator+=(long v) { s_ += toBase(v, DEC); return *this; }
+    String& operator+=(unsigned long v) { s_ += toBase(v, DEC); return *this; }
+    bool concat(const String& rhs) { s_ += rhs.s_; return true; }
+    bool concat(const char* rhs) { s_ += rhs; return true; }
+    bool concat(char c) { s_ += c; return true; }
+
+    bool operator==(const String& rhs) const { return s_ == rhs.s_; }
+    bool operator==(const char* rhs) const { return s_ == (rhs ? rhs : ""); }
+    bool operator!=(const String& rhs) const { return s_ != rhs.s_; }
+    bool operator!=(const char* rhs) const { return !(*this == rhs); }
+    bool operator<(const String& rhs) const { return s_ < rhs.s_; }
+    bool equals(const String& rhs) const { return s_ == rhs.s_; }
+    bool equalsIgnoreCase(const String& rhs) const;
+
+    char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { return s_[i]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+    int indexOf(const char* s, unsigned int from = 0) const { return pos(s_.find(s, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return pos(s_.find(s.s_, from)); }
+    int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+    bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+    bool endsWith(const String& p) const {
+        return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+    }
+    String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from >= s_.size() || to <= from) return String();
+        return String(s_.substr(from, to - from));
+    }
+
+    void toUpperCase();
+    void toLowerCase();
+    void trim();
+    void replace(const String& from, const String& to);
+    void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+    long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+    const std::string& str() const { return s_; }
+
+private:
+    static std::string toBase(unsigned long long v, unsigned char base);
+    static std::string toBase(long long v, unsigned char base) {
+        if (v < 0 && base == DEC) return "-" + toBase((unsigned long long)(-v), base);
+        return toBase((unsigned long long)v, base);
+    }
+    static std::string toBase(int v, unsigned char base) {
+        return base == DEC ? toBase((long long)v, base) : toBase((unsigned long long)(unsigned int)v, base);
+    }
+    static std::string toBase(long v, unsigned char base) {
+        return base == DEC ? toBase((long long)v, base) : toBase((unsigned long long)(unsigned long)v, base);
+    }
+    static std::string toBase(unsigned int v, unsigned char base) { return toBase((unsigned long long)v, base); }
+    static std::string toBase(unsigned long v, unsigned char base) { return toBase((unsigned long long)v, base); }
+    static std::string toBase(unsigned char v, unsigned char base) { return toBase((unsigned long long)v, base); }
+    static std::string toFixed(double v, unsigned int decimals);
+    static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+    std::string s_;
+};
+
+
+// ===== Конкатенация =====
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char c) { String r(a); r += c; return r; }
+inline String operator+(const String& a, int v) { String r(a); r += v; return r; }
+inline String operator+(const String& a, unsigned int v) { String r(a); r += v; return r; }
+inline String operator+(const String& a, long v) { String r(a); r += v; return r; }
+inline String operator+(const String& a, unsigned long v) { String r(a); r += v; return r; }
+inline bool operator==(const char* a, const String& b) { return b == a; }
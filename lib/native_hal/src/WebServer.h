@@ -0,0 +1,104 @@
+// WebServer.h - синхронный HTTP сервер Arduino для хостовой сборки
+//
+// begin() слушает настоящий TCP порт (sim::hostPort), handleClient()
+// обслуживает одного клиента за вызов и закрывает соединение, как у
+// настоящего WebServer. Бенчмарки могут подавать запросы и без сокетов:
+// sim::httpRequest() сразу, sim::queueHttpRequest() - через handleClient().
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Arduino.h"
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+
+class WiFiClient {
+public:
+    WiFiClient() {}
+    explicit WiFiClient(IPAddress ip) : ip_(ip) {}
+    IPAddress remoteIP() const { return ip_; }
+    bool connected() const { return true; }
+
+private:
+    IPAddress ip_;
+};
+
+
+namespace sim {
+struct HttpRequest {
+    HTTPMethod method = HTTP_GET;
+    String uri;
+    std::vector<std::pair<String, String>> args;
+    std::vector<std::pair<String, String>> headers;
+    IPAddress remote = IPAddress(127, 0, 0, 1);
+};
+
+struct HttpResponse {
+    int code = 0;
+    String contentType;
+    String body;
+    std::vector<std::pair<String, String>> headers;
+};
+}
+
+
+class WebServer {
+public:
+    typedef std::function<void()> THandlerFunction;
+
+    explicit WebServer(int port = 80);
+    ~WebServer();
+
+    void begin();
+    void stop();
+    void handleClient();
+
+    void on(const String& uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction fn) {
+        routes_.push_back({uri, method, fn});
+    }
+    void onNotFound(THandlerFunction fn) { notFound_ = fn; }
+
+    // Данные текущего запроса
+    String arg(const String& name) const;
+    String arg(int i) const;
+    String argName(int i) const;
+    int args() const { return (int)req_.args.size(); }
+    bool hasArg(const String& name) const;
+    String header(const String& name) const;
+    bool hasHeader(const String& name) const;
+    HTTPMethod method() const { return req_.method; }
+    String uri() const { return req_.uri; }
+    WiFiClient client() const { return WiFiClient(req_.remote); }
+
+    // Ответ
+    void sendHeader(const String& name, const String& value, bool first = false);
+    void send(int code, const char* contentType = nullptr, const String& content = String());
+    void send(int code, const String& contentType, const String& content) {
+        send(code, contentType.c_str(), content);
+    }
+
+    // Обработка одного запроса немедленно (для бенчмарков)
+    sim::HttpResponse dispatch(const sim::HttpRequest& req);
+    int port() const { return port_; }
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction fn;
+    };
+
+    bool serveSocket();
+
+    int port_;
+    bool started_ = false;
+    int listenFd_ = -1;
+    std::vector<Route> routes_;
+    THandlerFunction notFound_;
+    sim::HttpRequest req_;
+    sim::HttpResponse resp_;
+    std::vector<std::pair<String, String>> pendingHeaders_;
+};
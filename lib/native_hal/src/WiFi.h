@@ -0,0 +1,41 @@
+// WiFi.h - WiFi станции для хостовой сборки (состояние задается через hal_sim.h)
+#pragma once
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+
+class WiFiClass {
+public:
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr,
+                      int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+    wl_status_t status();
+    bool reconnect();
+    bool disconnect(bool wifioff = false);
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool mode(wifi_mode_t m) { (void)m; return true; }
+    bool setAutoReconnect(bool on) { (void)on; return true; }
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t n = 0);
+    String macAddress() { return "02:00:00:00:00:01"; }
+    int8_t RSSI();
+    uint8_t* BSSID();
+    int32_t channel();
+};
+
+extern WiFiClass WiFi;
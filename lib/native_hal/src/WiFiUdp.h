@@ -0,0 +1,45 @@
+// WiFiUdp.h - UDP сокет Arduino (WiFiUDP) для хостовой сборки на сокетах ПК
+#pragma once
+
+#include "Arduino.h"
+
+
+class WiFiUDP {
+public:
+    ~WiFiUDP() { stop(); }
+
+    uint8_t begin(uint16_t port);
+    void stop();
+
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacket(const char* host, uint16_t port);
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t* buf, size_t size);
+    int endPacket();
+
+    int parsePacket();             // Размер следующей датаграммы или 0
+    int available() { return (int)(rxLen_ - rxPos_); }
+    int read();
+    int read(uint8_t* buf, size_t len);
+    int read(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+    void flush() { rxPos_ = rxLen_; }
+    IPAddress remoteIP() const { return remoteIp_; }
+    uint16_t remotePort() const { return remotePort_; }
+
+    // Только на ПК: ждать датаграмму, не занимая процессор (для бенчмарков)
+    bool waitPacket(uint32_t timeoutMs);
+
+private:
+    bool ensureSocket();
+
+    int fd_ = -1;
+    uint8_t tx_[1472];
+    size_t txLen_ = 0;
+    IPAddress txIp_;
+    uint16_t txPort_ = 0;
+    uint8_t rx_[1472];
+    size_t rxLen_ = 0;
+    size_t rxPos_ = 0;
+    IPAddress remoteIp_;
+    uint16_t remotePort_ = 0;
+};
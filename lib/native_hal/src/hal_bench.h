@@ -0,0 +1,87 @@
+// hal_bench.h - регистрация и утилиты хостовых бенчмарков
+//
+//   SIM_BENCH(event_log) { ... }
+//
+// Запуск: .pio/build/native/program --bench event_log  (или --bench all)
+//
+// Ключевые числа бенчмарк отдает через sim::report() (или Samples::report()).
+// --save results.json сохраняет их, --baseline results.json сравнивает
+// с сохраненными: хуже больше чем на --tolerance процентов (по умолчанию 25) -
+// регрессия, программа завершается с кодом 2.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace sim {
+
+typedef void (*BenchFn)();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char* name, BenchFn fn);
+};
+
+int runBenchmarks(const char* name);
+void listBenchmarks();
+
+enum class Better { Lower, Higher };
+
+// Число для сравнения с базовой линией; ключ дополняется именем бенчмарка
+void report(const char* key, double value, Better better = Better::Lower);
+
+
+// Монотонное время хоста (не зависит от виртуальных часов прошивки)
+inline uint64_t hostNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// ===== Набор замеров с перцентилями =====
+class Samples {
+public:
+    void reserve(size_t n) { v_.reserve(n); }
+    void add(double x) { v_.push_back(x); }
+    void add(const Samples& other) { v_.insert(v_.end(), other.v_.begin(), other.v_.end()); }
+    size_t count() const { return v_.size(); }
+    void clear() { v_.clear(); }
+
+    double percentile(double p) {
+        if (v_.empty()) return 0;
+        std::sort(v_.begin(), v_.end());
+        size_t i = (size_t)(p / 100.0 * (v_.size() - 1) + 0.5);
+        return v_[i];
+    }
+    double mean() const {
+        double s = 0;
+        for (double x : v_) s += x;
+        return v_.empty() ? 0 : s / v_.size();
+    }
+
+    void print(const char* label, const char* unit) {
+        printf("  %-28s n=%-8zu mean=%9.2f p50=%9.2f p99=%9.2f max=%9.2f %s\n",
+               label, count(), mean(), percentile(50), percentile(99), percentile(100), unit);
+    }
+
+    // p50 и p99 в базовую линию: key.p50, key.p99
+    void report(const char* key) {
+        char name[96];
+        snprintf(name, sizeof(name), "%s.p50", key);
+        sim::report(name, percentile(50));
+        snprintf(name, sizeof(name), "%s.p99", key);
+        sim::report(name, percentile(99));
+    }
+
+private:
+    std::vector<double> v_;
+};
+
+}  // namespace sim
+
+#define SIM_BENCH(name)                                                  \
+    static void bench_##name();                                          \
+    static sim::BenchRegistrar benchRegistrar_##name(#name, bench_##name); \
+    static void bench_##name()
@@ -0,0 +1,135 @@
+// hal_sim.h - управление "железом" хостовой сборки из бенчмарков
+//
+// Прошивка работает через обычный Arduino API (Arduino.h, WiFi.h, WebServer.h,
+// HTTPClient.h, FastBot.h, MFRC522.h). На ПК эти заголовки реализованы этой
+// библиотекой, а здесь лежат ручки для подачи входов и чтения выходов.
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Arduino.h"
+#include "FastBot.h"
+#include "WebServer.h"
+
+namespace sim {
+
+// ===== Часы =====
+// В реальном режиме время идет по steady_clock, delay() спит.
+// В виртуальном время двигается только через advance*() и delay().
+void useVirtualClock(bool on);
+bool virtualClock();
+void advanceUs(uint64_t us);
+inline void advanceMs(uint64_t ms) { advanceUs(ms * 1000); }
+uint64_t nowUs();
+
+
+// ===== Задачи FreeRTOS =====
+// Задача - поток ПК и на виртуальных часах идет вместе с главным потоком:
+// в какой момент часов она что-то сделает, решает планировщик ПК. Задачу
+// на шагах vTaskDelay() останавливает до stepTask(), и весь ее проход
+// идет при стоящих часах. Только для задач, которые ждут в vTaskDelay().
+void holdTask(TaskHandle_t task, bool held);   // held - дождаться остановки в vTaskDelay()
+void stepTask(TaskHandle_t task);              // Один проход до следующего vTaskDelay()
+
+
+// ===== GPIO =====
+void setPin(uint8_t pin, int level);     // Входной уровень (датчик)
+int pinLevel(uint8_t pin);               // Текущий уровень (вход или выход)
+uint32_t pinWrites(uint8_t pin);         // Сколько раз пин переключали
+
+
+// ===== Serial =====
+void serialEnabled(bool on);
+
+
+// ===== Память =====
+uint64_t allocCount();                   // Вызовы operator new с запуска
+int64_t liveHeapBytes();                 // Занято в куче через operator new
+int64_t peakHeapBytes();                 // Максимум liveHeapBytes() с запуска или resetHeapPeak()
+void resetHeapPeak();                    // Пик (и ESP.getMinFreeHeap()) заново от текущего
+void setFreeHeap(uint32_t bytes);        // ESP.getFreeHeap() от bytes с текущего: куча прошлых бенчмарков не в счет
+
+
+// ===== LittleFS =====
+void setFsRoot(const char* path);        // Папка на ПК (по умолчанию $NATIVE_FS_ROOT или ./native_fs)
+void clearFs();
+
+
+// ===== WiFi =====
+struct WiFiSim {
+    bool available = true;               // Есть ли сеть
+    uint32_t connectDelayMs = 0;         // Время подключения после begin() (ассоциация)
+    uint32_t scanMs = 0;                 // + сканирование, если в begin() нет канала и BSSID
+    uint32_t dhcpMs = 0;                 // + DHCP, если адрес не задан через config()
+    int32_t channel = 6;                 // Канал точки: begin() с другим каналом не подключится
+    int8_t rssi = -55;
+};
+WiFiSim& wifi();
+
+
+// ===== Сеть =====
+// WebServer, HTTPClient и WiFiUDP работают через настоящие сокеты ПК.
+// Порты ниже 1024 сдвигаются на +8000 (80 -> 8080), чтобы не нужен был root.
+uint16_t hostPort(uint16_t port);
+
+
+// ===== HTTP сервер =====
+HttpResponse httpRequest(int port, const HttpRequest& req);   // Сразу, минуя очередь
+void queueHttpRequest(int port, const HttpRequest& req);      // Через handleClient()
+WebServer* webServer(int port);
+// Другой HTTP сервер прошивки (не WebServer) принимает sim::httpRequest() через этот обработчик
+void registerHttpHandler(int port, std::function<HttpResponse(const HttpRequest&)> fn);
+bool popQueuedHttpRequest(int port, HttpRequest& out);         // Для его handleClient()
+
+
+// ===== HTTP клиент =====
+struct HttpClientSim {
+    // url, тело запроса, ответ -> HTTP код. Не задан - настоящий TCP запрос.
+    std::function<int(const String&, const String&, String&)> handler;
+    uint32_t latencyMs = 0;
+    uint64_t requests = 0;
+};
+HttpClientSim& httpClient();
+
+
+// ===== Telegram =====
+struct TelegramSim {
+    std::mutex lock;
+    std::deque<FB_msg> inbox;            // Команды, ждущие tick()
+    std::deque<String> sent;             // Последние отправленные сообщения
+    size_t keepSent = 64;
+    uint64_t sentCount = 0;
+    uint64_t polls = 0;
+    uint32_t sendLatencyMs = 0;          // Имитация HTTPS sendMessage
+    uint32_t pollLatencyMs = 0;          // Имитация getUpdates
+    bool online = true;
+
+    void command(const String& text, const String& chatID = "123456789");
+};
+TelegramSim& telegram();
+
+
+// ===== RFID =====
+struct RfidSim {
+    uint8_t uid[10] = {0};
+    uint8_t uidSize = 0;
+    std::atomic<bool> present{false};    // Считыватель может быть в своей задаче
+    std::atomic<bool> hold{false};       // Карту держат у считывателя
+    std::atomic<uint64_t> spiBytes{0};   // Примерный трафик SPI
+    std::atomic<uint64_t> polls{0};      // Вызовов PICC_IsNewCardPresent()
+    uint8_t irqPin = 0xFF;               // Пин IRQ считывателя, 0xFF - не подключен
+    std::atomic<uint64_t> irqs{0};       // Ответов карты на REQA через IRQ
+
+    // Состояние регистров для IRQ (пишет прошивка через PCD_WriteRegister)
+    bool rxIrqEnabled = false;           // ComIEnReg.RxIEn
+    uint8_t command = 0;                 // CommandReg
+
+    void tap(const uint8_t* bytes, uint8_t size, bool held = false);
+    void remove() { present = false; hold = false; }
+};
+RfidSim& rfid();
+
+}  // namespace sim
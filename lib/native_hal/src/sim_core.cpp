@@ -0,0 +1,381 @@
+// sim_core.cpp - время, таймеры, GPIO, Serial, куча и String для хостовой сборки
+#include <malloc.h>
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Arduino.h"
+#include "SPI.h"
+#include "esp_timer.h"
+#include "hal_sim.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+uint32_t esp_random() {
+    static std::random_device rd;
+    return rd();
+}
+
+
+// ===== Часы =====
+namespace {
+const auto startTime = std::chrono::steady_clock::now();
+std::atomic<bool> virtualMode{false};
+std::atomic<uint64_t> virtualUs{0};
+std::atomic<int64_t> realOffsetUs{0};
+
+uint64_t realUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool fireDueTimer(uint64_t uptoUs);
+}
+
+namespace sim {
+void useVirtualClock(bool on) {
+    if (on == virtualMode.load()) return;
+    if (on) {
+        virtualUs = realUs() + realOffsetUs.load();
+    } else {
+        realOffsetUs = (int64_t)virtualUs.load() - (int64_t)realUs();
+    }
+    virtualMode = on;
+}
+
+bool virtualClock() { return virtualMode; }
+
+void advanceUs(uint64_t us) {
+    if (!virtualMode) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+        return;
+    }
+    // Таймеры срабатывают по порядку, каждый в свой момент виртуального времени
+    uint64_t target = virtualUs + us;
+    while (fireDueTimer(target)) {
+    }
+    if (virtualUs < target) virtualUs = target;
+}
+
+uint64_t nowUs() {
+    return virtualMode ? virtualUs.load() : realUs() + realOffsetUs.load();
+}
+}
+
+unsigned long millis() { return (unsigned long)(uint32_t)(sim::nowUs() / 1000); }
+unsigned long micros() { return (unsigned long)(uint32_t)sim::nowUs(); }
+int64_t esp_timer_get_time() { return (int64_t)sim::nowUs(); }
+void delay(uint32_t ms) { sim::advanceUs((uint64_t)ms * 1000); }
+void delayMicroseconds(uint32_t us) { sim::advanceUs(us); }
+void yield() { if (!sim::virtualClock()) std::this_thread::yield(); }
+
+
+// ===== esp_timer =====
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    const char* name;
+    uint64_t periodUs;                   // 0 - однократный
+    uint64_t dueUs;
+    bool active;
+};
+
+namespace {
+std::mutex timersLock;
+std::condition_variable timersCv;
+std::vector<esp_timer*> timers;
+std::recursive_mutex callbackLock;       // Колбэки по одному, как в задаче esp_timer
+
+// Один просроченный таймер (самый ранний); false - до uptoUs срабатывать нечему
+bool fireDueTimer(uint64_t uptoUs) {
+    std::lock_guard<std::recursive_mutex> cbGuard(callbackLock);
+    esp_timer_cb_t cb;
+    void* arg;
+    {
+        std::lock_guard<std::mutex> g(timersLock);
+        esp_timer* next = nullptr;
+        for (esp_timer* t : timers) {
+            if (t->active && t->dueUs <= uptoUs && (!next || t->dueUs < next->dueUs)) next = t;
+        }
+        if (!next) return false;
+        uint64_t due = next->dueUs;
+        if (next->periodUs) next->dueUs += next->periodUs;
+        else next->active = false;
+        if (virtualMode && virtualUs < due) virtualUs = due;
+        cb = next->callback;
+        arg = next->arg;
+    }
+    cb(arg);
+    return true;
+}
+
+// На реальных часах таймеры обслуживает отдельный поток
+void timerWorker() {
+    std::unique_lock<std::mutex> g(timersLock);
+    for (;;) {
+        uint64_t nextDue = UINT64_MAX;
+        for (esp_timer* t : timers) {
+            if (t->active && t->dueUs < nextDue) nextDue = t->dueUs;
+        }
+        uint64_t now = sim::nowUs();
+        if (virtualMode || nextDue == UINT64_MAX) {
+            timersCv.wait_for(g, std::chrono::milliseconds(1));
+        } else if (nextDue > now) {
+            timersCv.wait_for(g, std::chrono::microseconds(nextDue - now));
+        } else {
+            g.unlock();
+            while (!virtualMode && fireDueTimer(sim::nowUs())) {
+            }
+            g.lock();
+        }
+    }
+}
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    static std::once_flag workerStarted;
+    std::call_once(workerStarted, [] { std::thread(timerWorker).detach(); });
+    esp_timer* t = new esp_timer{args->callback, args->arg, args->name, 0, 0, false};
+    std::lock_guard<std::mutex> g(timersLock);
+    timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t firstUs, uint64_t periodUs) {
+    {
+        std::lock_guard<std::mutex> g(timersLock);
+        if (timer->active) return ESP_ERR_INVALID_STATE;
+        timer->periodUs = periodUs;
+        timer->dueUs = sim::nowUs() + firstUs;
+        timer->active = true;
+    }
+    timersCv.notify_one();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    return startTimer(timer, timeoutUs, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    return startTimer(timer, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> g(timersLock);
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> g(timersLock);
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> g(timersLock);
+    return timer->active;
+}
+
+
+// ===== GPIO =====
+namespace {
+const int PIN_COUNT = 64;
+std::atomic<int> pinLevels[PIN_COUNT];
+std::atomic<uint32_t> pinWriteCount[PIN_COUNT];
+
+struct PinIsr {
+    void (*fn)();
+    int mode;
+};
+std::atomic<PinIsr*> pinIsrs[PIN_COUNT];
+}
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+
+int digitalRead(uint8_t pin) { return pin < PIN_COUNT ? pinLevels[pin].load() : LOW; }
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (pin >= PIN_COUNT) return;
+    pinLevels[pin] = val ? HIGH : LOW;
+    pinWriteCount[pin]++;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+    if (pin >= PIN_COUNT) return;
+    delete pinIsrs[pin].exchange(new PinIsr{isr, mode});
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < PIN_COUNT) delete pinIsrs[pin].exchange(nullptr);
+}
+
+namespace sim {
+void setPin(uint8_t pin, int level) {
+    if (pin >= PIN_COUNT) return;
+    int now = level ? HIGH : LOW;
+    int was = pinLevels[pin].exchange(now);
+    PinIsr* isr = pinIsrs[pin].load();
+    if (!isr || was == now) return;
+    if (isr->mode == CHANGE || (isr->mode == RISING && now == HIGH) || (isr->mode == FALLING && now == LOW)) {
+        isr->fn();
+    }
+}
+int pinLevel(uint8_t pin) { return digitalRead(pin); }
+uint32_t pinWrites(uint8_t pin) { return pin < PIN_COUNT ? pinWriteCount[pin].load() : 0; }
+}
+
+
+// ===== Serial =====
+namespace {
+std::atomic<bool> serialOn{true};
+}
+
+namespace sim {
+void serialEnabled(bool on) { serialOn = on; }
+}
+
+size_t HardwareSerial::write(const char* s) {
+    size_t n = strlen(s);
+    if (serialOn) fwrite(s, 1, n, stdout);
+    return n;
+}
+
+size_t HardwareSerial::printf(const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    write(buf);
+    return n < 0 ? 0 : (size_t)n;
+}
+
+
+// ===== Куча =====
+// operator new подменен, чтобы бенчмарки могли считать выделения памяти
+namespace {
+std::atomic<uint64_t> allocs{0};
+std::atomic<int64_t> liveBytes{0};
+std::atomic<int64_t> peakBytes{0};
+std::atomic<int64_t> baseBytes{0};              // Не в счет ESP.getFreeHeap() (sim::setFreeHeap())
+const uint32_t NATIVE_HEAP_SIZE = 320 * 1024;   // Как у ESP32 без PSRAM
+
+void* countedAlloc(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    allocs++;
+    int64_t live = liveBytes += (int64_t)malloc_usable_size(p);
+    for (int64_t peak = peakBytes; live > peak && !peakBytes.compare_exchange_weak(peak, live);) {}
+    return p;
+}
+
+void countedFree(void* p) {
+    if (!p) return;
+    liveBytes -= (int64_t)malloc_usable_size(p);
+    free(p);
+}
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+
+namespace sim {
+uint64_t allocCount() { return allocs; }
+int64_t liveHeapBytes() { return liveBytes; }
+int64_t peakHeapBytes() { return peakBytes; }
+void resetHeapPeak() { peakBytes = liveBytes.load(); }
+void setFreeHeap(uint32_t bytes) {
+    baseBytes = liveBytes.load() - (int64_t)(NATIVE_HEAP_SIZE - bytes);
+    resetHeapPeak();
+}
+}
+
+uint32_t EspClass::getHeapSize() { return NATIVE_HEAP_SIZE; }
+
+static uint32_t freeOf(int64_t used) {
+    used -= baseBytes;
+    return used >= NATIVE_HEAP_SIZE ? 0 : used <= 0 ? NATIVE_HEAP_SIZE : NATIVE_HEAP_SIZE - (uint32_t)used;
+}
+
+uint32_t EspClass::getFreeHeap() { return freeOf(liveBytes); }
+uint32_t EspClass::getMinFreeHeap() { return freeOf(peakBytes); }
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return getFreeHeap();
+}
+
+uint32_t EspClass::getCycleCount() {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+    return (uint32_t)((uint64_t)ns.count() * 240 / 1000);
+}
+
+void EspClass::restart() {
+    fflush(stdout);
+    exit(0);
+}
+
+
+// ===== String =====
+std::string String::toBase(unsigned long long v, unsigned char base) {
+    if (base < 2 || base > 36) base = DEC;
+    char buf[72];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        int d = (int)(v % base);
+        buf[--i] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+        v /= base;
+    } while (v && i > 0);
+    return std::string(buf + i);
+}
+
+std::string String::toFixed(double v, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+}
+
+bool String::equalsIgnoreCase(const String& rhs) const {
+    return strcasecmp(s_.c_str(), rhs.s_.c_str()) == 0;
+}
+
+void String::toUpperCase() {
+    for (char& c : s_) if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+}
+
+void String::toLowerCase() {
+    for (char& c : s_) if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+}
+
+void String::trim() {
+    size_t b = s_.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) { s_.clear(); return; }
+    size_t e = s_.find_last_not_of(" \t\r\n");
+    s_ = s_.substr(b, e - b + 1);
+}
+
+void String::replace(const String& from, const String& to) {
+    if (from.s_.empty()) return;
+    size_t p = 0;
+    while ((p = s_.find(from.s_, p)) != std::string::npos) {
+        s_.replace(p, from.s_.size(), to.s_);
+        p += to.s_.size();
+    }
+}
@@ -0,0 +1,162 @@
+// sim_devices.cpp - Telegram (FastBot) и RFID (MFRC522) для хостовой сборки
+#include "FastBot.h"
+#include "MFRC522.h"
+#include "hal_sim.h"
+
+
+// ===== Telegram =====
+namespace {
+sim::TelegramSim telegramState;
+}
+
+namespace sim {
+TelegramSim& telegram() { return telegramState; }
+
+void TelegramSim::command(const String& text, const String& chatID) {
+    FB_msg msg;
+    msg.text = text;
+    msg.chatID = chatID;
+    msg.userID = chatID;
+    msg.username = "sim";
+    std::lock_guard<std::mutex> g(lock);
+    inbox.push_back(msg);
+}
+}
+
+uint8_t FastBot::sendMessage(const String& msg, const String& id) {
+    (void)id;
+    if (telegramState.sendLatencyMs) delay(telegramState.sendLatencyMs);
+    std::lock_guard<std::mutex> g(telegramState.lock);
+    if (!telegramState.online) return 4;
+    telegramState.sentCount++;
+    telegramState.sent.push_back(msg);
+    while (telegramState.sent.size() > telegramState.keepSent) telegramState.sent.pop_front();
+    return 1;
+}
+
+uint8_t FastBot::tick() {
+    if (millis() - lastPoll_ < period_) return 0;
+    lastPoll_ = millis();
+    return tickManual();
+}
+
+uint8_t FastBot::tickManual() {
+    telegramState.polls++;
+    if (telegramState.pollLatencyMs) delay(telegramState.pollLatencyMs);
+
+    // Забираем пачку команд под замком, обработчик вызываем без него
+    std::deque<FB_msg> batch;
+    {
+        std::lock_guard<std::mutex> g(telegramState.lock);
+        if (!telegramState.online) return 4;
+        while (!telegramState.inbox.empty() && batch.size() < limit_) {
+            batch.push_back(telegramState.inbox.front());
+            telegramState.inbox.pop_front();
+        }
+    }
+    for (FB_msg& msg : batch) {
+        if (handler_) handler_(msg);
+    }
+    return 1;
+}
+
+
+// ===== RFID =====
+namespace {
+sim::RfidSim rfidState;
+
+// Примерная стоимость операций библиотеки MFRC522 в байтах SPI
+const int SPI_REG_ACCESS = 2;
+const int SPI_REQA = 12 * SPI_REG_ACCESS;
+const int SPI_SELECT = 40 * SPI_REG_ACCESS;
+const int SPI_HALT = 10 * SPI_REG_ACCESS;
+// Без карты PCD_CommunicateWithPICC() читает ComIrqReg, пока не истечет
+// таймер чипа (25 мс после PCD_Init): около 2500 чтений по 10 мкс
+const int SPI_NO_ANSWER = 2500 * SPI_REG_ACCESS;
+
+// IRQ инвертирован (ComIEnReg.IRqInv): запрос прерывания - низкий уровень
+void irqLine(bool asserted) {
+    if (rfidState.irqPin != 0xFF) sim::setPin(rfidState.irqPin, asserted ? LOW : HIGH);
+}
+}
+
+namespace sim {
+RfidSim& rfid() { return rfidState; }
+
+void RfidSim::tap(const uint8_t* bytes, uint8_t size, bool held) {
+    if (size > sizeof(uid)) size = sizeof(uid);
+    memcpy(uid, bytes, size);
+    uidSize = size;
+    hold = held;
+    present = true;
+}
+}
+
+void MFRC522::PCD_Init() {
+    rfidState.spiBytes += 16 * SPI_REG_ACCESS;
+    rfidState.rxIrqEnabled = false;
+    rfidState.command = PCD_Idle;
+}
+
+void MFRC522::PCD_DumpVersionToSerial() {
+    Serial.println("Firmware Version: 0x92 = v2.0 (native)");
+}
+
+uint8_t MFRC522::PCD_ReadRegister(PCD_Register reg) {
+    rfidState.spiBytes += SPI_REG_ACCESS;
+    return reg == VersionReg ? 0x92 : 0x00;
+}
+
+void MFRC522::PCD_WriteRegister(PCD_Register reg, uint8_t value) {
+    rfidState.spiBytes += SPI_REG_ACCESS;
+    switch (reg) {
+        case ComIEnReg:
+            rfidState.rxIrqEnabled = value & 0x20;
+            irqLine(false);
+            break;
+        case ComIrqReg:
+            if (!(value & 0x80)) irqLine(false);     // Set1 = 0: сброс запросов
+            break;
+        case CommandReg:
+            rfidState.command = value & 0x0F;
+            break;
+        case BitFramingReg:
+            // StartSend: REQA ушел, поднесенная карта отвечает ATQA
+            if ((value & 0x80) && rfidState.command == PCD_Transceive && rfidState.present &&
+                rfidState.rxIrqEnabled) {
+                rfidState.irqs++;
+                irqLine(true);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool MFRC522::PCD_PerformSelfTest() {
+    rfidState.spiBytes += 64 * SPI_REG_ACCESS;
+    return true;
+}
+
+bool MFRC522::PICC_IsNewCardPresent() {
+    rfidState.polls++;
+    rfidState.spiBytes += SPI_REQA;
+    if (!rfidState.present) rfidState.spiBytes += SPI_NO_ANSWER;
+    return rfidState.present;
+}
+
+bool MFRC522::PICC_ReadCardSerial() {
+    rfidState.spiBytes += SPI_SELECT;
+    if (!rfidState.present) return false;
+    uid.size = rfidState.uidSize;
+    memcpy(uid.uidByte, rfidState.uid, rfidState.uidSize);
+    uid.sak = 0x08;
+    return true;
+}
+
+MFRC522::StatusCode MFRC522::PICC_HaltA() {
+    rfidState.spiBytes += SPI_HALT;
+    // Убранная карта больше не отвечает; удерживаемую считыватель видит снова
+    if (!rfidState.hold) rfidState.present = false;
+    return STATUS_OK;
+}
@@ -0,0 +1,243 @@
+// sim_fs.cpp - LittleFS поверх папки на диске
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include "LittleFS.h"
+#include "hal_sim.h"
+
+fs::LittleFSFS LittleFS;
+
+namespace {
+std::string fsRoot;
+const size_t NATIVE_FS_SIZE = 1408 * 1024;   // Раздел littlefs по умолчанию на 4 МБ флеш
+
+const std::string& root() {
+    if (fsRoot.empty()) {
+        const char* env = getenv("NATIVE_FS_ROOT");
+        fsRoot = env ? env : "native_fs";
+    }
+    return fsRoot;
+}
+
+std::string hostPath(const char* path) {
+    std::string p = root();
+    if (path[0] != '/') p += '/';
+    return p + path;
+}
+
+void makeDirs(const std::string& path) {
+    for (size_t i = 1; i < path.size(); i++) {
+        if (path[i] == '/') ::mkdir(path.substr(0, i).c_str(), 0755);
+    }
+    ::mkdir(path.c_str(), 0755);
+}
+
+size_t dirUsage(const std::string& dir) {
+    size_t total = 0;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return 0;
+    while (dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        std::string p = dir + "/" + e->d_name;
+        struct stat st;
+        if (stat(p.c_str(), &st) != 0) continue;
+        total += S_ISDIR(st.st_mode) ? dirUsage(p) : (size_t)st.st_size;
+    }
+    closedir(d);
+    return total;
+}
+}
+
+namespace sim {
+void setFsRoot(const char* path) {
+    fsRoot = path;
+    makeDirs(fsRoot);
+}
+
+void clearFs() {
+    std::string cmd = "rm -rf '" + root() + "'";
+    if (system(cmd.c_str()) != 0) return;
+    makeDirs(root());
+}
+}
+
+
+namespace fs {
+
+struct FileImpl {
+    FILE* f = nullptr;
+    DIR* dir = nullptr;
+    std::string path;     // Путь внутри ФС
+    std::string name;
+
+    ~FileImpl() {
+        if (f) fclose(f);
+        if (dir) closedir(dir);
+    }
+};
+
+size_t File::write(const uint8_t* buf, size_t size) {
+    if (!impl_ || !impl_->f) return 0;
+    return fwrite(buf, 1, size, impl_->f);
+}
+
+size_t File::printf(const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+int File::available() {
+    if (!impl_ || !impl_->f) return 0;
+    long pos = ftell(impl_->f);
+    return (int)(size() - pos);
+}
+
+int File::read() {
+    if (!impl_ || !impl_->f) return -1;
+    int c = fgetc(impl_->f);
+    return c == EOF ? -1 : c;
+}
+
+int File::peek() {
+    if (!impl_ || !impl_->f) return -1;
+    int c = fgetc(impl_->f);
+    if (c != EOF) ungetc(c, impl_->f);
+    return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+    if (!impl_ || !impl_->f) return 0;
+    return fread(buf, 1, size, impl_->f);
+}
+
+size_t File::readBytesUntil(char terminator, char* buf, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+        int c = read();
+        if (c < 0 || c == terminator) break;
+        buf[n++] = (char)c;
+    }
+    return n;
+}
+
+String File::readStringUntil(char terminator) {
+    std::string s;
+    for (;;) {
+        int c = read();
+        if (c < 0 || c == terminator) break;
+        s += (char)c;
+    }
+    return String(s);
+}
+
+void File::flush() {
+    if (impl_ && impl_->f) fflush(impl_->f);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!impl_ || !impl_->f) return false;
+    int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return fseek(impl_->f, (long)pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!impl_ || !impl_->f) return 0;
+    return (size_t)ftell(impl_->f);
+}
+
+size_t File::size() const {
+    if (!impl_ || !impl_->f) return 0;
+    fflush(impl_->f);
+    struct stat st;
+    if (fstat(fileno(impl_->f), &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+void File::close() { impl_.reset(); }
+
+File::operator bool() const { return impl_ && (impl_->f || impl_->dir); }
+
+const char* File::name() const { return impl_ ? impl_->name.c_str() : ""; }
+const char* File::path() const { return impl_ ? impl_->path.c_str() : ""; }
+bool File::isDirectory() const { return impl_ && impl_->dir; }
+
+File File::openNextFile(const char* mode) {
+    if (!impl_ || !impl_->dir) return File();
+    while (dirent* e = readdir(impl_->dir)) {
+        if (e->d_name[0] == '.') continue;
+        std::string p = impl_->path;
+        if (p.empty() || p.back() != '/') p += '/';
+        p += e->d_name;
+        return LittleFS.open(p.c_str(), mode);
+    }
+    return File();
+}
+
+void File::rewindDirectory() {
+    if (impl_ && impl_->dir) rewinddir(impl_->dir);
+}
+
+File FS::open(const char* path, const char* mode, bool create) {
+    std::string hp = hostPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    const char* slash = strrchr(path, '/');
+    impl->name = slash ? slash + 1 : path;
+
+    struct stat st;
+    if (stat(hp.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        impl->dir = opendir(hp.c_str());
+        return impl->dir ? File(impl) : File();
+    }
+    if (create || mode[0] != 'r') {
+        size_t cut = hp.rfind('/');
+        if (cut != std::string::npos) makeDirs(hp.substr(0, cut));
+    }
+    // "r+" в LittleFS - чтение и запись без усечения
+    impl->f = fopen(hp.c_str(), mode[0] == 'r' && mode[1] == '+' ? "r+b" :
+                                mode[0] == 'r' ? "rb" : mode[0] == 'w' ? "w+b" : "a+b");
+    return impl->f ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) { return ::unlink(hostPath(path).c_str()) == 0; }
+
+bool FS::rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+    makeDirs(hostPath(path));
+    return true;
+}
+
+bool FS::rmdir(const char* path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles,
+                       const char* partitionLabel) {
+    (void)formatOnFail; (void)basePath; (void)maxOpenFiles; (void)partitionLabel;
+    makeDirs(root());
+    return true;
+}
+
+bool LittleFSFS::format() {
+    sim::clearFs();
+    return true;
+}
+
+size_t LittleFSFS::totalBytes() { return NATIVE_FS_SIZE; }
+size_t LittleFSFS::usedBytes() { return dirUsage(root()); }
+
+}  // namespace fs
@@ -0,0 +1,160 @@
+// sim_main.cpp - точка входа хостовой сборки
+//
+//   program                 - запуск прошивки: setup() и бесконечный loop()
+//   program --list          - список бенчмарков
+//   program --bench <name>  - запуск бенчмарка (all - все по очереди)
+//       --save <file.json>       - сохранить числа из sim::report()
+//       --baseline <file.json>   - сравнить с сохраненными, регрессия - код 2
+//       --tolerance <pct>        - допустимое ухудшение, % (по умолчанию 25)
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "hal_bench.h"
+
+namespace {
+struct Bench {
+    const char* name;
+    sim::BenchFn fn;
+};
+
+std::vector<Bench>& benches() {
+    static std::vector<Bench> v;
+    return v;
+}
+
+struct Result {
+    std::string key;                   // "бенчмарк.ключ"
+    double value;
+    sim::Better better;
+};
+
+const char* currentBench = "";
+std::vector<Result> results;
+
+bool saveResults(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(f, "  \"%s\": %.6g%s\n", results[i].key.c_str(), results[i].value,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "}\n");
+    return fclose(f) == 0;
+}
+
+// Плоский JSON, который пишет saveResults(): "ключ": число на строку
+bool loadBaseline(const char* path, std::map<std::string, double>& out) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char* open = strchr(line, '"');
+        char* close = open ? strchr(open + 1, '"') : nullptr;
+        char* colon = close ? strchr(close, ':') : nullptr;
+        if (!colon) continue;
+        out[std::string(open + 1, close)] = strtod(colon + 1, nullptr);
+    }
+    fclose(f);
+    return true;
+}
+
+// Число регрессий; ключи, которых нет в базовой линии, только выводятся
+int compareBaseline(const std::map<std::string, double>& base, double tolerancePct) {
+    int regressions = 0;
+    printf("=== baseline (tolerance %.0f%%) ===\n", tolerancePct);
+    for (const Result& r : results) {
+        auto it = base.find(r.key);
+        if (it == base.end()) {
+            printf("  %-44s %12.4g  (new)\n", r.key.c_str(), r.value);
+            continue;
+        }
+        double was = it->second;
+        double change = was != 0 ? (r.value - was) / was * 100 : (r.value != 0 ? 100 : 0);
+        double worse = r.better == sim::Better::Lower ? change : -change;
+        bool bad = worse > tolerancePct;
+        regressions += bad;
+        printf("  %-44s %12.4g -> %-12.4g %+7.1f%%%s\n", r.key.c_str(), was, r.value, change,
+               bad ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+}
+
+namespace sim {
+BenchRegistrar::BenchRegistrar(const char* name, BenchFn fn) { benches().push_back({name, fn}); }
+
+void listBenchmarks() {
+    for (const Bench& b : benches()) printf("%s\n", b.name);
+}
+
+int runBenchmarks(const char* name) {
+    int ran = 0;
+    for (const Bench& b : benches()) {
+        if (strcmp(name, "all") != 0 && strcmp(name, b.name) != 0) continue;
+        printf("=== %s ===\n", b.name);
+        fflush(stdout);
+        currentBench = b.name;
+        b.fn();
+        fflush(stdout);
+        ran++;
+    }
+    if (!ran) {
+        fprintf(stderr, "Unknown benchmark: %s\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+void report(const char* key, double value, Better better) {
+    results.push_back({std::string(currentBench) + "." + key, value, better});
+}
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--list") == 0) {
+        sim::listBenchmarks();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        const char* name = "all";
+        const char* savePath = nullptr;
+        const char* basePath = nullptr;
+        double tolerancePct = 25;
+        for (int i = 2; i < argc; i++) {
+            bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "--save") == 0 && hasValue) savePath = argv[++i];
+            else if (strcmp(argv[i], "--baseline") == 0 && hasValue) basePath = argv[++i];
+            else if (strcmp(argv[i], "--tolerance") == 0 && hasValue) tolerancePct = atof(argv[++i]);
+            else name = argv[i];
+        }
+        // Базовая линия читается до запуска: ее можно перезаписать через --save
+        std::map<std::string, double> base;
+        if (basePath && !loadBaseline(basePath, base)) {
+            fprintf(stderr, "Cannot read baseline: %s\n", basePath);
+            _exit(1);
+        }
+
+        // Задачи FreeRTOS - отсоединенные потоки; выходим, не разрушая
+        // глобальные объекты, которые они еще могут трогать
+        int rc = sim::runBenchmarks(name);
+        if (rc == 0 && savePath && !saveResults(savePath)) {
+            fprintf(stderr, "Cannot write results: %s\n", savePath);
+            rc = 1;
+        }
+        if (rc == 0 && basePath) {
+            int regressions = compareBaseline(base, tolerancePct);
+            printf("  %d regression(s)\n", regressions);
+            if (regressions) rc = 2;
+        }
+        fflush(stdout);
+        _exit(rc);
+    }
+
+    setup();
+    for (;;) loop();
+}
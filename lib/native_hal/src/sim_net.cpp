@@ -0,0 +1,212 @@
+// sim_net.cpp - WiFi, WebServer и HTTPClient для хостовой сборки
+#include <map>
+#include <mutex>
+#include "HTTPClient.h"
+#include "WebServer.h"
+#include "WiFi.h"
+#include "hal_sim.h"
+
+WiFiClass WiFi;
+
+
+// ===== WiFi =====
+namespace {
+sim::WiFiSim wifiState;
+bool wifiStarted = false;
+uint64_t wifiBeginUs = 0;
+bool wifiHinted = false;                 // begin() с каналом и BSSID
+int32_t wifiHintChannel = 0;
+bool wifiStatic = false;                 // Адрес задан через config()
+uint8_t bssid[6] = {0x02, 0, 0, 0, 0, 0x02};
+}
+
+namespace sim {
+WiFiSim& wifi() { return wifiState; }
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+                             const uint8_t* bssidHint, bool connect) {
+    (void)ssid; (void)passphrase;
+    wifiStarted = connect;
+    wifiHinted = channel > 0 && bssidHint;
+    wifiHintChannel = channel;
+    wifiBeginUs = sim::nowUs();
+    return status();
+}
+
+wl_status_t WiFiClass::status() {
+    if (!wifiStarted) return WL_IDLE_STATUS;
+    if (!wifiState.available) return WL_DISCONNECTED;
+    if (wifiHinted && wifiHintChannel != wifiState.channel) return WL_NO_SSID_AVAIL;
+    uint64_t connectMs = wifiState.connectDelayMs + (wifiHinted ? 0 : wifiState.scanMs) +
+                         (wifiStatic ? 0 : wifiState.dhcpMs);
+    if (sim::nowUs() - wifiBeginUs < connectMs * 1000) return WL_DISCONNECTED;
+    return WL_CONNECTED;
+}
+
+bool WiFiClass::reconnect() {
+    wifiStarted = true;
+    wifiBeginUs = sim::nowUs();
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff) {
+    (void)wifioff;
+    wifiStarted = false;
+    return true;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+    (void)gateway; (void)subnet; (void)dns1; (void)dns2;
+    wifiStatic = (uint32_t)local != 0;
+    return true;
+}
+
+IPAddress WiFiClass::localIP() { return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+int8_t WiFiClass::RSSI() { return status() == WL_CONNECTED ? wifiState.rssi : 0; }
+uint8_t* WiFiClass::BSSID() { return bssid; }
+int32_t WiFiClass::channel() { return wifiState.channel; }
+IPAddress WiFiClass::gatewayIP() { return status() == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+IPAddress WiFiClass::subnetMask() { return status() == WL_CONNECTED ? IPAddress(255, 0, 0, 0) : IPAddress(); }
+IPAddress WiFiClass::dnsIP(uint8_t n) { return status() == WL_CONNECTED && n == 0 ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+
+
+// ===== WebServer =====
+namespace {
+std::map<int, WebServer*>& servers() {
+    static std::map<int, WebServer*> m;
+    return m;
+}
+
+std::map<int, std::deque<sim::HttpRequest>>& pending() {
+    static std::map<int, std::deque<sim::HttpRequest>> m;
+    return m;
+}
+
+// Очередь пишет поток бенчмарка, читает задача сервера
+std::mutex& pendingLock() {
+    static std::mutex m;
+    return m;
+}
+
+std::map<int, std::function<sim::HttpResponse(const sim::HttpRequest&)>>& httpHandlers() {
+    static std::map<int, std::function<sim::HttpResponse(const sim::HttpRequest&)>> m;
+    return m;
+}
+
+const String* findPair(const std::vector<std::pair<String, String>>& v, const String& name) {
+    for (const auto& kv : v) {
+        if (kv.first == name) return &kv.second;
+    }
+    return nullptr;
+}
+}
+
+WebServer::WebServer(int port) : port_(port) { servers()[port] = this; }
+
+WebServer::~WebServer() {
+    stop();
+    servers().erase(port_);
+}
+
+void WebServer::handleClient() {
+    if (!started_) return;
+    sim::HttpRequest req;
+    if (!sim::popQueuedHttpRequest(port_, req)) {
+        serveSocket();
+        return;
+    }
+    dispatch(req);
+}
+
+sim::HttpResponse WebServer::dispatch(const sim::HttpRequest& req) {
+    req_ = req;
+    resp_ = sim::HttpResponse();
+    pendingHeaders_.clear();
+    for (const Route& r : routes_) {
+        if (r.uri == req.uri && (r.method == HTTP_ANY || r.method == req.method)) {
+            r.fn();
+            return resp_;
+        }
+    }
+    if (notFound_) notFound_();
+    else send(404, "text/plain", "Not found");
+    return resp_;
+}
+
+String WebServer::arg(const String& name) const {
+    const String* v = findPair(req_.args, name);
+    return v ? *v : String();
+}
+
+String WebServer::arg(int i) const {
+    return i >= 0 && i < args() ? req_.args[i].second : String();
+}
+
+String WebServer::argName(int i) const {
+    return i >= 0 && i < args() ? req_.args[i].first : String();
+}
+
+bool WebServer::hasArg(const String& name) const { return findPair(req_.args, name) != nullptr; }
+
+String WebServer::header(const String& name) const {
+    const String* v = findPair(req_.headers, name);
+    return v ? *v : String();
+}
+
+bool WebServer::hasHeader(const String& name) const { return findPair(req_.headers, name) != nullptr; }
+
+void WebServer::sendHeader(const String& name, const String& value, bool first) {
+    if (first) pendingHeaders_.insert(pendingHeaders_.begin(), {name, value});
+    else pendingHeaders_.push_back({name, value});
+}
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+    resp_.code = code;
+    resp_.contentType = contentType ? contentType : "";
+    resp_.body = content;
+    resp_.headers = pendingHeaders_;
+    pendingHeaders_.clear();
+}
+
+namespace sim {
+WebServer* webServer(int port) {
+    auto it = servers().find(port);
+    return it == servers().end() ? nullptr : it->second;
+}
+
+HttpResponse httpRequest(int port, const HttpRequest& req) {
+    WebServer* s = webServer(port);
+    if (s) return s->dispatch(req);
+    auto it = httpHandlers().find(port);
+    return it == httpHandlers().end() ? HttpResponse() : it->second(req);
+}
+
+void registerHttpHandler(int port, std::function<HttpResponse(const HttpRequest&)> fn) {
+    httpHandlers()[port] = fn;
+}
+
+bool popQueuedHttpRequest(int port, HttpRequest& out) {
+    std::lock_guard<std::mutex> g(pendingLock());
+    auto& q = pending()[port];
+    if (q.empty()) return false;
+    out = q.front();
+    q.pop_front();
+    return true;
+}
+
+void queueHttpRequest(int port, const HttpRequest& req) {
+    std::lock_guard<std::mutex> g(pendingLock());
+    pending()[port].push_back(req);
+}
+}
+
+
+// ===== HTTPClient =====
+namespace {
+sim::HttpClientSim clientState;
+}
+
+namespace sim {
+HttpClientSim& httpClient() { return clientState; }
+}
@@ -0,0 +1,159 @@
+// sim_rtos.cpp - задачи FreeRTOS поверх std::thread
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Arduino.h"
+#include "freertos/FreeRTOS.h"
+#include "hal_sim.h"
+
+struct SimTask {
+    SimTask(const char* n, uint32_t depth, BaseType_t c) : name(n), stackDepth(depth), core(c) {}
+
+    const char* name;
+    uint32_t stackDepth;
+    BaseType_t core;
+
+    std::mutex notifyLock;
+    std::condition_variable notifyCv;
+    uint32_t notifyCount = 0;
+
+    // Задача на шагах (sim::holdTask): стоит в vTaskDelay(), пока нет шага
+    std::mutex stepLock;
+    std::condition_variable stepCv;
+    bool stepped = false;
+    bool parked = false;
+    uint32_t grants = 0;
+    uint32_t passes = 0;               // Сколько раз задача дошла до vTaskDelay()
+};
+
+namespace {
+struct TaskExit {};
+
+thread_local SimTask* currentTask = nullptr;
+SimTask loopTask("loopTask", 8192, 1);
+
+std::mutex& tasksLock() {
+    static std::mutex m;
+    return m;
+}
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                                   void* arg, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t coreId) {
+    (void)priority;
+    SimTask* task = new SimTask(name, stackDepth, coreId == tskNO_AFFINITY ? 0 : coreId);
+    {
+        std::lock_guard<std::mutex> g(tasksLock());
+        if (handle) *handle = task;
+    }
+    std::thread([task, fn, arg]() {
+        currentTask = task;
+        try {
+            fn(arg);
+        } catch (const TaskExit&) {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    SimTask* t = currentTask;
+    if (t) {
+        std::unique_lock<std::mutex> g(t->stepLock);
+        if (t->stepped) {
+            t->parked = true;
+            t->passes++;
+            t->stepCv.notify_all();
+            t->stepCv.wait(g, [t] { return t->grants > 0 || !t->stepped; });
+            if (t->grants) t->grants--;
+            t->parked = false;
+            return;
+        }
+    }
+    if (sim::virtualClock()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ticks ? ticks : 1));
+    }
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == currentTask) throw TaskExit();
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+BaseType_t xPortGetCoreID() { return currentTask ? currentTask->core : loopTask.core; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    SimTask* t = task ? task : (currentTask ? currentTask : &loopTask);
+    return t->stackDepth / 2;   // На ПК глубину стека не измерить - отдаем условную половину
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    SimTask* t = task ? task : (currentTask ? currentTask : &loopTask);
+    return t->name;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentTask ? currentTask : &loopTask; }
+
+
+namespace sim {
+void holdTask(TaskHandle_t task, bool held) {
+    std::unique_lock<std::mutex> g(task->stepLock);
+    task->stepped = held;
+    task->grants = 0;
+    task->stepCv.notify_all();
+    if (held) task->stepCv.wait(g, [task] { return task->parked; });
+}
+
+void stepTask(TaskHandle_t task) {
+    std::unique_lock<std::mutex> g(task->stepLock);
+    if (!task->stepped) return;
+    uint32_t passes = task->passes;
+    task->grants++;
+    task->stepCv.notify_all();
+    task->stepCv.wait(g, [task, passes] { return task->passes != passes; });
+}
+}
+
+
+// ===== Уведомления =====
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> g(task->notifyLock);
+        task->notifyCount++;
+    }
+    task->notifyCv.notify_one();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    SimTask* t = currentTask ? currentTask : &loopTask;
+    std::unique_lock<std::mutex> g(t->notifyLock);
+    auto ready = [t] { return t->notifyCount > 0; };
+    if (sim::virtualClock()) {
+        // Время стоит: ждем уведомления не дольше 1 мс реального времени
+        if (ticksToWait > 0) t->notifyCv.wait_for(g, std::chrono::milliseconds(1), ready);
+    } else if (ticksToWait == portMAX_DELAY) {
+        t->notifyCv.wait(g, ready);
+    } else {
+        t->notifyCv.wait_for(g, std::chrono::milliseconds(ticksToWait), ready);
+    }
+    uint32_t value = t->notifyCount;
+    if (value > 0) t->notifyCount = clearCountOnExit ? 0 : value - 1;
+    return value;
+}
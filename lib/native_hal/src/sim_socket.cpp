@@ -0,0 +1,355 @@
+// sim_socket.cpp - настоящие сокеты ПК для WebServer, HTTPClient и WiFiUDP
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <strings.h>
+#include <unistd.h>
+#include <string>
+#include "HTTPClient.h"
+#include "WebServer.h"
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "hal_sim.h"
+
+namespace sim {
+uint16_t hostPort(uint16_t port) { return port < 1024 ? port + 8000 : port; }
+}
+
+namespace {
+sockaddr_in makeAddr(uint32_t ipNetOrder, uint16_t port) {
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = ipNetOrder;
+    return a;
+}
+
+// IPAddress хранит октеты в памяти по порядку - это и есть сетевой порядок
+uint32_t toNet(const IPAddress& ip) {
+    uint8_t b[4] = {ip[0], ip[1], ip[2], ip[3]};
+    uint32_t v;
+    memcpy(&v, b, 4);
+    return v;
+}
+
+IPAddress fromNet(uint32_t v) {
+    uint8_t b[4];
+    memcpy(b, &v, 4);
+    return IPAddress(b[0], b[1], b[2], b[3]);
+}
+
+bool waitFd(int fd, short events, int timeoutMs) {
+    pollfd p = {fd, events, 0};
+    return poll(&p, 1, timeoutMs) > 0;
+}
+
+bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string urlDecode(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') out += ' ';
+        else if (s[i] == '%' && i + 2 < s.size() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+            out += (char)(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]));
+            i += 2;
+        } else out += s[i];
+    }
+    return out;
+}
+
+void parseForm(const std::string& s, std::vector<std::pair<String, String>>& args) {
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t amp = s.find('&', pos);
+        if (amp == std::string::npos) amp = s.size();
+        std::string kv = s.substr(pos, amp - pos);
+        size_t eq = kv.find('=');
+        if (!kv.empty()) {
+            args.push_back({String(urlDecode(kv.substr(0, eq))),
+                            String(eq == std::string::npos ? "" : urlDecode(kv.substr(eq + 1)))});
+        }
+        pos = amp + 1;
+    }
+}
+
+const char* statusText(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 503: return "Service Unavailable";
+        default:  return "";
+    }
+}
+}
+
+
+// ===== WebServer =====
+void WebServer::begin() {
+    started_ = true;
+    if (listenFd_ >= 0) return;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = makeAddr(htonl(INADDR_ANY), sim::hostPort((uint16_t)port_));
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        fprintf(stderr, "[native] WebServer: порт %u занят, только sim::httpRequest()\n",
+                sim::hostPort((uint16_t)port_));
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    listenFd_ = fd;
+}
+
+void WebServer::stop() {
+    started_ = false;
+    if (listenFd_ >= 0) close(listenFd_);
+    listenFd_ = -1;
+}
+
+// Один клиент за вызов: читаем запрос целиком, отвечаем и закрываем
+bool WebServer::serveSocket() {
+    if (listenFd_ < 0) return false;
+    sockaddr_in peer;
+    socklen_t peerLen = sizeof(peer);
+    int fd = accept(listenFd_, (sockaddr*)&peer, &peerLen);
+    if (fd < 0) return false;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::string data;
+    size_t headerEnd = std::string::npos;
+    size_t contentLength = 0;
+    char buf[2048];
+    while (waitFd(fd, POLLIN, 1000)) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        data.append(buf, (size_t)n);
+        if (headerEnd == std::string::npos) {
+            headerEnd = data.find("\r\n\r\n");
+            if (headerEnd != std::string::npos) {
+                size_t cl = data.find("Content-Length:");
+                if (cl == std::string::npos) cl = data.find("content-length:");
+                if (cl != std::string::npos && cl < headerEnd) contentLength = strtoul(data.c_str() + cl + 15, nullptr, 10);
+            }
+        }
+        if (headerEnd != std::string::npos && data.size() >= headerEnd + 4 + contentLength) break;
+    }
+    if (headerEnd == std::string::npos) {
+        close(fd);
+        return false;
+    }
+
+    sim::HttpRequest req;
+    req.remote = fromNet(peer.sin_addr.s_addr);
+    size_t lineEnd = data.find("\r\n");
+    std::string line = data.substr(0, lineEnd);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    std::string method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.method = method == "POST" ? HTTP_POST : method == "PUT" ? HTTP_PUT :
+                 method == "DELETE" ? HTTP_DELETE : method == "HEAD" ? HTTP_HEAD : HTTP_GET;
+    size_t q = target.find('?');
+    req.uri = String(target.substr(0, q));
+    if (q != std::string::npos) parseForm(target.substr(q + 1), req.args);
+
+    size_t pos = lineEnd + 2;
+    while (pos < headerEnd) {
+        size_t e = data.find("\r\n", pos);
+        std::string h = data.substr(pos, e - pos);
+        size_t colon = h.find(':');
+        if (colon != std::string::npos) {
+            size_t v = h.find_first_not_of(' ', colon + 1);
+            req.headers.push_back({String(h.substr(0, colon)), String(v == std::string::npos ? "" : h.substr(v))});
+        }
+        pos = e + 2;
+    }
+    std::string body = data.substr(headerEnd + 4, contentLength);
+    // Как у WebServer ESP32: форма разбирается в аргументы, иначе тело целиком в "plain"
+    bool form = false;
+    for (const auto& h : req.headers) {
+        if (strcasecmp(h.first.c_str(), "Content-Type") == 0) form = strstr(h.second.c_str(), "x-www-form-urlencoded");
+    }
+    if (req.method == HTTP_POST && form) parseForm(body, req.args);
+    else if (!body.empty()) req.args.push_back({String("plain"), String(body)});
+
+    sim::HttpResponse resp = dispatch(req);
+    std::string out = "HTTP/1.1 " + std::to_string(resp.code) + " " + statusText(resp.code) + "\r\n";
+    if (!resp.contentType.isEmpty()) out += "Content-Type: " + resp.contentType.str() + "\r\n";
+    for (const auto& h : resp.headers) out += h.first.str() + ": " + h.second.str() + "\r\n";
+    out += "Content-Length: " + std::to_string(resp.body.length()) + "\r\nConnection: close\r\n\r\n";
+    out += resp.body.str();
+    sendAll(fd, out.data(), out.size());
+    close(fd);
+    return true;
+}
+
+
+// ===== HTTPClient =====
+int HTTPClient::request(const char* method, const String& payload) {
+    sim::HttpClientSim& state = sim::httpClient();
+    state.requests++;
+    if (WiFi.status() != WL_CONNECTED) return HTTPC_ERROR_CONNECTION_REFUSED;
+    if (state.latencyMs) delay(state.latencyMs);
+    response_ = String();
+    if (state.handler) return state.handler(url_, payload, response_);
+
+    // http://host[:port]/path
+    std::string url = url_.str();
+    if (url.compare(0, 7, "http://") == 0) url = url.substr(7);
+    size_t slash = url.find('/');
+    std::string hostPort = url.substr(0, slash);
+    std::string path = slash == std::string::npos ? "/" : url.substr(slash);
+    size_t colon = hostPort.find(':');
+    std::string host = hostPort.substr(0, colon);
+    uint16_t port = colon == std::string::npos ? 80 : (uint16_t)atoi(hostPort.c_str() + colon + 1);
+    if (host == "localhost") host = "127.0.0.1";
+
+    in_addr ip;
+    if (inet_pton(AF_INET, host.c_str(), &ip) != 1) return HTTPC_ERROR_CONNECTION_REFUSED;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in addr = makeAddr(ip.s_addr, sim::hostPort(port));
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    std::string req = std::string(method) + " " + path + " HTTP/1.1\r\nHost: " + hostPort + "\r\n" +
+                      headers_.str() + "Content-Length: " + std::to_string(payload.length()) +
+                      "\r\nConnection: close\r\n\r\n" + payload.str();
+    if (!sendAll(fd, req.data(), req.size())) {
+        close(fd);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    std::string data;
+    char buf[2048];
+    for (;;) {
+        if (!waitFd(fd, POLLIN, timeoutMs_)) {
+            close(fd);
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        data.append(buf, (size_t)n);
+    }
+    close(fd);
+
+    int code = 0;
+    if (sscanf(data.c_str(), "HTTP/1.%*d %d", &code) != 1) return HTTPC_ERROR_READ_TIMEOUT;
+    size_t bodyStart = data.find("\r\n\r\n");
+    if (bodyStart != std::string::npos) response_ = String(data.substr(bodyStart + 4));
+    return code;
+}
+
+
+// ===== WiFiUDP =====
+bool WiFiUDP::ensureSocket() {
+    if (fd_ >= 0) return true;
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) return false;
+    fcntl(fd_, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    stop();
+    if (!ensureSocket()) return 0;
+    int one = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = makeAddr(htonl(INADDR_ANY), sim::hostPort(port));
+    if (bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiUDP::stop() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    rxLen_ = rxPos_ = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    txIp_ = ip;
+    txPort_ = port;
+    txLen_ = 0;
+    return ensureSocket() ? 1 : 0;
+}
+
+int WiFiUDP::beginPacket(const char* host, uint16_t port) {
+    IPAddress ip;
+    if (!ip.fromString(strcmp(host, "localhost") == 0 ? "127.0.0.1" : host)) return 0;
+    return beginPacket(ip, port);
+}
+
+size_t WiFiUDP::write(const uint8_t* buf, size_t size) {
+    if (txLen_ + size > sizeof(tx_)) size = sizeof(tx_) - txLen_;
+    memcpy(tx_ + txLen_, buf, size);
+    txLen_ += size;
+    return size;
+}
+
+int WiFiUDP::endPacket() {
+    if (fd_ < 0 || WiFi.status() != WL_CONNECTED) return 0;
+    sockaddr_in addr = makeAddr(toNet(txIp_), sim::hostPort(txPort_));
+    ssize_t n = sendto(fd_, tx_, txLen_, 0, (sockaddr*)&addr, sizeof(addr));
+    txLen_ = 0;
+    return n >= 0 ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket() {
+    rxLen_ = rxPos_ = 0;
+    if (fd_ < 0) return 0;
+    sockaddr_in peer;
+    socklen_t peerLen = sizeof(peer);
+    ssize_t n = recvfrom(fd_, rx_, sizeof(rx_), 0, (sockaddr*)&peer, &peerLen);
+    if (n <= 0) return 0;
+    rxLen_ = (size_t)n;
+    remoteIp_ = fromNet(peer.sin_addr.s_addr);
+    remotePort_ = ntohs(peer.sin_port);
+    return (int)n;
+}
+
+int WiFiUDP::read() {
+    return rxPos_ < rxLen_ ? rx_[rxPos_++] : -1;
+}
+
+int WiFiUDP::read(uint8_t* buf, size_t len) {
+    size_t n = rxLen_ - rxPos_;
+    if (n > len) n = len;
+    memcpy(buf, rx_ + rxPos_, n);
+    rxPos_ += n;
+    return (int)n;
+}
+
+bool WiFiUDP::waitPacket(uint32_t timeoutMs) {
+    return fd_ >= 0 && waitFd(fd_, POLLIN, (int)timeoutMs);
+}